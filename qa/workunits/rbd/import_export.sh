@@ -254,6 +254,51 @@ rbd export sparse ${TMPDIR}/sparse
 [ $(stat ${TMPDIR}/sparse --format=%b) = '0' ]
 rbd rm sparse
 
+echo "sparse export skips objects missing from the fast-diff object map"
+# 1M objects, data in objects 3 and 40 only
+rm ${TMPDIR}/sparse || true
+dd if=/dev/urandom bs=1M seek=3 count=1 of=${TMPDIR}/sparse
+dd if=/dev/urandom bs=1M seek=40 count=1 of=${TMPDIR}/sparse conv=notrunc
+truncate ${TMPDIR}/sparse -s 64M
+rbd import --image-format 2 --order 20 \
+    --image-feature layering,exclusive-lock,object-map,fast-diff \
+    ${TMPDIR}/sparse sparse
+[ $tiered -eq 1 -o "$(objects sparse)" = '28 3' ]
+# drop in an object behind the object map's back: an export that only
+# reads allocated extents never sees it
+prefix=$(rbd info sparse | grep block_name_prefix | awk '{print $NF;}')
+dd if=/dev/urandom bs=1M count=1 | rados -p $(get_image_data_pool sparse) \
+                                        put ${prefix}.0000000000000010 -
+rbd export sparse ${TMPDIR}/sparse.out
+compare_files_and_ondisk_sizes ${TMPDIR}/sparse ${TMPDIR}/sparse.out
+rbd export sparse - > ${TMPDIR}/sparse.out
+cmp ${TMPDIR}/sparse ${TMPDIR}/sparse.out
+rm ${TMPDIR}/sparse.out
+# without a valid object map everything is read
+rbd feature disable sparse fast-diff
+rbd export sparse ${TMPDIR}/sparse.out
+cmp -s ${TMPDIR}/sparse ${TMPDIR}/sparse.out && exit 1 || true
+rm ${TMPDIR}/sparse.out
+rbd rm sparse
+
+echo "export and import with byte based concurrency"
+# 64K objects: 256 requests of 64K in flight instead of 1
+rbd import $RBD_CREATE_ARGS --order 16 --rbd-concurrent-management-ops 1 \
+    --rbd-concurrent-management-bytes 16M ${TMPDIR}/sparse sparse
+rbd export --rbd-concurrent-management-ops 1 \
+    --rbd-concurrent-management-bytes 16M sparse ${TMPDIR}/sparse.out
+compare_files_and_ondisk_sizes ${TMPDIR}/sparse ${TMPDIR}/sparse.out
+rm ${TMPDIR}/sparse.out
+rbd export --export-format 2 --rbd-concurrent-management-ops 1 \
+    --rbd-concurrent-management-bytes 16M sparse ${TMPDIR}/sparse_v2
+rbd import --export-format 2 --rbd-concurrent-management-ops 1 \
+    --rbd-concurrent-management-bytes 16M ${TMPDIR}/sparse_v2 sparse_import
+rbd export sparse_import ${TMPDIR}/sparse.out
+compare_files_and_ondisk_sizes ${TMPDIR}/sparse ${TMPDIR}/sparse.out
+rm ${TMPDIR}/sparse.out ${TMPDIR}/sparse_v2
+rbd rm sparse_import
+rbd rm sparse
+
 rm ${TMPDIR}/sparse ${TMPDIR}/sparse1 ${TMPDIR}/sparse2 ${TMPDIR}/sparse3 || true
 
 echo OK
@@ -145,6 +145,9 @@
 
 #define DEBUG_GETATTR_CAPS (CEPH_CAP_XATTR_SHARED)
 
+// writes at least this big copy the caller's data without client_lock
+#define WRITE_COPY_UNLOCKED_MIN (64 << 10)
+
 using namespace TOPNSPC::common;
 
 namespace bs = boost::system;
@@ -571,6 +574,8 @@ void Client::_finish_init()
     plb.add_time_avg(l_c_wrlat, "wrlat", "Latency of a file data write operation");
     plb.add_time_avg(l_c_read, "rdlat", "Latency of a file data read operation");
     plb.add_time_avg(l_c_fsync, "fsync", "Latency of a file sync operation");
+    plb.add_u64_counter(l_c_async_create, "async_create", "Creates completed without waiting for the MDS");
+    plb.add_u64_counter(l_c_async_unlink, "async_unlink", "Unlinks completed without waiting for the MDS");
     logger.reset(plb.create_perf_counters());
     cct->get_perfcounters_collection()->add(logger.get());
   }
@@ -1247,6 +1252,8 @@ void Client::insert_readdir_results(MetaRequest *request, MetaSession *session,
 
     _readdir_drop_dirp_buffer(dirp);
     dirp->buffer.reserve(numdn);
+    dirp->buffer_stamp = ceph::coarse_mono_clock::now();
+    dirp->buffer_start_name = readdir_start;
 
     string dname;
     LeaseStat dlease;
@@ -1673,13 +1680,8 @@ int Client::verify_reply_trace(int r, MetaSession *session,
 
      decode(ocres, extra_bl);
      created_ino = ocres.created_ino;
-     /*
-      * The userland cephfs client doesn't have a way to do an async create
-      * (yet), so just discard delegated_inos for now. Eventually we should
-      * store them and use them in create calls, even if they are synchronous,
-      * if only for testing purposes.
-      */
      ldout(cct, 10) << "delegated_inos: " << ocres.delegated_inos << dendl;
+     session->delegated_inos.union_of(ocres.delegated_inos);
     } else {
      // u64 containing number of created ino
      decode(created_ino, extra_bl);
@@ -1768,6 +1770,8 @@ int Client::make_request(MetaRequest *request,
 {
   int r = 0;
 
+  wait_on_async_ops(request);
+
   // assign a unique tid
   ceph_tid_t tid = ++last_tid;
   request->set_tid(tid);
@@ -1906,6 +1910,188 @@ int Client::make_request(MetaRequest *request,
   return r;
 }
 
+/*
+ * The session to send a create (need DIR_CREATE) or unlink (need
+ * DIR_UNLINK) in dir to without waiting for the reply, or null.  The
+ * first op in a dir only asks the mds for the caps, for the next ones.
+ */
+MetaSession *Client::get_async_dirop_session(Inode *dir, unsigned need)
+{
+  if (!cct->_conf.get_val<bool>("client_async_dirops"))
+    return nullptr;
+
+  if (!(dir->flags & I_DIROPS_WANTED)) {
+    dir->flags |= I_DIROPS_WANTED;
+    check_caps(dir, CHECK_CAPS_NODELAY);
+    return nullptr;
+  }
+
+  need |= CEPH_CAP_FILE_EXCL;
+  Cap *cap = dir->auth_cap;
+  if (!cap || !dir->cap_is_valid(*cap) || (cap->issued & need) != need)
+    return nullptr;
+  if (cap->session->state != MetaSession::STATE_OPEN)
+    return nullptr;
+  return cap->session;
+}
+
+/*
+ * Send a create or unlink and return without waiting for the reply.
+ * Requests that depend on it wait in make_request() until its first
+ * reply is in; a failure is reported through the async_err of the dir
+ * and of the created file.
+ */
+void Client::make_async_request(MetaRequest *request, const UserPerm& perms,
+				MetaSession *session)
+{
+  ceph_tid_t tid = ++last_tid;
+  request->set_tid(tid);
+  request->op_stamp = ceph_clock_now();
+
+  mds_requests[tid] = request->get();
+  if (oldest_tid == 0)
+    oldest_tid = tid;
+
+  request->set_caller_perms(perms);
+  if (cct->_conf->client_inject_fixed_oldest_tid) {
+    ldout(cct, 20) << __func__ << " injecting fixed oldest_client_tid(1)" << dendl;
+    request->set_oldest_client_tid(1);
+  } else {
+    request->set_oldest_client_tid(oldest_tid);
+  }
+  request->head.flags = request->head.flags | CEPH_MDS_FLAG_ASYNC;
+
+  // fsync of the dir or of the new file waits for it from now on
+  request->inode()->unsafe_ops.push_back(&request->unsafe_dir_item);
+  if (request->target)
+    request->target->unsafe_ops.push_back(&request->unsafe_target_item);
+
+  ldout(cct, 10) << __func__ << " tid " << tid << " "
+		 << ceph_mds_op_name(request->get_op()) << dendl;
+  send_request(request, session);
+  put_request(request);
+}
+
+void Client::wait_on_async_request(MetaRequest *request)
+{
+  ldout(cct, 10) << __func__ << " tid " << request->get_tid() << dendl;
+  request->get();
+  wait_on_list(request->waitfor_reply);
+  put_request(request);
+}
+
+/*
+ * The mds may not know about a file we created or unlinked until our
+ * async request gets there, so nothing that names it goes out before.
+ */
+void Client::wait_on_async_ops(MetaRequest *request)
+{
+  for (Inode *in : {request->inode(), request->old_inode(),
+		    request->other_inode()}) {
+    while (in && in->async_create_req)
+      wait_on_async_request(in->async_create_req);
+  }
+  for (Dentry *dn : {request->dentry(), request->old_dentry()}) {
+    while (dn && dn->async_unlink_req)
+      wait_on_async_request(dn->async_unlink_req);
+    while (dn && dn->inode && dn->inode->async_create_req)
+      wait_on_async_request(dn->inode->async_create_req);
+  }
+}
+
+/*
+ * An async request was forwarded, or got ESTALE: send it again, unless
+ * it has nowhere to go.
+ */
+void Client::resend_async_request(MetaRequest *request)
+{
+  mds_rank_t mds = choose_target_mds(request);
+  if (mds != MDS_RANK_NONE && have_open_session(mds)) {
+    send_request(request, &mds_sessions.at(mds));
+    return;
+  }
+
+  lderr(cct) << __func__ << " no session to mds." << mds << " for tid "
+	     << request->get_tid() << ", failing it" << dendl;
+  request->item.remove_myself();
+  finish_async_request(request, -CEPHFS_EIO);
+  request->unsafe_dir_item.remove_myself();
+  request->unsafe_target_item.remove_myself();
+  signal_cond_list(request->waitfor_safe);
+  unregister_request(request);
+}
+
+/*
+ * The first reply to an async request is in (r is its result), or the
+ * request is lost.
+ */
+void Client::finish_async_request(MetaRequest *request, int r)
+{
+  ldout(cct, 10) << __func__ << " tid " << request->get_tid() << " "
+		 << ceph_mds_op_name(request->get_op()) << " = " << r << dendl;
+
+  Inode *dir = request->inode();
+  Dentry *dn = request->dentry();
+  if (request->get_op() == CEPH_MDS_OP_CREATE) {
+    InodeRef in = request->target;
+    ceph_assert(in->async_create_req == request);
+    in->async_create_req = nullptr;
+    if (r < 0) {
+      lderr(cct) << "async create of " << dn->name << " in " << *dir
+		 << " failed: " << cpp_strerror(r) << dendl;
+      in->set_async_err(r);
+      dir->set_async_err(r);
+      if (dn->inode == in)
+	unlink(dn, true, true);
+      // we do not know what is there on the mds
+      dir->shared_gen++;
+      clear_dir_complete_and_ordered(dir, true);
+      // the file is gone; io on it fails once the caps are renewed
+      in->flags |= I_CAP_DROPPED;
+      if (in->dirty_caps) {
+	in->mark_caps_clean();
+	put_inode(in.get());
+      }
+      remove_all_caps(in.get());
+      signal_cond_list(in->waitfor_caps);
+    } else {
+      if (request->reply) {
+	auto& session = mds_sessions.at(request->mds);
+	bufferlist extra_bl = request->reply->get_extra_bl();
+	if (extra_bl.length() >= 8 &&
+	    session.mds_features.test(CEPHFS_FEATURE_DELEG_INO)) {
+	  openc_response_t ocres;
+	  decode(ocres, extra_bl);
+	  session.delegated_inos.union_of(ocres.delegated_inos);
+	}
+      }
+      // send what was held back
+      check_caps(in.get(), CHECK_CAPS_NODELAY);
+    }
+  } else {
+    ceph_assert(dn->async_unlink_req == request);
+    dn->async_unlink_req = nullptr;
+    if (r < 0) {
+      lderr(cct) << "async unlink of " << dn->name << " in " << *dir
+		 << " failed: " << cpp_strerror(r) << dendl;
+      dir->set_async_err(r);
+      // the name may still be there on the mds
+      dir->shared_gen++;
+      clear_dir_complete_and_ordered(dir, true);
+    }
+  }
+
+  if (request->reply) {
+    utime_t lat = ceph_clock_now();
+    lat -= request->sent_stamp;
+    ldout(cct, 20) << "lat " << lat << dendl;
+    logger->tinc(l_c_reply, lat);
+  }
+
+  signal_cond_list(request->waitfor_reply);
+  put_request(request);  // the inode's or dentry's ref
+}
+
 void Client::unregister_request(MetaRequest *req)
 {
   mds_requests.erase(req->tid);
@@ -2445,7 +2631,10 @@ void Client::handle_client_request_forward(const MConstRef<MClientRequestForward
   request->item.remove_myself();
   request->num_fwd = fwd->get_num_fwd();
   request->resend_mds = fwd->get_dest_mds();
-  request->caller_cond->notify_all();
+  if (request->is_async())
+    resend_async_request(request);
+  else
+    request->caller_cond->notify_all();
 }
 
 bool Client::is_dir_operation(MetaRequest *req)
@@ -2502,6 +2691,10 @@ void Client::handle_client_reply(const MConstRef<MClientReply>& reply)
          (it = in->caps.find(request->resend_mds)) != in->caps.end() ||
          request->sent_on_mseq == it->second.mseq)) {
       ldout(cct, 20) << "have to return ESTALE" << dendl;
+    } else if (request->is_async()) {
+      request->item.remove_myself();
+      resend_async_request(request);
+      return;
     } else {
       request->caller_cond->notify_all();
       return;
@@ -2516,12 +2709,15 @@ void Client::handle_client_reply(const MConstRef<MClientReply>& reply)
   if (!is_safe) {
     request->got_unsafe = true;
     session->unsafe_requests.push_back(&request->unsafe_item);
-    if (is_dir_operation(request)) {
+    // async requests are on them already, in the order they were sent
+    if (is_dir_operation(request) &&
+	!request->unsafe_dir_item.is_on_list()) {
       Inode *dir = request->inode();
       ceph_assert(dir);
       dir->unsafe_ops.push_back(&request->unsafe_dir_item);
     }
-    if (request->target) {
+    if (request->target &&
+	!request->unsafe_target_item.is_on_list()) {
       InodeRef &in = request->target;
       in->unsafe_ops.push_back(&request->unsafe_target_item);
     }
@@ -2529,7 +2725,11 @@ void Client::handle_client_reply(const MConstRef<MClientReply>& reply)
 
   // Only signal the caller once (on the first reply):
   // Either its an unsafe reply, or its a safe reply and no unsafe reply was sent.
-  if (!is_safe || !request->got_unsafe) {
+  if (request->is_async() && (!is_safe || !request->got_unsafe)) {
+    // the caller is long gone
+    finish_async_request(request, reply->get_result());
+    request->reply.reset();
+  } else if (!is_safe || !request->got_unsafe) {
     ceph::condition_variable cond;
     request->dispatch_cond = &cond;
 
@@ -2552,7 +2752,7 @@ void Client::handle_client_reply(const MConstRef<MClientReply>& reply)
   if (is_safe) {
     // the filesystem change is committed to disk
     // we're done, clean up
-    if (request->got_unsafe) {
+    if (request->got_unsafe || request->is_async()) {
       request->unsafe_item.remove_myself();
       request->unsafe_dir_item.remove_myself();
       request->unsafe_target_item.remove_myself();
@@ -2922,6 +3122,9 @@ void Client::send_reconnect(MetaSession *session)
 
   session->release.reset();
 
+  // the mds takes back whatever it delegated when it restarts
+  session->delegated_inos.clear();
+
   // reset my cap seq number
   session->seq = 0;
   //connect to the mds' offload targets
@@ -3064,12 +3267,22 @@ void Client::wait_unsafe_requests()
       last_unsafe_reqs.push_back(req);
     }
   }
+  // async requests get on the unsafe lists when the mds replies
+  for (auto p = mds_requests.rbegin(); p != mds_requests.rend(); ++p) {
+    MetaRequest *req = p->second;
+    if (req->is_async() && !req->got_unsafe) {
+      req->get();
+      last_unsafe_reqs.push_back(req);
+      break;
+    }
+  }
 
   for (list<MetaRequest*>::iterator p = last_unsafe_reqs.begin();
        p != last_unsafe_reqs.end();
        ++p) {
     MetaRequest *req = *p;
-    if (req->unsafe_item.is_on_list())
+    if (req->unsafe_item.is_on_list() ||
+	(req->is_async() && mds_requests.count(req->get_tid())))
       wait_on_list(req->waitfor_safe);
     put_request(req);
   }
@@ -3088,7 +3301,9 @@ void Client::kick_requests_closed(MetaSession *session)
 	req->caller_cond->notify_all();
       }
       req->item.remove_myself();
-      if (req->got_unsafe) {
+      if (req->is_async() && !req->got_unsafe)
+	finish_async_request(req, -CEPHFS_EIO);
+      if (req->got_unsafe || req->is_async()) {
 	lderr(cct) << __func__ << " removing unsafe request " << req->get_tid() << dendl;
 	req->unsafe_item.remove_myself();
 	if (is_dir_operation(req)) {
@@ -3740,6 +3955,12 @@ void Client::check_caps(Inode *in, unsigned flags)
   if (in->caps.empty())
     return;   // guard if at end of func
 
+  if (in->async_create_req) {
+    // the mds does not know the inode until the create gets there
+    ldout(cct, 10) << __func__ << " async create in flight, holding caps" << dendl;
+    return;
+  }
+
   if (!(orig_used & CEPH_CAP_FILE_BUFFER) &&
       (revoking & used & (CEPH_CAP_FILE_CACHE | CEPH_CAP_FILE_LAZYIO))) {
     if (_release(in))
@@ -4192,6 +4413,14 @@ void Client::check_cap_issue(Inode *in, unsigned issued)
     if (in->is_dir())
       clear_dir_complete_and_ordered(in, true);
   }
+
+  if (in->is_dir()) {
+    if ((had & CEPH_CAP_DIR_CREATE) && !(issued & CEPH_CAP_DIR_CREATE))
+      in->cached_layout = file_layout_t();
+    // stop asking for the dir ops caps once the mds takes them back
+    if ((had & CEPH_CAP_FILE_EXCL) && !(issued & CEPH_CAP_FILE_EXCL))
+      in->flags &= ~I_DIROPS_WANTED;
+  }
 }
 
 void Client::add_update_cap(Inode *in, MetaSession *mds_session, uint64_t cap_id,
@@ -8860,6 +9089,11 @@ int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p,
     ldout(cct, 10) << "frag " << fg << " buffer size " << dirp->buffer.size()
 		   << " offset " << hex << dirp->offset << dendl;
 
+    bool refetch = false;
+    auto attr_timeout = cct->_conf.get_val<std::chrono::milliseconds>(
+      "client_readdir_attr_timeout");
+    bool buffer_fresh =
+      dirp->buffer_stamp + attr_timeout > ceph::coarse_mono_clock::now();
     for (auto it = std::lower_bound(dirp->buffer.begin(), dirp->buffer.end(),
 				    dirp->offset, dir_result_t::dentry_off_lt());
 	 it != dirp->buffer.end();
@@ -8874,9 +9108,30 @@ int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p,
 	if(entry.inode->is_dir()){
           mask |= CEPH_STAT_RSTAT;
 	}
-	r = _getattr(entry.inode, mask, dirp->perms);
-	if (r < 0)
-	  return r;
+	if (buffer_fresh || diri->snapid == CEPH_SNAPDIR ||
+	    entry.inode->caps_issued_mask(mask, true)) {
+	  // the attributes from the readdir reply are recent enough
+	} else {
+	  // rather than a getattr round trip for this and each following
+	  // uncapped entry, read the rest of the chunk again: one readdir
+	  // reply carries fresh attributes (and caps) for all of them.
+	  dirp->last_name = it == dirp->buffer.begin() ?
+	    dirp->buffer_start_name : std::prev(it)->name;
+	  ldout(cct, 10) << " no caps on " << entry.name
+			 << ", refetching from after '" << dirp->last_name
+			 << "'" << dendl;
+	  dirp->next_offset = dir_result_t::fpos_low(entry.offset);
+	  if (dirp->release_count == diri->dir_release_count &&
+	      dirp->ordered_count == diri->dir_ordered_count &&
+	      dirp->start_shared_gen == diri->shared_gen) {
+	    // the entries read again take their old places in the
+	    // readdir cache
+	    dirp->cache_index -= dirp->buffer.end() - it;
+	  }
+	  _readdir_drop_dirp_buffer(dirp);
+	  refetch = true;
+	  break;
+	}
       }
 
       fill_statx(entry.inode, caps, &stx);
@@ -8902,6 +9157,9 @@ int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p,
 	return r;
     }
 
+    if (refetch)
+      continue;
+
     if (dirp->next_offset > 2) {
       ldout(cct, 10) << " fetching next chunk of this frag" << dendl;
       _readdir_drop_dirp_buffer(dirp);
@@ -10222,6 +10480,42 @@ int64_t Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf,
 
   uint64_t fpos = 0;
 
+  // copy into fresh buffer (since our write may be resub, async).  The
+  // copy touches only the caller's memory, so don't make every other
+  // thread wait for it unless it is small.  Nothing is checked until
+  // client_lock is held again, and the Fh, which holds the inode, is
+  // pinned in case another thread closes it meanwhile.
+  bufferlist bl;
+  {
+    bool unlock = size >= WRITE_COPY_UNLOCKED_MIN;
+    if (unlock) {
+      f->get();
+      client_lock.unlock();
+    }
+    if (buf) {
+      if (size > 0)
+        bl.append(buf, size);
+    } else if (iov) {
+      // size may have been clamped below the sum of the iov lengths
+      uint64_t left = size;
+      for (int i = 0; i < iovcnt && left > 0; i++) {
+        uint64_t len = std::min<uint64_t>(iov[i].iov_len, left);
+        if (len > 0) {
+          bl.append((const char *)iov[i].iov_base, len);
+          left -= len;
+        }
+      }
+    }
+    if (unlock) {
+      client_lock.lock();
+      if (f->put() == 0) {
+        // released while we were copying
+        delete f;
+        return -CEPHFS_EBADF;
+      }
+    }
+  }
+
   if ((uint64_t)(offset+size) > mdsmap->get_max_filesize()) //too large!
     return -CEPHFS_EFBIG;
 
@@ -10278,19 +10572,6 @@ int64_t Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf,
     ceph_assert(in->inline_version > 0);
   }
 
-  // copy into fresh buffer (since our write may be resub, async)
-  bufferlist bl;
-  if (buf) {
-    if (size > 0)
-      bl.append(buf, size);
-  } else if (iov){
-    for (int i = 0; i < iovcnt; i++) {
-      if (iov[i].iov_len > 0) {
-        bl.append((const char *)iov[i].iov_base, iov[i].iov_len);
-      }
-    }
-  }
-
   utime_t lat;
   uint64_t totalwritten;
   int want, have;
@@ -10552,6 +10833,10 @@ int Client::_fsync(Inode *in, bool syncdataonly)
     ldout(cct, 15) << "using return-valued form of _fsync" << dendl;
   }
   
+  // no caps can be flushed before the mds has the inode
+  while (!syncdataonly && in->async_create_req)
+    wait_on_async_request(in->async_create_req);
+
   if (!syncdataonly && in->dirty_caps) {
     check_caps(in, CHECK_CAPS_NODELAY|CHECK_CAPS_SYNCHRONOUS);
     if (in->flushing_caps)
@@ -13148,9 +13433,34 @@ int Client::_create(Inode *dir, const char *name, int flags, mode_t mode,
     goto fail;
   req->set_dentry(de);
 
-  res = make_request(req, perms, inp, created);
-  if (res < 0) {
-    goto reply_error;
+  if (MetaSession *session = get_async_dirop_session(dir, CEPH_CAP_DIR_CREATE);
+      session && !de->inode && !de->async_unlink_req &&
+      !session->delegated_inos.empty() &&
+      dir->cached_layout.is_valid() &&
+      !stripe_unit && !stripe_count && !object_size && pool_id < 0 &&
+      xattrs_bl.length() == 0 && req->alternate_name.empty()) {
+    inodeno_t ino = session->delegated_inos.range_start();
+    session->delegated_inos.erase(ino);
+    req->head.ino = ino;
+    req->head.args.open.flags = req->head.args.open.flags | CEPH_O_EXCL;
+
+    *inp = add_async_create_inode(de, ino, mode, cmode, perms, session);
+    (*inp)->async_create_req = req->get();
+    req->target = *inp;
+    if (created)
+      *created = true;
+    make_async_request(req, perms, session);
+    logger->inc(l_c_async_create);
+  } else {
+    res = make_request(req, perms, inp, created);
+    if (res < 0) {
+      goto reply_error;
+    }
+    // what the mds would give the next files created here
+    if ((dir->caps_issued() & CEPH_CAP_DIR_CREATE) &&
+	!dir->cached_layout.is_valid() &&
+	!stripe_unit && !stripe_count && !object_size && pool_id < 0)
+      dir->cached_layout = (*inp)->layout;
   }
 
   /* If the caller passed a value in fhp, do the open */
@@ -13174,6 +13484,46 @@ int Client::_create(Inode *dir, const char *name, int flags, mode_t mode,
   return res;
 }
 
+/*
+ * Link the inode an async create of dn will make, as the mds will make
+ * it: with the delegated ino, the layout of the files created in the
+ * dir so far and the caps the create reply would issue.
+ */
+Inode *Client::add_async_create_inode(Dentry *dn, inodeno_t ino, mode_t mode,
+				      int cmode, const UserPerm& perms,
+				      MetaSession *session)
+{
+  Inode *dir = dn->dir->parent_inode;
+  utime_t now = ceph_clock_now();
+
+  InodeStat st;
+  st.vino = vinodeno_t(ino, CEPH_NOSNAP);
+  st.mode = mode;
+  st.uid = perms.uid();
+  st.gid = (dir->mode & S_ISGID) ? dir->gid : perms.gid();
+  st.nlink = 1;
+  st.layout = dir->cached_layout;
+  st.max_size = st.layout.stripe_unit;
+  st.truncate_seq = 1;
+  st.truncate_size = -1ull;
+  st.ctime = st.mtime = st.atime = st.btime = now;
+  st.inline_version = CEPH_INLINE_NONE;
+  st.dir_pin = MDS_RANK_NONE;
+  st.cap.caps = CEPH_CAP_PIN | CEPH_CAP_ANY_SHARED | CEPH_CAP_AUTH_EXCL |
+		CEPH_CAP_XATTR_EXCL | ceph_caps_for_mode(cmode);
+  st.cap.wanted = ceph_caps_for_mode(cmode);
+  st.cap.cap_id = 1;  // what the mds gives the first cap on a new inode
+  st.cap.seq = 0;
+  st.cap.mseq = 0;
+  st.cap.realm = dir->snaprealm->ino;
+  st.cap.flags = CEPH_CAP_FLAG_AUTH;
+
+  Inode *in = add_update_inode(&st, now, session, perms);
+  LeaseStat dlease;  // Fs on the dir covers the dentry
+  insert_dentry_inode(dn->dir, dn->name, &dlease, in, now, session);
+  return in;
+}
+
 int Client::_mkdir(Inode *dir, const char *name, mode_t mode, const UserPerm& perm,
 		   InodeRef *inp, const std::map<std::string, std::string> &metadata,
                    std::string alternate_name)
@@ -13481,7 +13831,18 @@ int Client::_unlink(Inode *dir, const char *name, const UserPerm& perm)
 
   req->set_inode(dir);
 
-  res = make_request(req, perm);
+  if (MetaSession *session = get_async_dirop_session(dir, CEPH_CAP_DIR_UNLINK);
+      session && !in->is_dir() && !in->async_create_req) {
+    clear_dir_complete_and_ordered(dir, false);
+    unlink(de, true, true);
+    if (in->nlink > 0)
+      in->nlink--;
+    de->async_unlink_req = req->get();
+    make_async_request(req, perm, session);
+    logger->inc(l_c_async_unlink);
+  } else {
+    res = make_request(req, perm);
+  }
 
   trim_cache();
   ldout(cct, 8) << "unlink(" << path << ") = " << res << dendl;
@@ -77,6 +77,8 @@ enum {
   l_c_wrlat,
   l_c_read,
   l_c_fsync,
+  l_c_async_create,
+  l_c_async_unlink,
   l_c_last,
 };
 
@@ -224,6 +226,8 @@ struct dir_result_t {
   UserPerm perms;
 
   frag_t buffer_frag;
+  ceph::coarse_mono_time buffer_stamp; // when the buffer was read
+  string buffer_start_name;            // last_name the buffer was read after
 
   vector<dentry> buffer;
   struct dirent de;
@@ -915,6 +919,16 @@ protected:
   int make_request(MetaRequest *req, const UserPerm& perms,
 		   InodeRef *ptarget = 0, bool *pcreated = 0,
 		   mds_rank_t use_mds=-1, bufferlist *pdirbl=0);
+  MetaSession *get_async_dirop_session(Inode *dir, unsigned need);
+  void make_async_request(MetaRequest *req, const UserPerm& perms,
+			  MetaSession *session);
+  void wait_on_async_request(MetaRequest *req);
+  void wait_on_async_ops(MetaRequest *req);
+  void resend_async_request(MetaRequest *req);
+  void finish_async_request(MetaRequest *req, int r);
+  Inode *add_async_create_inode(Dentry *dn, inodeno_t ino, mode_t mode,
+				int cmode, const UserPerm& perms,
+				MetaSession *session);
   void put_request(MetaRequest *request);
   void unregister_request(MetaRequest *request);
 
@@ -91,6 +91,7 @@ public:
   ceph_seq_t lease_seq = 0;
   int cap_shared_gen = 0;
   std::string alternate_name;
+  MetaRequest *async_unlink_req = nullptr;  // unlink sent, no reply yet
 
 private:
   xlist<Dentry *>::item inode_xlist_link;
@@ -325,6 +325,9 @@ int Inode::caps_wanted()
   int want = caps_file_wanted() | caps_used();
   if (want & CEPH_CAP_FILE_BUFFER)
     want |= CEPH_CAP_FILE_EXCL;
+  if (flags & I_DIROPS_WANTED)
+    want |= CEPH_CAP_PIN | CEPH_CAP_FILE_SHARED | CEPH_CAP_FILE_EXCL |
+	    CEPH_CAP_ANY_DIR_OPS;
   return want;
 }
 
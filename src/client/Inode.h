@@ -113,6 +113,7 @@ struct CapSnap {
 #define I_KICK_FLUSH		(1 << 3)
 #define I_CAP_DROPPED		(1 << 4)
 #define I_ERROR_FILELOCK	(1 << 5)
+#define I_DIROPS_WANTED		(1 << 6)
 
 struct Inode : RefCountedObject {
   Client *client;
@@ -276,6 +277,9 @@ struct Inode : RefCountedObject {
 
   xlist<MetaRequest*> unsafe_ops;
 
+  MetaRequest *async_create_req = nullptr;  // create sent, no reply yet
+  file_layout_t cached_layout;  // dir: layout for async creates in it
+
   std::set<Fh*> fhs;
 
   mds_rank_t dir_pin = MDS_RANK_NONE;
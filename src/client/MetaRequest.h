@@ -68,6 +68,7 @@ public:
   ceph::condition_variable *caller_cond;          // who to take up
   ceph::condition_variable *dispatch_cond;        // who to kick back
   list<ceph::condition_variable*> waitfor_safe;
+  list<ceph::condition_variable*> waitfor_reply;  // async requests only
 
   InodeRef target;
   UserPerm perms;
@@ -183,6 +184,9 @@ public:
   void set_dentry_wanted() {
     head.flags = head.flags | CEPH_MDS_FLAG_WANT_DENTRY;
   }
+  bool is_async() const {
+    return head.flags & CEPH_MDS_FLAG_ASYNC;
+  }
   int get_op() { return head.op; }
   ceph_tid_t get_tid() { return tid; }
   filepath& get_filepath() { return path; }
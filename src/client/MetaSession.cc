@@ -40,6 +40,7 @@ void MetaSession::dump(Formatter *f, bool cap_dump) const
     f->close_section();
   }
   f->dump_string("state", get_state_name());
+  f->dump_stream("delegated_inos") << delegated_inos;
 }
 
 void MetaSession::enqueue_cap_release(inodeno_t ino, uint64_t cap_id, ceph_seq_t iseq,
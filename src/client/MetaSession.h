@@ -4,6 +4,7 @@
 #ifndef CEPH_CLIENT_METASESSION_H
 #define CEPH_CLIENT_METASESSION_H
 
+#include "include/interval_set.h"
 #include "include/types.h"
 #include "include/utime.h"
 #include "include/xlist.h"
@@ -56,6 +57,9 @@ struct MetaSession {
 
   ceph::ref_t<MClientCapRelease> release;
 
+  // inode numbers the mds delegated to us, for async creates
+  interval_set<inodeno_t> delegated_inos;
+
   MetaSession(mds_rank_t mds_num, ConnectionRef con, const entity_addrvec_t& addrs)
     : mds_num(mds_num), con(con), addrs(addrs) {
   }
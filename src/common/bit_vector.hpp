@@ -184,6 +184,8 @@ public:
   uint64_t size() const;
 
   const bufferlist& get_data() const;
+  // contiguous packed element data for bulk (word at a time) operations
+  uint8_t* get_data_buffer();
 
   Reference operator[](uint64_t offset);
   ConstReference operator[](uint64_t offset) const;
@@ -298,6 +300,14 @@ const bufferlist& BitVector<_b>::get_data() const {
   return m_data;
 }
 
+template <uint8_t _b>
+uint8_t* BitVector<_b>::get_data_buffer() {
+  if (m_data.length() == 0) {
+    return nullptr;
+  }
+  return reinterpret_cast<uint8_t*>(m_data.c_str());
+}
+
 template <uint8_t _b>
 void BitVector<_b>::compute_index(uint64_t offset, uint64_t *index, uint64_t *shift) {
   *index = offset / ELEMENTS_PER_BLOCK;
@@ -0,0 +1,193 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_COMMON_SHARDED_SHARED_MUTEX_H
+#define CEPH_COMMON_SHARDED_SHARED_MUTEX_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+
+#ifdef CEPH_DEBUG_MUTEX
+#include "common/mutex_debug.h"
+#endif
+
+namespace ceph {
+
+// A reader-biased shared mutex for read-mostly data consulted on hot
+// paths from many threads.
+//
+// Even uncontended, every lock_shared() on a single shared_mutex is
+// an atomic read-modify-write on the same cache line, so with enough
+// threads the lock word itself becomes the bottleneck.  Here each
+// thread is assigned one of several cache line aligned shards and
+// shared ownership only touches that shard.  Exclusive ownership
+// acquires every shard, in order, so writers pay in proportion to
+// the number of shards; this is only a win when writes are rare.
+//
+// Satisfies Lockable and SharedLockable, so it works with
+// std::unique_lock, std::shared_lock and ceph::shunique_lock.  Like
+// std::shared_mutex, shared ownership must be released by the thread
+// that acquired it.  With CEPH_DEBUG_MUTEX the mutex as a whole, not
+// each shard, is tracked by lockdep under the given name, like
+// ceph::shared_mutex_debug, and supports the ceph_mutex_is_*() checks.
+class sharded_shared_mutex
+#ifdef CEPH_DEBUG_MUTEX
+  : public mutex_debug_detail::mutex_debugging_base
+#endif
+{
+  struct alignas(64) shard_t {
+    std::shared_mutex lock;
+  };
+
+  const unsigned num_shards;
+  std::unique_ptr<shard_t[]> shards;
+
+  shard_t& my_shard() {
+    return shards[thread_slot() % num_shards];
+  }
+
+#ifdef CEPH_DEBUG_MUTEX
+  std::atomic<unsigned> nrlock{0};
+
+  void _pre_lock() {
+    if (_enable_lockdep()) {
+      _will_lock();
+    }
+  }
+  void _post_lock() {
+    if (_enable_lockdep()) {
+      _locked();
+    }
+    ceph_assert(nlock == 0);
+    locked_by = std::this_thread::get_id();
+    ++nlock;
+  }
+  void _pre_unlock() {
+    ceph_assert(nlock > 0);
+    ceph_assert(locked_by == std::this_thread::get_id());
+    --nlock;
+    locked_by = std::thread::id();
+    if (_enable_lockdep()) {
+      _will_unlock();
+    }
+  }
+  void _post_lock_shared() {
+    if (_enable_lockdep()) {
+      _locked();
+    }
+    ++nrlock;
+  }
+  void _pre_unlock_shared() {
+    ceph_assert(nrlock > 0);
+    --nrlock;
+    if (_enable_lockdep()) {
+      _will_unlock();
+    }
+  }
+#else
+  void _pre_lock() {}
+  void _post_lock() {}
+  void _pre_unlock() {}
+  void _post_lock_shared() {}
+  void _pre_unlock_shared() {}
+#endif
+
+public:
+  // Small dense per-thread number, assigned on first use.  Exposed so
+  // that callers keeping their own per-thread state next to the lock
+  // (counters, queues) map each thread the same way the lock does.
+  static unsigned thread_slot() {
+    static std::atomic<unsigned> next_slot{0};
+    static thread_local const unsigned slot = next_slot++;
+    return slot;
+  }
+
+  static unsigned default_num_shards() {
+    return std::clamp(std::thread::hardware_concurrency(), 1u, 32u);
+  }
+
+#ifdef CEPH_DEBUG_MUTEX
+  explicit sharded_shared_mutex(std::string name,
+				unsigned n = default_num_shards())
+    : mutex_debugging_base(std::move(name)),
+      num_shards(std::max(n, 1u)),
+      shards(new shard_t[num_shards]) {}
+#else
+  // the name is for lockdep in debug builds, as with make_shared_mutex()
+  explicit sharded_shared_mutex(const std::string& name,
+				unsigned n = default_num_shards())
+    : num_shards(std::max(n, 1u)),
+      shards(new shard_t[num_shards]) {}
+#endif
+  sharded_shared_mutex(const sharded_shared_mutex&) = delete;
+  sharded_shared_mutex& operator=(const sharded_shared_mutex&) = delete;
+
+  unsigned get_num_shards() const {
+    return num_shards;
+  }
+
+  // Lockable
+  void lock() {
+    _pre_lock();
+    for (unsigned i = 0; i < num_shards; ++i) {
+      shards[i].lock.lock();
+    }
+    _post_lock();
+  }
+  bool try_lock() {
+    for (unsigned i = 0; i < num_shards; ++i) {
+      if (!shards[i].lock.try_lock()) {
+	while (i > 0) {
+	  shards[--i].lock.unlock();
+	}
+	return false;
+      }
+    }
+    _post_lock();
+    return true;
+  }
+  void unlock() {
+    _pre_unlock();
+    for (unsigned i = num_shards; i > 0; --i) {
+      shards[i - 1].lock.unlock();
+    }
+  }
+
+  // SharedLockable
+  void lock_shared() {
+    _pre_lock();
+    my_shard().lock.lock_shared();
+    _post_lock_shared();
+  }
+  bool try_lock_shared() {
+    if (!my_shard().lock.try_lock_shared()) {
+      return false;
+    }
+    _post_lock_shared();
+    return true;
+  }
+  void unlock_shared() {
+    _pre_unlock_shared();
+    my_shard().lock.unlock_shared();
+  }
+
+#ifdef CEPH_DEBUG_MUTEX
+  bool is_wlocked() const {
+    return nlock > 0;
+  }
+  bool is_rlocked() const {
+    return nrlock > 0;
+  }
+  bool is_locked() const {
+    return nlock > 0 || nrlock > 0;
+  }
+#endif
+};
+
+} // namespace ceph
+
+#endif // CEPH_COMMON_SHARDED_SHARED_MUTEX_H
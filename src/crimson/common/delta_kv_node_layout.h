@@ -0,0 +1,1138 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <string.h>
+
+#include "include/byteorder.h"
+
+#include "crimson/common/fixed_kv_node_layout.h"
+
+namespace crimson::common {
+
+/**
+ * delta_varint helpers
+ *
+ * Little endian base-128 varints used by DeltaKVNodeLayout codecs.
+ * Each returns the number of bytes produced/consumed.
+ */
+constexpr size_t DELTA_VARINT_MAX_SIZE = 10;
+
+inline size_t encode_delta_varint(char *out, uint64_t v) {
+  size_t len = 0;
+  while (v >= 0x80) {
+    out[len++] = static_cast<char>((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  out[len++] = static_cast<char>(v);
+  return len;
+}
+
+inline size_t decode_delta_varint(const char *in, uint64_t &v) {
+  v = 0;
+  size_t len = 0;
+  unsigned shift = 0;
+  uint8_t byte;
+  do {
+    byte = static_cast<uint8_t>(in[len++]);
+    v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return len;
+}
+
+inline size_t encode_delta_signed_varint(char *out, int64_t v) {
+  return encode_delta_varint(
+    out,
+    (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+}
+
+inline size_t decode_delta_signed_varint(const char *in, int64_t &v) {
+  uint64_t u;
+  auto len = decode_delta_varint(in, u);
+  v = static_cast<int64_t>(u >> 1) ^ -static_cast<int64_t>(u & 1);
+  return len;
+}
+
+/**
+ * DeltaKVNodeLayout
+ *
+ * Reusable implementation of a fixed size block mapping K -> V in
+ * which each entry is encoded relative to its predecessor, allowing
+ * runs of adjacent keys and values to be stored in a byte or two per
+ * entry.
+ *
+ * Entries are grouped into blocks of at most ENTRIES_PER_BLOCK
+ * entries.  The first entry of each block uses Codec's fixed width
+ * full encoding so that lookups can binary search the block heads
+ * and then decode at most ENTRIES_PER_BLOCK entries.  The remaining
+ * entries of a block are delta encoded against the preceding entry.
+ *
+ * Layout (NODE_SIZE):
+ *   header     : header_t                   (8 + sizeof(MetaInt))b
+ *   payload    : encoded blocks, front to back
+ *   (free)
+ *   slots      : block_slot_t[num_blocks], back to front
+ *
+ * Capacity is expressed in bytes rather than entries.  Mutations
+ * decode and re-encode only the affected block, shifting those
+ * following it, so a single insert/update/replace/remove grows the
+ * encoding by at most get_max_op_growth() bytes.  Users must split
+ * before any such operation when at_max_capacity().
+ *
+ * Codec must provide:
+ *   static constexpr size_t FULL_SIZE;
+ *   static constexpr size_t MAX_DELTA_SIZE;
+ *   static void encode_full(char *out, const K &, const V &);
+ *   static std::pair<K, V> decode_full(const char *in);
+ *   static size_t encode_delta(
+ *     char *out, const std::pair<K, V> &prev, const K &, const V &);
+ *   static size_t decode_delta(
+ *     const char *in, const std::pair<K, V> &prev, std::pair<K, V> &out);
+ *
+ * The primary interface mirrors FixedKVNodeLayout so that users can
+ * switch between the two with minimal changes.
+ */
+template <
+  size_t NODE_SIZE,
+  size_t ENTRIES_PER_BLOCK,
+  typename Meta,
+  typename MetaInt,
+  typename K,
+  typename KINT,
+  typename V,
+  typename VINT,
+  typename Codec>
+class DeltaKVNodeLayout {
+  char *buf = nullptr;
+
+  struct header_t {
+    ceph_le16 size;
+    ceph_le16 num_blocks;
+    ceph_le16 payload_len;
+    ceph_le16 reserved;
+    MetaInt meta;
+  };
+
+  struct block_slot_t {
+    ceph_le16 offset; ///< offset of block within payload
+    ceph_le16 start;  ///< index of first entry in block
+  };
+
+  static_assert(ENTRIES_PER_BLOCK > 1);
+  static_assert(NODE_SIZE <= std::numeric_limits<uint16_t>::max());
+
+  static constexpr size_t HEADER_SIZE = sizeof(header_t);
+  static constexpr size_t SLOT_SIZE = sizeof(block_slot_t);
+  static constexpr size_t MAX_ENTRY_SIZE =
+    std::max(Codec::FULL_SIZE, Codec::MAX_DELTA_SIZE);
+
+public:
+  using entry_t = std::pair<K, V>;
+
+  static constexpr size_t PAYLOAD_CAPACITY = NODE_SIZE - HEADER_SIZE;
+
+  template <bool is_const>
+  struct iter_t {
+    friend class DeltaKVNodeLayout;
+    using parent_t = typename maybe_const_t<DeltaKVNodeLayout, is_const>::type;
+
+    parent_t node;
+    uint16_t offset;
+
+    iter_t(
+      parent_t parent,
+      uint16_t offset) : node(parent), offset(offset) {}
+
+    iter_t(const iter_t &) = default;
+    iter_t(iter_t &&) = default;
+    iter_t &operator=(const iter_t &) = default;
+    iter_t &operator=(iter_t &&) = default;
+
+    operator iter_t<!is_const>() const {
+      static_assert(!is_const);
+      return iter_t<!is_const>(node, offset);
+    }
+
+    // Work nicely with for loops without requiring a nested type.
+    iter_t &operator*() { return *this; }
+    iter_t *operator->() { return this; }
+
+    iter_t operator++(int) {
+      auto ret = *this;
+      ++offset;
+      return ret;
+    }
+
+    iter_t &operator++() {
+      ++offset;
+      return *this;
+    }
+
+    uint16_t operator-(const iter_t &rhs) const {
+      assert(rhs.node == node);
+      return offset - rhs.offset;
+    }
+
+    iter_t operator+(uint16_t off) const {
+      return iter_t(
+	node,
+	offset + off);
+    }
+    iter_t operator-(uint16_t off) const {
+      return iter_t(
+	node,
+	offset - off);
+    }
+
+    bool operator==(const iter_t &rhs) const {
+      assert(node == rhs.node);
+      return rhs.offset == offset;
+    }
+
+    bool operator!=(const iter_t &rhs) const {
+      return !(*this == rhs);
+    }
+
+    K get_key() const {
+      return node->get_entry(offset).first;
+    }
+
+    K get_next_key_or_max() const {
+      auto next = *this + 1;
+      if (next == node->end())
+	return std::numeric_limits<K>::max();
+      else
+	return next->get_key();
+    }
+
+    /**
+     * set_val
+     *
+     * Re-encodes the node, prefer DeltaKVNodeLayout::update_vals
+     * when updating many entries.
+     */
+    void set_val(V val) const {
+      static_assert(!is_const);
+      node->update(*this, val);
+    }
+
+    V get_val() const {
+      return node->get_entry(offset).second;
+    };
+
+    bool contains(K addr) const {
+      return (get_key() <= addr) && (get_next_key_or_max() > addr);
+    }
+
+    uint16_t get_offset() const {
+      return offset;
+    }
+  };
+  using const_iterator = iter_t<true>;
+  using iterator = iter_t<false>;
+
+  struct delta_t {
+    enum class op_t : uint8_t {
+      INSERT,
+      REMOVE,
+      UPDATE,
+    } op;
+    KINT key;
+    VINT val;
+
+    void replay(DeltaKVNodeLayout &l) {
+      switch (op) {
+      case op_t::INSERT: {
+	l.insert(l.lower_bound(key), key, val);
+	break;
+      }
+      case op_t::REMOVE: {
+	auto iter = l.find(key);
+	assert(iter != l.end());
+	l.remove(iter);
+	break;
+      }
+      case op_t::UPDATE: {
+	auto iter = l.find(key);
+	assert(iter != l.end());
+	l.update(iter, val);
+	break;
+      }
+      default:
+	assert(0 == "Impossible");
+      }
+    }
+
+    bool operator==(const delta_t &rhs) const {
+      return op == rhs.op &&
+	key == rhs.key &&
+	val == rhs.val;
+    }
+  };
+
+public:
+  class delta_buffer_t {
+    std::vector<delta_t> buffer;
+  public:
+    bool empty() const {
+      return buffer.empty();
+    }
+    void insert(
+      const K &key,
+      const V &val) {
+      KINT k;
+      k = key;
+      buffer.push_back(
+	delta_t{
+	  delta_t::op_t::INSERT,
+	  k,
+	  VINT(val)
+	});
+    }
+    void update(
+      const K &key,
+      const V &val) {
+      KINT k;
+      k = key;
+      buffer.push_back(
+	delta_t{
+	  delta_t::op_t::UPDATE,
+	  k,
+	  VINT(val)
+	});
+    }
+    void remove(const K &key) {
+      KINT k;
+      k = key;
+      buffer.push_back(
+	delta_t{
+	  delta_t::op_t::REMOVE,
+	  k,
+	  VINT()
+	});
+    }
+    void replay(DeltaKVNodeLayout &node) {
+      for (auto &i: buffer) {
+	i.replay(node);
+      }
+    }
+    size_t get_bytes() const {
+      return buffer.size() * sizeof(delta_t);
+    }
+    void copy_out(char *out, size_t len) {
+      assert(len == get_bytes());
+      ::memcpy(out, reinterpret_cast<const void *>(buffer.data()), get_bytes());
+      buffer.clear();
+    }
+    void copy_in(const char *out, size_t len) {
+      assert(empty());
+      assert(len % sizeof(delta_t) == 0);
+      buffer = std::vector(
+	reinterpret_cast<const delta_t*>(out),
+	reinterpret_cast<const delta_t*>(out + len));
+    }
+    bool operator==(const delta_buffer_t &rhs) const {
+      return buffer == rhs.buffer;
+    }
+  };
+
+  void journal_insert(
+    const_iterator _iter,
+    const K &key,
+    const V &val,
+    delta_buffer_t *recorder) {
+    auto iter = iterator(this, _iter.offset);
+    if (recorder) {
+      recorder->insert(
+	key,
+	val);
+    }
+    insert(iter, key, val);
+  }
+
+  void journal_update(
+    const_iterator _iter,
+    const V &val,
+    delta_buffer_t *recorder) {
+    auto iter = iterator(this, _iter.offset);
+    if (recorder) {
+      recorder->update(iter->get_key(), val);
+    }
+    update(iter, val);
+  }
+
+  void journal_replace(
+    const_iterator _iter,
+    const K &key,
+    const V &val,
+    delta_buffer_t *recorder) {
+    auto iter = iterator(this, _iter.offset);
+    if (recorder) {
+      recorder->remove(iter->get_key());
+      recorder->insert(key, val);
+    }
+    replace(iter, key, val);
+  }
+
+  void journal_remove(
+    const_iterator _iter,
+    delta_buffer_t *recorder) {
+    auto iter = iterator(this, _iter.offset);
+    if (recorder) {
+      recorder->remove(iter->get_key());
+    }
+    remove(iter);
+  }
+
+
+  DeltaKVNodeLayout(char *buf) :
+    buf(buf) {}
+
+  virtual ~DeltaKVNodeLayout() = default;
+
+  const_iterator begin() const {
+    return const_iterator(
+      this,
+      0);
+  }
+
+  const_iterator end() const {
+    return const_iterator(
+      this,
+      get_size());
+  }
+
+  iterator begin() {
+    return iterator(
+      this,
+      0);
+  }
+
+  iterator end() {
+    return iterator(
+      this,
+      get_size());
+  }
+
+  const_iterator iter_idx(uint16_t off) const {
+    return const_iterator(
+      this,
+      off);
+  }
+
+  const_iterator find(K l) const {
+    auto ret = lower_bound(l);
+    if (ret != end() && ret->get_key() != l) {
+      return end();
+    }
+    return ret;
+  }
+  iterator find(K l) {
+    const auto &tref = *this;
+    return iterator(this, tref.find(l).offset);
+  }
+
+  const_iterator lower_bound(K l) const {
+    return iter_idx(search([&l](const K &k) { return k >= l; }));
+  }
+  iterator lower_bound(K l) {
+    const auto &tref = *this;
+    return iterator(this, tref.lower_bound(l).offset);
+  }
+
+  const_iterator upper_bound(K l) const {
+    return iter_idx(search([&l](const K &k) { return k > l; }));
+  }
+  iterator upper_bound(K l) {
+    const auto &tref = *this;
+    return iterator(this, tref.upper_bound(l).offset);
+  }
+
+  uint16_t get_size() const {
+    return get_header().size;
+  }
+
+  /**
+   * clear
+   *
+   * Resets the node to contain no entries, meta is unchanged.
+   */
+  void clear() {
+    encode_blocks({});
+  }
+
+  /**
+   * get_meta/set_meta
+   *
+   * Enables stashing a templated type within the layout.
+   * Cannot be modified after initial write as it is not represented
+   * in delta_t
+   */
+  Meta get_meta() const {
+    return Meta(get_header().meta);
+  }
+  void set_meta(const Meta &meta) {
+    get_header().meta = MetaInt(meta);
+  }
+
+  /// bytes of payload and block slots currently in use
+  size_t get_used_bytes() const {
+    return get_header().payload_len + (get_header().num_blocks * SLOT_SIZE);
+  }
+
+  size_t get_free_bytes() const {
+    return PAYLOAD_CAPACITY - get_used_bytes();
+  }
+
+  /**
+   * get_max_op_growth
+   *
+   * Upper bound on the growth of the encoding caused by a single
+   * insert, update, replace or remove: the entry itself, the
+   * re-encoding of its successor and a block split.
+   */
+  static constexpr size_t get_max_op_growth() {
+    return (3 * MAX_ENTRY_SIZE) + SLOT_SIZE;
+  }
+
+  bool at_max_capacity() const {
+    return get_free_bytes() < get_max_op_growth() ||
+      get_size() == std::numeric_limits<uint16_t>::max();
+  }
+
+  /**
+   * at_min_capacity
+   *
+   * Two nodes at min capacity are guaranteed to merge into a node
+   * which is not at max capacity.
+   */
+  bool at_min_capacity() const {
+    return get_used_bytes() <= (PAYLOAD_CAPACITY / 4);
+  }
+
+  bool operator==(const DeltaKVNodeLayout &rhs) const {
+    if (get_size() != rhs.get_size()) {
+      return false;
+    }
+
+    auto iter = begin();
+    auto iter2 = rhs.begin();
+    while (iter != end()) {
+      if (iter->get_key() != iter2->get_key() ||
+	  iter->get_val() != iter2->get_val()) {
+	return false;
+      }
+      iter++;
+      iter2++;
+    }
+    return true;
+  }
+
+  /**
+   * update_vals
+   *
+   * Applies f to each value in [from, to) and re-encodes the node
+   * once.  f must not change the relative ordering of values in a
+   * way which grows the encoding by more than get_free_bytes().
+   */
+  template <typename F>
+  void update_vals(const_iterator from, const_iterator to, F &&f) {
+    auto blocks = decode_blocks();
+    for_each_in_range(blocks, from.offset, to.offset, [&f](entry_t &e) {
+      e.second = f(e.second);
+    });
+    [[maybe_unused]] bool fits = encode_blocks(blocks);
+    assert(fits);
+  }
+
+  /**
+   * split_into
+   *
+   * Takes *this and splits its contents into left and right such
+   * that each receives roughly half of the encoded bytes.
+   */
+  K split_into(
+    DeltaKVNodeLayout &left,
+    DeltaKVNodeLayout &right) const {
+    assert(get_size() > 1);
+    auto blocks = decode_blocks();
+    auto pivot_idx = pick_pivot(blocks, get_used_bytes() / 2);
+    auto [lblocks, rblocks] = cut_blocks(std::move(blocks), pivot_idx);
+    auto pivot = rblocks.front().front().first;
+
+    left.fill_from_foreign(*this, std::move(lblocks));
+    right.fill_from_foreign(*this, std::move(rblocks));
+
+    auto [lmeta, rmeta] = get_meta().split_into(pivot);
+    left.set_meta(lmeta);
+    right.set_meta(rmeta);
+
+    return pivot;
+  }
+
+  /**
+   * merge_from
+   *
+   * Takes two nodes and copies their contents into *this.
+   *
+   * precondition: left.at_min_capacity() && right.at_min_capacity()
+   */
+  void merge_from(
+    const DeltaKVNodeLayout &left,
+    const DeltaKVNodeLayout &right)
+  {
+    auto lblocks = left.decode_blocks();
+    auto rblocks = right.decode_blocks();
+    left.resolve_blocks(lblocks);
+    right.resolve_blocks(rblocks);
+    lblocks.insert(
+      lblocks.end(),
+      std::make_move_iterator(rblocks.begin()),
+      std::make_move_iterator(rblocks.end()));
+    unresolve_blocks(lblocks);
+    [[maybe_unused]] bool fits = encode_blocks(lblocks);
+    assert(fits);
+    set_meta(Meta::merge_from(left.get_meta(), right.get_meta()));
+  }
+
+  /**
+   * balance_into_new_nodes
+   *
+   * Takes the contents of left and right and copies them into
+   * replacement_left and replacement_right such that each receives
+   * roughly half of the encoded bytes.  In the event of a tie the
+   * extra entry goes to the left side iff prefer_left.
+   */
+  static K balance_into_new_nodes(
+    const DeltaKVNodeLayout &left,
+    const DeltaKVNodeLayout &right,
+    bool prefer_left,
+    DeltaKVNodeLayout &replacement_left,
+    DeltaKVNodeLayout &replacement_right)
+  {
+    assert(left.get_size() + right.get_size() > 1);
+    auto lblocks = left.decode_blocks();
+    auto rblocks = right.decode_blocks();
+    left.resolve_blocks(lblocks);
+    right.resolve_blocks(rblocks);
+    auto total = left.get_used_bytes() + right.get_used_bytes();
+    lblocks.insert(
+      lblocks.end(),
+      std::make_move_iterator(rblocks.begin()),
+      std::make_move_iterator(rblocks.end()));
+
+    auto target = total / 2;
+    if (total % 2 && prefer_left) {
+      target++;
+    }
+    auto pivot_idx = pick_pivot(lblocks, target);
+    auto [nl, nr] = cut_blocks(std::move(lblocks), pivot_idx);
+    auto replacement_pivot = nr.front().front().first;
+
+    replacement_left.unresolve_blocks(nl);
+    [[maybe_unused]] bool lfits = replacement_left.encode_blocks(nl);
+    assert(lfits);
+    replacement_right.unresolve_blocks(nr);
+    [[maybe_unused]] bool rfits = replacement_right.encode_blocks(nr);
+    assert(rfits);
+
+    auto [lmeta, rmeta] = Meta::rebalance(
+      left.get_meta(), right.get_meta(), replacement_pivot);
+    replacement_left.set_meta(lmeta);
+    replacement_right.set_meta(rmeta);
+    return replacement_pivot;
+  }
+
+private:
+  using block_t = std::vector<entry_t>;
+  using block_list_t = std::vector<block_t>;
+
+  /// single block decode cache, entries are decoded lazily on access
+  mutable int cached_block = -1;
+  mutable block_t cached_entries;
+
+  header_t &get_header() {
+    return *reinterpret_cast<header_t*>(buf);
+  }
+  const header_t &get_header() const {
+    return *reinterpret_cast<const header_t*>(buf);
+  }
+
+  const char *get_payload() const {
+    return buf + HEADER_SIZE;
+  }
+
+  const block_slot_t &get_slot(uint16_t block) const {
+    assert(block < get_header().num_blocks);
+    return *reinterpret_cast<const block_slot_t*>(
+      buf + NODE_SIZE - ((block + 1) * SLOT_SIZE));
+  }
+
+  uint16_t get_block_start(uint16_t block) const {
+    return block == get_header().num_blocks ?
+      get_size() : uint16_t(get_slot(block).start);
+  }
+
+  K get_block_head_key(uint16_t block) const {
+    return Codec::decode_full(get_payload() + get_slot(block).offset).first;
+  }
+
+  /// returns index of the block containing entry idx
+  uint16_t get_block_for(uint16_t idx) const {
+    assert(idx < get_size());
+    uint16_t lo = 0, hi = get_header().num_blocks;
+    while (hi - lo > 1) {
+      uint16_t mid = lo + (hi - lo) / 2;
+      if (get_slot(mid).start <= idx) {
+	lo = mid;
+      } else {
+	hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  const block_t &get_block(uint16_t block) const {
+    if (cached_block != int(block)) {
+      cached_entries = decode_block(block);
+      cached_block = block;
+    }
+    return cached_entries;
+  }
+
+  block_t decode_block(uint16_t block) const {
+    block_t ret;
+    unsigned count = get_block_start(block + 1) - get_block_start(block);
+    ret.reserve(count);
+    const char *p = get_payload() + get_slot(block).offset;
+    ret.push_back(Codec::decode_full(p));
+    p += Codec::FULL_SIZE;
+    for (unsigned i = 1; i < count; ++i) {
+      entry_t next = ret.back();
+      p += Codec::decode_delta(p, ret.back(), next);
+      ret.push_back(next);
+    }
+    return ret;
+  }
+
+  block_list_t decode_blocks() const {
+    block_list_t ret;
+    ret.reserve(get_header().num_blocks);
+    for (uint16_t i = 0; i < get_header().num_blocks; ++i) {
+      ret.push_back(decode_block(i));
+    }
+    return ret;
+  }
+
+  const entry_t &get_entry(uint16_t idx) const {
+    auto block = get_block_for(idx);
+    return get_block(block)[idx - get_block_start(block)];
+  }
+
+  /**
+   * search
+   *
+   * Returns the index of the first entry for which pred(key) holds,
+   * pred must be monotonic over the keys.
+   */
+  template <typename P>
+  uint16_t search(P &&pred) const {
+    uint16_t lo = 0, hi = get_header().num_blocks;
+    while (lo < hi) {
+      uint16_t mid = lo + (hi - lo) / 2;
+      if (pred(get_block_head_key(mid))) {
+	hi = mid;
+      } else {
+	lo = mid + 1;
+      }
+    }
+    // lo is the first block whose head satisfies pred, the answer is
+    // either within the preceding block or lo's head.
+    if (lo == 0) {
+      return 0;
+    }
+    const auto &entries = get_block(lo - 1);
+    for (unsigned i = 1; i < entries.size(); ++i) {
+      if (pred(entries[i].first)) {
+	return get_block_start(lo - 1) + i;
+      }
+    }
+    return get_block_start(lo);
+  }
+
+  /**
+   * encode_blocks
+   *
+   * Encodes blocks into the node, returns false without modifying
+   * the node if they do not fit.  Unused bytes are zeroed so that
+   * the encoding (and hence the crc) depends only on the contents.
+   */
+  bool encode_blocks(const block_list_t &blocks) {
+    char scratch[NODE_SIZE];
+    size_t payload_len = 0;
+    size_t size = 0;
+    auto nblocks = blocks.size();
+    for (auto &block : blocks) {
+      assert(!block.empty());
+      assert(block.size() <= ENTRIES_PER_BLOCK);
+      if (payload_len + MAX_ENTRY_SIZE * block.size() +
+	  nblocks * SLOT_SIZE > PAYLOAD_CAPACITY) {
+	// slow path, compute exact size before writing
+	if (payload_len + encoded_block_size(block) +
+	    nblocks * SLOT_SIZE > PAYLOAD_CAPACITY) {
+	  return false;
+	}
+      }
+      auto slot = reinterpret_cast<block_slot_t*>(
+	scratch + NODE_SIZE - ((&block - blocks.data() + 1) * SLOT_SIZE));
+      slot->offset = payload_len;
+      slot->start = size;
+      payload_len += encode_block(scratch + HEADER_SIZE + payload_len, block);
+      size += block.size();
+    }
+    if (size > std::numeric_limits<uint16_t>::max()) {
+      return false;
+    }
+    auto slots_len = nblocks * SLOT_SIZE;
+    ::memcpy(buf + HEADER_SIZE, scratch + HEADER_SIZE, payload_len);
+    ::memset(
+      buf + HEADER_SIZE + payload_len,
+      0,
+      PAYLOAD_CAPACITY - payload_len - slots_len);
+    ::memcpy(
+      buf + NODE_SIZE - slots_len,
+      scratch + NODE_SIZE - slots_len,
+      slots_len);
+    auto &header = get_header();
+    header.size = size;
+    header.num_blocks = nblocks;
+    header.payload_len = payload_len;
+    header.reserved = 0;
+    cached_block = -1;
+    return true;
+  }
+
+  static size_t encode_block(char *out, const block_t &block) {
+    char *p = out;
+    Codec::encode_full(p, block.front().first, block.front().second);
+    p += Codec::FULL_SIZE;
+    for (unsigned i = 1; i < block.size(); ++i) {
+      p += Codec::encode_delta(
+	p, block[i - 1], block[i].first, block[i].second);
+    }
+    return p - out;
+  }
+
+  static size_t encoded_block_size(const block_t &block) {
+    char scratch[MAX_ENTRY_SIZE * ENTRIES_PER_BLOCK];
+    return encode_block(scratch, block);
+  }
+
+  template <typename F>
+  static void for_each_in_range(
+    block_list_t &blocks, uint16_t from, uint16_t to, F &&f) {
+    uint16_t idx = 0;
+    for (auto &block : blocks) {
+      for (auto &e : block) {
+	if (idx >= from && idx < to) {
+	  f(e);
+	}
+	++idx;
+      }
+    }
+  }
+
+  /// returns <block, position in block> for entry idx, idx may be size
+  static std::pair<size_t, size_t> locate(
+    const block_list_t &blocks, uint16_t idx) {
+    size_t block = 0;
+    for (; block < blocks.size(); ++block) {
+      if (idx < blocks[block].size()) {
+	return std::make_pair(block, idx);
+      }
+      idx -= blocks[block].size();
+    }
+    assert(idx == 0);
+    return std::make_pair(block, 0);
+  }
+
+  /**
+   * pick_pivot
+   *
+   * Returns the index of the first entry of the right side when
+   * splitting blocks after roughly target encoded bytes.  Always
+   * leaves at least one entry on each side.
+   */
+  static uint16_t pick_pivot(const block_list_t &blocks, size_t target) {
+    size_t total_entries = 0;
+    for (auto &block : blocks) {
+      total_entries += block.size();
+    }
+    assert(total_entries > 1);
+    char scratch[MAX_ENTRY_SIZE];
+    size_t bytes = 0;
+    uint16_t idx = 0;
+    for (auto &block : blocks) {
+      bytes += SLOT_SIZE;
+      for (unsigned i = 0; i < block.size(); ++i, ++idx) {
+	if (i == 0) {
+	  bytes += Codec::FULL_SIZE;
+	} else {
+	  bytes += Codec::encode_delta(
+	    scratch, block[i - 1], block[i].first, block[i].second);
+	}
+	if (bytes > target) {
+	  return std::clamp<size_t>(idx, 1, total_entries - 1);
+	}
+      }
+    }
+    return total_entries - 1;
+  }
+
+  /// splits blocks into [0, pivot_idx) and [pivot_idx, size)
+  static std::pair<block_list_t, block_list_t> cut_blocks(
+    block_list_t &&blocks, uint16_t pivot_idx) {
+    auto [block, pos] = locate(blocks, pivot_idx);
+    block_list_t left(
+      std::make_move_iterator(blocks.begin()),
+      std::make_move_iterator(blocks.begin() + block));
+    block_list_t right;
+    if (pos > 0) {
+      auto &b = blocks[block];
+      left.emplace_back(b.begin(), b.begin() + pos);
+      right.emplace_back(b.begin() + pos, b.end());
+      block++;
+    }
+    right.insert(
+      right.end(),
+      std::make_move_iterator(blocks.begin() + block),
+      std::make_move_iterator(blocks.end()));
+    return std::make_pair(std::move(left), std::move(right));
+  }
+
+  /**
+   * replace_block
+   *
+   * Replaces block (or, if block == num_blocks, appends) with the
+   * encoding of replacement, which may hold zero or more blocks.
+   * Only the affected block is re-encoded, later blocks are shifted.
+   * Returns false without modifying the node if the result does not
+   * fit.
+   */
+  bool replace_block(uint16_t block, const block_list_t &replacement) {
+    auto &header = get_header();
+    uint16_t nblocks = header.num_blocks;
+    size_t payload_len = header.payload_len;
+    assert(block <= nblocks);
+    bool existing = block < nblocks;
+    size_t old_begin = existing ? size_t(get_slot(block).offset) : payload_len;
+    size_t old_end = (block + 1 < nblocks) ?
+      size_t(get_slot(block + 1).offset) : payload_len;
+    size_t old_count = existing ?
+      get_block_start(block + 1) - get_block_start(block) : 0;
+    uint16_t first = get_block_start(block);
+
+    char scratch[NODE_SIZE];
+    size_t new_len = 0;
+    size_t new_count = 0;
+    std::vector<block_slot_t> new_slots;
+    new_slots.reserve(replacement.size());
+    for (auto &b : replacement) {
+      assert(!b.empty());
+      assert(b.size() <= ENTRIES_PER_BLOCK);
+      if (new_len + (MAX_ENTRY_SIZE * b.size()) > NODE_SIZE) {
+	return false;
+      }
+      block_slot_t slot;
+      slot.offset = old_begin + new_len;
+      slot.start = first + new_count;
+      new_slots.push_back(slot);
+      new_len += encode_block(scratch + new_len, b);
+      new_count += b.size();
+    }
+
+    size_t new_nblocks = nblocks - (existing ? 1 : 0) + replacement.size();
+    size_t new_payload_len = payload_len - (old_end - old_begin) + new_len;
+    size_t new_size = get_size() - old_count + new_count;
+    if (new_payload_len + (new_nblocks * SLOT_SIZE) > PAYLOAD_CAPACITY ||
+	new_size > std::numeric_limits<uint16_t>::max()) {
+      return false;
+    }
+
+    // gather slots for blocks following the replaced one before the
+    // payload and slot arrays are rearranged
+    std::vector<block_slot_t> tail_slots;
+    for (uint16_t i = block + (existing ? 1 : 0); i < nblocks; ++i) {
+      block_slot_t slot;
+      slot.offset = get_slot(i).offset + new_len - (old_end - old_begin);
+      slot.start = get_slot(i).start + new_count - old_count;
+      tail_slots.push_back(slot);
+    }
+
+    char *payload = buf + HEADER_SIZE;
+    ::memmove(
+      payload + old_begin + new_len,
+      payload + old_end,
+      payload_len - old_end);
+    ::memcpy(payload + old_begin, scratch, new_len);
+
+    auto write_slot = [this](size_t i, const block_slot_t &slot) {
+      ::memcpy(buf + NODE_SIZE - ((i + 1) * SLOT_SIZE), &slot, SLOT_SIZE);
+    };
+    size_t i = block;
+    for (auto &slot : new_slots) {
+      write_slot(i++, slot);
+    }
+    for (auto &slot : tail_slots) {
+      write_slot(i++, slot);
+    }
+    assert(i == new_nblocks);
+
+    ::memset(
+      payload + new_payload_len,
+      0,
+      PAYLOAD_CAPACITY - new_payload_len - (new_nblocks * SLOT_SIZE));
+    header.size = new_size;
+    header.num_blocks = new_nblocks;
+    header.payload_len = new_payload_len;
+    cached_block = -1;
+    return true;
+  }
+
+  void insert(
+    iterator iter,
+    const K &key,
+    const V &val) {
+    if (iter != begin()) {
+      assert((iter - 1)->get_key() < key);
+    }
+    if (iter != end()) {
+      assert(iter->get_key() > key);
+    }
+    [[maybe_unused]] bool fits;
+    if (get_header().num_blocks == 0) {
+      fits = replace_block(0, block_list_t{block_t{entry_t(key, val)}});
+    } else {
+      // Prefer appending to the preceding block over displacing the
+      // head of the following one.
+      uint16_t block = iter.offset == get_size() ?
+	get_header().num_blocks - 1 : get_block_for(iter.offset);
+      if (block > 0 && iter.offset == get_block_start(block)) {
+	block--;
+      }
+      auto b = decode_block(block);
+      b.insert(b.begin() + (iter.offset - get_block_start(block)),
+	       entry_t(key, val));
+      block_list_t replacement;
+      if (b.size() > ENTRIES_PER_BLOCK) {
+	auto mid = b.begin() + b.size() / 2;
+	block_t tail(mid, b.end());
+	b.erase(mid, b.end());
+	replacement.push_back(std::move(b));
+	replacement.push_back(std::move(tail));
+      } else {
+	replacement.push_back(std::move(b));
+      }
+      fits = replace_block(block, replacement);
+    }
+    assert(fits);
+  }
+
+  /// applies f to the entry at iter
+  template <typename F>
+  void mutate_entry(iterator iter, F &&f) {
+    assert(iter != end());
+    auto block = get_block_for(iter.offset);
+    auto b = decode_block(block);
+    f(b[iter.offset - get_block_start(block)]);
+    [[maybe_unused]] bool fits = replace_block(
+      block, block_list_t{std::move(b)});
+    assert(fits);
+  }
+
+  void update(
+    iterator iter,
+    V val) {
+    mutate_entry(iter, [&val](entry_t &e) {
+      e.second = val;
+    });
+  }
+
+  void replace(
+    iterator iter,
+    const K &key,
+    const V &val) {
+    assert(iter != end());
+    if (iter != begin()) {
+      assert((iter - 1)->get_key() < key);
+    }
+    if ((iter + 1) != end()) {
+      assert((iter + 1)->get_key() > key);
+    }
+    mutate_entry(iter, [&key, &val](entry_t &e) {
+      e = entry_t(key, val);
+    });
+  }
+
+  void remove(iterator iter) {
+    assert(iter != end());
+    auto block = get_block_for(iter.offset);
+    auto b = decode_block(block);
+    b.erase(b.begin() + (iter.offset - get_block_start(block)));
+    block_list_t replacement;
+    if (!b.empty()) {
+      replacement.push_back(std::move(b));
+    }
+    [[maybe_unused]] bool fits = replace_block(block, replacement);
+    assert(fits);
+  }
+
+  /**
+   * node_resolve/unresolve_vals
+   *
+   * If the representation for values depends in some way on the
+   * node in which they are located, users may implement
+   * resolve/unresolve to enable copies between nodes to handle that
+   * transition.  Codecs must not grow the encoding as a result.
+   */
+  virtual void node_resolve_vals([[maybe_unused]] entry_t *from,
+				 [[maybe_unused]] entry_t *to) const {}
+  virtual void node_unresolve_vals([[maybe_unused]] entry_t *from,
+				   [[maybe_unused]] entry_t *to) const {}
+
+  void resolve_blocks(block_list_t &blocks) const {
+    for (auto &block : blocks) {
+      node_resolve_vals(block.data(), block.data() + block.size());
+    }
+  }
+
+  void unresolve_blocks(block_list_t &blocks) const {
+    for (auto &block : blocks) {
+      node_unresolve_vals(block.data(), block.data() + block.size());
+    }
+  }
+
+  /**
+   * fill_from_foreign
+   *
+   * Replaces the contents of *this with blocks taken from src.
+   */
+  void fill_from_foreign(
+    const DeltaKVNodeLayout &src,
+    block_list_t &&blocks) {
+    assert(&src != this);
+    src.resolve_blocks(blocks);
+    unresolve_blocks(blocks);
+    [[maybe_unused]] bool fits = encode_blocks(blocks);
+    assert(fits);
+  }
+};
+
+}
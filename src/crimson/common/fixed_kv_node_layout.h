@@ -358,10 +358,9 @@ public:
   }
 
   const_iterator find(K l) const {
-    auto ret = begin();
-    for (; ret != end(); ++ret) {
-      if (ret->get_key() == l)
-	break;
+    auto ret = lower_bound(l);
+    if (ret != end() && ret->get_key() != l) {
+      return end();
     }
     return ret;
   }
@@ -371,12 +370,7 @@ public:
   }
 
   const_iterator lower_bound(K l) const {
-    auto ret = begin();
-    for (; ret != end(); ++ret) {
-      if (ret->get_key() >= l)
-	break;
-    }
-    return ret;
+    return search([&l](const K &k) { return k >= l; });
   }
   iterator lower_bound(K l) {
     const auto &tref = *this;
@@ -384,12 +378,7 @@ public:
   }
 
   const_iterator upper_bound(K l) const {
-    auto ret = begin();
-    for (; ret != end(); ++ret) {
-      if (ret->get_key() > l)
-	break;
-    }
-    return ret;
+    return search([&l](const K &k) { return k > l; });
   }
   iterator upper_bound(K l) {
     const auto &tref = *this;
@@ -567,6 +556,26 @@ public:
   }
 
 private:
+  /**
+   * search
+   *
+   * Binary search for the first entry for which pred(key) holds,
+   * pred must be monotonic over the (sorted) keys.
+   */
+  template <typename P>
+  const_iterator search(P &&pred) const {
+    uint16_t lo = 0, hi = get_size();
+    while (lo < hi) {
+      uint16_t mid = lo + (hi - lo) / 2;
+      if (pred(K(get_key_ptr()[mid]))) {
+	hi = mid;
+      } else {
+	lo = mid + 1;
+      }
+    }
+    return iter_idx(lo);
+  }
+
   void insert(
     iterator iter,
     const K &key,
@@ -27,7 +27,7 @@ BtreeLBAManager::mkfs_ret BtreeLBAManager::mkfs(
     auto root_leaf = cache.alloc_new_extent<LBALeafNode>(
       t,
       LBA_BLOCK_SIZE);
-    root_leaf->set_size(0);
+    root_leaf->clear();
     lba_node_meta_t meta{0, L_ADDR_MAX, 1};
     root_leaf->set_meta(meta);
     root_leaf->pin.set_range(meta);
@@ -512,6 +512,42 @@ BtreeLBAManager::BtreeLBAManager(
   : segment_manager(segment_manager),
     cache(cache) {}
 
+BtreeLBAManager::split_root_ret BtreeLBAManager::split_root(
+  Transaction &t,
+  LBANodeRef root,
+  laddr_t laddr)
+{
+  return cache.get_root(t).safe_then(
+    [this, root, laddr, &t](RootBlockRef croot) {
+      logger().debug(
+	"BtreeLBAManager::split_root: splitting root {}",
+	*croot);
+      {
+	auto mut_croot = cache.duplicate_for_write(t, croot);
+	croot = mut_croot->cast<RootBlock>();
+      }
+      auto nroot = cache.alloc_new_extent<LBAInternalNode>(t, LBA_BLOCK_SIZE);
+      lba_node_meta_t meta{0, L_ADDR_MAX, root->get_node_meta().depth + 1};
+      nroot->set_meta(meta);
+      nroot->pin.set_range(meta);
+      nroot->journal_insert(
+	nroot->begin(),
+	L_ADDR_MIN,
+	root->get_paddr(),
+	nullptr);
+      croot->get_root().lba_root = lba_root_t{
+	nroot->get_paddr(),
+	root->get_node_meta().depth + 1
+      };
+      return nroot->split_entry(
+	get_context(t),
+	laddr, nroot->begin(), root
+      ).safe_then([nroot](auto) {
+	return split_root_ertr::make_ready_future<LBANodeRef>(nroot);
+      });
+    });
+}
+
 BtreeLBAManager::insert_mapping_ret BtreeLBAManager::insert_mapping(
   Transaction &t,
   LBANodeRef root,
@@ -522,32 +558,7 @@ BtreeLBAManager::insert_mapping_ret BtreeLBAManager::insert_mapping(
     insert_mapping_ertr::ready_future_marker{},
     root);
   if (root->at_max_capacity()) {
-    split = cache.get_root(t).safe_then(
-      [this, root, laddr, &t](RootBlockRef croot) {
-	logger().debug(
-	  "BtreeLBAManager::insert_mapping: splitting root {}",
-	  *croot);
-	{
-	  auto mut_croot = cache.duplicate_for_write(t, croot);
-	  croot = mut_croot->cast<RootBlock>();
-	}
-	auto nroot = cache.alloc_new_extent<LBAInternalNode>(t, LBA_BLOCK_SIZE);
-	lba_node_meta_t meta{0, L_ADDR_MAX, root->get_node_meta().depth + 1};
-	nroot->set_meta(meta);
-	nroot->pin.set_range(meta);
-	nroot->journal_insert(
-	  nroot->begin(),
-	  L_ADDR_MIN,
-	  root->get_paddr(),
-	  nullptr);
-	croot->get_root().lba_root = lba_root_t{
-	  nroot->get_paddr(),
-	  root->get_node_meta().depth + 1
-	};
-	return nroot->split_entry(
-	  get_context(t),
-	  laddr, nroot->begin(), root);
-      });
+    split = split_root(t, root, laddr);
   }
   return split.safe_then([this, &t, laddr, val](LBANodeRef node) {
     return node->insert(
@@ -584,7 +595,15 @@ BtreeLBAManager::update_mapping_ret BtreeLBAManager::update_mapping(
   update_func_t &&f)
 {
   return get_root(t
-  ).safe_then([this, f=std::move(f), &t, addr](LBANodeRef root) mutable {
+  ).safe_then([this, &t, addr](LBANodeRef root) {
+    // updates may grow a leaf's encoding, so a full root must be
+    // split just as for insert_mapping
+    if (root->at_max_capacity()) {
+      return split_root(t, root, addr);
+    } else {
+      return split_root_ertr::make_ready_future<LBANodeRef>(root);
+    }
+  }).safe_then([this, f=std::move(f), &t, addr](LBANodeRef root) mutable {
     return root->mutate_mapping(
       get_context(t),
       addr,
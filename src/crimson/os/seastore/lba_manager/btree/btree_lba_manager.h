@@ -141,6 +141,20 @@ private:
   using get_root_ret = get_root_ertr::future<LBANodeRef>;
   get_root_ret get_root(Transaction &);
 
+  /**
+   * split_root
+   *
+   * Splits root, which must be at max capacity, beneath a new
+   * internal root.  Returns the new root.
+   */
+  using split_root_ertr = base_ertr;
+  using split_root_ret = split_root_ertr::future<LBANodeRef>;
+  split_root_ret split_root(
+    Transaction &t,   ///< [in,out] transaction
+    LBANodeRef root,  ///< [in] current root node
+    laddr_t laddr     ///< [in] logical addr motivating the split
+  );
+
   /**
    * insert_mapping
    *
@@ -143,6 +143,9 @@ LBAInternalNode::mutate_mapping_ret LBAInternalNode::mutate_mapping_internal(
 	mutation_pt,
 	extent,
 	is_root);
+    } else if (extent->at_max_capacity()) {
+      // leaf encodings may grow on update, see LBALeafNode
+      return split_entry(c, laddr, mutation_pt, extent);
     } else {
       return merge_ertr::make_ready_future<LBANodeRef>(
 	std::move(extent));
@@ -446,13 +449,11 @@ LBAInternalNode::merge_entry(
 LBAInternalNode::internal_iterator_t
 LBAInternalNode::get_containing_child(laddr_t laddr)
 {
-  // TODO: binary search
-  for (auto i = begin(); i != end(); ++i) {
-    if (i.contains(laddr))
-      return i;
-  }
-  ceph_assert(0 == "invalid");
-  return end();
+  auto i = upper_bound(laddr);
+  ceph_assert(i != begin());
+  i = i - 1;
+  ceph_assert(i.contains(laddr));
+  return i;
 }
 
 std::ostream &LBALeafNode::print_detail(std::ostream &out) const
@@ -646,17 +647,17 @@ LBALeafNode::scan_mapped_space_ret LBALeafNode::scan_mapped_space(
 
 void LBALeafNode::resolve_relative_addrs(paddr_t base)
 {
-  for (auto i: *this) {
-    if (i->get_val().paddr.is_relative()) {
-      auto val = i->get_val();
-      val.paddr = base.add_relative(val.paddr);
+  update_vals(begin(), end(), [base](lba_map_val_t val) {
+    if (val.paddr.is_relative()) {
+      auto updated = base.add_relative(val.paddr);
       logger().debug(
 	"LBALeafNode::resolve_relative_addrs {} -> {}",
-	i->get_val().paddr,
-	val.paddr);
-      i->set_val(val);
+	val.paddr,
+	updated);
+      val.paddr = updated;
     }
-  }
+    return val;
+  });
 }
 
 std::pair<LBALeafNode::internal_iterator_t, LBALeafNode::internal_iterator_t>
@@ -12,6 +12,7 @@
 #include "include/buffer.h"
 
 #include "crimson/common/fixed_kv_node_layout.h"
+#include "crimson/common/delta_kv_node_layout.h"
 #include "crimson/common/errorator.h"
 #include "crimson/os/seastore/lba_manager.h"
 #include "crimson/os/seastore/seastore_types.h"
@@ -257,16 +258,14 @@ struct LBAInternalNode
   /// returns iterators containing [l, r)
   std::pair<internal_iterator_t, internal_iterator_t> bound(
     laddr_t l, laddr_t r) {
-    // TODO: inefficient
-    auto retl = begin();
-    for (; retl != end(); ++retl) {
-      if (retl->get_next_key_or_max() > l)
-	break;
+    // first child whose successor's key is > l
+    auto retl = upper_bound(l);
+    if (retl != begin()) {
+      retl = retl - 1;
     }
-    auto retr = retl;
-    for (; retr != end(); ++retr) {
-      if (retr->get_key() >= r)
-	break;
+    auto retr = lower_bound(r);
+    if (retr.get_offset() < retl.get_offset()) {
+      retr = retl;
     }
     return std::make_pair(retl, retr);
   }
@@ -292,25 +291,6 @@ struct LBAInternalNode
   internal_iterator_t get_containing_child(laddr_t laddr);
 };
 
-/**
- * LBALeafNode
- *
- * Abstracts operations on and layout of leaf nodes for the
- * LBA Tree.
- *
- * Layout (4k):
- *   size       : uint32_t[1]                4b
- *   (padding)  :                            4b
- *   meta       : lba_node_meta_le_t[3]      (1*24)b
- *   keys       : laddr_t[170]               (145*8)b
- *   values     : lba_map_val_t[170]         (145*20)b
- *                                           = 4092
- *
- * TODO: update FixedKVNodeLayout to handle the above calculation
- * TODO: the above alignment probably isn't portable without further work
- */
-constexpr size_t LEAF_NODE_CAPACITY = 145;
-
 /**
  * lba_map_val_le_t
  *
@@ -335,18 +315,198 @@ struct lba_map_val_le_t {
   }
 };
 
+/**
+ * lba_leaf_codec_t
+ *
+ * Delta encoding for LBALeafNode entries.  Block heads are stored as
+ * laddr_le_t followed by lba_map_val_le_t.  Other entries are stored
+ * as a flags byte followed by only those fields which cannot be
+ * inferred from the preceding entry:
+ *
+ *   key      : omitted if adjacent to prev, else varint delta from prev key
+ *   len      : omitted if equal to prev, else varint
+ *   paddr    : omitted if adjacent to prev, zigzag varint delta from the
+ *              end of prev if in the same segment, else paddr_le_t
+ *   refcount : omitted if 1, else varint
+ *   checksum : omitted if 0, else ceph_le32
+ *
+ * A run of sequentially written extents therefore costs one byte per
+ * mapping.  Translating all relative paddrs by the same base (see
+ * node_resolve_vals) never grows the encoding, which copies between
+ * nodes rely upon.
+ */
+struct lba_leaf_codec_t {
+  using entry_t = std::pair<laddr_t, lba_map_val_t>;
+
+  enum flags_t : uint8_t {
+    KEY_ADJACENT = 1 << 0,
+    LEN_SAME = 1 << 1,
+    PADDR_ADJACENT = 1 << 2,
+    PADDR_SAME_SEGMENT = 1 << 3,
+    REFCOUNT_ONE = 1 << 4,
+    CHECKSUM_ZERO = 1 << 5,
+  };
+
+  static constexpr size_t FULL_SIZE =
+    sizeof(laddr_le_t) + sizeof(lba_map_val_le_t);
+  static constexpr size_t MAX_DELTA_SIZE =
+    1 +                                  // flags
+    common::DELTA_VARINT_MAX_SIZE +      // key
+    5 +                                  // len
+    sizeof(paddr_le_t) +                 // paddr
+    5 +                                  // refcount
+    sizeof(ceph_le32);                   // checksum
+
+  static void encode_full(
+    char *out, laddr_t key, const lba_map_val_t &val) {
+    laddr_le_t k(key);
+    lba_map_val_le_t v(val);
+    ::memcpy(out, &k, sizeof(k));
+    ::memcpy(out + sizeof(k), &v, sizeof(v));
+  }
+
+  static entry_t decode_full(const char *in) {
+    laddr_le_t k;
+    lba_map_val_le_t v;
+    ::memcpy(&k, in, sizeof(k));
+    ::memcpy(&v, in + sizeof(k), sizeof(v));
+    return entry_t(k, v);
+  }
+
+  /// offset immediately following prev within its segment
+  static int64_t get_paddr_end(const lba_map_val_t &prev) {
+    return int64_t(prev.paddr.offset) + prev.len;
+  }
+
+  static size_t encode_delta(
+    char *out, const entry_t &prev, laddr_t key, const lba_map_val_t &val) {
+    assert(key > prev.first);
+    uint8_t flags = 0;
+    char *p = out + 1;
+    if (key == prev.first + prev.second.len) {
+      flags |= KEY_ADJACENT;
+    } else {
+      p += common::encode_delta_varint(p, key - prev.first);
+    }
+    if (val.len == prev.second.len) {
+      flags |= LEN_SAME;
+    } else {
+      p += common::encode_delta_varint(p, val.len);
+    }
+    if (val.paddr.segment == prev.second.paddr.segment) {
+      auto delta = int64_t(val.paddr.offset) - get_paddr_end(prev.second);
+      if (delta == 0) {
+	flags |= PADDR_ADJACENT;
+      } else {
+	flags |= PADDR_SAME_SEGMENT;
+	p += common::encode_delta_signed_varint(p, delta);
+      }
+    } else {
+      paddr_le_t paddr(val.paddr);
+      ::memcpy(p, &paddr, sizeof(paddr));
+      p += sizeof(paddr);
+    }
+    if (val.refcount == 1) {
+      flags |= REFCOUNT_ONE;
+    } else {
+      p += common::encode_delta_varint(p, val.refcount);
+    }
+    if (val.checksum == 0) {
+      flags |= CHECKSUM_ZERO;
+    } else {
+      ceph_le32 checksum(val.checksum);
+      ::memcpy(p, &checksum, sizeof(checksum));
+      p += sizeof(checksum);
+    }
+    *out = flags;
+    return p - out;
+  }
+
+  static size_t decode_delta(
+    const char *in, const entry_t &prev, entry_t &out) {
+    uint8_t flags = *in;
+    const char *p = in + 1;
+    uint64_t v;
+    if (flags & KEY_ADJACENT) {
+      out.first = prev.first + prev.second.len;
+    } else {
+      p += common::decode_delta_varint(p, v);
+      out.first = prev.first + v;
+    }
+    if (flags & LEN_SAME) {
+      out.second.len = prev.second.len;
+    } else {
+      p += common::decode_delta_varint(p, v);
+      out.second.len = v;
+    }
+    if (flags & PADDR_ADJACENT) {
+      out.second.paddr = paddr_t{
+	prev.second.paddr.segment,
+	segment_off_t(get_paddr_end(prev.second))};
+    } else if (flags & PADDR_SAME_SEGMENT) {
+      int64_t delta;
+      p += common::decode_delta_signed_varint(p, delta);
+      out.second.paddr = paddr_t{
+	prev.second.paddr.segment,
+	segment_off_t(get_paddr_end(prev.second) + delta)};
+    } else {
+      paddr_le_t paddr;
+      ::memcpy(&paddr, p, sizeof(paddr));
+      p += sizeof(paddr);
+      out.second.paddr = paddr;
+    }
+    if (flags & REFCOUNT_ONE) {
+      out.second.refcount = 1;
+    } else {
+      p += common::decode_delta_varint(p, v);
+      out.second.refcount = v;
+    }
+    if (flags & CHECKSUM_ZERO) {
+      out.second.checksum = 0;
+    } else {
+      ceph_le32 checksum;
+      ::memcpy(&checksum, p, sizeof(checksum));
+      p += sizeof(checksum);
+      out.second.checksum = checksum;
+    }
+    return p - in;
+  }
+};
+
+/**
+ * LBALeafNode
+ *
+ * Abstracts operations on and layout of leaf nodes for the
+ * LBA Tree.
+ *
+ * Uses DeltaKVNodeLayout with lba_leaf_codec_t so that capacity
+ * depends on how well the mappings compress rather than on a fixed
+ * entry count: roughly 1300 mappings for sequentially allocated
+ * extents vs 145 for a fixed width layout.
+ *
+ * Layout (4k):
+ *   header     : size, num_blocks, payload_len   8b
+ *                meta : lba_node_meta_le_t       24b
+ *   payload    : blocks of up to 16 entries, the first 28b and the
+ *                remainder delta encoded
+ *   slots      : 4b per block
+ */
+constexpr size_t LEAF_NODE_ENTRIES_PER_BLOCK = 16;
+
 struct LBALeafNode
   : LBANode,
-    common::FixedKVNodeLayout<
-      LEAF_NODE_CAPACITY,
+    common::DeltaKVNodeLayout<
+      LBA_BLOCK_SIZE,
+      LEAF_NODE_ENTRIES_PER_BLOCK,
       lba_node_meta_t, lba_node_meta_le_t,
       laddr_t, laddr_le_t,
-      lba_map_val_t, lba_map_val_le_t> {
+      lba_map_val_t, lba_map_val_le_t,
+      lba_leaf_codec_t> {
   using internal_iterator_t = const_iterator;
   template <typename... T>
   LBALeafNode(T&&... t) :
     LBANode(std::forward<T>(t)...),
-    FixedKVNodeLayout(get_bptr().c_str()) {}
+    DeltaKVNodeLayout(get_bptr().c_str()) {}
 
   static constexpr extent_types_t type = extent_types_t::LADDR_LEAF;
 
@@ -465,27 +625,22 @@ struct LBALeafNode
 
   // See LBAInternalNode, same concept
   void resolve_relative_addrs(paddr_t base) final;
-  void node_resolve_vals(iterator from, iterator to) const final {
+  void node_resolve_vals(entry_t *from, entry_t *to) const final {
     if (is_initial_pending()) {
       for (auto i = from; i != to; ++i) {
-	auto val = i->get_val();
-	if (val.paddr.is_relative()) {
-	  assert(val.paddr.is_block_relative());
-	  val.paddr = get_paddr().add_relative(val.paddr);
-	  i->set_val(val);
+	if (i->second.paddr.is_relative()) {
+	  assert(i->second.paddr.is_block_relative());
+	  i->second.paddr = get_paddr().add_relative(i->second.paddr);
 	}
       }
     }
   }
-  void node_unresolve_vals(iterator from, iterator to) const final {
+  void node_unresolve_vals(entry_t *from, entry_t *to) const final {
     if (is_initial_pending()) {
       for (auto i = from; i != to; ++i) {
-	auto val = i->get_val();
-	if (val.paddr.is_relative()) {
-	  auto val = i->get_val();
-	  assert(val.paddr.is_record_relative());
-	  val.paddr = val.paddr - get_paddr();
-	  i->set_val(val);
+	if (i->second.paddr.is_relative()) {
+	  assert(i->second.paddr.is_record_relative());
+	  i->second.paddr = i->second.paddr - get_paddr();
 	}
       }
     }
@@ -519,26 +674,28 @@ struct LBALeafNode
   std::ostream &print_detail(std::ostream &out) const final;
 
   bool at_max_capacity() const final {
-    return get_size() == get_capacity();
+    return DeltaKVNodeLayout::at_max_capacity();
   }
 
   bool at_min_capacity() const final {
-    return get_size() == (get_capacity() / 2);
+    return DeltaKVNodeLayout::at_min_capacity();
   }
 
   /// returns iterators <lb, ub> containing addresses [l, r)
   std::pair<internal_iterator_t, internal_iterator_t> bound(
     laddr_t l, laddr_t r) {
-    // TODO: inefficient
-    auto retl = begin();
-    for (; retl != end(); ++retl) {
-      if (retl->get_key() >= l || (retl->get_key() + retl->get_val().len) > l)
-	break;
+    // mappings do not overlap, so only the predecessor of the first
+    // mapping at or after l may contain l
+    auto retl = lower_bound(l);
+    if (retl != begin()) {
+      auto prev = retl - 1;
+      if (prev->get_key() + prev->get_val().len > l) {
+	retl = prev;
+      }
     }
-    auto retr = retl;
-    for (; retr != end(); ++retr) {
-      if (retr->get_key() >= r)
-	break;
+    auto retr = lower_bound(r);
+    if (retr.get_offset() < retl.get_offset()) {
+      retr = retl;
     }
     return std::make_pair(retl, retr);
   }
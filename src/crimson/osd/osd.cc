@@ -21,6 +21,7 @@
 #include "messages/MOSDMap.h"
 #include "messages/MOSDMarkMeDown.h"
 #include "messages/MOSDOp.h"
+#include "messages/MOSDOpBatch.h"
 #include "messages/MOSDPGLog.h"
 #include "messages/MOSDPGPull.h"
 #include "messages/MOSDPGPush.h"
@@ -627,6 +628,8 @@ OSD::ms_dispatch(crimson::net::ConnectionRef conn, MessageRef m)
       return handle_osd_map(conn, boost::static_pointer_cast<MOSDMap>(m));
     case CEPH_MSG_OSD_OP:
       return handle_osd_op(conn, boost::static_pointer_cast<MOSDOp>(m));
+    case MSG_OSD_OP_BATCH:
+      return handle_osd_op_batch(conn, boost::static_pointer_cast<MOSDOpBatch>(m));
     case MSG_OSD_PG_CREATE2:
       shard_services.start_operation<CompoundPeeringRequest>(
 	*this,
@@ -1098,6 +1101,26 @@ seastar::future<> OSD::handle_osd_op(crimson::net::ConnectionRef conn,
   return seastar::now();
 }
 
+seastar::future<> OSD::handle_osd_op_batch(crimson::net::ConnectionRef conn,
+                                           Ref<MOSDOpBatch> m)
+{
+  std::vector<Ref<MOSDOp>> ops;
+  try {
+    ops = m->unpack<MOSDOp>();
+  } catch (const ceph::buffer::error& e) {
+    logger().warn("{}: dropping malformed {} from {}: {}",
+                  __func__, *m, m->get_source(), e.what());
+    return seastar::now();
+  }
+  for (auto& op : ops) {
+    (void) shard_services.start_operation<ClientRequest>(
+      *this,
+      conn,
+      std::move(op));
+  }
+  return seastar::now();
+}
+
 seastar::future<> OSD::send_incremental_map(crimson::net::ConnectionRef conn,
 					    epoch_t first)
 {
@@ -33,6 +33,7 @@
 
 class MCommand;
 class MOSDMap;
+class MOSDOpBatch;
 class MOSDRepOpReply;
 class MOSDRepOp;
 class MOSDScrub2;
@@ -182,6 +183,8 @@ private:
                                    Ref<MOSDMap> m);
   seastar::future<> handle_osd_op(crimson::net::ConnectionRef conn,
 				  Ref<MOSDOp> m);
+  seastar::future<> handle_osd_op_batch(crimson::net::ConnectionRef conn,
+					Ref<MOSDOpBatch> m);
   seastar::future<> handle_rep_op(crimson::net::ConnectionRef conn,
 				  Ref<MOSDRepOp> m);
   seastar::future<> handle_rep_op_reply(crimson::net::ConnectionRef conn,
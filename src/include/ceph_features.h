@@ -138,7 +138,7 @@ DEFINE_CEPH_FEATURE(35, 1, OSD_CACHEPOOL)    // 3.14
 DEFINE_CEPH_FEATURE(36, 1, CRUSH_V2)         // 3.14
 DEFINE_CEPH_FEATURE(37, 1, EXPORT_PEER)      // 3.14
 DEFINE_CEPH_FEATURE_RETIRED(38, 1, OSD_ERASURE_CODES, MIMIC, OCTOPUS)
-// available
+DEFINE_CEPH_FEATURE(38, 3, OSD_OP_BATCH)     // MOSDOpBatch
 DEFINE_CEPH_FEATURE(39, 1, OSDMAP_ENC)       // 3.15
 DEFINE_CEPH_FEATURE(40, 1, MDS_INLINE_DATA)  // 3.19
 DEFINE_CEPH_FEATURE(41, 1, CRUSH_TUNABLES3)  // 3.15
@@ -249,6 +249,7 @@ DEFINE_CEPH_FEATURE_DEPRECATED(63, 1, RESERVED_BROKEN, LUMINOUS) // client-facin
 	 CEPH_FEATUREMASK_SERVER_PACIFIC | \
 	 CEPH_FEATURE_OSD_FIXED_COLLECTION_LIST | \
 	 CEPH_FEATUREMASK_SERVER_QUINCY | \
+	 CEPH_FEATUREMASK_OSD_OP_BATCH | \
 	 0ULL)
 
 #define CEPH_FEATURES_SUPPORTED_DEFAULT  CEPH_FEATURES_ALL
@@ -1200,6 +1200,28 @@ inline namespace v14_2_0 {
     int aio_operate(const std::string& oid, AioCompletion *c,
         ObjectReadOperation *op, int flags,
         bufferlist *pbl, const blkin_trace_info *trace_info);
+    /**
+     * Schedule async read operations on many objects
+     *
+     * Each entry pairs an object name with the read operation to run
+     * on it, and each operation's results are returned through its own
+     * output parameters as usual.  Operations are submitted grouped by
+     * placement group so that those bound for the same OSD are sent
+     * back to back, and are all in flight at once.  The objects and
+     * operations must remain valid until c completes.
+     *
+     * @param c completes once every operation has completed; its
+     *          return value is 0 if all succeeded, otherwise the first
+     *          error in the order of ops
+     * @param ops (object name, operation) pairs
+     * @param prvals if non-NULL, filled with the return value of each
+     *               operation, in the order of ops
+     * @param flags LIBRADOS_OPERATION_* flags applied to every operation
+     * @returns 0 on success, negative error code on failure
+     */
+    int aio_operate_multi(AioCompletion *c,
+        std::vector<std::pair<std::string, ObjectReadOperation*>>& ops,
+        std::vector<int> *prvals, int flags = 0);
 
     // watch/notify
     int watch2(const std::string& o, uint64_t *handle,
@@ -316,7 +316,7 @@ ceph::ref_t<ObjectRecorder> JournalRecorder::create_object_recorder(
     m_ioctx, utils::get_object_name(m_object_oid_prefix, object_number),
     object_number, lock, m_journal_metadata->get_work_queue(),
     &m_object_handler, m_journal_metadata->get_order(),
-    m_max_in_flight_appends);
+    m_max_in_flight_appends, m_journal_metadata->get_settings().group_commit);
   object_recorder->set_append_batch_options(m_flush_interval, m_flush_bytes,
                                             m_flush_age);
   return object_recorder;
@@ -22,11 +22,13 @@ namespace journal {
 ObjectRecorder::ObjectRecorder(librados::IoCtx &ioctx, std::string_view oid,
                                uint64_t object_number, ceph::mutex* lock,
                                ContextWQ *work_queue, Handler *handler,
-                               uint8_t order, int32_t max_in_flight_appends)
+                               uint8_t order, int32_t max_in_flight_appends,
+                               bool group_commit)
   : m_oid(oid), m_object_number(object_number),
     m_op_work_queue(work_queue), m_handler(handler),
     m_order(order), m_soft_max_size(1 << m_order),
     m_max_in_flight_appends(max_in_flight_appends),
+    m_group_commit(group_commit),
     m_lock(lock)
 {
   m_ioctx.dup(ioctx);
@@ -84,6 +86,9 @@ bool ObjectRecorder::append(AppendBuffers &&append_buffers) {
     m_pending_bytes += append_buffer.second.length();
   }
 
+  if (last_flushed_future && defer_flush()) {
+    last_flushed_future.reset();
+  }
   return send_appends(!!last_flushed_future, last_flushed_future);
 }
 
@@ -137,7 +142,8 @@ void ObjectRecorder::flush(const ceph::ref_t<FutureImpl>& future) {
     return;
   }
 
-  if (!m_object_closed && !m_overflowed && send_appends(true, future)) {
+  if (!m_object_closed && !m_overflowed && !defer_flush() &&
+      send_appends(true, future)) {
     ++m_in_flight_callbacks;
     notify_handler_unlock(locker, true);
   }
@@ -227,9 +233,12 @@ void ObjectRecorder::handle_append_flushed(uint64_t tid, int r) {
     append_buffer.first->safe(r);
   }
 
-  // attempt to kick off more appends to the object
+  // attempt to kick off more appends to the object -- everything queued
+  // behind a deferred flush goes out as a single append
   locker.lock();
-  if (!m_object_closed && !m_overflowed && send_appends(false, {})) {
+  bool force = false;
+  std::swap(force, m_flush_requested);
+  if (!m_object_closed && !m_overflowed && send_appends(force, {})) {
     notify_overflowed = true;
   }
 
@@ -264,6 +273,27 @@ void ObjectRecorder::append_overflowed() {
   restart_append_buffers.swap(m_pending_buffers);
 }
 
+bool ObjectRecorder::defer_flush() {
+  ceph_assert(ceph_mutex_is_locked(*m_lock));
+  if (!m_group_commit) {
+    return false;
+  }
+
+  // instead of issuing an append per flush, hold flushes while the
+  // in-flight appends are maxed out and send all pending appends together
+  // once one completes
+  auto max_in_flight_appends = std::max<int32_t>(1, m_max_in_flight_appends);
+  if (static_cast<int32_t>(m_in_flight_tids.size()) < max_in_flight_appends) {
+    return false;
+  }
+
+  ldout(m_cct, 20) << "deferring flush: "
+                   << "in_flight_appends=" << m_in_flight_tids.size() << ", "
+                   << "pending_appends=" << m_pending_buffers.size() << dendl;
+  m_flush_requested = true;
+  return true;
+}
+
 bool ObjectRecorder::send_appends(bool force, ceph::ref_t<FutureImpl> flush_future) {
   ldout(m_cct, 20) << dendl;
 
@@ -293,7 +323,8 @@ bool ObjectRecorder::send_appends(bool force, ceph::ref_t<FutureImpl> flush_futu
   }
 
   auto max_in_flight_appends = m_max_in_flight_appends;
-  if (m_flush_interval > 0 || m_flush_bytes > 0 || m_flush_age > 0) {
+  if (m_flush_interval > 0 || m_flush_bytes > 0 || m_flush_age > 0 ||
+      m_group_commit) {
     if (!force && max_in_flight_appends == 0) {
       ldout(m_cct, 20) << "attempting to batch AIO appends" << dendl;
       max_in_flight_appends = 1;
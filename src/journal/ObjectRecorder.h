@@ -71,7 +71,7 @@ private:
   ObjectRecorder(librados::IoCtx &ioctx, std::string_view oid,
                  uint64_t object_number, ceph::mutex* lock,
                  ContextWQ *work_queue, Handler *handler, uint8_t order,
-                 int32_t max_in_flight_appends);
+                 int32_t max_in_flight_appends, bool group_commit = false);
   ~ObjectRecorder() override;
 
   typedef std::set<uint64_t> InFlightTids;
@@ -111,6 +111,7 @@ private:
   uint64_t m_flush_bytes = 0;
   double m_flush_age = 0;
   int32_t m_max_in_flight_appends;
+  bool m_group_commit;
 
   bool m_compat_mode;
 
@@ -132,6 +133,9 @@ private:
 
   uint64_t m_append_tid = 0;
 
+  // group commit: flush requested while the in-flight appends were maxed out
+  bool m_flush_requested = false;
+
   InFlightTids m_in_flight_tids;
   InFlightAppends m_in_flight_appends;
   uint64_t m_object_bytes = 0;
@@ -147,6 +151,7 @@ private:
   ceph::condition_variable m_in_flight_callbacks_cond;
   uint64_t m_in_flight_bytes = 0;
 
+  bool defer_flush();
   bool send_appends(bool force, ceph::ref_t<FutureImpl> flush_sentinal);
   void handle_append_flushed(uint64_t tid, int r);
   void append_overflowed();
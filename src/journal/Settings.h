@@ -14,6 +14,7 @@ struct Settings {
   int max_concurrent_object_sets = 0; ///< 0 implies no limit
   std::set<std::string> ignored_laggy_clients;
                                       ///< clients that mustn't be disconnected
+  bool group_commit = false;          ///< batch flushes behind in-flight appends
 };
 
 } // namespace journal
@@ -13,6 +13,7 @@
  */
 
 #include <limits.h>
+#include <numeric>
 
 #include "IoCtxImpl.h"
 
@@ -81,6 +82,49 @@ struct CB_notify_Finish {
   }
 };
 
+// Completes the caller's completion once every op of an
+// aio_operate_read_multi() batch has completed.
+struct MultiReadState {
+  ceph::mutex lock = ceph::make_mutex("librados::MultiReadState::lock");
+  size_t pending;
+  std::vector<int> rvals;
+  std::vector<int> *prvals;
+  Context *oncomplete;
+
+  MultiReadState(size_t n, std::vector<int> *prvals, Context *oncomplete)
+    : pending(n), rvals(n, 0), prvals(prvals), oncomplete(oncomplete) {}
+};
+
+struct C_MultiReadOne : public Context {
+  std::shared_ptr<MultiReadState> state;
+  size_t idx;
+
+  C_MultiReadOne(std::shared_ptr<MultiReadState> state, size_t idx)
+    : state(std::move(state)), idx(idx) {}
+
+  void finish(int r) override {
+    {
+      std::lock_guard l{state->lock};
+      state->rvals[idx] = r;
+      if (--state->pending > 0) {
+	return;
+      }
+    }
+    // batch result is the first failure in caller order, if any
+    int rval = 0;
+    for (auto rv : state->rvals) {
+      if (rv < 0) {
+	rval = rv;
+	break;
+      }
+    }
+    if (state->prvals) {
+      *state->prvals = std::move(state->rvals);
+    }
+    state->oncomplete->complete(rval);
+  }
+};
+
 struct CB_aio_linger_cancel {
   Objecter *objecter;
   Objecter::LingerOp *linger_op;
@@ -744,6 +788,53 @@ int librados::IoCtxImpl::aio_operate_read(const object_t &oid,
   return 0;
 }
 
+int librados::IoCtxImpl::aio_operate_read_multi(
+  const std::vector<std::pair<object_t, ::ObjectOperation*>>& ops,
+  AioCompletionImpl *c, int flags, std::vector<int> *prvals)
+{
+  FUNCTRACE(client->cct);
+  Context *oncomplete = new C_aio_Complete(c);
+  c->is_read = true;
+  c->io = this;
+
+  if (ops.empty()) {
+    if (prvals) {
+      prvals->clear();
+    }
+    oncomplete->complete(0);
+    return 0;
+  }
+
+  // Submit in pg order so that ops bound for the same pg (and thus the
+  // same OSD session) go out back to back and can share a message when
+  // the objecter batches ops.  Ops whose pool no longer exists sort
+  // first and fail individually in the objecter.
+  std::vector<size_t> order(ops.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::vector<pg_t> pgs(ops.size());
+  objecter->with_osdmap([&](const OSDMap& o) {
+      for (size_t i = 0; i < ops.size(); ++i) {
+	pg_t raw_pgid;
+	if (o.object_locator_to_pg(ops[i].first, oloc, raw_pgid) == 0) {
+	  pgs[i] = o.raw_pg_to_pg(raw_pgid);
+	}
+      }
+    });
+  std::stable_sort(order.begin(), order.end(),
+		   [&pgs](size_t a, size_t b) { return pgs[a] < pgs[b]; });
+
+  auto state = std::make_shared<MultiReadState>(ops.size(), prvals,
+						oncomplete);
+  for (auto i : order) {
+    Objecter::Op *objecter_op = objecter->prepare_read_op(
+      ops[i].first, oloc,
+      *ops[i].second, snap_seq, nullptr, flags | extra_op_flags,
+      new C_MultiReadOne(state, i), nullptr);
+    objecter->op_submit(objecter_op);
+  }
+  return 0;
+}
+
 int librados::IoCtxImpl::aio_operate(const object_t& oid,
 				     ::ObjectOperation *o, AioCompletionImpl *c,
 				     const SnapContext& snap_context, int flags,
@@ -160,6 +160,9 @@ struct librados::IoCtxImpl {
 		  int flags, const blkin_trace_info *trace_info = nullptr);
   int aio_operate_read(const object_t& oid, ::ObjectOperation *o,
 		       AioCompletionImpl *c, int flags, bufferlist *pbl, const blkin_trace_info *trace_info = nullptr);
+  int aio_operate_read_multi(
+    const std::vector<std::pair<object_t, ::ObjectOperation*>>& ops,
+    AioCompletionImpl *c, int flags, std::vector<int> *prvals);
 
   struct C_aio_stat_Ack : public Context {
     librados::AioCompletionImpl *c;
@@ -1672,6 +1672,22 @@ int librados::IoCtx::aio_operate(const std::string& oid, AioCompletion *c,
                translate_flags(flags), pbl, trace_info);
 }
 
+int librados::IoCtx::aio_operate_multi(
+  AioCompletion *c,
+  std::vector<std::pair<std::string, ObjectReadOperation*>>& ops,
+  std::vector<int> *prvals, int flags)
+{
+  std::vector<std::pair<object_t, ::ObjectOperation*>> impl_ops;
+  impl_ops.reserve(ops.size());
+  for (auto& [oid, o] : ops) {
+    if (unlikely(!o || !o->impl))
+      return -EINVAL;
+    impl_ops.emplace_back(object_t(oid), &o->impl->o);
+  }
+  return io_ctx_impl->aio_operate_read_multi(impl_ops, c->pc,
+					     translate_flags(flags), prvals);
+}
+
 void librados::IoCtx::snap_set_read(snap_t seq)
 {
   io_ctx_impl->set_snap_read(seq);
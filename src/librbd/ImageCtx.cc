@@ -285,6 +285,31 @@ librados::IoCtx duplicate_io_ctx(librados::IoCtx& io_ctx) {
     plb.add_u64_counter(l_librbd_readahead, "readahead", "Read ahead");
     plb.add_u64_counter(l_librbd_readahead_bytes, "readahead_bytes", "Data size in read ahead", NULL, 0, unit_t(UNIT_BYTES));
     plb.add_u64_counter(l_librbd_invalidate_cache, "invalidate_cache", "Cache invalidates");
+    plb.add_u64_counter(l_librbd_sched_delayed_wr, "sched_delayed_wr", "Writes delayed for merging by the IO scheduler");
+    plb.add_u64_counter(l_librbd_sched_merged_wr, "sched_merged_wr", "Merged writes sent by the IO scheduler");
+    plb.add_u64_counter(l_librbd_sched_overwritten_bytes, "sched_overwritten_bytes", "Delayed write data overwritten before being sent", NULL, 0, unit_t(UNIT_BYTES));
+
+    // journal append latency in nanoseconds vs. event size in bytes
+    PerfHistogramCommon::axis_config_d journal_hist_x_axis_config{
+      "Latency (nsec)",
+      PerfHistogramCommon::SCALE_LOG2, ///< Latency in logarithmic scale
+      0,                               ///< Start at 0
+      10000,                           ///< Quantization unit is 10usec
+      20,                              ///< Ranges into seconds
+    };
+    PerfHistogramCommon::axis_config_d journal_hist_y_axis_config{
+      "Event size (bytes)",
+      PerfHistogramCommon::SCALE_LOG2, ///< Event size in logarithmic scale
+      0,                               ///< Start at 0
+      512,                             ///< Quantization unit is 512 bytes
+      16,                              ///< Events up to >16M
+    };
+    plb.add_u64_counter(l_librbd_journal_append, "journal_append", "Journal IO event appends");
+    plb.add_time_avg(l_librbd_journal_append_latency, "journal_append_latency", "Latency of journal IO event appends");
+    plb.add_u64_counter_histogram(
+      l_librbd_journal_append_latency_hist, "journal_append_latency_bytes_histogram",
+      journal_hist_x_axis_config, journal_hist_y_axis_config,
+      "Histogram of journal append latency (nanoseconds) vs. event size");
 
     plb.add_time(l_librbd_opened_time, "opened_time", "Opened time",
                  "ots", perf_prio);
@@ -335,6 +360,7 @@ librados::IoCtx duplicate_io_ctx(librados::IoCtx& io_ctx) {
         data_ctx.snap_set_read(snap_id);
         rebuild_data_io_context();
       }
+      invalidate_io_state();
       return 0;
     }
     return -ENOENT;
@@ -351,6 +377,7 @@ librados::IoCtx duplicate_io_ctx(librados::IoCtx& io_ctx) {
       data_ctx.snap_set_read(snap_id);
       rebuild_data_io_context();
     }
+    invalidate_io_state();
   }
 
   snap_t ImageCtx::get_snap_id(const cls::rbd::SnapshotNamespace& in_snap_namespace,
@@ -505,6 +532,7 @@ librados::IoCtx duplicate_io_ctx(librados::IoCtx& io_ctx) {
 		  in_size, parent, protection_status, flags, timestamp);
     snap_info.insert({id, info});
     snap_ids.insert({{in_snap_namespace, in_snap_name}, id});
+    invalidate_io_state();
   }
 
   void ImageCtx::rm_snap(cls::rbd::SnapshotNamespace in_snap_namespace,
@@ -515,6 +543,7 @@ librados::IoCtx duplicate_io_ctx(librados::IoCtx& io_ctx) {
     snaps.erase(std::remove(snaps.begin(), snaps.end(), id), snaps.end());
     snap_info.erase(id);
     snap_ids.erase({in_snap_namespace, in_snap_name});
+    invalidate_io_state();
   }
 
   uint64_t ImageCtx::get_image_size(snap_t in_snap_id) const
@@ -547,6 +576,10 @@ librados::IoCtx duplicate_io_ctx(librados::IoCtx& io_ctx) {
     return extents.front().first;
   }
 
+  void ImageCtx::invalidate_io_state() {
+    io_state_epoch.fetch_add(1, std::memory_order_release);
+  }
+
   uint64_t ImageCtx::get_object_count(snap_t in_snap_id) const {
     ceph_assert(ceph_mutex_is_locked(image_lock));
     uint64_t image_size = get_image_size(in_snap_id);
@@ -104,6 +104,9 @@ namespace librbd {
     bool read_only;
     uint32_t read_only_flags = 0U;
     uint32_t read_only_mask = ~0U;
+    // bumped (with image_lock held for write) whenever the image size,
+    // snapshot or read-only state used to validate IO changes
+    std::atomic<uint64_t> io_state_epoch = {0};
 
     std::map<rados::cls::lock::locker_id_t,
 	     rados::cls::lock::locker_info_t> lockers;
@@ -305,6 +308,7 @@ namespace librbd {
 		 librados::snap_t id);
     uint64_t get_image_size(librados::snap_t in_snap_id) const;
     uint64_t get_effective_image_size(librados::snap_t in_snap_id) const;
+    void invalidate_io_state();
     uint64_t get_object_count(librados::snap_t in_snap_id) const;
     bool test_features(uint64_t test_features) const;
     bool test_features(uint64_t test_features,
@@ -5,6 +5,7 @@
 #include "include/rados/librados.hpp"
 #include "common/AsyncOpTracker.h"
 #include "common/errno.h"
+#include "common/perf_counters.h"
 #include "common/Timer.h"
 #include "common/WorkQueue.h"
 #include "cls/journal/cls_journal_types.h"
@@ -819,15 +820,21 @@ uint64_t Journal<I>::append_io_events(journal::EventType event_type,
     ceph_assert(tid != 0);
   }
 
+  auto append_time = ceph::mono_clock::now();
+  uint64_t append_bytes = 0;
   Futures futures;
   for (auto &bl : bufferlists) {
     ceph_assert(bl.length() <= m_max_append_size);
     futures.push_back(m_journaler->append(m_tag_tid, bl));
+    append_bytes += bl.length();
   }
 
   {
     std::lock_guard event_locker{m_event_lock};
-    m_events[tid] = Event(futures, offset, length, filter_ret_val);
+    auto& event = m_events[tid] = Event(futures, offset, length,
+                                        filter_ret_val);
+    event.append_time = append_time;
+    event.append_bytes = append_bytes;
   }
 
   CephContext *cct = m_image_ctx.cct;
@@ -1118,6 +1125,8 @@ void Journal<I>::create_journaler() {
     m_image_ctx.config.template get_val<Option::size_t>("rbd_journal_max_payload_bytes");
   settings.max_concurrent_object_sets =
     m_image_ctx.config.template get_val<uint64_t>("rbd_journal_max_concurrent_object_sets");
+  settings.group_commit =
+    m_image_ctx.config.template get_val<bool>("rbd_journal_object_group_commit");
   // TODO: a configurable filter to exclude certain peers from being
   // disconnected.
   settings.ignored_laggy_clients = {IMAGE_CLIENT_ID};
@@ -1526,6 +1535,16 @@ void Journal<I>::handle_io_event_safe(int r, uint64_t tid) {
     Event &event = it->second;
     on_safe_contexts.swap(event.on_safe_contexts);
 
+    if (r >= 0 && m_image_ctx.perfcounter != nullptr) {
+      auto latency = ceph::mono_clock::now() - event.append_time;
+      m_image_ctx.perfcounter->inc(l_librbd_journal_append);
+      m_image_ctx.perfcounter->tinc(l_librbd_journal_append_latency, latency);
+      m_image_ctx.perfcounter->hinc(
+        l_librbd_journal_append_latency_hist,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count(),
+        event.append_bytes);
+    }
+
     if (r < 0 || event.committed_io) {
       // failed journal write so IO won't be sent -- or IO extent was
       // overwritten by future IO operations so this was a no-op IO event
@@ -11,6 +11,7 @@
 #include "common/AsyncOpTracker.h"
 #include "common/Cond.h"
 #include "common/RefCountedObj.h"
+#include "common/ceph_time.h"
 #include "journal/Future.h"
 #include "journal/JournalMetadataListener.h"
 #include "journal/ReplayEntry.h"
@@ -192,6 +193,8 @@ private:
     bool committed_io = false;
     bool safe = false;
     int ret_val = 0;
+    ceph::mono_time append_time;
+    uint64_t append_bytes = 0;
 
     Event() {
     }
@@ -0,0 +1,33 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_MANAGEMENT_OPS_H
+#define CEPH_LIBRBD_MANAGEMENT_OPS_H
+
+#include "common/config_proxy.h"
+
+#include <algorithm>
+
+namespace librbd {
+namespace util {
+
+// number of concurrent data requests of up to io_size bytes allowed for a
+// management operation, see rbd_concurrent_management_{ops,bytes}.  Kept
+// header-only so that the rbd CLI, which does not link librbd internals,
+// shares it.
+inline uint64_t get_concurrent_management_ops(const ConfigProxy& config,
+                                              uint64_t io_size) {
+  uint64_t max_ops = config.get_val<uint64_t>(
+    "rbd_concurrent_management_ops");
+  uint64_t max_bytes = config.get_val<Option::size_t>(
+    "rbd_concurrent_management_bytes");
+  if (io_size > 0) {
+    max_ops = std::max(max_ops, max_bytes / io_size);
+  }
+  return max_ops;
+}
+
+} // namespace util
+} // namespace librbd
+
+#endif // CEPH_LIBRBD_MANAGEMENT_OPS_H
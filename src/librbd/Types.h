@@ -52,6 +52,14 @@ enum {
 
   l_librbd_invalidate_cache,
 
+  l_librbd_sched_delayed_wr,        // writes held back by the IO scheduler
+  l_librbd_sched_merged_wr,         // merged writes sent by the IO scheduler
+  l_librbd_sched_overwritten_bytes, // delayed bytes overwritten before sent
+
+  l_librbd_journal_append,              // IO events appended to the journal
+  l_librbd_journal_append_latency,      // average append to safe latency
+  l_librbd_journal_append_latency_hist, // append latency vs. event size
+
   l_librbd_opened_time,
   l_librbd_lock_acquired_time,
 
@@ -8,6 +8,7 @@
 #include "include/rbd_types.h"
 #include "include/ceph_assert.h"
 #include "include/Context.h"
+#include "common/config_fwd.h"
 #include "common/snap_types.h"
 #include "common/zipkin_trace.h"
 #include "common/RefCountedObj.h"
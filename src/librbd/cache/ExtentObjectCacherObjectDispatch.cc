@@ -0,0 +1,476 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/cache/ExtentObjectCacherObjectDispatch.h"
+#include "include/neorados/RADOS.hpp"
+#include "common/errno.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/Utils.h"
+#include "librbd/cache/ObjectCacherWriteback.h"
+#include "librbd/io/ObjectDispatchSpec.h"
+#include "librbd/io/ObjectDispatcherInterface.h"
+#include "librbd/io/ReadResult.h"
+#include "librbd/io/Types.h"
+#include "librbd/io/Utils.h"
+#include "osd/osd_types.h"
+#include "osdc/WritebackHandler.h"
+#include <vector>
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::cache::ExtentObjectCacherObjectDispatch: " \
+                           << this << " " << __func__ << ": "
+
+namespace librbd {
+namespace cache {
+
+using librbd::util::data_object_name;
+
+namespace {
+
+typedef std::vector<ObjectExtent> ObjectExtents;
+
+/**
+ * ObjectCacherWriteback expects its caller to hold the lock it was
+ * given while issuing writes, and completes reads and writes under it.
+ * The extent object cacher calls its writeback handler without holding
+ * any lock, so take one here for the writeback handler alone.
+ */
+class LockedWriteback : public WritebackHandler {
+public:
+  LockedWriteback(ImageCtx* image_ctx)
+    : m_lock(ceph::make_mutex(util::unique_lock_name(
+        "librbd::cache::ExtentObjectCacherObjectDispatch::writeback_lock",
+        this))),
+      m_writeback(image_ctx, m_lock) {
+  }
+
+  void read(const object_t& oid, uint64_t object_no,
+            const object_locator_t& oloc, uint64_t off, uint64_t len,
+            snapid_t snapid, bufferlist *pbl, uint64_t trunc_size,
+            __u32 trunc_seq, int op_flags,
+            const ZTracer::Trace &parent_trace, Context *onfinish) override {
+    m_writeback.read(oid, object_no, oloc, off, len, snapid, pbl, trunc_size,
+                     trunc_seq, op_flags, parent_trace, onfinish);
+  }
+
+  bool may_copy_on_write(const object_t& oid, uint64_t read_off,
+                         uint64_t read_len, snapid_t snapid) override {
+    return m_writeback.may_copy_on_write(oid, read_off, read_len, snapid);
+  }
+
+  ceph_tid_t write(const object_t& oid, const object_locator_t& oloc,
+                   uint64_t off, uint64_t len,
+                   const SnapContext& snapc, const bufferlist &bl,
+                   ceph::real_time mtime, uint64_t trunc_size,
+                   __u32 trunc_seq, ceph_tid_t journal_tid,
+                   const ZTracer::Trace &parent_trace,
+                   Context *oncommit) override {
+    std::lock_guard locker{m_lock};
+    return m_writeback.write(oid, oloc, off, len, snapc, bl, mtime,
+                             trunc_size, trunc_seq, journal_tid,
+                             parent_trace, oncommit);
+  }
+  using WritebackHandler::write;
+
+private:
+  ceph::mutex m_lock;
+  ObjectCacherWriteback m_writeback;
+};
+
+} // anonymous namespace
+
+template <typename I>
+struct ExtentObjectCacherObjectDispatch<I>::C_InvalidateCache
+  : public Context {
+  ExtentObjectCacherObjectDispatch* dispatcher;
+  bool purge_on_error;
+  Context *on_finish;
+
+  C_InvalidateCache(ExtentObjectCacherObjectDispatch* dispatcher,
+                    bool purge_on_error, Context *on_finish)
+    : dispatcher(dispatcher), purge_on_error(purge_on_error),
+      on_finish(on_finish) {
+  }
+
+  void finish(int r) override {
+    auto cct = dispatcher->m_image_ctx->cct;
+
+    if (r == -EBLOCKLISTED) {
+      lderr(cct) << "blocklisted during flush (purging)" << dendl;
+      dispatcher->m_object_cacher->purge_set(dispatcher->m_object_set);
+    } else if (r < 0 && purge_on_error) {
+      lderr(cct) << "failed to invalidate cache (purging): "
+                 << cpp_strerror(r) << dendl;
+      dispatcher->m_object_cacher->purge_set(dispatcher->m_object_set);
+    } else if (r != 0) {
+      lderr(cct) << "failed to invalidate cache: " << cpp_strerror(r) << dendl;
+    }
+
+    auto unclean = dispatcher->m_object_cacher->release_set(
+      dispatcher->m_object_set);
+    if (unclean == 0) {
+      r = 0;
+    } else {
+      lderr(cct) << "could not release all objects from cache: "
+                 << unclean << " bytes remain" << dendl;
+      if (r == 0) {
+        r = -EBUSY;
+      }
+    }
+
+    on_finish->complete(r);
+  }
+};
+
+template <typename I>
+ExtentObjectCacherObjectDispatch<I>::ExtentObjectCacherObjectDispatch(
+    I* image_ctx, size_t max_dirty, bool writethrough_until_flush,
+    unsigned num_shards)
+  : m_image_ctx(image_ctx), m_max_dirty(max_dirty),
+    m_writethrough_until_flush(writethrough_until_flush),
+    m_num_shards(num_shards) {
+  ceph_assert(m_image_ctx->data_ctx.is_valid());
+}
+
+template <typename I>
+ExtentObjectCacherObjectDispatch<I>::~ExtentObjectCacherObjectDispatch() {
+  delete m_object_cacher;
+  delete m_object_set;
+
+  delete m_writeback_handler;
+}
+
+template <typename I>
+void ExtentObjectCacherObjectDispatch<I>::init() {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << dendl;
+
+  m_writeback_handler = new LockedWriteback(m_image_ctx);
+
+  auto init_max_dirty = m_max_dirty;
+  if (m_writethrough_until_flush) {
+    init_max_dirty = 0;
+  }
+
+  auto cache_size =
+    m_image_ctx->config.template get_val<Option::size_t>("rbd_cache_size");
+  auto target_dirty =
+    m_image_ctx->config.template get_val<Option::size_t>("rbd_cache_target_dirty");
+  auto max_dirty_age =
+    m_image_ctx->config.template get_val<double>("rbd_cache_max_dirty_age");
+
+  ldout(cct, 5) << "Initial cache settings:"
+                << " size=" << cache_size
+                << " shards=" << m_num_shards
+                << " max_dirty=" << init_max_dirty
+                << " target_dirty=" << target_dirty
+                << " max_dirty_age=" << max_dirty_age << dendl;
+
+  m_object_cacher = new ExtentObjectCacher(
+    cct, m_image_ctx->perfcounter->get_name(), *m_writeback_handler,
+    cache_size, init_max_dirty, target_dirty, max_dirty_age, m_num_shards);
+  m_object_set = new ExtentObjectCacher::ObjectSet(
+    m_image_ctx->data_ctx.get_id(), 0);
+  m_object_cacher->start();
+
+  // add ourself to the IO object dispatcher chain
+  if (m_max_dirty > 0) {
+    m_image_ctx->disable_zero_copy = true;
+  }
+  m_image_ctx->io_object_dispatcher->register_dispatch(this);
+}
+
+template <typename I>
+void ExtentObjectCacherObjectDispatch<I>::shut_down(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << dendl;
+
+  // chain shut down in reverse order
+
+  // shut down the cache
+  on_finish = new LambdaContext([this, on_finish](int r) {
+      m_object_cacher->stop();
+      on_finish->complete(r);
+    });
+
+  // ensure we aren't completing from within the writeback handler
+  on_finish = util::create_async_context_callback(*m_image_ctx, on_finish);
+
+  // invalidate any remaining cache entries
+  on_finish = new C_InvalidateCache(this, true, on_finish);
+
+  // flush all pending writeback state
+  m_object_cacher->release_set(m_object_set);
+  m_object_cacher->flush_set(m_object_set, on_finish);
+}
+
+template <typename I>
+std::vector<ObjectExtent>
+ExtentObjectCacherObjectDispatch<I>::get_object_extents(
+    uint64_t object_no, uint64_t object_off, uint64_t object_len) const {
+  ObjectExtents object_extents;
+  object_extents.emplace_back(data_object_name(m_image_ctx, object_no),
+                              object_no, object_off, object_len, 0);
+  object_extents.back().oloc.pool = m_image_ctx->data_ctx.get_id();
+  object_extents.back().buffer_extents.push_back({0, object_len});
+  return object_extents;
+}
+
+template <typename I>
+void ExtentObjectCacherObjectDispatch<I>::bypass(
+    ObjectExtents&& object_extents, io::DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  // drop the range again once the request is done, in case a read
+  // filled it in with the old data meanwhile
+  auto ctx = *on_finish;
+  *on_finish = new LambdaContext(
+    [this, object_extents, ctx](int r) {
+      m_object_cacher->discard_set(m_object_set, object_extents);
+      ctx->complete(r);
+    });
+
+  *dispatch_result = io::DISPATCH_RESULT_CONTINUE;
+
+  // ensure any in-flight writeback is complete before advancing the
+  // request
+  m_object_cacher->discard_writeback(m_object_set, object_extents,
+                                     on_dispatched);
+}
+
+template <typename I>
+bool ExtentObjectCacherObjectDispatch<I>::read(
+    uint64_t object_no, io::ReadExtents* extents, IOContext io_context,
+    int op_flags, int read_flags, const ZTracer::Trace &parent_trace,
+    uint64_t* version, int* object_dispatch_flags,
+    io::DispatchResult* dispatch_result, Context** on_finish,
+    Context* on_dispatched) {
+  // IO chained in reverse order
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << object_no << " " << *extents << dendl;
+
+  if (extents->size() == 0) {
+    ldout(cct, 20) << "no extents to read" << dendl;
+    return false;
+  }
+
+  if (version != nullptr) {
+    // we currently don't cache read versions
+    return false;
+  }
+
+  // ensure we aren't completing from within the writeback handler
+  on_dispatched = util::create_async_context_callback(*m_image_ctx,
+                                                      on_dispatched);
+
+  // embed the RBD-internal read flags in the generic RADOS op_flags
+  op_flags = ((op_flags & ~ObjectCacherWriteback::READ_FLAGS_MASK) |
+              ((read_flags << ObjectCacherWriteback::READ_FLAGS_SHIFT) &
+               ObjectCacherWriteback::READ_FLAGS_MASK));
+
+  ceph::bufferlist* bl;
+  if (extents->size() > 1) {
+    auto req = new io::ReadResult::C_ObjectReadMergedExtents(
+            cct, extents, on_dispatched);
+    on_dispatched = req;
+    bl = &req->bl;
+  } else {
+    bl = &extents->front().bl;
+  }
+
+  ObjectExtents object_extents;
+  uint64_t off = 0;
+  for (auto& read_extent: *extents) {
+    object_extents.emplace_back(data_object_name(m_image_ctx, object_no),
+                                object_no, read_extent.offset,
+                                read_extent.length, 0);
+    object_extents.back().oloc.pool = m_image_ctx->data_ctx.get_id();
+    object_extents.back().buffer_extents.push_back({off, read_extent.length});
+    off += read_extent.length;
+  }
+
+  *dispatch_result = io::DISPATCH_RESULT_COMPLETE;
+
+  int r = m_object_cacher->readx(
+    object_extents, io_context->read_snap().value_or(CEPH_NOSNAP), bl,
+    m_object_set, on_dispatched, op_flags);
+  if (r != 0) {
+    on_dispatched->complete(r);
+  }
+  return true;
+}
+
+template <typename I>
+bool ExtentObjectCacherObjectDispatch<I>::discard(
+    uint64_t object_no, uint64_t object_off, uint64_t object_len,
+    IOContext io_context, int discard_flags,
+    const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+    uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << object_no << " " << object_off << "~"
+                 << object_len << dendl;
+
+  on_dispatched = util::create_async_context_callback(*m_image_ctx,
+                                                      on_dispatched);
+  bypass(get_object_extents(object_no, object_off, object_len),
+         dispatch_result, on_finish, on_dispatched);
+  return true;
+}
+
+template <typename I>
+bool ExtentObjectCacherObjectDispatch<I>::write(
+    uint64_t object_no, uint64_t object_off, ceph::bufferlist&& data,
+    IOContext io_context, int op_flags, int write_flags,
+    std::optional<uint64_t> assert_version,
+    const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+    uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << object_no << " " << object_off << "~"
+                 << data.length() << dendl;
+
+  // ensure we aren't completing from within the writeback handler
+  on_dispatched = util::create_async_context_callback(*m_image_ctx,
+                                                      on_dispatched);
+
+  auto object_extents = get_object_extents(object_no, object_off,
+                                           data.length());
+
+  // cache layer does not handle version checking, and the writeback of
+  // journaled writes is left to the layers below
+  if (assert_version.has_value() ||
+      (write_flags & io::OBJECT_WRITE_FLAG_CREATE_EXCLUSIVE) != 0 ||
+      *journal_tid != 0) {
+    bypass(std::move(object_extents), dispatch_result, on_finish,
+           on_dispatched);
+    return true;
+  }
+
+  SnapContext snapc;
+  if (io_context->write_snap_context()) {
+    auto write_snap_context = *io_context->write_snap_context();
+    snapc = SnapContext(write_snap_context.first,
+                        {write_snap_context.second.begin(),
+                         write_snap_context.second.end()});
+  }
+
+  *dispatch_result = io::DISPATCH_RESULT_COMPLETE;
+  m_object_cacher->writex(object_extents, snapc, data, ceph::real_time::min(),
+                          m_object_set, on_dispatched);
+  return true;
+}
+
+template <typename I>
+bool ExtentObjectCacherObjectDispatch<I>::write_same(
+    uint64_t object_no, uint64_t object_off, uint64_t object_len,
+    io::LightweightBufferExtents&& buffer_extents, ceph::bufferlist&& data,
+    IOContext io_context, int op_flags,
+    const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+    uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << object_no << " " << object_off << "~"
+                 << object_len << dendl;
+
+  // convert write-same to a regular write
+  io::LightweightObjectExtent extent(object_no, object_off, object_len, 0);
+  extent.buffer_extents = std::move(buffer_extents);
+
+  bufferlist ws_data;
+  io::util::assemble_write_same_extent(extent, data, &ws_data, true);
+
+  return write(object_no, object_off, std::move(ws_data), io_context, op_flags,
+               0, std::nullopt, parent_trace, object_dispatch_flags,
+               journal_tid, dispatch_result, on_finish, on_dispatched);
+}
+
+template <typename I>
+bool ExtentObjectCacherObjectDispatch<I>::compare_and_write(
+    uint64_t object_no, uint64_t object_off, ceph::bufferlist&& cmp_data,
+    ceph::bufferlist&& write_data, IOContext io_context, int op_flags,
+    const ZTracer::Trace &parent_trace, uint64_t* mismatch_offset,
+    int* object_dispatch_flags, uint64_t* journal_tid,
+    io::DispatchResult* dispatch_result, Context** on_finish,
+    Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << object_no << " " << object_off << "~"
+                 << cmp_data.length() << dendl;
+
+  // pass-through the compare-and-write request, but flush the cache
+  // first so that it compares against everything written before it
+  on_dispatched = util::create_async_context_callback(*m_image_ctx,
+                                                      on_dispatched);
+
+  // drop the range once it has been written
+  auto object_extents = get_object_extents(object_no, object_off,
+                                           cmp_data.length());
+  auto ctx = *on_finish;
+  *on_finish = new LambdaContext(
+    [this, object_extents, ctx](int r) {
+      m_object_cacher->discard_set(m_object_set, object_extents);
+      ctx->complete(r);
+    });
+
+  *dispatch_result = io::DISPATCH_RESULT_CONTINUE;
+  m_object_cacher->flush_set(m_object_set, on_dispatched);
+  return true;
+}
+
+template <typename I>
+bool ExtentObjectCacherObjectDispatch<I>::flush(
+    io::FlushSource flush_source, const ZTracer::Trace &parent_trace,
+    uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << dendl;
+
+  // ensure we aren't completing from within the writeback handler
+  on_dispatched = util::create_async_context_callback(*m_image_ctx,
+                                                      on_dispatched);
+
+  if (flush_source == io::FLUSH_SOURCE_USER && !m_user_flushed.exchange(true)) {
+    if (m_writethrough_until_flush && m_max_dirty > 0) {
+      m_object_cacher->set_max_dirty(m_max_dirty);
+      ldout(cct, 5) << "saw first user flush, enabling writeback" << dendl;
+    }
+  }
+
+  *dispatch_result = io::DISPATCH_RESULT_CONTINUE;
+  m_object_cacher->flush_set(m_object_set, on_dispatched);
+  return true;
+}
+
+template <typename I>
+bool ExtentObjectCacherObjectDispatch<I>::invalidate_cache(
+    Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << dendl;
+
+  // ensure we aren't completing from within the writeback handler
+  on_finish = util::create_async_context_callback(*m_image_ctx, on_finish);
+
+  // invalidate any remaining cache entries
+  on_finish = new C_InvalidateCache(this, false, on_finish);
+
+  m_object_cacher->release_set(m_object_set);
+  m_object_cacher->flush_set(m_object_set, on_finish);
+  return true;
+}
+
+template <typename I>
+bool ExtentObjectCacherObjectDispatch<I>::reset_existence_cache(
+    Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << dendl;
+
+  // reads of missing objects were cached as the data found in their
+  // place, which may have been the parent's
+  m_object_cacher->release_set(m_object_set);
+  return false;
+}
+
+} // namespace cache
+} // namespace librbd
+
+template class librbd::cache::ExtentObjectCacherObjectDispatch<librbd::ImageCtx>;
@@ -11,6 +11,7 @@
 #include "librbd/io/ObjectDispatcherInterface.h"
 #include "librbd/plugin/Api.h"
 #include "osd/osd_types.h"
+#include "osdc/Striper.h"
 #include "osdc/WritebackHandler.h"
 
 #include <vector>
@@ -173,10 +174,60 @@ int ParentCacheObjectDispatch<I>::handle_register_client(bool reg) {
 
   if (!reg) {
     lderr(cct) << "Parent cache register fails." << dendl;
+    return 0;
   }
+
+  warmup();
   return 0;
 }
 
+template <typename I>
+void ParentCacheObjectDispatch<I>::warmup() {
+  auto cct = m_image_ctx->cct;
+  uint64_t warmup_size = m_image_ctx->config.template get_val<uint64_t>(
+    "rbd_parent_cache_warmup_size");
+  if (warmup_size == 0) {
+    return;
+  }
+  if (!m_cache_client->supports_promote()) {
+    ldout(cct, 5) << "RO daemon does not support promotion, skipping warmup"
+                  << dendl;
+    return;
+  }
+
+  uint64_t object_count;
+  librados::snap_t snap_id;
+  {
+    std::shared_lock image_locker{m_image_ctx->image_lock};
+    snap_id = m_image_ctx->snap_id;
+    object_count = Striper::get_num_objects(
+      m_image_ctx->layout,
+      std::min(warmup_size, m_image_ctx->get_image_size(snap_id)));
+  }
+  ldout(cct, 10) << "promoting " << object_count << " objects" << dendl;
+
+  // keep each request to a reasonable message size
+  const uint64_t max_batch = 1024;
+  for (uint64_t object_no = 0; object_no < object_count; ) {
+    std::vector<std::string> oids;
+    for (; object_no < object_count && oids.size() < max_batch; ++object_no) {
+      oids.push_back(data_object_name(m_image_ctx, object_no));
+    }
+
+    CacheGenContextURef ctx = make_gen_lambda_context<ObjectCacheRequest*,
+                                       std::function<void(ObjectCacheRequest*)>>
+      ([this, cct](ObjectCacheRequest* ack) {
+        if (ack->type != RBDSC_PROMOTE_REPLY) {
+          ldout(cct, 5) << "parent cache warmup request failed" << dendl;
+        }
+      });
+    m_cache_client->promote_objects(m_image_ctx->data_ctx.get_namespace(),
+                                    m_image_ctx->data_ctx.get_id(), snap_id,
+                                    m_image_ctx->layout.object_size,
+                                    std::move(oids), std::move(ctx));
+  }
+}
+
 template <typename I>
 void ParentCacheObjectDispatch<I>::create_cache_session(Context* on_finish,
                                                        bool is_reconnect) {
@@ -151,6 +151,8 @@ void AbstractWriteLog<I>::perf_start(std::string name) {
   plb.add_time_avg(l_librbd_pwl_rd_hit_latency, "hit_rd_latency", "Latency of read hits");
 
   plb.add_u64_counter(l_librbd_pwl_rd_part_hit_req, "part_hit_rd", "reads partially hitting RWL");
+  plb.add_u64_counter(l_librbd_pwl_rd_cache_hit_bytes, "rd_cache_hit_bytes", "Bytes read from the SSD read cache");
+  plb.add_u64_counter(l_librbd_pwl_rd_cache_fill_bytes, "rd_cache_fill_bytes", "Bytes admitted to the SSD read cache");
 
   plb.add_u64_counter_histogram(
     l_librbd_pwl_syncpoint_hist, "syncpoint_logentry_bytes_histogram",
@@ -701,9 +703,7 @@ void AbstractWriteLog<I>::read(Extents&& image_extents,
         read_ctx->complete(0);
       } else {
       /* Pass the read misses on to the layer below RWL */
-        m_image_writeback.aio_read(
-            std::move(read_ctx->miss_extents), &read_ctx->miss_bl,
-            fadvise_flags, read_ctx);
+        read_misses(read_ctx, fadvise_flags);
       }
     });
 
@@ -807,6 +807,14 @@ void AbstractWriteLog<I>::read(Extents&& image_extents,
   complete_read(log_entries_to_read, bls_to_read, ctx);
 }
 
+template <typename I>
+void AbstractWriteLog<I>::read_misses(C_ReadRequest *read_ctx,
+                                      int fadvise_flags) {
+  m_image_writeback.aio_read(
+      std::move(read_ctx->miss_extents), &read_ctx->miss_bl,
+      fadvise_flags, read_ctx);
+}
+
 template <typename I>
 void AbstractWriteLog<I>::write(Extents &&image_extents,
                                       bufferlist&& bl,
@@ -2026,6 +2034,7 @@ void AbstractWriteLog<I>::internal_flush(bool invalidate, Context *on_finish) {
               }
               /* Discards all RWL entries */
               while (retire_entries(MAX_ALLOC_PER_TRANSACTION)) { }
+              invalidate_read_cache();
               next_ctx->complete(0);
             } else {
               {
@@ -152,8 +152,8 @@ public:
   uint32_t get_free_log_entries() {
     return m_free_log_entries;
   }
-  void add_into_log_map(pwl::GenericWriteLogEntries &log_entries,
-                        C_BlockIORequestT *req);
+  virtual void add_into_log_map(pwl::GenericWriteLogEntries &log_entries,
+                                C_BlockIORequestT *req);
   virtual void complete_user_request(Context *&user_req, int r) = 0;
   virtual void copy_bl_to_buffer(
       WriteRequestResources *resources,
@@ -375,6 +375,11 @@ protected:
   virtual void complete_read(
       std::vector<WriteLogCacheEntry*> &log_entries_to_read,
       std::vector<bufferlist*> &bls_to_read, Context *ctx) = 0;
+  /* Read the miss extents of read_ctx from below the cache, then
+   * complete read_ctx */
+  virtual void read_misses(pwl::C_ReadRequest *read_ctx, int fadvise_flags);
+  /* Drop anything cached besides the log, once the log is invalidated */
+  virtual void invalidate_read_cache() {}
   virtual void write_data_to_buffer(
       std::shared_ptr<pwl::WriteLogEntry> ws_entry,
       pwl::WriteLogCacheEntry *cache_entry) {}
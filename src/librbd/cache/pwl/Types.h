@@ -36,6 +36,10 @@ enum {
   // Reed requests with hit and miss extents
   l_librbd_pwl_rd_part_hit_req,  // read ops
 
+  // Reads served from and blocks admitted to the SSD read cache
+  l_librbd_pwl_rd_cache_hit_bytes,
+  l_librbd_pwl_rd_cache_fill_bytes,
+
   // Per SyncPoint's LogEntry number and write bytes distribution
   l_librbd_pwl_syncpoint_hist,
 
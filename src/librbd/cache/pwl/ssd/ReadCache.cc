@@ -0,0 +1,170 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "ReadCache.h"
+#include "common/dout.h"
+#include "include/ceph_assert.h"
+
+#define dout_subsys ceph_subsys_rbd_pwl
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::cache::pwl::ssd::ReadCache: " \
+                           << this << " " <<  __func__ << ": "
+
+namespace librbd {
+namespace cache {
+namespace pwl {
+namespace ssd {
+
+ReadCache::ReadCache(CephContext *cct, uint64_t region_offset,
+                     uint64_t region_size, uint32_t admit_reads)
+  : m_cct(cct), m_region_offset(region_offset),
+    m_admit_reads(std::max(admit_reads, 1u)),
+    m_slots(region_size / BLOCK_SIZE) {
+  ceph_assert(region_offset % BLOCK_SIZE == 0);
+  ldout(m_cct, 5) << "offset=" << region_offset << ", slots="
+                  << m_slots.size() << dendl;
+}
+
+bool ReadCache::get(uint64_t block, uint64_t *dev_offset) {
+  std::lock_guard locker(m_lock);
+  auto it = m_index.find(block);
+  if (it == m_index.end()) {
+    return false;
+  }
+  slot_t &slot = m_slots[it->second];
+  if (slot.state != slot_state_t::VALID) {
+    return false;
+  }
+  slot.pins++;
+  slot.referenced = true;
+  *dev_offset = slot_offset(it->second);
+  return true;
+}
+
+void ReadCache::put(uint64_t dev_offset) {
+  std::lock_guard locker(m_lock);
+  slot_t &slot = m_slots[offset_slot(dev_offset)];
+  ceph_assert(slot.state == slot_state_t::VALID);
+  ceph_assert(slot.pins > 0);
+  if (--slot.pins == 0 && slot.stale) {
+    slot = slot_t();
+  }
+}
+
+bool ReadCache::alloc_slot(uint32_t *slot) {
+  ceph_assert(ceph_mutex_is_locked_by_me(m_lock));
+  /* Clock: give referenced slots a second chance, skip slots that are
+   * being filled or read from */
+  for (size_t i = 0; i < 2 * m_slots.size(); ++i) {
+    uint32_t s = m_hand;
+    m_hand = (m_hand + 1) % m_slots.size();
+    slot_t &candidate = m_slots[s];
+    if (candidate.state == slot_state_t::FREE) {
+      *slot = s;
+      return true;
+    }
+    if (candidate.state != slot_state_t::VALID || candidate.pins > 0) {
+      continue;
+    }
+    if (candidate.referenced) {
+      candidate.referenced = false;
+      continue;
+    }
+    ldout(m_cct, 20) << "evicting block " << candidate.block << dendl;
+    m_index.erase(candidate.block);
+    candidate = slot_t();
+    *slot = s;
+    return true;
+  }
+  return false;
+}
+
+bool ReadCache::admit(uint64_t block, uint64_t *dev_offset) {
+  std::lock_guard locker(m_lock);
+  if (m_slots.empty() || m_index.count(block)) {
+    return false;
+  }
+  if (m_admit_reads > 1) {
+    uint32_t &misses = m_misses[block];
+    if (++misses < m_admit_reads) {
+      if (m_misses.size() > 2 * m_slots.size()) {
+        m_misses.clear();
+      }
+      return false;
+    }
+    m_misses.erase(block);
+  }
+  uint32_t s;
+  if (!alloc_slot(&s)) {
+    return false;
+  }
+  slot_t &slot = m_slots[s];
+  slot.block = block;
+  slot.state = slot_state_t::FILLING;
+  m_index[block] = s;
+  *dev_offset = slot_offset(s);
+  return true;
+}
+
+void ReadCache::fill_finish(uint64_t dev_offset, bool success) {
+  std::lock_guard locker(m_lock);
+  uint32_t s = offset_slot(dev_offset);
+  slot_t &slot = m_slots[s];
+  ceph_assert(slot.state == slot_state_t::FILLING);
+  if (!slot.stale && success) {
+    slot.state = slot_state_t::VALID;
+    return;
+  }
+  if (!slot.stale) {
+    m_index.erase(slot.block);
+  }
+  slot = slot_t();
+}
+
+void ReadCache::invalidate_slot(uint32_t s) {
+  slot_t &slot = m_slots[s];
+  m_index.erase(slot.block);
+  if (slot.state == slot_state_t::FILLING || slot.pins > 0) {
+    slot.stale = true;
+  } else {
+    slot = slot_t();
+  }
+}
+
+void ReadCache::invalidate(uint64_t offset, uint64_t length) {
+  if (length == 0) {
+    return;
+  }
+  uint64_t first = offset / BLOCK_SIZE;
+  uint64_t last = (offset + length - 1) / BLOCK_SIZE;
+  std::lock_guard locker(m_lock);
+  if (last - first + 1 > m_index.size()) {
+    for (auto it = m_index.begin(); it != m_index.end(); ) {
+      auto next = std::next(it);
+      if (it->first >= first && it->first <= last) {
+        invalidate_slot(it->second);
+      }
+      it = next;
+    }
+  } else {
+    for (uint64_t block = first; block <= last; ++block) {
+      auto it = m_index.find(block);
+      if (it != m_index.end()) {
+        invalidate_slot(it->second);
+      }
+    }
+  }
+}
+
+void ReadCache::invalidate_all() {
+  std::lock_guard locker(m_lock);
+  while (!m_index.empty()) {
+    invalidate_slot(m_index.begin()->second);
+  }
+  m_misses.clear();
+}
+
+} // namespace ssd
+} // namespace pwl
+} // namespace cache
+} // namespace librbd
@@ -0,0 +1,104 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_CACHE_PWL_SSD_READ_CACHE_H
+#define CEPH_LIBRBD_CACHE_PWL_SSD_READ_CACHE_H
+
+#include "common/ceph_mutex.h"
+#include "librbd/cache/pwl/Types.h"
+#include <unordered_map>
+#include <vector>
+
+namespace librbd {
+namespace cache {
+namespace pwl {
+namespace ssd {
+
+/*
+ * Index of the read cache region of an SSD write log pool.
+ *
+ * The region is split into fixed size slots, each holding one aligned
+ * image block that was read from the cluster.  Blocks are admitted
+ * once they have missed admit_reads times, and evicted with the clock
+ * algorithm.  The index is kept in RAM only; the region starts cold
+ * every time the pool is opened.
+ *
+ * Coherency with writes: every write, writesame or discard invalidates
+ * the blocks it covers once it has been added to the log map.  A slot
+ * being filled when its block is invalidated is marked stale and
+ * dropped when the fill completes, and a slot being read from is only
+ * reused once the read has finished.
+ */
+class ReadCache {
+public:
+  static const uint64_t BLOCK_SIZE = MIN_WRITE_ALLOC_SSD_SIZE;
+
+  ReadCache(CephContext *cct, uint64_t region_offset, uint64_t region_size,
+            uint32_t admit_reads);
+
+  uint64_t get_num_slots() const {
+    return m_slots.size();
+  }
+
+  /// look up an image block; on a hit, pin its slot for reading
+  bool get(uint64_t block, uint64_t *dev_offset);
+  /// unpin a slot pinned by get()
+  void put(uint64_t dev_offset);
+
+  /**
+   * record a miss on an image block
+   *
+   * Returns true, with a slot reserved for the block, if the block
+   * should now be cached.  The caller writes the block to dev_offset
+   * and then calls fill_finish().
+   */
+  bool admit(uint64_t block, uint64_t *dev_offset);
+  void fill_finish(uint64_t dev_offset, bool success);
+
+  /// drop any cached image blocks overlapping [offset, offset+length)
+  void invalidate(uint64_t offset, uint64_t length);
+  void invalidate_all();
+
+private:
+  enum class slot_state_t : uint8_t {
+    FREE,
+    FILLING,
+    VALID,
+  };
+
+  struct slot_t {
+    uint64_t block = 0;
+    uint32_t pins = 0;
+    slot_state_t state = slot_state_t::FREE;
+    bool referenced = false;
+    bool stale = false;  ///< invalidated; free once filled or unpinned
+  };
+
+  CephContext *m_cct;
+  const uint64_t m_region_offset;
+  const uint32_t m_admit_reads;
+
+  ceph::mutex m_lock = ceph::make_mutex(
+    "librbd::cache::pwl::ssd::ReadCache::m_lock");
+  std::vector<slot_t> m_slots;
+  std::unordered_map<uint64_t, uint32_t> m_index;  ///< block -> slot
+  /// recent misses on uncached blocks, reset when it grows too large
+  std::unordered_map<uint64_t, uint32_t> m_misses;
+  uint32_t m_hand = 0;
+
+  uint64_t slot_offset(uint32_t slot) const {
+    return m_region_offset + slot * BLOCK_SIZE;
+  }
+  uint32_t offset_slot(uint64_t dev_offset) const {
+    return (dev_offset - m_region_offset) / BLOCK_SIZE;
+  }
+  bool alloc_slot(uint32_t *slot);
+  void invalidate_slot(uint32_t slot);
+};
+
+} // namespace ssd
+} // namespace pwl
+} // namespace cache
+} // namespace librbd
+
+#endif // CEPH_LIBRBD_CACHE_PWL_SSD_READ_CACHE_H
@@ -94,6 +94,200 @@ void WriteLog<I>::complete_read(
   }
 }
 
+/*
+ * Serve what blocks we can of the miss extents from the read cache,
+ * and pass the rest on to the layer below.  Whole blocks in the
+ * remaining misses are candidates for admission; those admitted are
+ * written to their read cache slots once the miss read returns.
+ */
+template <typename I>
+void WriteLog<I>::read_misses(pwl::C_ReadRequest *read_ctx,
+                              int fadvise_flags) {
+  if (!m_read_cache) {
+    AbstractWriteLog<I>::read_misses(read_ctx, fadvise_flags);
+    return;
+  }
+
+  CephContext *cct = m_image_ctx.cct;
+  const uint64_t block_size = ReadCache::BLOCK_SIZE;
+  pwl::ImageExtentBufs read_extents;
+  io::Extents miss_extents;
+  uint64_t miss_bytes = 0;
+  uint64_t hit_bytes = 0;
+  bool last_was_miss = false;
+  /* device offsets of pinned read cache hits, and the bufferlists to
+   * read them into */
+  std::vector<std::pair<uint64_t, bufferlist*>> hits;
+  /* (offset in miss_bl, device offset) of blocks to admit */
+  std::vector<std::pair<uint64_t, uint64_t>> fills;
+
+  for (auto &extent : read_ctx->read_extents) {
+    if (extent->m_bl.length()) {
+      /* log hit */
+      read_extents.push_back(extent);
+      last_was_miss = false;
+      continue;
+    }
+    uint64_t pos = extent->first;
+    uint64_t end = extent->first + extent->second;
+    while (pos < end) {
+      uint64_t block = pos / block_size;
+      uint64_t block_start = block * block_size;
+      uint64_t piece_end = std::min(end, block_start + block_size);
+      uint64_t piece_len = piece_end - pos;
+      uint64_t dev_offset;
+      if (m_read_cache->get(block, &dev_offset)) {
+        auto hit_extent_buf = std::make_shared<ImageExtentBuf>(
+            Extent(pos, piece_len), true, pos - block_start);
+        read_extents.push_back(hit_extent_buf);
+        hits.emplace_back(dev_offset, &hit_extent_buf->m_bl);
+        hit_bytes += piece_len;
+        last_was_miss = false;
+      } else {
+        if (pos == block_start && piece_len == block_size &&
+            m_read_cache->admit(block, &dev_offset)) {
+          /* A write may have been added to the log map after this read
+           * looked it up.  Writes invalidate the read cache after
+           * adding themselves to the log map, so either we see the
+           * entry here or the slot we just reserved becomes stale. */
+          auto map_entries = this->m_blocks_to_log_entries.find_map_entries(
+              pwl::block_extent(Extent(block_start, block_size)));
+          if (map_entries.empty()) {
+            fills.emplace_back(miss_bytes, dev_offset);
+          } else {
+            m_read_cache->fill_finish(dev_offset, false);
+          }
+        }
+        if (last_was_miss &&
+            miss_extents.back().first + miss_extents.back().second == pos) {
+          read_extents.back()->second += piece_len;
+          miss_extents.back().second += piece_len;
+        } else {
+          Extent miss_extent(pos, piece_len);
+          read_extents.push_back(std::make_shared<ImageExtentBuf>(miss_extent));
+          miss_extents.push_back(miss_extent);
+        }
+        miss_bytes += piece_len;
+        last_was_miss = true;
+      }
+      pos = piece_end;
+    }
+  }
+
+  ldout(cct, 20) << "read cache hits=" << hits.size() << ", fills="
+                 << fills.size() << ", miss_extents=" << miss_extents
+                 << dendl;
+  read_ctx->read_extents.swap(read_extents);
+  read_ctx->miss_extents.swap(miss_extents);
+
+  Context *ctx = new LambdaContext(
+    [this, read_ctx, hits, fills](int r) {
+      for (auto &hit : hits) {
+        m_read_cache->put(hit.first);
+      }
+      if (!fills.empty()) {
+        fill_read_cache(r, read_ctx->miss_bl, fills);
+      }
+      read_ctx->complete(r);
+    });
+  C_GatherBuilder gather(cct, ctx);
+  if (!hits.empty()) {
+    this->m_perfcounter->inc(l_librbd_pwl_rd_cache_hit_bytes, hit_bytes);
+    AioTransContext *aio = new AioTransContext(cct, gather.new_sub());
+    for (auto &hit : hits) {
+      bdev->aio_read(hit.first, block_size, hit.second, &aio->ioc);
+    }
+    bdev->aio_submit(&aio->ioc);
+  }
+  if (!read_ctx->miss_extents.empty()) {
+    this->m_image_writeback.aio_read(
+        std::move(read_ctx->miss_extents), &read_ctx->miss_bl,
+        fadvise_flags, gather.new_sub());
+  }
+  gather.activate();
+}
+
+template <typename I>
+void WriteLog<I>::fill_read_cache(
+    int r, const bufferlist &miss_bl,
+    const std::vector<std::pair<uint64_t, uint64_t>> &fills) {
+  if (r < 0) {
+    for (auto &fill : fills) {
+      m_read_cache->fill_finish(fill.second, false);
+    }
+    return;
+  }
+
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "admitting " << fills.size() << " blocks" << dendl;
+  this->m_async_op_tracker.start_op();
+  Context *ctx = new LambdaContext(
+    [this, fills](int r) {
+      for (auto &fill : fills) {
+        m_read_cache->fill_finish(fill.second, r >= 0);
+      }
+      this->m_async_op_tracker.finish_op();
+    });
+  AioTransContext *aio = new AioTransContext(cct, ctx);
+  for (auto &fill : fills) {
+    bufferlist bl;
+    bl.substr_of(miss_bl, fill.first, ReadCache::BLOCK_SIZE);
+    bdev->aio_write(fill.second, bl, &aio->ioc, false, WRITE_LIFE_NOT_SET);
+  }
+  bdev->aio_submit(&aio->ioc);
+  this->m_perfcounter->inc(l_librbd_pwl_rd_cache_fill_bytes,
+                           fills.size() * ReadCache::BLOCK_SIZE);
+}
+
+/*
+ * Invalidation (snapshot rollback, resize, invalidate_cache) changes
+ * the image below the cache, so blocks cached from it are stale.
+ */
+template <typename I>
+void WriteLog<I>::invalidate_read_cache() {
+  if (m_read_cache) {
+    ldout(m_image_ctx.cct, 6) << "invalidating read cache" << dendl;
+    m_read_cache->invalidate_all();
+  }
+}
+
+template <typename I>
+uint64_t WriteLog<I>::get_read_cache_config_size() {
+  uint64_t size = m_image_ctx.config.template get_val<uint64_t>(
+      "rbd_persistent_cache_read_size");
+  return size - size % ReadCache::BLOCK_SIZE;
+}
+
+/*
+ * The read cache region follows the write log ring in the pool file.
+ * Pool files created without one (or with a smaller one) get whatever
+ * fits in the file.
+ */
+template <typename I>
+void WriteLog<I>::init_read_cache() {
+  CephContext *cct = m_image_ctx.cct;
+  uint64_t read_size = get_read_cache_config_size();
+  if (!read_size) {
+    return;
+  }
+  uint64_t region_offset = round_up_to(pool_root.pool_size,
+                                       ReadCache::BLOCK_SIZE);
+  uint64_t file_size = bdev->get_size();
+  uint64_t avail = file_size > region_offset ? file_size - region_offset : 0;
+  if (avail < read_size) {
+    ldout(cct, 5) << "pool file has room for " << avail
+                  << " bytes of read cache, " << read_size << " configured"
+                  << dendl;
+    read_size = avail - avail % ReadCache::BLOCK_SIZE;
+  }
+  if (read_size) {
+    m_read_cache = std::make_unique<ReadCache>(
+        cct, region_offset, read_size,
+        m_image_ctx.config.template get_val<uint64_t>(
+            "rbd_persistent_cache_read_admit_reads"));
+  }
+}
+
 template <typename I>
 bool WriteLog<I>::initialize_pool(Context *on_finish,
                                   pwl::DeferredContexts &later) {
@@ -103,8 +297,11 @@ bool WriteLog<I>::initialize_pool(Context *on_finish,
     int fd = ::open(this->m_log_pool_name.c_str(), O_RDWR|O_CREAT, 0644);
     bool succeed = true;
     if (fd >= 0) {
-      if (truncate(this->m_log_pool_name.c_str(),
-                   this->m_log_pool_config_size) != 0) {
+      uint64_t file_size = this->m_log_pool_config_size;
+      if (uint64_t read_size = get_read_cache_config_size(); read_size) {
+        file_size = round_up_to(file_size, ReadCache::BLOCK_SIZE) + read_size;
+      }
+      if (truncate(this->m_log_pool_name.c_str(), file_size) != 0) {
         succeed = false;
       }
       ::close(fd);
@@ -164,6 +361,7 @@ bool WriteLog<I>::initialize_pool(Context *on_finish,
     }
     this->m_total_log_entries = new_root->num_log_entries;
     this->m_free_log_entries = new_root->num_log_entries - 1;
+    init_read_cache();
    } else {
      m_cache_state->present = true;
      bdev = BlockDevice::create(
@@ -191,6 +389,7 @@ bool WriteLog<I>::initialize_pool(Context *on_finish,
      }
      m_cache_state->clean = this->m_dirty_log_entries.empty();
      m_cache_state->empty = m_log_entries.empty();
+     init_read_cache();
   }
   return true;
 }
@@ -1004,6 +1203,19 @@ void WriteLog<I>::aio_read_data_block(
   bdev->aio_submit(&aio->ioc);
 }
 
+template <typename I>
+void WriteLog<I>::add_into_log_map(pwl::GenericWriteLogEntries &log_entries,
+                                   C_BlockIORequestT *req) {
+  AbstractWriteLog<I>::add_into_log_map(log_entries, req);
+  /* Only after the entries are in the log map; see read_misses() */
+  if (m_read_cache) {
+    for (auto &log_entry : log_entries) {
+      auto extent = pwl::image_extent(log_entry->ram_entry.block_extent());
+      m_read_cache->invalidate(extent.first, extent.second);
+    }
+  }
+}
+
 template <typename I>
 void WriteLog<I>::complete_user_request(Context *&user_req, int r) {
   m_image_ctx.op_work_queue->queue(user_req, r);
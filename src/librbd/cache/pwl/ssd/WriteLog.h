@@ -19,6 +19,7 @@
 #include "librbd/cache/pwl/LogOperation.h"
 #include "librbd/cache/pwl/Request.h"
 #include "librbd/cache/pwl/ssd/Builder.h"
+#include "librbd/cache/pwl/ssd/ReadCache.h"
 #include "librbd/cache/pwl/ssd/Types.h"
 #include <functional>
 #include <list>
@@ -53,6 +54,8 @@ public:
       pwl::GenericLogOperationsVector &ops, bool do_early_flush,
       C_BlockIORequestT *req) override;
   void complete_user_request(Context *&user_req, int r) override;
+  void add_into_log_map(pwl::GenericWriteLogEntries &log_entries,
+                        C_BlockIORequestT *req) override;
 
 protected:
   using AbstractWriteLog<ImageCtxT>::m_lock;
@@ -105,6 +108,7 @@ private:
   uint64_t pool_size;
   pwl::WriteLogPoolRoot pool_root;
   Builder<This> *m_builderobj;
+  std::unique_ptr<ReadCache> m_read_cache; /* null if disabled */
 
   Builder<This>* create_builder();
   void load_existing_entries(pwl::DeferredContexts &later);
@@ -116,6 +120,13 @@ private:
   void complete_read(
       std::vector<WriteLogCacheEntry*> &log_entries_to_read,
       std::vector<bufferlist*> &bls_to_read, Context *ctx) override;
+  void read_misses(pwl::C_ReadRequest *read_ctx, int fadvise_flags) override;
+  void invalidate_read_cache() override;
+  uint64_t get_read_cache_config_size();
+  void init_read_cache();
+  void fill_read_cache(
+      int r, const bufferlist &miss_bl,
+      const std::vector<std::pair<uint64_t, uint64_t>> &fills);
   void enlist_op_appender();
   bool retire_entries(const unsigned long int frees_per_tx);
   bool has_sync_point_logs(GenericLogOperations &ops);
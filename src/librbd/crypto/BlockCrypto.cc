@@ -14,7 +14,8 @@ template <typename T>
 BlockCrypto<T>::BlockCrypto(CephContext* cct, DataCryptor<T>* data_cryptor,
                             uint64_t block_size, uint64_t data_offset)
      : m_cct(cct), m_data_cryptor(data_cryptor), m_block_size(block_size),
-       m_data_offset(data_offset), m_iv_size(data_cryptor->get_iv_size()) {
+       m_data_offset(data_offset), m_iv_size(data_cryptor->get_iv_size()),
+       m_context_pool(data_cryptor, CONTEXT_POOL_SIZE) {
   ceph_assert(isp2(block_size));
   ceph_assert((block_size % data_cryptor->get_block_size()) == 0);
   ceph_assert((block_size % 512) == 0);
@@ -22,12 +23,42 @@ BlockCrypto<T>::BlockCrypto(CephContext* cct, DataCryptor<T>* data_cryptor,
 
 template <typename T>
 BlockCrypto<T>::~BlockCrypto() {
+  m_context_pool.clear();
   if (m_data_cryptor != nullptr) {
     delete m_data_cryptor;
     m_data_cryptor = nullptr;
   }
 }
 
+template <typename T>
+int BlockCrypto<T>::crypt_blocks(T* ctx, const unsigned char* in,
+                                 unsigned char* out, uint64_t len,
+                                 uint64_t* sector_number) {
+  ceph_assert(len % m_block_size == 0);
+  unsigned char* iv = (unsigned char*)alloca(m_iv_size);
+  memset(iv, 0, m_iv_size);
+
+  // XTS takes a tweak per data unit, so every block needs its own IV
+  for (uint64_t off = 0; off < len; off += m_block_size) {
+    auto block_offset_le = ceph_le64(*sector_number);
+    memcpy(iv, &block_offset_le, sizeof(block_offset_le));
+    auto r = m_data_cryptor->init_context(ctx, iv, m_iv_size);
+    if (r != 0) {
+      lderr(m_cct) << "unable to init cipher's IV" << dendl;
+      return r;
+    }
+
+    r = m_data_cryptor->update_context(ctx, in + off, out + off,
+                                       m_block_size);
+    if (r < 0) {
+      lderr(m_cct) << "crypt update failed" << dendl;
+      return r;
+    }
+    *sector_number += m_block_size / 512;
+  }
+  return 0;
+}
+
 template <typename T>
 int BlockCrypto<T>::crypt(ceph::bufferlist* data, uint64_t image_offset,
                            CipherMode mode) {
@@ -42,73 +73,93 @@ int BlockCrypto<T>::crypt(ceph::bufferlist* data, uint64_t image_offset,
     return -EINVAL;
   }
 
-  unsigned char* iv = (unsigned char*)alloca(m_iv_size);
-  memset(iv, 0, m_iv_size);
-
-  bufferlist src = *data;
-  data->clear();
-
-  auto ctx = m_data_cryptor->get_context(mode);
+  auto ctx = m_context_pool.get_context(mode);
   if (ctx == nullptr) {
     lderr(m_cct) << "unable to get crypt context" << dendl;
     return -EIO;
   }
+
+  bufferlist src;
+  src.swap(*data);
+
+  /* Ciphertext read back from the OSDs is decrypted in place as long as
+   * nobody else references the buffer.  Plaintext being encrypted may be
+   * caller memory (zero-copy writes) and must be left untouched, so it is
+   * always encrypted into a new buffer. */
+  bool in_place = (mode == CipherMode::CIPHER_MODE_DEC);
   auto sector_number = image_offset / 512;
-  auto appender = data->get_contiguous_appender(src.length());
-  unsigned char* out_buf_ptr = nullptr;
+  auto remaining = src.length();
+  bufferptr out;
+  uint32_t out_off = 0;
+  auto get_out = [&](uint32_t len) {
+    if (out.length() == 0) {
+      out = buffer::create(remaining);
+      out_off = 0;
+    }
+    ceph_assert(out_off + len <= out.length());
+    auto ptr = reinterpret_cast<unsigned char*>(out.c_str() + out_off);
+    data->append(out, out_off, len);
+    out_off += len;
+    return ptr;
+  };
+
   unsigned char* leftover_block = (unsigned char*)alloca(m_block_size);
   uint32_t leftover_size = 0;
-  for (auto buf = src.buffers().begin(); buf != src.buffers().end(); ++buf) {
-    auto in_buf_ptr = reinterpret_cast<const unsigned char*>(buf->c_str());
-    auto remaining_buf_bytes = buf->length();
-    while (remaining_buf_bytes > 0) {
-      if (leftover_size == 0) {
-        auto block_offset_le = ceph_le64(sector_number);
-        memcpy(iv, &block_offset_le, sizeof(block_offset_le));
-        auto r = m_data_cryptor->init_context(ctx, iv, m_iv_size);
-        if (r != 0) {
-          lderr(m_cct) << "unable to init cipher's IV" << dendl;
-          return r;
-        }
-
-        out_buf_ptr = reinterpret_cast<unsigned char*>(
-                appender.get_pos_add(m_block_size));
-        sector_number += m_block_size / 512;
+  int r = 0;
+  for (auto& buf : src.buffers()) {
+    auto in_buf_ptr = reinterpret_cast<const unsigned char*>(buf.c_str());
+    uint32_t buf_off = 0;
+    uint32_t buf_len = buf.length();
+
+    // complete a block that straddles buffers
+    if (leftover_size > 0) {
+      auto copy_size = std::min(
+        static_cast<uint32_t>(m_block_size) - leftover_size, buf_len);
+      memcpy(leftover_block + leftover_size, in_buf_ptr, copy_size);
+      leftover_size += copy_size;
+      buf_off += copy_size;
+      if (leftover_size < m_block_size) {
+        continue;
       }
-
-      if (leftover_size > 0 || remaining_buf_bytes < m_block_size) {
-        auto copy_size = std::min(
-                (uint32_t)m_block_size - leftover_size, remaining_buf_bytes);
-        memcpy(leftover_block + leftover_size, in_buf_ptr, copy_size);
-        in_buf_ptr += copy_size;
-        leftover_size += copy_size;
-        remaining_buf_bytes -= copy_size;
+      r = crypt_blocks(ctx, leftover_block, get_out(m_block_size),
+                       m_block_size, &sector_number);
+      if (r < 0) {
+        break;
       }
+      remaining -= m_block_size;
+      leftover_size = 0;
+    }
 
-      int crypto_output_length = 0;
-      if (leftover_size == 0) {
-        crypto_output_length = m_data_cryptor->update_context(
-              ctx, in_buf_ptr, out_buf_ptr, m_block_size);
-
-        in_buf_ptr += m_block_size;
-        remaining_buf_bytes -= m_block_size;
-      } else if (leftover_size == m_block_size) {
-        crypto_output_length = m_data_cryptor->update_context(
-              ctx, leftover_block, out_buf_ptr, m_block_size);
-        leftover_size = 0;
+    // whole blocks straight from the source buffer
+    uint32_t len = p2align<uint64_t>(buf_len - buf_off, m_block_size);
+    if (len > 0) {
+      unsigned char* out_ptr;
+      if (in_place && buf.raw_nref() == 1) {
+        out_ptr = const_cast<unsigned char*>(in_buf_ptr) + buf_off;
+        data->append(buf, buf_off, len);
+      } else {
+        out_ptr = get_out(len);
       }
-
-      if (crypto_output_length < 0) {
-        lderr(m_cct) << "crypt update failed" << dendl;
-        return crypto_output_length;
+      r = crypt_blocks(ctx, in_buf_ptr + buf_off, out_ptr, len,
+                       &sector_number);
+      if (r < 0) {
+        break;
       }
+      remaining -= len;
+      buf_off += len;
+    }
 
-      out_buf_ptr += crypto_output_length;
+    if (buf_off < buf_len) {
+      leftover_size = buf_len - buf_off;
+      memcpy(leftover_block, in_buf_ptr + buf_off, leftover_size);
     }
   }
 
-  m_data_cryptor->return_context(ctx, mode);
-
+  m_context_pool.return_context(ctx, mode);
+  if (r < 0) {
+    return r;
+  }
+  ceph_assert(leftover_size == 0);
   return 0;
 }
 
@@ -5,6 +5,7 @@
 #define CEPH_LIBRBD_CRYPTO_BLOCK_CRYPTO_H
 
 #include "include/Context.h"
+#include "librbd/crypto/CryptoContextPool.h"
 #include "librbd/crypto/CryptoInterface.h"
 #include "librbd/crypto/openssl/DataCryptor.h"
 
@@ -49,7 +50,13 @@ private:
     uint64_t m_data_offset;
     uint32_t m_iv_size;
 
+    // cipher contexts are expensive to set up (key schedule), reuse them
+    static constexpr uint32_t CONTEXT_POOL_SIZE = 32;
+    CryptoContextPool<T> m_context_pool;
+
     int crypt(ceph::bufferlist* data, uint64_t image_offset, CipherMode mode);
+    int crypt_blocks(T* ctx, const unsigned char* in, unsigned char* out,
+                     uint64_t len, uint64_t* sector_number);
 };
 
 } // namespace crypto
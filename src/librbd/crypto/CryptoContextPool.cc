@@ -2,6 +2,7 @@
 // vim: ts=8 sw=2 smarttab
 
 #include "librbd/crypto/CryptoContextPool.h"
+#include "librbd/crypto/openssl/DataCryptor.h"
 
 namespace librbd {
 namespace crypto {
@@ -15,6 +16,11 @@ CryptoContextPool<T>::CryptoContextPool(DataCryptor<T>* data_cryptor,
 
 template <typename T>
 CryptoContextPool<T>::~CryptoContextPool() {
+  clear();
+}
+
+template <typename T>
+void CryptoContextPool<T>::clear() {
   T* ctx;
   while (m_encrypt_contexts.pop(ctx)) {
     m_data_cryptor->return_context(ctx, CipherMode::CIPHER_MODE_ENC);
@@ -42,3 +48,5 @@ void CryptoContextPool<T>::return_context(T* ctx, CipherMode mode) {
 
 } // namespace crypto
 } // namespace librbd
+
+template class librbd::crypto::CryptoContextPool<EVP_CIPHER_CTX>;
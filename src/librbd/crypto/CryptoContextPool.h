@@ -22,6 +22,9 @@ public:
     T* get_context(CipherMode mode) override;
     void return_context(T* ctx, CipherMode mode) override;
 
+    // release all pooled contexts
+    void clear();
+
     inline uint32_t get_block_size() const override {
       return m_data_cryptor->get_block_size();
     }
@@ -4,11 +4,13 @@
 #include "ImageCopyRequest.h"
 #include "ObjectCopyRequest.h"
 #include "common/errno.h"
+#include "librbd/ManagementOps.h"
 #include "librbd/Utils.h"
 #include "librbd/deep_copy/Handler.h"
 #include "librbd/deep_copy/Utils.h"
 #include "librbd/object_map/DiffRequest.h"
 #include "osdc/Striper.h"
+#include <cstring>
 
 #define dout_subsys ceph_subsys_rbd
 #undef dout_prefix
@@ -88,6 +90,32 @@ void ImageCopyRequest<I>::map_src_objects(uint64_t dst_object,
   ldout(m_cct, 20) << dst_object << " -> " << *src_objects << dendl;
 }
 
+template <typename I>
+uint64_t ImageCopyRequest<I>::find_next_changed_object(uint64_t object_no) {
+  // only valid when source and destination objects map 1:1.  Unchanged
+  // holes are zero, so a zero word of the diff state is 32 objects to skip
+  static_assert(object_map::DIFF_STATE_HOLE == 0);
+  uint64_t end_object_no = std::min(m_end_object_no,
+                                    m_object_diff_state.size());
+  auto data = m_object_diff_state.get_data_buffer();
+  while (object_no < end_object_no) {
+    if (object_no % 32 == 0 && end_object_no - object_no >= 32) {
+      uint64_t word;
+      memcpy(&word, data + object_no / 4, sizeof(word));
+      if (word == 0) {
+        object_no += 32;
+        continue;
+      }
+    }
+    if ((data[object_no / 4] >> ((3 - object_no % 4) * 2) & 3) !=
+          object_map::DIFF_STATE_HOLE) {
+      break;
+    }
+    ++object_no;
+  }
+  return object_no;
+}
+
 template <typename I>
 void ImageCopyRequest<I>::compute_diff() {
   if (m_flatten) {
@@ -133,6 +161,13 @@ void ImageCopyRequest<I>::send_object_copies() {
     }
   }
   m_end_object_no = Striper::get_num_objects(m_dst_image_ctx->layout, size);
+  m_same_layout = (
+    m_src_image_ctx->layout.object_size ==
+      m_dst_image_ctx->layout.object_size &&
+    m_src_image_ctx->layout.stripe_unit ==
+      m_dst_image_ctx->layout.stripe_unit &&
+    m_src_image_ctx->layout.stripe_count ==
+      m_dst_image_ctx->layout.stripe_count);
 
   ldout(m_cct, 20) << "start_object=" << m_object_no << ", "
                    << "end_object=" << m_end_object_no << dendl;
@@ -140,8 +175,8 @@ void ImageCopyRequest<I>::send_object_copies() {
   bool complete;
   {
     std::lock_guard locker{m_lock};
-    auto max_ops = m_src_image_ctx->config.template get_val<uint64_t>(
-      "rbd_concurrent_management_ops");
+    auto max_ops = librbd::util::get_concurrent_management_ops(
+      m_src_image_ctx->config, m_src_image_ctx->layout.object_size);
 
     // attempt to schedule at least 'max_ops' initial requests where
     // some objects might be skipped if fast-diff notes no change
@@ -175,10 +210,28 @@ int ImageCopyRequest<I>::send_next_object_copy() {
     return -ENODATA;
   }
 
+  if (m_same_layout && m_object_diff_state.size() > 0) {
+    // skip whole runs of unchanged objects instead of one per call
+    uint64_t object_no = find_next_changed_object(m_object_no);
+    if (object_no > m_object_no) {
+      ldout(m_cct, 20) << "skipping non-existent objects [" << m_object_no
+                       << ", " << object_no << ")" << dendl;
+      m_copied_objects.push({m_object_no, object_no});
+      m_object_no = object_no;
+      if (m_object_no >= m_end_object_no) {
+        return -ENODATA;
+      }
+    }
+  }
+
   uint64_t ono = m_object_no++;
 
   uint8_t object_diff_state = object_map::DIFF_STATE_HOLE;
-  if (m_object_diff_state.size() > 0) {
+  if (m_same_layout && m_object_diff_state.size() > 0) {
+    object_diff_state = (ono < m_object_diff_state.size() ?
+      static_cast<uint8_t>(m_object_diff_state[ono]) :
+      static_cast<uint8_t>(object_map::DIFF_STATE_DATA_UPDATED));
+  } else if (m_object_diff_state.size() > 0) {
     std::set<uint64_t> src_objects;
     map_src_objects(ono, &src_objects);
 
@@ -199,6 +252,7 @@ int ImageCopyRequest<I>::send_next_object_copy() {
 
     if (object_diff_state == object_map::DIFF_STATE_HOLE) {
       ldout(m_cct, 20) << "skipping non-existent object " << ono << dendl;
+      m_copied_objects.push({ono, ono + 1});
       return 1;
     }
   }
@@ -242,20 +296,7 @@ void ImageCopyRequest<I>::handle_object_copy(uint64_t object_no, int r) {
         m_ret_val = r;
       }
     } else {
-      m_copied_objects.push(object_no);
-      while (!m_updating_progress && !m_copied_objects.empty() &&
-             m_copied_objects.top() ==
-               (m_object_number ? *m_object_number + 1 : 0)) {
-        m_object_number = m_copied_objects.top();
-        m_copied_objects.pop();
-        uint64_t progress_object_no = *m_object_number + 1;
-        m_updating_progress = true;
-        m_lock.unlock();
-        m_handler->update_progress(progress_object_no, m_end_object_no);
-        m_lock.lock();
-        ceph_assert(m_updating_progress);
-        m_updating_progress = false;
-      }
+      m_copied_objects.push({object_no, object_no + 1});
     }
 
     while (true) {
@@ -265,6 +306,21 @@ void ImageCopyRequest<I>::handle_object_copy(uint64_t object_no, int r) {
       }
     }
 
+    // skipped objects are reported along with the copied ones
+    while (!m_updating_progress && !m_copied_objects.empty() &&
+           m_copied_objects.top().first ==
+             (m_object_number ? *m_object_number + 1 : 0)) {
+      m_object_number = m_copied_objects.top().second - 1;
+      m_copied_objects.pop();
+      uint64_t progress_object_no = *m_object_number + 1;
+      m_updating_progress = true;
+      m_lock.unlock();
+      m_handler->update_progress(progress_object_no, m_end_object_no);
+      m_lock.lock();
+      ceph_assert(m_updating_progress);
+      m_updating_progress = false;
+    }
+
     complete = (m_current_ops == 0) && !m_updating_progress;
   }
 
@@ -95,15 +95,19 @@ private:
   uint64_t m_object_no = 0;
   uint64_t m_end_object_no = 0;
   uint64_t m_current_ops = 0;
+  // [start, end) ranges of copied or skipped objects pending progress update
   std::priority_queue<
-    uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> m_copied_objects;
+    std::pair<uint64_t, uint64_t>, std::vector<std::pair<uint64_t, uint64_t>>,
+    std::greater<std::pair<uint64_t, uint64_t>>> m_copied_objects;
   bool m_updating_progress = false;
   SnapMap m_snap_map;
   int m_ret_val = 0;
 
   BitVector<2> m_object_diff_state;
+  bool m_same_layout = false;
 
   void map_src_objects(uint64_t dst_object, std::set<uint64_t> *src_objects);
+  uint64_t find_next_changed_object(uint64_t object_no);
 
   void compute_diff();
   void handle_compute_diff(int r);
@@ -9,6 +9,7 @@
 #include "librbd/ImageCtx.h"
 #include "librbd/PluginRegistry.h"
 #include "librbd/Utils.h"
+#include "librbd/cache/ExtentObjectCacherObjectDispatch.h"
 #include "librbd/cache/ObjectCacherObjectDispatch.h"
 #include "librbd/cache/WriteAroundObjectDispatch.h"
 #include "librbd/image/CloseRequest.h"
@@ -583,9 +584,17 @@ Context *OpenRequest<I>::send_init_cache(int *result) {
       max_dirty = 0;
     }
 
-    auto cache = cache::ObjectCacherObjectDispatch<I>::create(
-      m_image_ctx, max_dirty, writethrough_until_flush);
-    cache->init();
+    auto shards = m_image_ctx->config.template get_val<uint64_t>(
+      "rbd_cache_shards");
+    if (shards > 0) {
+      auto cache = cache::ExtentObjectCacherObjectDispatch<I>::create(
+        m_image_ctx, max_dirty, writethrough_until_flush, shards);
+      cache->init();
+    } else {
+      auto cache = cache::ObjectCacherObjectDispatch<I>::create(
+        m_image_ctx, max_dirty, writethrough_until_flush);
+      cache->init();
+    }
 
     // readahead requires the object cacher cache
     m_image_ctx->readahead.set_trigger_requests(
@@ -1400,6 +1400,7 @@ void RefreshRequest<I>::apply() {
                << m_image_ctx.snap_name << dendl;
     m_image_ctx.snap_exists = false;
   }
+  m_image_ctx.invalidate_io_state();
 
   if (m_refresh_parent != nullptr) {
     m_refresh_parent->apply();
@@ -9,9 +9,11 @@
 #include "common/ceph_mutex.h"
 #include "common/dout.h"
 #include "common/AsyncOpTracker.h"
+#include "common/sharded_shared_mutex.h"
 #include "librbd/Utils.h"
 #include "librbd/io/DispatcherInterface.h"
 #include "librbd/io/Types.h"
+#include <algorithm>
 #include <map>
 
 #define dout_subsys ceph_subsys_rbd
@@ -29,11 +31,19 @@ public:
   typedef typename DispatchInterfaceT::DispatchLayer DispatchLayer;
   typedef typename DispatchInterfaceT::DispatchSpec DispatchSpec;
 
-  Dispatcher(ImageCtxT* image_ctx)
+  /**
+   * With num_queues > 1, IO submitted from different threads is spread
+   * over that many dispatch queues: the dispatch lock is sharded and each
+   * layer tracks in-flight calls per queue, so that threads submitting IO
+   * concurrently do not share any lock on the dispatch path.  Registering
+   * and removing layers becomes proportionally more expensive.
+   */
+  Dispatcher(ImageCtxT* image_ctx, uint32_t num_queues = 1)
     : m_image_ctx(image_ctx),
-      m_lock(ceph::make_shared_mutex(
-        librbd::util::unique_lock_name("librbd::io::Dispatcher::lock",
-                                       this))) {
+      m_num_queues(std::max<uint32_t>(num_queues, 1)),
+      m_lock(librbd::util::unique_lock_name("librbd::io::Dispatcher::lock",
+                                            this),
+             m_num_queues) {
   }
 
   virtual ~Dispatcher() {
@@ -64,7 +74,7 @@ public:
     std::unique_lock locker{m_lock};
 
     auto result = m_dispatches.insert(
-      {type, {dispatch, new AsyncOpTracker()}});
+      {type, {dispatch, new QueueOpTracker[m_num_queues]}});
     ceph_assert(result.second);
   }
 
@@ -116,7 +126,7 @@ public:
 
       auto& dispatch_meta = it->second;
       auto dispatch = dispatch_meta.dispatch;
-      auto async_op_tracker = dispatch_meta.async_op_tracker;
+      auto async_op_tracker = get_async_op_tracker(dispatch_meta);
       dispatch_spec->dispatch_result = DISPATCH_RESULT_INVALID;
 
       // prevent recursive locking back into the dispatcher while handling IO
@@ -140,22 +150,39 @@ public:
   }
 
 protected:
+  struct alignas(64) QueueOpTracker {
+    AsyncOpTracker async_op_tracker;
+  };
+
   struct DispatchMeta {
     Dispatch* dispatch = nullptr;
-    AsyncOpTracker* async_op_tracker = nullptr;
+    QueueOpTracker* async_op_trackers = nullptr; // one per queue
 
     DispatchMeta() {
     }
-    DispatchMeta(Dispatch* dispatch, AsyncOpTracker* async_op_tracker)
-      : dispatch(dispatch), async_op_tracker(async_op_tracker) {
+    DispatchMeta(Dispatch* dispatch, QueueOpTracker* async_op_trackers)
+      : dispatch(dispatch), async_op_trackers(async_op_trackers) {
     }
   };
 
   ImageCtxT* m_image_ctx;
+  const uint32_t m_num_queues;
 
-  ceph::shared_mutex m_lock;
+  ceph::sharded_shared_mutex m_lock;
   std::map<DispatchLayer, DispatchMeta> m_dispatches;
 
+  /// dispatch queue used by the calling thread
+  uint32_t get_queue_index() const {
+    if (m_num_queues == 1) {
+      return 0;
+    }
+    return ceph::sharded_shared_mutex::thread_slot() % m_num_queues;
+  }
+
+  AsyncOpTracker* get_async_op_tracker(const DispatchMeta& dispatch_meta) {
+    return &dispatch_meta.async_op_trackers[get_queue_index()].async_op_tracker;
+  }
+
   virtual bool send_dispatch(Dispatch* dispatch,
                              DispatchSpec* dispatch_spec) = 0;
 
@@ -183,16 +210,18 @@ protected:
 
         auto& dispatch_meta = it->second;
         auto dispatch = dispatch_meta.dispatch;
+        auto async_op_tracker = dispatcher->get_async_op_tracker(
+          dispatch_meta);
 
         // prevent recursive locking back into the dispatcher while handling IO
-        dispatch_meta.async_op_tracker->start_op();
+        async_op_tracker->start_op();
         dispatcher->m_lock.unlock_shared();
 
         // next loop should start after current layer
         dispatch_layer = dispatch->get_dispatch_layer();
 
         auto handled = execute(dispatch, this);
-        dispatch_meta.async_op_tracker->finish_op();
+        async_op_tracker->finish_op();
 
         if (handled) {
           break;
@@ -222,22 +251,27 @@ private:
   void shut_down_dispatch(DispatchMeta& dispatch_meta,
                           Context** on_finish) {
     auto dispatch = dispatch_meta.dispatch;
-    auto async_op_tracker = dispatch_meta.async_op_tracker;
+    auto async_op_trackers = dispatch_meta.async_op_trackers;
 
     auto ctx = *on_finish;
     ctx = new LambdaContext(
-      [dispatch, async_op_tracker, ctx](int r) {
+      [dispatch, async_op_trackers, ctx](int r) {
         delete dispatch;
-        delete async_op_tracker;
+        delete[] async_op_trackers;
 
         ctx->complete(r);
       });
     ctx = new LambdaContext([dispatch, ctx](int r) {
         dispatch->shut_down(ctx);
       });
-    *on_finish = new LambdaContext([async_op_tracker, ctx](int r) {
-        async_op_tracker->wait_for_ops(ctx);
-      });
+    for (auto queue = m_num_queues; queue > 0; --queue) {
+      auto async_op_tracker =
+        &async_op_trackers[queue - 1].async_op_tracker;
+      ctx = new LambdaContext([async_op_tracker, ctx](int r) {
+          async_op_tracker->wait_for_ops(ctx);
+        });
+    }
+    *on_finish = ctx;
   }
 
 };
@@ -126,16 +126,43 @@ struct ImageDispatcher<I>::PreprocessVisitor
   : public boost::static_visitor<bool> {
   ImageDispatcher<I>* image_dispatcher;
   ImageDispatchSpec* image_dispatch_spec;
+  const IOState* io_state;
 
   PreprocessVisitor(ImageDispatcher<I>* image_dispatcher,
-                    ImageDispatchSpec* image_dispatch_spec)
+                    ImageDispatchSpec* image_dispatch_spec,
+                    const IOState* io_state)
     : image_dispatcher(image_dispatcher),
-      image_dispatch_spec(image_dispatch_spec) {
+      image_dispatch_spec(image_dispatch_spec),
+      io_state(io_state) {
+  }
+
+  // equivalent of util::clip_request against a cached IO state
+  int clip_request(const IOState& state, Extents* image_extents) const {
+    if (state.snapshot && !state.snap_exists) {
+      return -ENOENT;
+    }
+
+    for (auto& image_extent : *image_extents) {
+      if (image_extent.second == 0) {
+        continue;
+      }
+      if (image_extent.first >= state.image_size) {
+        return -EINVAL;
+      }
+      image_extent.second = std::min(image_extent.second,
+                                     state.image_size - image_extent.first);
+    }
+    return 0;
   }
 
   bool clip_request() const {
-    int r = util::clip_request(image_dispatcher->m_image_ctx,
-                               &image_dispatch_spec->image_extents);
+    int r;
+    if (io_state != nullptr) {
+      r = clip_request(*io_state, &image_dispatch_spec->image_extents);
+    } else {
+      r = util::clip_request(image_dispatcher->m_image_ctx,
+                             &image_dispatch_spec->image_extents);
+    }
     if (r < 0) {
       image_dispatch_spec->fail(r);
       return true;
@@ -164,6 +191,14 @@ struct ImageDispatcher<I>::PreprocessVisitor
       return true;
     }
 
+    if (io_state != nullptr) {
+      if (io_state->snapshot || io_state->read_only) {
+        image_dispatch_spec->fail(-EROFS);
+        return true;
+      }
+      return false;
+    }
+
     std::shared_lock image_locker{image_dispatcher->m_image_ctx->image_lock};
     if (image_dispatcher->m_image_ctx->snap_id != CEPH_NOSNAP ||
         image_dispatcher->m_image_ctx->read_only) {
@@ -176,7 +211,15 @@ struct ImageDispatcher<I>::PreprocessVisitor
 
 template <typename I>
 ImageDispatcher<I>::ImageDispatcher(I* image_ctx)
-  : Dispatcher<I, ImageDispatcherInterface>(image_ctx) {
+  : Dispatcher<I, ImageDispatcherInterface>(
+      image_ctx, image_ctx->cct->_conf.template get_val<uint64_t>(
+        "rbd_io_dispatch_queues")) {
+  if (this->m_num_queues > 1) {
+    ldout(image_ctx->cct, 5) << "dispatch_queues=" << this->m_num_queues
+                             << dendl;
+    m_queues.reset(new DispatchQueue[this->m_num_queues]);
+  }
+
   // configure the core image dispatch handler on startup
   auto image_dispatch = new ImageDispatch(image_ctx);
   this->register_dispatch(image_dispatch);
@@ -224,6 +267,27 @@ void ImageDispatcher<I>::shut_down(Context* on_finish) {
   async_op->flush(on_finish);
 }
 
+template <typename I>
+void ImageDispatcher<I>::register_dispatch(
+    ImageDispatchInterface* image_dispatch) {
+  Dispatcher<I, ImageDispatcherInterface>::register_dispatch(image_dispatch);
+
+  // layers can remap extents and therefore change the effective image size
+  this->m_image_ctx->invalidate_io_state();
+}
+
+template <typename I>
+void ImageDispatcher<I>::shut_down_dispatch(ImageDispatchLayer dispatch_layer,
+                                            Context* on_finish) {
+  auto image_ctx = this->m_image_ctx;
+  on_finish = new LambdaContext([image_ctx, on_finish](int r) {
+      image_ctx->invalidate_io_state();
+      on_finish->complete(r);
+    });
+  Dispatcher<I, ImageDispatcherInterface>::shut_down_dispatch(dispatch_layer,
+                                                              on_finish);
+}
+
 template <typename I>
 void ImageDispatcher<I>::apply_qos_schedule_tick_min(uint64_t tick) {
   m_qos_image_dispatch->apply_qos_schedule_tick_min(tick);
@@ -289,9 +353,15 @@ bool ImageDispatcher<I>::send_dispatch(
     ImageDispatchInterface* image_dispatch,
     ImageDispatchSpec* image_dispatch_spec) {
   if (image_dispatch_spec->tid == 0) {
-    image_dispatch_spec->tid = ++m_next_tid;
-
-    bool finished = preprocess(image_dispatch_spec);
+    bool finished;
+    if (m_queues) {
+      IOState io_state;
+      image_dispatch_spec->tid = queue_io(&io_state);
+      finished = preprocess(image_dispatch_spec, &io_state);
+    } else {
+      image_dispatch_spec->tid = ++m_next_tid;
+      finished = preprocess(image_dispatch_spec, nullptr);
+    }
     if (finished) {
       return true;
     }
@@ -304,12 +374,58 @@ bool ImageDispatcher<I>::send_dispatch(
 
 template <typename I>
 bool ImageDispatcher<I>::preprocess(
-    ImageDispatchSpec* image_dispatch_spec) {
+    ImageDispatchSpec* image_dispatch_spec, const IOState* io_state) {
   return boost::apply_visitor(
-    PreprocessVisitor{this, image_dispatch_spec},
+    PreprocessVisitor{this, image_dispatch_spec, io_state},
     image_dispatch_spec->request);
 }
 
+template <typename I>
+uint64_t ImageDispatcher<I>::queue_io(IOState* io_state) {
+  auto queue_index = this->get_queue_index();
+  auto& queue = m_queues[queue_index];
+  auto epoch = this->m_image_ctx->io_state_epoch.load(
+    std::memory_order_acquire);
+
+  std::unique_lock locker{queue.lock};
+
+  // interleave the per-queue sequences so that tids remain unique
+  uint64_t tid = ++queue.next_tid * this->m_num_queues + queue_index;
+  if (queue.io_state_valid && queue.io_state.epoch == epoch) {
+    *io_state = queue.io_state;
+    return tid;
+  }
+  locker.unlock();
+
+  // the image has been refreshed (or this queue is new)
+  get_io_state(io_state);
+
+  locker.lock();
+  if (!queue.io_state_valid || queue.io_state.epoch < io_state->epoch) {
+    queue.io_state = *io_state;
+    queue.io_state_valid = true;
+  }
+  return tid;
+}
+
+template <typename I>
+void ImageDispatcher<I>::get_io_state(IOState* io_state) {
+  auto image_ctx = this->m_image_ctx;
+
+  std::shared_lock image_locker{image_ctx->image_lock};
+  io_state->epoch = image_ctx->io_state_epoch.load(std::memory_order_acquire);
+  io_state->snapshot = (image_ctx->snap_id != CEPH_NOSNAP);
+  io_state->snap_exists = (!io_state->snapshot ||
+                           image_ctx->get_snap_info(image_ctx->snap_id) !=
+                             nullptr);
+  io_state->read_only = image_ctx->read_only;
+  io_state->image_size = image_ctx->get_effective_image_size(
+    image_ctx->snap_id);
+
+  ldout(image_ctx->cct, 15) << "epoch=" << io_state->epoch << ", "
+                            << "image_size=" << io_state->image_size << dendl;
+}
+
 } // namespace io
 } // namespace librbd
 
@@ -13,6 +13,7 @@
 #include "librbd/io/Types.h"
 #include <atomic>
 #include <map>
+#include <memory>
 
 struct Context;
 
@@ -34,6 +35,10 @@ public:
 
   void shut_down(Context* on_finish) override;
 
+  void register_dispatch(ImageDispatchInterface* image_dispatch) override;
+  void shut_down_dispatch(ImageDispatchLayer dispatch_layer,
+                          Context* on_finish) override;
+
   void apply_qos_schedule_tick_min(uint64_t tick) override;
   void apply_qos_limit(uint64_t flag, uint64_t limit, uint64_t burst,
                        uint64_t burst_seconds) override;
@@ -60,12 +65,40 @@ private:
 
   using typename Dispatcher<ImageCtxT, ImageDispatcherInterface>::C_InvalidateCache;
 
+  /// what new IO is validated and clipped against
+  struct IOState {
+    uint64_t epoch = 0;
+    bool snap_exists = true;
+    bool read_only = false;
+    bool snapshot = false;
+    uint64_t image_size = 0;
+  };
+
+  /**
+   * With rbd_io_dispatch_queues > 1, each queue assigns tids and keeps a
+   * copy of the IO state, refreshed only when ImageCtx::io_state_epoch
+   * changes, so that preprocessing new IO does not touch the image_lock
+   * or any other cache line shared with other queues.
+   */
+  struct alignas(64) DispatchQueue {
+    ceph::mutex lock = ceph::make_mutex(
+      "librbd::io::ImageDispatcher::DispatchQueue::lock");
+    uint64_t next_tid = 0;
+    bool io_state_valid = false;
+    IOState io_state;
+  };
+
   std::atomic<uint64_t> m_next_tid{0};
+  std::unique_ptr<DispatchQueue[]> m_queues;
 
   QosImageDispatch<ImageCtxT>* m_qos_image_dispatch = nullptr;
   WriteBlockImageDispatch<ImageCtxT>* m_write_block_dispatch = nullptr;
 
-  bool preprocess(ImageDispatchSpec* image_dispatch_spec);
+  bool preprocess(ImageDispatchSpec* image_dispatch_spec,
+                  const IOState* io_state);
+
+  uint64_t queue_io(IOState* io_state);
+  void get_io_state(IOState* io_state);
 
 };
 
@@ -6,6 +6,7 @@
 #include "common/ceph_time.h"
 #include "common/Timer.h"
 #include "common/errno.h"
+#include "common/perf_counters.h"
 #include "librbd/AsioEngine.h"
 #include "librbd/ImageCtx.h"
 #include "librbd/Utils.h"
@@ -14,6 +15,9 @@
 #include "librbd/io/ObjectDispatcher.h"
 #include "librbd/io/Utils.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics/rolling_count.hpp>
 #include <boost/accumulators/statistics/rolling_sum.hpp>
@@ -63,11 +67,14 @@ public:
 template <typename I>
 bool SimpleSchedulerObjectDispatch<I>::ObjectRequests::try_delay_request(
     uint64_t object_off, ceph::bufferlist&& data, IOContext io_context,
-    int op_flags, int object_dispatch_flags, Context* on_dispatched) {
+    int op_flags, int object_dispatch_flags, Context* on_dispatched,
+    uint64_t* overwritten_bytes) {
+  *overwritten_bytes = 0;
   if (!m_delayed_requests.empty()) {
+    // a delayed zero length write covers the whole object
     if (!m_io_context || *m_io_context != *io_context ||
         op_flags != m_op_flags || data.length() == 0 ||
-        intersects(object_off, data.length())) {
+        m_delayed_request_extents.range_end() == UINT64_MAX) {
       return false;
     }
   } else {
@@ -75,77 +82,85 @@ bool SimpleSchedulerObjectDispatch<I>::ObjectRequests::try_delay_request(
     m_op_flags = op_flags;
   }
 
+  m_object_dispatch_flags |= object_dispatch_flags;
+
   if (data.length() == 0) {
     // a zero length write is usually a special case,
     // and we don't want it to be merged with others
     ceph_assert(m_delayed_requests.empty());
     m_delayed_request_extents.insert(0, UINT64_MAX);
-  } else {
-    m_delayed_request_extents.insert(object_off, data.length());
+
+    auto iter = m_delayed_requests.insert({object_off, {}}).first;
+    iter->second.requests.push_back(on_dispatched);
+    return true;
   }
-  m_object_dispatch_flags |= object_dispatch_flags;
 
-  if (!m_delayed_requests.empty()) {
-    // try to merge front to an existing request
-    auto iter = m_delayed_requests.find(object_off + data.length());
-    if (iter != m_delayed_requests.end()) {
-      auto new_iter = m_delayed_requests.insert({object_off, {}}).first;
-      new_iter->second.data = std::move(data);
-      new_iter->second.data.append(std::move(iter->second.data));
-      new_iter->second.requests = std::move(iter->second.requests);
-      new_iter->second.requests.push_back(on_dispatched);
-      m_delayed_requests.erase(iter);
-
-      if (new_iter != m_delayed_requests.begin()) {
-        auto prev = new_iter;
-        try_merge_delayed_requests(--prev, new_iter);
-      }
-      return true;
+  // find the delayed requests overlapping or adjacent to this one
+  uint64_t object_end = object_off + data.length();
+  auto first = m_delayed_requests.lower_bound(object_off);
+  if (first != m_delayed_requests.begin()) {
+    auto prev = std::prev(first);
+    if (prev->first + prev->second.data.length() >= object_off) {
+      first = prev;
     }
+  }
+  auto last = first;
+  while (last != m_delayed_requests.end() && last->first <= object_end) {
+    ++last;
+  }
+  m_delayed_request_extents.union_insert(object_off, data.length());
 
-    // try to merge back to an existing request
-    iter = m_delayed_requests.lower_bound(object_off);
-    if (iter == m_delayed_requests.end() || iter->first > object_off) {
-      iter--;
-    }
-    if (iter != m_delayed_requests.end() &&
-        iter->first + iter->second.data.length() == object_off) {
-      iter->second.data.append(std::move(data));
-      iter->second.requests.push_back(on_dispatched);
-
-      auto next = iter;
-      if (++next != m_delayed_requests.end()) {
-        try_merge_delayed_requests(iter, next);
-      }
-      return true;
-    }
+  if (first == last) {
+    // create a new request
+    auto iter = m_delayed_requests.insert({object_off, {}}).first;
+    iter->second.data = std::move(data);
+    iter->second.requests.push_back(on_dispatched);
+    return true;
   }
 
-  // create a new request
-  auto iter = m_delayed_requests.insert({object_off, {}}).first;
-  iter->second.data = std::move(data);
-  iter->second.requests.push_back(on_dispatched);
-  return true;
-}
+  // merge into a single request, with the new data replacing any
+  // overlapping delayed data
+  MergedRequests merged;
+  uint64_t merged_off = std::min(first->first, object_off);
+  if (first->first < object_off) {
+    merged.data.substr_of(first->second.data, 0, object_off - first->first);
+  }
+  merged.data.claim_append(data);
+
+  auto back = std::prev(last);
+  uint64_t back_end = back->first + back->second.data.length();
+  if (back_end > object_end) {
+    ceph::bufferlist tail;
+    tail.substr_of(back->second.data, object_end - back->first,
+                   back_end - object_end);
+    merged.data.claim_append(tail);
+  }
 
-template <typename I>
-void SimpleSchedulerObjectDispatch<I>::ObjectRequests::try_merge_delayed_requests(
-    typename std::map<uint64_t, MergedRequests>::iterator &iter1,
-    typename std::map<uint64_t, MergedRequests>::iterator &iter2) {
-  if (iter1->first + iter1->second.data.length() != iter2->first) {
-    return;
+  for (auto iter = first; iter != last; ++iter) {
+    uint64_t overlap_off = std::max(iter->first, object_off);
+    uint64_t overlap_end = std::min(iter->first + iter->second.data.length(),
+                                    object_end);
+    if (overlap_end > overlap_off) {
+      *overwritten_bytes += overlap_end - overlap_off;
+    }
+    merged.requests.splice(merged.requests.end(), iter->second.requests);
   }
+  merged.requests.push_back(on_dispatched);
 
-  iter1->second.data.append(std::move(iter2->second.data));
-  iter1->second.requests.insert(iter1->second.requests.end(),
-                                iter2->second.requests.begin(),
-                                iter2->second.requests.end());
-  m_delayed_requests.erase(iter2);
+  m_delayed_requests.erase(first, last);
+  m_delayed_requests.emplace(merged_off, std::move(merged));
+  return true;
 }
 
 template <typename I>
 void SimpleSchedulerObjectDispatch<I>::ObjectRequests::dispatch_delayed_requests(
     I *image_ctx, LatencyStats *latency_stats, ceph::mutex *latency_stats_lock) {
+  auto cct = image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << m_object_no << ": sending "
+                 << m_delayed_requests.size() << " merged writes" << dendl;
+  image_ctx->perfcounter->inc(l_librbd_sched_merged_wr,
+                              m_delayed_requests.size());
+
   for (auto &it : m_delayed_requests) {
     auto offset = it.first;
     auto &merged_requests = it.second;
@@ -391,11 +406,20 @@ bool SimpleSchedulerObjectDispatch<I>::try_delay_write(
   }
 
   auto &object_requests = it->second;
+  uint64_t overwritten_bytes;
   bool delayed = object_requests->try_delay_request(
       object_off, std::move(data), io_context, op_flags, object_dispatch_flags,
-      on_dispatched);
-
-  ldout(cct, 20) << "delayed: " << delayed << dendl;
+      on_dispatched, &overwritten_bytes);
+
+  ldout(cct, 20) << "delayed: " << delayed << ", overwritten_bytes="
+                 << overwritten_bytes << dendl;
+  if (delayed) {
+    m_image_ctx->perfcounter->inc(l_librbd_sched_delayed_wr);
+    if (overwritten_bytes > 0) {
+      m_image_ctx->perfcounter->inc(l_librbd_sched_overwritten_bytes,
+                                    overwritten_bytes);
+    }
+  }
 
   // schedule dispatch on the first request added
   if (delayed && !object_requests->is_scheduled_dispatch()) {
@@ -505,6 +529,36 @@ void SimpleSchedulerObjectDispatch<I>::dispatch_delayed_requests(
   }
 }
 
+template <typename I>
+void SimpleSchedulerObjectDispatch<I>::dispatch_expired_delayed_requests() {
+  ceph_assert(ceph_mutex_is_locked(m_lock));
+  auto cct = m_image_ctx->cct;
+
+  // send everything else that is due in one pass, ordered by object,
+  // rather than waking up once per object
+  auto now = ceph::real_clock::now();
+  std::vector<uint64_t> object_nos;
+  for (auto& object_requests : m_dispatch_queue) {
+    if (!object_requests->is_scheduled_dispatch()) {
+      continue;
+    }
+    if (object_requests->get_dispatch_time() > now) {
+      break;
+    }
+    object_nos.push_back(object_requests->get_object_no());
+  }
+  if (object_nos.empty()) {
+    return;
+  }
+
+  ldout(cct, 20) << "dispatching " << object_nos.size() << " objects"
+                 << dendl;
+  std::sort(object_nos.begin(), object_nos.end());
+  for (auto object_no : object_nos) {
+    dispatch_delayed_requests(object_no);
+  }
+}
+
 template <typename I>
 void SimpleSchedulerObjectDispatch<I>::schedule_dispatch_delayed_requests() {
   ceph_assert(ceph_mutex_is_locked(m_lock));
@@ -549,6 +603,7 @@ void SimpleSchedulerObjectDispatch<I>::schedule_dispatch_delayed_requests() {
         [this, object_no]() {
           std::lock_guard locker{m_lock};
           dispatch_delayed_requests(object_no);
+          dispatch_expired_delayed_requests();
         });
     });
 
@@ -26,6 +26,12 @@ class LatencyStats;
 
 /**
  * Simple scheduler plugin for object dispatcher layer.
+ *
+ * Writes to an object that already has IO in flight are delayed until
+ * that IO completes or a short deadline passes.  Delayed writes that
+ * are adjacent are concatenated and overlapping ones are collapsed, the
+ * newer data replacing the older, so that each object gets as few
+ * writes as possible.
  */
 template <typename ImageCtxT = ImageCtx>
 class SimpleSchedulerObjectDispatch : public ObjectDispatchInterface {
@@ -165,7 +171,8 @@ private:
 
     bool try_delay_request(uint64_t object_off, ceph::bufferlist&& data,
                            IOContext io_context, int op_flags,
-                           int object_dispatch_flags, Context* on_dispatched);
+                           int object_dispatch_flags, Context* on_dispatched,
+                           uint64_t* overwritten_bytes);
 
     void dispatch_delayed_requests(ImageCtxT *image_ctx,
                                    LatencyStats *latency_stats,
@@ -180,10 +187,6 @@ private:
     int m_object_dispatch_flags = 0;
     std::map<uint64_t, MergedRequests> m_delayed_requests;
     interval_set<uint64_t> m_delayed_request_extents;
-
-    void try_merge_delayed_requests(
-        typename std::map<uint64_t, MergedRequests>::iterator &iter,
-        typename std::map<uint64_t, MergedRequests>::iterator &iter2);
   };
 
   typedef std::shared_ptr<ObjectRequests> ObjectRequestsRef;
@@ -213,6 +216,7 @@ private:
   void dispatch_all_delayed_requests();
   void dispatch_delayed_requests(uint64_t object_no);
   void dispatch_delayed_requests(ObjectRequestsRef object_requests);
+  void dispatch_expired_delayed_requests();
   void register_in_flight_request(uint64_t object_no, const utime_t &start_time,
                                   Context** on_finish);
 
@@ -8,6 +8,7 @@
 #include "librbd/ObjectMap.h"
 #include "librbd/Utils.h"
 #include "osdc/Striper.h"
+#include <cstring>
 #include <string>
 
 #define dout_subsys ceph_subsys_rbd
@@ -20,6 +21,87 @@ namespace object_map {
 
 using util::create_rados_callback;
 
+namespace {
+
+// object maps and diff states are packed two bits per object, four objects
+// per byte with the first object in the most significant bits
+const uint64_t OBJECTS_PER_BYTE = 4;
+const uint64_t OBJECTS_PER_WORD = OBJECTS_PER_BYTE * sizeof(uint64_t);
+const uint64_t LOW_BITS = 0x5555555555555555ULL;
+
+/*
+ * Apply a lane-wise transform to the diff state of objects [start, end).
+ * The transform is given a word of object map states and a word of the
+ * matching previous diff states and returns the new diff states, so most
+ * of the range is processed 32 objects at a time.
+ */
+template <typename F>
+void transform_diff_state(const uint8_t* object_map, uint8_t* diff_state,
+                          uint64_t start, uint64_t end, F&& transform) {
+  uint64_t object_no = start;
+  while (object_no < end) {
+    uint64_t byte = object_no / OBJECTS_PER_BYTE;
+    if (object_no % OBJECTS_PER_WORD == 0 &&
+        end - object_no >= OBJECTS_PER_WORD) {
+      uint64_t om;
+      uint64_t ds;
+      memcpy(&om, object_map + byte, sizeof(om));
+      memcpy(&ds, diff_state + byte, sizeof(ds));
+      ds = transform(om, ds);
+      memcpy(diff_state + byte, &ds, sizeof(ds));
+      object_no += OBJECTS_PER_WORD;
+      continue;
+    }
+
+    uint64_t first = object_no % OBJECTS_PER_BYTE;
+    uint64_t count = std::min(OBJECTS_PER_BYTE - first, end - object_no);
+    uint8_t mask = 0;
+    for (uint64_t i = first; i < first + count; ++i) {
+      mask |= 3 << ((OBJECTS_PER_BYTE - 1 - i) * 2);
+    }
+    uint8_t ds = transform(object_map[byte], diff_state[byte]);
+    diff_state[byte] = (diff_state[byte] & ~mask) | (ds & mask);
+    object_no += count;
+  }
+}
+
+// new diff state of objects covered by both this and the previous snapshot
+uint64_t overlap_diff_state(uint64_t object_map, uint64_t diff_state) {
+  static_assert(OBJECT_NONEXISTENT == 0 && OBJECT_EXISTS == 1 &&
+                OBJECT_PENDING == 2 && OBJECT_EXISTS_CLEAN == 3);
+  static_assert(DIFF_STATE_HOLE == 0 && DIFF_STATE_DATA == 1 &&
+                DIFF_STATE_HOLE_UPDATED == 2 && DIFF_STATE_DATA_UPDATED == 3);
+  uint64_t om_hi = (object_map >> 1) & LOW_BITS;
+  uint64_t om_lo = object_map & LOW_BITS;
+  uint64_t ds_hi = (diff_state >> 1) & LOW_BITS;
+  uint64_t ds_lo = diff_state & LOW_BITS;
+
+  // EXISTS / PENDING: data updated
+  // EXISTS_CLEAN: data updated unless the previous state holds data
+  // NONEXISTENT: hole updated unless the previous state is a hole
+  uint64_t dirty = om_hi ^ om_lo;
+  uint64_t clean = om_hi & om_lo;
+  uint64_t nonexistent = ~(om_hi | om_lo) & LOW_BITS;
+  uint64_t hi = dirty | (clean & (ds_hi | ~ds_lo)) |
+                (nonexistent & (ds_hi | ds_lo));
+  uint64_t lo = om_hi | om_lo;
+  return ((hi & LOW_BITS) << 1) | lo;
+}
+
+// diff state of objects beyond the end of the previous snapshot
+uint64_t resize_diff_state(uint64_t object_map, bool diff_from_start) {
+  uint64_t om_hi = (object_map >> 1) & LOW_BITS;
+  uint64_t om_lo = object_map & LOW_BITS;
+
+  // NONEXISTENT: hole, EXISTS_CLEAN: data (updated if diffing from the
+  // start), otherwise data updated
+  uint64_t lo = om_hi | om_lo;
+  uint64_t hi = diff_from_start ? lo : om_hi ^ om_lo;
+  return (hi << 1) | lo;
+}
+
+} // anonymous namespace
+
 template <typename I>
 void DiffRequest<I>::send() {
   auto cct = m_image_ctx->cct;
@@ -188,52 +270,31 @@ void DiffRequest<I>::handle_load_object_map(int r) {
   }
 
   uint64_t overlap = std::min(m_object_map.size(), prev_object_diff_state_size);
-  auto it = m_object_map.begin();
-  auto overlap_end_it = it + overlap;
-  auto diff_it = m_object_diff_state->begin();
-  uint64_t i = 0;
-  for (; it != overlap_end_it; ++it, ++diff_it, ++i) {
-    uint8_t object_map_state = *it;
-    uint8_t prev_object_diff_state = *diff_it;
-    if (object_map_state == OBJECT_EXISTS ||
-        object_map_state == OBJECT_PENDING ||
-        (object_map_state == OBJECT_EXISTS_CLEAN &&
-         prev_object_diff_state != DIFF_STATE_DATA &&
-         prev_object_diff_state != DIFF_STATE_DATA_UPDATED)) {
-      *diff_it = DIFF_STATE_DATA_UPDATED;
-    } else if (object_map_state == OBJECT_NONEXISTENT &&
-               prev_object_diff_state != DIFF_STATE_HOLE &&
-               prev_object_diff_state != DIFF_STATE_HOLE_UPDATED) {
-      *diff_it = DIFF_STATE_HOLE_UPDATED;
-    }
-
-    ldout(cct, 20) << "object state: " << i << " "
-                   << static_cast<uint32_t>(prev_object_diff_state)
-                   << "->" << static_cast<uint32_t>(*diff_it) << " ("
-                   << static_cast<uint32_t>(object_map_state) << ")"
-                   << dendl;
-  }
+  auto object_map = m_object_map.get_data_buffer();
+  auto diff_state = m_object_diff_state->get_data_buffer();
+  transform_diff_state(object_map, diff_state, 0, overlap,
+                       overlap_diff_state);
   ldout(cct, 20) << "computed overlap diffs" << dendl;
 
   bool diff_from_start = (m_snap_id_start == 0);
-  auto end_it = m_object_map.end();
   if (m_object_map.size() > prev_object_diff_state_size) {
-    for (; it != end_it; ++it,++diff_it, ++i) {
-      uint8_t object_map_state = *it;
-      if (object_map_state == OBJECT_NONEXISTENT) {
-        *diff_it = DIFF_STATE_HOLE;
-      } else if (diff_from_start || object_map_state != OBJECT_EXISTS_CLEAN) {
-        *diff_it = DIFF_STATE_DATA_UPDATED;
-      } else {
-        *diff_it = DIFF_STATE_DATA;
-      }
+    transform_diff_state(
+      object_map, diff_state, overlap, m_object_map.size(),
+      [diff_from_start](uint64_t om, uint64_t) {
+        return resize_diff_state(om, diff_from_start);
+      });
+  }
+  ldout(cct, 20) << "computed resize diffs" << dendl;
 
+  if (cct->_conf->subsys.template should_gather<dout_subsys, 20>()) {
+    auto it = m_object_map.begin();
+    auto diff_it = m_object_diff_state->begin();
+    for (uint64_t i = 0; it != m_object_map.end(); ++it, ++diff_it, ++i) {
       ldout(cct, 20) << "object state: " << i << " "
                      << "->" << static_cast<uint32_t>(*diff_it) << " ("
                      << static_cast<uint32_t>(*it) << ")" << dendl;
     }
   }
-  ldout(cct, 20) << "computed resize diffs" << dendl;
 
   m_object_diff_state_valid = true;
 
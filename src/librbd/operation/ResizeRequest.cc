@@ -48,6 +48,7 @@ ResizeRequest<I>::~ResizeRequest() {
     if (!image_ctx.resize_reqs.empty()) {
       next_req = image_ctx.resize_reqs.front();
     }
+    image_ctx.invalidate_io_state();
   }
 
   if (next_req != NULL) {
@@ -73,6 +74,7 @@ void ResizeRequest<I>::send() {
     ceph_assert(image_ctx.resize_reqs.front() == this);
     m_original_size = image_ctx.size;
     compute_parent_overlap();
+    image_ctx.invalidate_io_state();
   }
 
   Request<I>::send();
@@ -454,6 +456,7 @@ void ResizeRequest<I>::update_size_and_overlap() {
     if (image_ctx.parent != NULL && m_new_size < m_original_size) {
       image_ctx.parent_md.overlap = m_new_parent_overlap;
     }
+    image_ctx.invalidate_io_state();
   }
 
   // blocked by PRE_BLOCK_WRITES (grow) or POST_BLOCK_WRITES (shrink) state
@@ -19,6 +19,8 @@
 #include <string_view>
 #include <set>
 
+#include <boost/intrusive/set.hpp>
+
 #include "include/counter.h"
 #include "include/types.h"
 #include "include/buffer_fwd.h"
@@ -149,7 +151,7 @@ public:
     return *this < *static_cast<const CDentry*>(r);
   }
 
-  dentry_key_t key() {
+  dentry_key_t key() const {
     return dentry_key_t(last, name.c_str(), hash);
   }
 
@@ -366,8 +368,13 @@ public:
   SimpleLock lock; // FIXME referenced containers not in mempool
   LocalLockC versionlock; // FIXME referenced containers not in mempool
 
-  mempool::mds_co::map<client_t,ClientLease*> client_lease_map;
-  std::map<int, std::unique_ptr<BatchOp>> batch_ops;
+  mempool::mds_co::compact_map<client_t,ClientLease*> client_lease_map;
+  batch_op_map_t batch_ops;
+
+  // link in the containing dirfrag's items, keyed by key()
+  using dir_item_hook_t = boost::intrusive::set_member_hook<
+    boost::intrusive::optimize_size<true>>;
+  dir_item_hook_t item_dir;
 
 
 protected:
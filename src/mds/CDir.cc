@@ -359,7 +359,7 @@ CDentry* CDir::add_null_dentry(std::string_view dname,
   ceph_assert(items.count(dn->key()) == 0);
   //assert(null_items.count(dn->get_name()) == 0);
 
-  items[dn->key()] = dn;
+  items.insert(dn);
   if (last == CEPH_NOSNAP)
     num_head_null++;
   else
@@ -406,7 +406,7 @@ CDentry* CDir::add_primary_dentry(std::string_view dname, CInode *in,
   ceph_assert(items.count(dn->key()) == 0);
   //assert(null_items.count(dn->get_name()) == 0);
 
-  items[dn->key()] = dn;
+  items.insert(dn);
 
   dn->get_linkage()->inode = in;
 
@@ -451,7 +451,7 @@ CDentry* CDir::add_remote_dentry(std::string_view dname, inodeno_t ino, unsigned
   ceph_assert(items.count(dn->key()) == 0);
   //assert(null_items.count(dn->get_name()) == 0);
 
-  items[dn->key()] = dn;
+  items.insert(dn);
   if (last == CEPH_NOSNAP)
     num_head_items++;
   else
@@ -504,7 +504,7 @@ void CDir::remove_dentry(CDentry *dn)
   
   // remove from list
   ceph_assert(items.count(dn->key()) == 1);
-  items.erase(dn->key());
+  items.erase(dn);
 
   // clean?
   if (dn->is_dirty())
@@ -848,12 +848,13 @@ void CDir::steal_dentry(CDentry *dn)
 {
   dout(15) << __func__ << " " << *dn << dendl;
 
-  items[dn->key()] = dn;
-
-  dn->dir->items.erase(dn->key());
+  // a dentry is linked into one dirfrag at a time
+  dn->dir->items.erase(dn);
   if (dn->dir->items.empty())
     dn->dir->put(PIN_CHILD);
 
+  items.insert(dn);
+
   if (get_num_any() == 0)
     get(PIN_CHILD);
   if (dn->get_linkage()->is_null()) {
@@ -19,10 +19,13 @@
 #include <iosfwd>
 #include <list>
 #include <map>
+#include <optional>
 #include <set>
 #include <string>
 #include <string_view>
 
+#include <boost/intrusive/set.hpp>
+
 #include "common/bloom_filter.hpp"
 #include "common/config.h"
 #include "include/buffer_fwd.h"
@@ -45,7 +48,112 @@ class CDir : public MDSCacheObject, public Counter<CDir> {
 public:
   MEMPOOL_CLASS_HELPERS();
 
-  typedef mempool::mds_co::map<dentry_key_t, CDentry*> dentry_key_map;
+  /**
+   * The dentries of a dirfrag, ordered by CDentry::key().
+   *
+   * Dentries are linked in through CDentry::item_dir, so unlike a map
+   * this allocates nothing per dentry.  Iterators stay valid until their
+   * own dentry is removed and dereference to a (key, dentry) pair, as a
+   * map's would; the pair is kept in the iterator.
+   */
+  class dentry_key_map {
+    struct key_of_dentry {
+      typedef dentry_key_t type;
+      dentry_key_t operator()(const CDentry& dn) const {
+	return dn.key();
+      }
+    };
+    typedef boost::intrusive::set<
+      CDentry,
+      boost::intrusive::member_hook<CDentry, CDentry::dir_item_hook_t,
+				    &CDentry::item_dir>,
+      boost::intrusive::key_of_value<key_of_dentry>> dentry_set_t;
+
+  public:
+    typedef std::pair<const dentry_key_t, CDentry*> value_type;
+
+    class iterator {
+    public:
+      typedef std::bidirectional_iterator_tag iterator_category;
+      typedef dentry_key_map::value_type value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef value_type* pointer;
+      typedef value_type& reference;
+
+      iterator() {}
+      explicit iterator(dentry_set_t::iterator p) : p(p) {}
+      iterator(const iterator& o) : p(o.p) {}
+      iterator& operator=(const iterator& o) {
+	p = o.p;
+	v.reset();
+	return *this;
+      }
+
+      reference operator*() const {
+	v.emplace(p->key(), &*p);
+	return *v;
+      }
+      pointer operator->() const {
+	return &**this;
+      }
+      iterator& operator++() {
+	++p;
+	return *this;
+      }
+      iterator operator++(int) {
+	iterator t(*this);
+	++p;
+	return t;
+      }
+      iterator& operator--() {
+	--p;
+	return *this;
+      }
+      iterator operator--(int) {
+	iterator t(*this);
+	--p;
+	return t;
+      }
+      bool operator==(const iterator& o) const { return p == o.p; }
+      bool operator!=(const iterator& o) const { return p != o.p; }
+
+    private:
+      dentry_set_t::iterator p;
+      mutable std::optional<value_type> v;
+    };
+
+    bool empty() const { return dentries.empty(); }
+    size_t size() const { return dentries.size(); }
+
+    iterator begin() { return iterator(dentries.begin()); }
+    iterator end() { return iterator(dentries.end()); }
+    iterator begin() const {
+      return iterator(const_cast<dentry_set_t&>(dentries).begin());
+    }
+    iterator end() const {
+      return iterator(const_cast<dentry_set_t&>(dentries).end());
+    }
+    iterator find(const dentry_key_t& key) {
+      return iterator(dentries.find(key));
+    }
+    iterator lower_bound(const dentry_key_t& key) {
+      return iterator(dentries.lower_bound(key));
+    }
+    size_t count(const dentry_key_t& key) const {
+      return dentries.count(key);
+    }
+
+    void insert(CDentry *dn) {
+      [[maybe_unused]] bool inserted = dentries.insert(*dn).second;
+      ceph_assert(inserted);
+    }
+    void erase(CDentry *dn) {
+      dentries.erase(dentries.iterator_to(*dn));
+    }
+
+  private:
+    dentry_set_t dentries;
+  };
   typedef mempool::mds_co::set<dentry_key_t> dentry_key_set;
 
   using fnode_ptr = std::shared_ptr<fnode_t>;
@@ -3679,6 +3679,20 @@ int CInode::encode_inodestat(bufferlist& bl, Session *session,
 			     snapid_t snapid,
 			     unsigned max_bytes,
 			     int getattr_caps)
+{
+  inodestat_t st;
+  int r = get_inodestat(st, session, dir_realm, snapid, max_bytes,
+			getattr_caps);
+  if (r >= 0)
+    st.encode(bl);
+  return r;
+}
+
+int CInode::get_inodestat(inodestat_t& st, Session *session,
+			  SnapRealm *dir_realm,
+			  snapid_t snapid,
+			  unsigned max_bytes,
+			  int getattr_caps)
 {
   client_t client = session->get_client();
   ceph_assert(snapid);
@@ -3689,7 +3703,7 @@ int CInode::encode_inodestat(bufferlist& bl, Session *session,
   const mempool_inode *oi = get_inode().get();
   const mempool_inode *pi = get_projected_inode().get();
 
-  const mempool_xattr_map *pxattrs = nullptr;
+  xattr_map_const_ptr pxattrs;
 
   if (snapid != CEPH_NOSNAP) {
 
@@ -3710,7 +3724,7 @@ int CInode::encode_inodestat(bufferlist& bl, Session *session,
 		   << " " << it->second.inode.rstat
 		   << dendl;
 	  pi = oi = &it->second.inode;
-	  pxattrs = &it->second.xattrs;
+	  pxattrs = allocate_xattr_map(it->second.xattrs);
 	} else {
 	  // snapshoted remote dentry can result this
 	  dout(0) << __func__ << " old_inode for snapid " << snapid
@@ -3820,14 +3834,13 @@ int CInode::encode_inodestat(bufferlist& bl, Session *session,
   // xattr
   const mempool_inode *xattr_i = pxattr ? pi:oi;
 
-  using ceph::encode;
   // xattr
   version_t xattr_version;
   if ((!cap && !no_caps) ||
       (cap && cap->client_xattr_version < xattr_i->xattr_version) ||
       (getattr_caps & CEPH_CAP_XATTR_SHARED)) { // client requests xattrs
     if (!pxattrs)
-      pxattrs = pxattr ? get_projected_xattrs().get() : get_xattrs().get();
+      pxattrs = pxattr ? get_projected_xattrs() : get_xattrs();
     xattr_version = xattr_i->xattr_version;
   } else {
     xattr_version = 0;
@@ -3836,6 +3849,7 @@ int CInode::encode_inodestat(bufferlist& bl, Session *session,
   // do we have room?
   if (max_bytes) {
     unsigned bytes =
+      6 + // encoding header
       8 + 8 + 4 + 8 + 8 + sizeof(ceph_mds_reply_cap) +
       sizeof(struct ceph_file_layout) +
       sizeof(struct ceph_timespec) * 3 + 4 + // ctime ~ time_warp_seq
@@ -3858,10 +3872,16 @@ int CInode::encode_inodestat(bufferlist& bl, Session *session,
       sizeof(version_t) + sizeof(__u32) + inline_data.length() + // inline data
       1 + 1 + 8 + 8 + 4 + // quota
       4 + layout.pool_ns.size() + // pool ns
-      sizeof(struct ceph_timespec) + 8; // btime + change_attr
+      sizeof(struct ceph_timespec) + 8 + // btime + change_attr
+      4 + sizeof(struct ceph_timespec) + 8 + // export_pin ~ rsnaps
+      sizeof(__u32) + 1; // snap_metadata + fscrypt
+    for (const auto &p : snap_metadata)
+      bytes += sizeof(__u32) * 2 + p.first.length() + p.second.length();
 
     if (bytes > max_bytes)
       return -CEPHFS_ENOSPC;
+    // everything counted above, so a bound on the encoded length
+    st.length_bound = bytes;
   }
 
 
@@ -3961,145 +3981,48 @@ int CInode::encode_inodestat(bufferlist& bl, Session *session,
     }
   }
 
-  // The end result of encode_xattrs() is equivalent to:
-  // {
-  //   bufferlist xbl;
-  //   if (xattr_version) {
-  //     if (pxattrs)
-  //       encode(*pxattrs, bl);
-  //     else
-  //       encode((__u32)0, bl);
-  //   }
-  //   encode(xbl, bl);
-  // }
-  //
-  // But encoding xattrs into the 'xbl' requires a memory allocation.
-  // The 'bl' should have enough pre-allocated memory in most cases.
-  // Encoding xattrs directly into it can avoid the extra allocation.
-  auto encode_xattrs = [xattr_version, pxattrs, &bl]() {
-    using ceph::encode;
-    if (xattr_version) {
-      ceph_le32 xbl_len;
-      auto filler = bl.append_hole(sizeof(xbl_len));
-      const auto starting_bl_len = bl.length();
-      if (pxattrs)
-	encode(*pxattrs, bl);
-      else
-	encode((__u32)0, bl);
-      xbl_len = bl.length() - starting_bl_len;
-      filler.copy_in(sizeof(xbl_len), (char *)&xbl_len);
-    } else {
-      encode((__u32)0, bl);
-    }
-  };
-
-  /*
-   * note: encoding matches MClientReply::InodeStat
-   */
-  if (session->info.has_feature(CEPHFS_FEATURE_REPLY_ENCODING)) {
-    ENCODE_START(6, 1, bl);
-    encode(oi->ino, bl);
-    encode(snapid, bl);
-    encode(oi->rdev, bl);
-    encode(version, bl);
-    encode(xattr_version, bl);
-    encode(ecap, bl);
-    {
-      ceph_file_layout legacy_layout;
-      layout.to_legacy(&legacy_layout);
-      encode(legacy_layout, bl);
-    }
-    encode(any_i->ctime, bl);
-    encode(file_i->mtime, bl);
-    encode(file_i->atime, bl);
-    encode(file_i->time_warp_seq, bl);
-    encode(file_i->size, bl);
-    encode(max_size, bl);
-    encode(file_i->truncate_size, bl);
-    encode(file_i->truncate_seq, bl);
-    encode(auth_i->mode, bl);
-    encode((uint32_t)auth_i->uid, bl);
-    encode((uint32_t)auth_i->gid, bl);
-    encode(link_i->nlink, bl);
-    encode(file_i->dirstat.nfiles, bl);
-    encode(file_i->dirstat.nsubdirs, bl);
-    encode(file_i->rstat.rbytes, bl);
-    encode(file_i->rstat.rfiles, bl);
-    encode(file_i->rstat.rsubdirs, bl);
-    encode(file_i->rstat.rctime, bl);
-    dirfragtree.encode(bl);
-    encode(symlink, bl);
-    encode(file_i->dir_layout, bl);
-    encode_xattrs();
-    encode(inline_version, bl);
-    encode(inline_data, bl);
-    const mempool_inode *policy_i = ppolicy ? pi : oi;
-    encode(policy_i->quota, bl);
-    encode(layout.pool_ns, bl);
-    encode(any_i->btime, bl);
-    encode(any_i->change_attr, bl);
-    encode(file_i->export_pin, bl);
-    encode(snap_btime, bl);
-    encode(file_i->rstat.rsnaps, bl);
-    encode(snap_metadata, bl);
-    encode(file_i->fscrypt, bl);
-    ENCODE_FINISH(bl);
-  }
-  else {
+  // copy out what inodestat_t::encode() needs; the xattr map is
+  // never changed once it is set on the inode, so it is shared
+  st.reply_encoding = session->info.has_feature(CEPHFS_FEATURE_REPLY_ENCODING);
+  if (!st.reply_encoding) {
     ceph_assert(session->get_connection());
-
-    encode(oi->ino, bl);
-    encode(snapid, bl);
-    encode(oi->rdev, bl);
-    encode(version, bl);
-    encode(xattr_version, bl);
-    encode(ecap, bl);
-    {
-      ceph_file_layout legacy_layout;
-      layout.to_legacy(&legacy_layout);
-      encode(legacy_layout, bl);
-    }
-    encode(any_i->ctime, bl);
-    encode(file_i->mtime, bl);
-    encode(file_i->atime, bl);
-    encode(file_i->time_warp_seq, bl);
-    encode(file_i->size, bl);
-    encode(max_size, bl);
-    encode(file_i->truncate_size, bl);
-    encode(file_i->truncate_seq, bl);
-    encode(auth_i->mode, bl);
-    encode((uint32_t)auth_i->uid, bl);
-    encode((uint32_t)auth_i->gid, bl);
-    encode(link_i->nlink, bl);
-    encode(file_i->dirstat.nfiles, bl);
-    encode(file_i->dirstat.nsubdirs, bl);
-    encode(file_i->rstat.rbytes, bl);
-    encode(file_i->rstat.rfiles, bl);
-    encode(file_i->rstat.rsubdirs, bl);
-    encode(file_i->rstat.rctime, bl);
-    dirfragtree.encode(bl);
-    encode(symlink, bl);
-    auto& conn = session->get_connection();
-    if (conn->has_feature(CEPH_FEATURE_DIRLAYOUTHASH)) {
-      encode(file_i->dir_layout, bl);
-    }
-    encode_xattrs();
-    if (conn->has_feature(CEPH_FEATURE_MDS_INLINE_DATA)) {
-      encode(inline_version, bl);
-      encode(inline_data, bl);
-    }
-    if (conn->has_feature(CEPH_FEATURE_MDS_QUOTA)) {
-      const mempool_inode *policy_i = ppolicy ? pi : oi;
-      encode(policy_i->quota, bl);
-    }
-    if (conn->has_feature(CEPH_FEATURE_FS_FILE_LAYOUT_V2)) {
-      encode(layout.pool_ns, bl);
-    }
-    if (conn->has_feature(CEPH_FEATURE_FS_BTIME)) {
-      encode(any_i->btime, bl);
-      encode(any_i->change_attr, bl);
-    }
-  }
+    st.con_features = session->get_connection()->get_features();
+  }
+  st.ino = oi->ino;
+  st.snapid = snapid;
+  st.rdev = oi->rdev;
+  st.version = version;
+  st.xattr_version = xattr_version;
+  st.ecap = ecap;
+  st.layout = layout;
+  st.ctime = any_i->ctime;
+  st.mtime = file_i->mtime;
+  st.atime = file_i->atime;
+  st.time_warp_seq = file_i->time_warp_seq;
+  st.size = file_i->size;
+  st.max_size = max_size;
+  st.truncate_size = file_i->truncate_size;
+  st.truncate_seq = file_i->truncate_seq;
+  st.mode = auth_i->mode;
+  st.uid = auth_i->uid;
+  st.gid = auth_i->gid;
+  st.nlink = link_i->nlink;
+  st.dirstat = file_i->dirstat;
+  st.rstat = file_i->rstat;
+  st.dirfragtree = dirfragtree;
+  st.symlink = symlink;
+  st.dir_layout = file_i->dir_layout;
+  if (xattr_version)
+    st.xattrs = std::move(pxattrs);
+  st.inline_version = inline_version;
+  st.inline_data = std::move(inline_data);
+  st.quota = (ppolicy ? pi : oi)->quota;
+  st.btime = any_i->btime;
+  st.change_attr = any_i->change_attr;
+  st.export_pin = file_i->export_pin;
+  st.snap_btime = snap_btime;
+  st.snap_metadata = std::move(snap_metadata);
+  st.fscrypt = file_i->fscrypt;
 
   return valid;
 }
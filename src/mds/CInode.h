@@ -417,7 +417,7 @@ class CInode : public MDSCacheObject, public InodeStoreBase, public Counter<CIno
     ceph_assert(batch_ops.empty());
   }
 
-  std::map<int, std::unique_ptr<BatchOp>> batch_ops;
+  batch_op_map_t batch_ops;
 
   std::string_view pin_name(int p) const override;
 
@@ -794,6 +794,11 @@ class CInode : public MDSCacheObject, public InodeStoreBase, public Counter<CIno
   int encode_inodestat(ceph::buffer::list& bl, Session *session, SnapRealm *realm,
 		       snapid_t snapid=CEPH_NOSNAP, unsigned max_bytes=0,
 		       int getattr_wants=0);
+  // issue caps as encode_inodestat() does, but copy the stat into st
+  // rather than encode it, so that it can be encoded without mds_lock
+  int get_inodestat(inodestat_t& st, Session *session, SnapRealm *realm,
+		    snapid_t snapid=CEPH_NOSNAP, unsigned max_bytes=0,
+		    int getattr_wants=0);
   void encode_cap_message(const ceph::ref_t<MClientCaps> &m, Capability *cap);
 
   SimpleLock* get_lock(int type) override;
@@ -1067,7 +1072,7 @@ class CInode : public MDSCacheObject, public InodeStoreBase, public Counter<CIno
   // list item node for when we have unpropagated rstat data
   elist<CInode*>::item dirty_rstat_item;
 
-  mempool::mds_co::set<client_t> client_snap_caps;
+  mempool::mds_co::compact_set<client_t> client_snap_caps;
   mempool::mds_co::compact_map<snapid_t, mempool::mds_co::set<client_t> > client_need_snapflush;
 
   // LogSegment lists i (may) belong to
@@ -700,7 +700,11 @@ void MDBalancer::prep_rebalance(int beat)
 	      << dendl;
     }
 
+    // remember the last round to see where the load is going
+    auto last_raw_load = std::move(mds_raw_load);
+    mds_raw_load.clear();
     mds_meta_load.clear();
+    const double trend = g_conf().get_val<double>("mds_bal_load_trend");
 
     double total_load = 0.0;
     multimap<double,mds_rank_t> load_map;
@@ -708,6 +712,12 @@ void MDBalancer::prep_rebalance(int beat)
       mds_load_t& load = mds_load.at(i);
 
       double l = load.mds_load() * load_fac;
+      mds_raw_load[i] = l;
+      if (auto p = last_raw_load.find(i); trend > 0 && p != last_raw_load.end()) {
+	// balance for the load we expect by the next round, not the
+	// current one, so that growing ranks are offloaded in time
+	l = predict_load(l, p->second, trend);
+      }
       mds_meta_load[i] = l;
 
       if (whoami == 0)
@@ -895,6 +905,7 @@ void MDBalancer::try_rebalance(balance_state_t& state)
   // make a sorted list of my imports
   multimap<double, CDir*> import_pop_map;
   multimap<mds_rank_t, pair<CDir*, double> > import_from_map;
+  set<CDir*> recent_imports;
 
   for (auto& dir : mds->mdcache->get_fullauth_subtrees()) {
     CInode *diri = dir->get_inode();
@@ -907,6 +918,13 @@ void MDBalancer::try_rebalance(balance_state_t& state)
 
     mds_rank_t from = diri->authority().first;
     double pop = dir->pop_auth_subtree.meta_load();
+    if (is_recent_import(dir)) {
+      // not itself, but find_exports() may still hand out its hot
+      // subdirectories
+      recent_imports.insert(dir);
+      import_pop_map.insert(make_pair(pop, dir));
+      continue;
+    }
     if (g_conf()->mds_bal_idle_threshold > 0 &&
 	pop < g_conf()->mds_bal_idle_threshold &&
 	diri != mds->mdcache->get_root() &&
@@ -994,7 +1012,7 @@ void MDBalancer::try_rebalance(balance_state_t& state)
     for (auto p = import_pop_map.begin();
 	 p != import_pop_map.end(); ) {
       CDir *dir = p->second;
-      if (dir->inode->is_base()) {
+      if (dir->inode->is_base() || recent_imports.count(dir)) {
 	++p;
 	continue;
       }
@@ -1051,6 +1069,16 @@ void MDBalancer::try_rebalance(balance_state_t& state)
   mds->mdcache->show_subtrees();
 }
 
+bool MDBalancer::is_recent_import(CDir *dir)
+{
+  auto cooldown = g_conf().get_val<std::chrono::seconds>("mds_bal_export_cooldown");
+  if (import_cooldown.is_recent(dir->dirfrag(), clock::now(), cooldown)) {
+    dout(15) << "  imported " << *dir << " recently, not exporting it" << dendl;
+    return true;
+  }
+  return false;
+}
+
 void MDBalancer::find_exports(CDir *dir,
                               double amount,
                               std::vector<CDir*>* exports,
@@ -1349,6 +1377,9 @@ void MDBalancer::add_import(CDir *dir)
 {
   dirfrag_load_vec_t subload = dir->pop_auth_subtree;
 
+  auto cooldown = g_conf().get_val<std::chrono::seconds>("mds_bal_export_cooldown");
+  import_cooldown.add(dir->dirfrag(), clock::now(), cooldown);
+
   while (true) {
     dir = dir->inode->get_parent_dir();
     if (!dir) break;
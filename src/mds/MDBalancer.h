@@ -30,6 +30,44 @@ class CDir;
 class Messenger;
 class MonClient;
 
+/**
+ * When this rank imported each subtree, so that the balancer does not
+ * send it on, or back, for mds_bal_export_cooldown: that makes hot
+ * directories ping-pong between ranks.
+ */
+class ImportCooldown {
+public:
+  using clock = ceph::coarse_mono_clock;
+  using time = ceph::coarse_mono_time;
+
+  void add(dirfrag_t df, time now, clock::duration cooldown) {
+    // forget the imports that are past it on the way
+    for (auto p = import_time.begin(); p != import_time.end(); ) {
+      if (now - p->second >= cooldown)
+	p = import_time.erase(p);
+      else
+	++p;
+    }
+    if (cooldown > clock::duration::zero())
+      import_time[df] = now;
+  }
+  bool is_recent(dirfrag_t df, time now, clock::duration cooldown) {
+    auto p = import_time.find(df);
+    if (p == import_time.end())
+      return false;
+    if (now - p->second < cooldown)
+      return true;
+    import_time.erase(p);
+    return false;
+  }
+  size_t size() const {
+    return import_time.size();
+  }
+
+private:
+  std::map<dirfrag_t, time> import_time;
+};
+
 class MDBalancer {
 public:
   using clock = ceph::coarse_mono_clock;
@@ -38,6 +76,14 @@ public:
 
   MDBalancer(MDSRank *m, Messenger *msgr, MonClient *monc);
 
+  /**
+   * The load of a rank expected by the next balancer round, from its
+   * raw load now and in the last round, for mds_bal_load_trend.
+   */
+  static double predict_load(double load, double last_load, double trend) {
+    return std::max(0.0, load + trend * (load - last_load));
+  }
+
   void handle_conf_change(const std::set<std::string>& changed, const MDSMap& mds_map);
 
   int proc_message(const cref_t<Message> &m);
@@ -118,6 +164,12 @@ private:
    */
   void try_rebalance(balance_state_t& state);
 
+  /**
+   * Was this subtree imported less than mds_bal_export_cooldown ago?
+   * Its subdirectories may still be exported.
+   */
+  bool is_recent_import(CDir *dir);
+
   bool bal_fragment_dirs;
   int64_t bal_fragment_interval;
   static const unsigned int AUTH_TREES_THRESHOLD = 5;
@@ -144,9 +196,13 @@ private:
   // dirfrags that already have one in flight.
   set<dirfrag_t> split_pending, merge_pending;
 
+  ImportCooldown import_cooldown;
+
   // per-epoch scatter/gathered info
   std::map<mds_rank_t, mds_load_t> mds_load;
   std::map<mds_rank_t, double> mds_meta_load;
+  // mds_meta_load before the trend is applied, for mds_bal_load_trend
+  std::map<mds_rank_t, double> mds_raw_load;
   std::map<mds_rank_t, map<mds_rank_t, float> > mds_import_map;
   std::map<mds_rank_t, int> mds_last_epoch_under_map;
 
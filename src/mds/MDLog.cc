@@ -14,6 +14,7 @@
 
 #include "MDSRank.h"
 #include "MDLog.h"
+#include "MDLogReplayDecoder.h"
 #include "MDCache.h"
 #include "LogEvent.h"
 #include "MDSContext.h"
@@ -1307,18 +1308,28 @@ void MDLog::_replay_thread()
 {
   dout(10) << "_replay_thread start" << dendl;
 
+  // keep many journal objects in flight while replaying
+  uint64_t prefetch_periods =
+    g_conf().get_val<uint64_t>("mds_log_replay_prefetch_periods");
+  if (prefetch_periods) {
+    journaler->set_prefetch_periods(prefetch_periods);
+  }
+  MDLogReplayDecoder decoder(
+    g_conf().get_val<uint64_t>("mds_log_replay_decode_threads"),
+    g_conf().get_val<uint64_t>("mds_log_replay_decode_ahead"));
+
   // loop
   int r = 0;
   while (1) {
     // wait for read?
-    while (!journaler->is_readable() &&
+    while (decoder.empty() && !journaler->is_readable() &&
 	   journaler->get_read_pos() < journaler->get_write_pos() &&
 	   !journaler->get_error()) {
       C_SaferCond readable_waiter;
       journaler->wait_for_readable(&readable_waiter);
       r = readable_waiter.wait();
     }
-    if (journaler->get_error()) {
+    if (decoder.empty() && journaler->get_error()) {
       r = journaler->get_error();
       dout(0) << "_replay journaler got error " << r << ", aborting" << dendl;
       if (r == -CEPHFS_ENOENT) {
@@ -1376,22 +1387,31 @@ void MDLog::_replay_thread()
       break;
     }
 
-    if (!journaler->is_readable() &&
+    if (decoder.empty() && !journaler->is_readable() &&
 	journaler->get_read_pos() == journaler->get_write_pos())
       break;
     
-    ceph_assert(journaler->is_readable() || mds->is_daemon_stopping());
+    ceph_assert(!decoder.empty() || journaler->is_readable() ||
+		mds->is_daemon_stopping());
     
-    // read it
-    uint64_t pos = journaler->get_read_pos();
-    bufferlist bl;
-    bool r = journaler->try_read_entry(bl);
-    if (!r && journaler->get_error())
+    // read it, along with whatever else is prefetched, so that the
+    // following events decode while this one replays
+    while (!decoder.full() && journaler->is_readable()) {
+      uint64_t pos = journaler->get_read_pos();
+      bufferlist bl;
+      if (!journaler->try_read_entry(bl))
+	break;
+      decoder.queue(pos, journaler->get_read_pos(), std::move(bl));
+    }
+    if (decoder.empty() && journaler->get_error())
       continue;
-    ceph_assert(r);
+    ceph_assert(!decoder.empty());
     
     // unpack event
-    auto le = LogEvent::decode_event(bl.cbegin());
+    auto entry = decoder.pop();
+    uint64_t pos = entry.pos;
+    bufferlist& bl = entry.bl;
+    auto& le = entry.le;
     if (!le) {
       dout(0) << "_replay " << pos << "~" << bl.length() << " / " << journaler->get_write_pos() 
 	      << " -- unable to decode event" << dendl;
@@ -1436,7 +1456,7 @@ void MDLog::_replay_thread()
 	       << " " << le->get_stamp() << ": " << *le << dendl;
       le->_segment = get_current_segment();    // replay may need this
       le->_segment->num_events++;
-      le->_segment->end = journaler->get_read_pos();
+      le->_segment->end = entry.end;
       num_events++;
 
       {
@@ -1462,6 +1482,9 @@ void MDLog::_replay_thread()
   }
 
   safe_pos = journaler->get_write_safe_pos();
+  if (prefetch_periods) {
+    journaler->set_prefetch_periods(0);
+  }
 
   dout(10) << "_replay_thread kicking waiters" << dendl;
   {
@@ -0,0 +1,132 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MDS_MDLOGREPLAYDECODER_H
+#define CEPH_MDS_MDLOGREPLAYDECODER_H
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+#include "common/Thread.h"
+#include "include/buffer.h"
+#include "LogEvent.h"
+
+/*
+ * Decodes journal entries ahead of _replay_thread on a few worker
+ * threads.  Entries are handed back in journal order, so only the
+ * decode runs in parallel; replay itself stays serial under mds_lock.
+ */
+class MDLogReplayDecoder {
+public:
+  struct Entry {
+    uint64_t pos = 0;
+    uint64_t end = 0;
+    bufferlist bl;
+    std::unique_ptr<LogEvent> le;
+    bool decoded = false;
+  };
+
+  MDLogReplayDecoder(unsigned nthreads, size_t max_entries)
+    : max_entries(std::max<size_t>(max_entries, 1)) {
+    for (unsigned i = 0; i < nthreads; ++i) {
+      threads.push_back(make_named_thread(
+        "md_log_decode", &MDLogReplayDecoder::decode_entries, this));
+    }
+  }
+  ~MDLogReplayDecoder() {
+    {
+      std::lock_guard l(lock);
+      stopping = true;
+    }
+    cond.notify_all();
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+
+  bool empty() {
+    std::lock_guard l(lock);
+    return entries.empty();
+  }
+  bool full() {
+    std::lock_guard l(lock);
+    return entries.size() >= max_entries;
+  }
+
+  void queue(uint64_t pos, uint64_t end, bufferlist&& bl) {
+    {
+      std::lock_guard l(lock);
+      auto& e = entries.emplace_back();
+      e.pos = pos;
+      e.end = end;
+      e.bl = std::move(bl);
+    }
+    cond.notify_all();
+  }
+
+  // wait for the oldest entry to be decoded and take it
+  Entry pop() {
+    std::unique_lock l(lock);
+    ceph_assert(!entries.empty());
+    auto& e = entries.front();
+    if (next_decode == 0) {
+      // no worker picked it up yet; don't wait for one
+      next_decode = 1;
+      l.unlock();
+      auto le = LogEvent::decode_event(e.bl.cbegin());
+      l.lock();
+      e.le = std::move(le);
+      e.decoded = true;
+    }
+    cond.wait(l, [&e] { return e.decoded; });
+    Entry r = std::move(e);
+    entries.pop_front();
+    --next_decode;
+    return r;
+  }
+
+private:
+  void decode_entries() {
+    std::unique_lock l(lock);
+    while (true) {
+      cond.wait(l, [this] {
+	return stopping || next_decode < entries.size();
+      });
+      if (stopping) {
+	return;
+      }
+      // entries only move on pop_front() of an already decoded entry,
+      // so the reference stays valid while the lock is dropped
+      auto& e = entries[next_decode++];
+      l.unlock();
+      auto le = LogEvent::decode_event(e.bl.cbegin());
+      l.lock();
+      e.le = std::move(le);
+      e.decoded = true;
+      cond.notify_all();
+    }
+  }
+
+  const size_t max_entries;
+  ceph::mutex lock = ceph::make_mutex("MDLogReplayDecoder::lock");
+  ceph::condition_variable cond;
+  std::deque<Entry> entries;
+  size_t next_decode = 0;   // entries before this are claimed by a decoder
+  bool stopping = false;
+  std::vector<std::thread> threads;
+};
+
+#endif
@@ -898,10 +898,15 @@ void MDSDaemon::respawn()
 
 bool MDSDaemon::ms_dispatch2(const ref_t<Message> &m)
 {
+  auto start = ceph::mono_clock::now();
   std::lock_guard l(mds_lock);
   if (stopping) {
     return false;
   }
+  if (mds_rank && mds_rank->logger) {
+    mds_rank->logger->tinc(l_mds_dispatch_lock_wait,
+                           ceph::mono_clock::now() - start);
+  }
 
   // Drop out early if shutting down
   if (beacon.get_want_state() == CEPH_MDS_STATE_DNE) {
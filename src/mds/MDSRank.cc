@@ -518,6 +518,9 @@ MDSRank::MDSRank(
   objecter->unset_honor_pool_full();
 
   finisher = new Finisher(cct, "MDSRank", "MR_Finisher");
+  if (auto n = g_conf().get_val<uint64_t>("mds_reply_encode_threads"); n) {
+    reply_encoder = std::make_unique<ReplyEncoder>(cct, n);
+  }
 
   mdcache = new MDCache(this, purge_queue);
   mdlog = new MDLog(this);
@@ -601,6 +604,9 @@ void MDSRankDispatcher::init()
   purge_queue.init();
 
   finisher->start();
+  if (reply_encoder) {
+    reply_encoder->start();
+  }
 }
 
 void MDSRank::update_targets()
@@ -832,6 +838,10 @@ void MDSRankDispatcher::shutdown()
 
   mds_lock.unlock();
   finisher->stop(); // no flushing
+  if (reply_encoder) {
+    // its workers never take mds_lock
+    reply_encoder->stop();
+  }
   mds_lock.lock();
 
   if (objecter->initialized)
@@ -1491,7 +1501,7 @@ void MDSRank::send_message_client_counted(const ref_t<Message>& m, Session* sess
   dout(10) << "send_message_client_counted " << session->info.inst.name << " seq "
 	   << seq << " " << *m << dendl;
   if (session->get_connection()) {
-    session->get_connection()->send_message2(m);
+    send_message_session(m, session);
   } else {
     session->preopen_out_queue.push_back(m);
   }
@@ -1501,12 +1511,21 @@ void MDSRank::send_message_client(const ref_t<Message>& m, Session* session)
 {
   dout(10) << "send_message_client " << session->info.inst << " " << *m << dendl;
   if (session->get_connection()) {
-    session->get_connection()->send_message2(m);
+    send_message_session(m, session);
   } else {
     session->preopen_out_queue.push_back(m);
   }
 }
 
+void MDSRank::send_message_session(const ref_t<Message>& m, Session* session)
+{
+  // keep it behind any reply still being encoded
+  auto& out = session->deferred_out_queue;
+  if (!out || !out->queue(m, session->get_connection())) {
+    session->get_connection()->send_message2(m);
+  }
+}
+
 /**
  * This is used whenever a RADOS operation has been cancelled
  * or a RADOS client has been blocklisted, to cause the MDS and
@@ -3348,6 +3367,8 @@ void MDSRank::create_logger()
     mds_plb.add_u64_counter(l_mds_traverse_lock, "traverse_lock",
                             "Traverse locks");
     mds_plb.add_u64(l_mds_dispatch_queue_len, "q", "Dispatch queue length");
+    mds_plb.add_time_avg(l_mds_dispatch_lock_wait, "dispatch_lock_wait",
+                         "Time messages waited for mds_lock before dispatch");
     mds_plb.add_u64_counter(l_mds_exported, "exported", "Exports");
     mds_plb.add_u64_counter(l_mds_imported, "imported", "Imports");
     mds_plb.add_u64_counter(l_mds_openino_backtrace_fetch, "openino_backtrace_fetch",
@@ -3681,6 +3702,7 @@ const char** MDSRankDispatcher::get_tracked_conf_keys() const
     "mds_op_history_duration",
     "mds_op_history_size",
     "mds_op_log_threshold",
+    "mds_purge_target_latency",
     "mds_recall_max_decay_rate",
     "mds_recall_warning_decay_rate",
     "mds_request_load_average_decay_rate",
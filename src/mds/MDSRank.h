@@ -74,6 +74,7 @@ enum {
   l_mds_traverse_lock,
   l_mds_load_cent,
   l_mds_dispatch_queue_len,
+  l_mds_dispatch_lock_wait,
   l_mds_exported,
   l_mds_exported_inodes,
   l_mds_imported,
@@ -296,6 +297,7 @@ class MDSRank {
     void send_message_client_counted(const ref_t<Message>& m, Session* session);
     void send_message_client_counted(const ref_t<Message>& m, const ConnectionRef& connection);
     void send_message_client(const ref_t<Message>& m, Session* session);
+    void send_message_session(const ref_t<Message>& m, Session* session);
     void send_message(const ref_t<Message>& m, const ConnectionRef& c);
 
     void wait_for_active_peer(mds_rank_t who, MDSContext *c) { 
@@ -408,6 +410,8 @@ class MDSRank {
     bool cluster_degraded = false;
 
     Finisher *finisher;
+    // encodes getattr/lookup/readdir replies, if mds_reply_encode_threads
+    std::unique_ptr<ReplyEncoder> reply_encoder;
   protected:
     typedef enum {
       // The MDSMap is available, configure default layouts and structures
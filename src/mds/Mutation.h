@@ -25,6 +25,7 @@
 #include "SimpleLock.h"
 #include "Capability.h"
 #include "BatchOp.h"
+#include "ReplyEncoder.h"
 
 #include "common/TrackedOp.h"
 #include "messages/MClientRequest.h"
@@ -430,6 +431,7 @@ struct MDRequestImpl : public MutationImpl {
   bool has_completed = false;	///< request has already completed
 
   ceph::buffer::list reply_extra_bl;
+  deferred_bl_t reply_extra_deferred;	///< reply_extra_bl, if stats are deferred
 
   // inos we did a embedded cap release on, and may need to eval if we haven't since reissued
   std::map<vinodeno_t, ceph_seq_t> cap_releases;
@@ -445,7 +447,7 @@ struct MDRequestImpl : public MutationImpl {
   // indicates how may retries of request have been made
   int retry = 0;
 
-  std::map<int, std::unique_ptr<BatchOp> > *batch_op_map = nullptr;
+  batch_op_map_t *batch_op_map = nullptr;
 
   // indicator for vxattr osdmap update
   bool waited_for_osdmap = false;
@@ -29,6 +29,7 @@ enum {
   l_oft_omap_total_kv_pairs,
   l_oft_omap_total_updates,
   l_oft_omap_total_removes,
+  l_oft_omap_skipped_updates,
   l_oft_last
 };
 
@@ -47,6 +48,8 @@ OpenFileTable::OpenFileTable(MDSRank *m) : mds(m) {
   b.add_u64(l_oft_omap_total_kv_pairs, "omap_total_kv_pairs");
   b.add_u64(l_oft_omap_total_updates, "omap_total_updates");
   b.add_u64(l_oft_omap_total_removes, "omap_total_removes");
+  b.add_u64_counter(l_oft_omap_skipped_updates, "omap_skipped_updates",
+		    "Dirty open file table entries that did not need a write");
   logger.reset(b.create_perf_counters());
   mds->cct->get_perfcounters_collection()->add(logger.get());
   logger->set(l_oft_omap_total_objs, 0);
@@ -61,6 +64,13 @@ OpenFileTable::~OpenFileTable() {
   }
 }
 
+void OpenFileTable::_note_dirty(const Anchor& anchor)
+{
+  // a clean anchor with an omap slot is what the table has on disk
+  if (anchor.omap_idx >= 0 && !dirty_items.count(anchor.ino))
+    committed_anchors.emplace(anchor.ino, anchor);
+}
+
 void OpenFileTable::get_ref(CInode *in, frag_t fg)
 {
   do {
@@ -76,6 +86,7 @@ void OpenFileTable::get_ref(CInode *in, frag_t fg)
       p->second.nref++;
 
       if (fg != -1U) {
+	_note_dirty(p->second);
 	auto ret = p->second.frags.insert(fg);
 	ceph_assert(ret.second);
 	dirty_items.emplace(in->ino(), (int)DIRTY_UNDEF);
@@ -123,6 +134,7 @@ void OpenFileTable::put_ref(CInode *in, frag_t fg)
     if (p->second.nref > 1) {
       p->second.nref--;
       if (fg != -1U) {
+	_note_dirty(p->second);
 	auto ret = p->second.frags.erase(fg);
 	ceph_assert(ret);
 	dirty_items.emplace(in->ino(), (int)DIRTY_UNDEF);
@@ -146,6 +158,7 @@ void OpenFileTable::put_ref(CInode *in, frag_t fg)
     }
 
     int omap_idx = p->second.omap_idx;
+    _note_dirty(p->second);
     anchor_map.erase(p);
     in->state_clear(CInode::STATE_TRACKEDBYOFT);
 
@@ -205,6 +218,7 @@ void OpenFileTable::notify_link(CInode *in)
   CDentry *dn = in->get_parent_dn();
   CInode *pin = dn->get_dir()->get_inode();
 
+  _note_dirty(p->second);
   p->second.dirino = pin->ino();
   p->second.d_name = dn->get_name();
   dirty_items.emplace(in->ino(), (int)DIRTY_UNDEF);
@@ -224,6 +238,7 @@ void OpenFileTable::notify_unlink(CInode *in)
   ceph_assert(p->second.dirino == pin->ino());
   ceph_assert(p->second.d_name == dn->get_name());
 
+  _note_dirty(p->second);
   p->second.dirino = inodeno_t(0);
   p->second.d_name = "";
   dirty_items.emplace(in->ino(), (int)DIRTY_UNDEF);
@@ -466,9 +481,19 @@ void OpenFileTable::commit(MDSContext *c, uint64_t log_seq, int op_prio)
     omap_updates.back().clear = true;
   }
 
+  uint64_t skipped_updates = 0;
   for (auto& [ino, state] : dirty_items) {
     auto p = anchor_map.find(ino);
 
+    if (p != anchor_map.end() && p->second.omap_idx >= 0) {
+      auto q = committed_anchors.find(ino);
+      if (q != committed_anchors.end() && p->second == q->second) {
+	ceph_assert(p->second.omap_idx == q->second.omap_idx);
+	skipped_updates++;
+	continue;
+      }
+    }
+
     if (first_commit) {
       auto q = loaded_anchor_map.find(ino);
       if (q != loaded_anchor_map.end()) {
@@ -536,6 +561,8 @@ void OpenFileTable::commit(MDSContext *c, uint64_t log_seq, int op_prio)
   }
 
   dirty_items.clear();
+  committed_anchors.clear();
+  logger->inc(l_oft_omap_skipped_updates, skipped_updates);
 
   if (first_commit) {
     for (auto& [ino, anchor] : loaded_anchor_map) {
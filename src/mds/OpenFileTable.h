@@ -81,6 +81,7 @@ protected:
   void _journal_finish(int r, uint64_t log_seq, MDSContext *fin,
 		       std::map<unsigned, std::vector<ObjectOperation> >& ops);
 
+  void _note_dirty(const Anchor& anchor);
   void get_ref(CInode *in, frag_t fg=-1U);
   void put_ref(CInode *in, frag_t fg=-1U);
 
@@ -118,6 +119,9 @@ protected:
   map<inodeno_t, OpenedAnchor> anchor_map;
 
   std::map<inodeno_t, int> dirty_items; // ino -> dirty state
+  // committed version of the dirty items, so that commit() can skip
+  // the ones that changed back (e.g. a file closed and opened again)
+  std::map<inodeno_t, Anchor> committed_anchors;
 
   uint64_t committed_log_seq = 0;
   uint64_t committing_log_seq = 0;
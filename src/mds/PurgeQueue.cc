@@ -144,6 +144,11 @@ void PurgeQueue::create_logger()
   pcb.add_u64(l_pq_executing, "pq_executing", "Purge queue tasks in flight");
   pcb.add_u64(l_pq_executing_high_water, "pq_executing_high_water", "Maximum number of executing file purges");
   pcb.add_u64(l_pq_item_in_journal, "pq_item_in_journal", "Purge item left in journal");
+  pcb.add_u64(l_pq_executing_bytes, "pq_executing_bytes", "Bytes of file data being purged",
+              NULL, 0, unit_t(UNIT_BYTES));
+  pcb.add_u64_counter(l_pq_executed_bytes, "pq_executed_bytes", "Bytes of file data purged",
+                      NULL, 0, unit_t(UNIT_BYTES));
+  pcb.add_u64(l_pq_ops_limit, "pq_ops_limit", "Current limit of purge ops in flight");
 
   logger.reset(pcb.create_perf_counters());
   g_ceph_context->get_perfcounters_collection()->add(logger.get());
@@ -384,6 +389,53 @@ uint32_t PurgeQueue::_calculate_ops(const PurgeItem &item) const
   return ops_required;
 }
 
+uint64_t PurgeQueue::_get_op_limit() const
+{
+  // drain() lifts the limit altogether
+  if (!draining && cct->_conf.get_val<double>("mds_purge_target_latency") > 0) {
+    return adaptive_ops;
+  }
+  return max_purge_ops;
+}
+
+void PurgeQueue::_update_adaptive_limit(const PurgeItem &item, double latency)
+{
+  const double target = cct->_conf.get_val<double>("mds_purge_target_latency");
+  if (target <= 0) {
+    return;
+  }
+
+  // Filer::purge_range() keeps filer_max_purge_ops deletes in flight, so a
+  // big file takes several rounds: compare the latency of one round
+  if (item.action != PurgeItem::PURGE_DIR && item.size > 0) {
+    const uint64_t window = std::max<uint64_t>(g_conf()->filer_max_purge_ops, 1);
+    const uint64_t num = Striper::get_num_objects(item.layout, item.size);
+    latency /= (num + window - 1) / window;
+  }
+  op_latency_avg = op_latency_avg > 0 ?
+    0.8 * op_latency_avg + 0.2 * latency : latency;
+
+  uint64_t ceiling = cct->_conf->mds_max_purge_ops;
+  if (!ceiling) {
+    ceiling = 0xffff;
+  }
+  if (op_latency_avg > target) {
+    // back off at most once per target period, the items that are still
+    // in flight were sent under the old limit
+    auto now = ceph::coarse_mono_clock::now();
+    if (now - last_backoff > ceph::make_timespan(target)) {
+      adaptive_ops = std::max<uint64_t>(adaptive_ops / 2, 1);
+      last_backoff = now;
+      dout(10) << "purge latency " << op_latency_avg << " above target, "
+               << "op limit now " << adaptive_ops << dendl;
+    }
+  } else if (adaptive_ops < ceiling) {
+    ++adaptive_ops;
+  }
+  adaptive_ops = std::min(adaptive_ops, ceiling);
+  logger->set(l_pq_ops_limit, _get_op_limit());
+}
+
 bool PurgeQueue::_can_consume()
 {
   if (readonly) {
@@ -391,11 +443,19 @@ bool PurgeQueue::_can_consume()
     return false;
   }
 
-  dout(20) << ops_in_flight << "/" << max_purge_ops << " ops, "
-           << in_flight.size() << "/" << g_conf()->mds_max_purge_files
+  const uint64_t op_limit = _get_op_limit();
+  uint64_t files_limit = g_conf()->mds_max_purge_files;
+  if (files_limit > 0 && !draining &&
+      cct->_conf.get_val<double>("mds_purge_target_latency") > 0) {
+    // every file takes at least one op, let the op limit decide
+    files_limit = std::max(files_limit, op_limit);
+  }
+
+  dout(20) << ops_in_flight << "/" << op_limit << " ops, "
+           << in_flight.size() << "/" << files_limit
            << " files" << dendl;
 
-  if (in_flight.size() == 0 && cct->_conf->mds_max_purge_files > 0) {
+  if (in_flight.size() == 0 && files_limit > 0) {
     // Always permit consumption if nothing is in flight, so that the ops
     // limit can never be so low as to forbid all progress (unless
     // administrator has deliberately paused purging by setting max
@@ -403,15 +463,15 @@ bool PurgeQueue::_can_consume()
     return true;
   }
 
-  if (ops_in_flight >= max_purge_ops) {
+  if (ops_in_flight >= op_limit) {
     dout(20) << "Throttling on op limit " << ops_in_flight << "/"
-             << max_purge_ops << dendl;
+             << op_limit << dendl;
     return false;
   }
 
-  if (in_flight.size() >= cct->_conf->mds_max_purge_files) {
+  if (in_flight.size() >= files_limit) {
     dout(20) << "Throttling on item limit " << in_flight.size()
-             << "/" << cct->_conf->mds_max_purge_files << dendl;
+             << "/" << files_limit << dendl;
     return false;
   } else {
     return true;
@@ -450,7 +510,39 @@ bool PurgeQueue::_consume()
       return could_consume;
     }
 
-    if (!journaler.is_readable()) {
+    // Read a few entries ahead and start the biggest one: purging large
+    // files first gives the space back sooner.  Entries are expired in
+    // journal order regardless, see _execute_item_complete().
+    const uint64_t window = cct->_conf.get_val<uint64_t>("mds_purge_lookahead");
+    while (!read_error && lookahead.size() < window && journaler.is_readable()) {
+      bufferlist bl;
+      bool readable = journaler.try_read_entry(bl);
+      ceph_assert(readable);  // we checked earlier
+
+      dout(20) << " decoding entry" << dendl;
+      PurgeItem item;
+      auto q = bl.cbegin();
+      try {
+        decode(item, q);
+      } catch (const buffer::error &err) {
+        derr << "Decode error at read_pos=0x" << std::hex
+             << journaler.get_read_pos() << dendl;
+        // purge what was read before it first
+        read_error = true;
+        break;
+      }
+      const uint64_t pos = journaler.get_read_pos();
+      lookahead.emplace(pos, LookaheadItem{std::move(item),
+					    ceph::coarse_mono_clock::now()});
+      expire_tracker.add(pos);
+    }
+
+    if (lookahead.empty() && read_error) {
+      _go_readonly(CEPHFS_EIO);
+      return could_consume;
+    }
+
+    if (lookahead.empty()) {
       dout(10) << " not readable right now" << dendl;
       // Because we are the writer and the reader of the journal
       // via the same Journaler instance, we never need to reread_head
@@ -469,23 +561,29 @@ bool PurgeQueue::_consume()
     }
 
     could_consume = true;
-    // The journaler is readable: consume an entry
-    bufferlist bl;
-    bool readable = journaler.try_read_entry(bl);
-    ceph_assert(readable);  // we checked earlier
-
-    dout(20) << " decoding entry" << dendl;
-    PurgeItem item;
-    auto q = bl.cbegin();
-    try {
-      decode(item, q);
-    } catch (const buffer::error &err) {
-      derr << "Decode error at read_pos=0x" << std::hex
-           << journaler.get_read_pos() << dendl;
-      _go_readonly(CEPHFS_EIO);
+    // The oldest entry goes first once it has been passed over window
+    // times or has waited mds_purge_lookahead_max_wait, so that a stream
+    // of large files cannot hold up a small one, nor the expiry of the
+    // journal behind it.  Otherwise the first of the largest, so equal
+    // sizes keep queue order.
+    auto p = lookahead.begin();
+    const auto max_wait = cct->_conf.get_val<std::chrono::seconds>(
+      "mds_purge_lookahead_max_wait");
+    if (p->second.skipped < window &&
+	ceph::coarse_mono_clock::now() - p->second.read_stamp < max_wait) {
+      p = std::max_element(lookahead.begin(), lookahead.end(),
+        [](const auto& a, const auto& b) {
+          return a.second.item.size < b.second.item.size;
+        });
+    }
+    for (auto q = lookahead.begin(); q != p; ++q) {
+      ++q->second.skipped;
     }
+    const uint64_t expire_to = p->first;
+    const PurgeItem item = std::move(p->second.item);
+    lookahead.erase(p);
     dout(20) << " executing item (" << item.ino << ")" << dendl;
-    _execute_item(item, journaler.get_read_pos());
+    _execute_item(item, expire_to);
   }
 
   dout(10) << " cannot consume right now" << dendl;
@@ -518,6 +616,7 @@ void PurgeQueue::_commit_ops(int r, const std::vector<PurgeItemCommitOp>& ops_ve
 
   SnapContext nullsnapc;
   C_GatherBuilder gather(cct);
+  const auto start = ceph::mono_clock::now();
 
   for (auto &op : ops_vec) {
     dout(10) << op.item.get_type_str() << dendl;
@@ -560,7 +659,7 @@ void PurgeQueue::_commit_ops(int r, const std::vector<PurgeItemCommitOp>& ops_ve
   ceph_assert(gather.has_subs());
 
   gather.set_finisher(new C_OnFinisher(
-	              new LambdaContext([this, expire_to](int r) {
+	              new LambdaContext([this, expire_to, start](int r) {
     std::lock_guard l(lock);
 
     if (r == -CEPHFS_EBLOCKLISTED) {
@@ -569,7 +668,9 @@ void PurgeQueue::_commit_ops(int r, const std::vector<PurgeItemCommitOp>& ops_ve
       return;
     }
 
-    _execute_item_complete(expire_to);
+    _execute_item_complete(
+      expire_to,
+      std::chrono::duration<double>(ceph::mono_clock::now() - start).count());
     _consume();
 
     // Have we gone idle?  If so, do an extra write_head now instead of
@@ -656,6 +757,9 @@ void PurgeQueue::_execute_item(
   } else {
     derr << "Invalid item (action=" << item.action << ") in purge queue, "
             "dropping it" << dendl;
+    if (uint64_t pos = expire_tracker.complete(expire_to); pos) {
+      journaler.set_expire_pos(pos);
+    }
     ops_in_flight -= ops;
     logger->set(l_pq_executing_ops, ops_in_flight);
     ops_high_water = std::max(ops_high_water, ops_in_flight);
@@ -668,11 +772,15 @@ void PurgeQueue::_execute_item(
     return;
   }
 
+  bytes_in_flight += item.size;
+  logger->set(l_pq_executing_bytes, bytes_in_flight);
+
   submit_ops();
 }
 
 void PurgeQueue::_execute_item_complete(
-    uint64_t expire_to)
+    uint64_t expire_to,
+    double latency)
 {
   ceph_assert(ceph_mutex_is_locked_by_me(lock));
   dout(10) << "complete at 0x" << std::hex << expire_to << std::dec << dendl;
@@ -680,31 +788,15 @@ void PurgeQueue::_execute_item_complete(
 
   auto iter = in_flight.find(expire_to);
   ceph_assert(iter != in_flight.end());
-  if (iter == in_flight.begin()) {
-    uint64_t pos = expire_to;
-    if (!pending_expire.empty()) {
-      auto n = iter;
-      ++n;
-      if (n == in_flight.end()) {
-	pos = *pending_expire.rbegin();
-	pending_expire.clear();
-      } else {
-	auto p = pending_expire.begin();
-	do {
-	  if (*p >= n->first)
-	    break;
-	  pos = *p;
-	  pending_expire.erase(p++);
-	} while (p != pending_expire.end());
-      }
-    }
+  // entries in flight or still waiting in the lookahead before this one
+  // hold the expiry back until they are done
+  if (uint64_t pos = expire_tracker.complete(expire_to); pos) {
     dout(10) << "expiring to 0x" << std::hex << pos << std::dec << dendl;
     journaler.set_expire_pos(pos);
   } else {
     // This is completely fine, we're not supposed to purge files in
     // order when doing them in parallel.
     dout(10) << "non-sequential completion, not expiring anything" << dendl;
-    pending_expire.insert(expire_to);
   }
 
   ops_in_flight -= _calculate_ops(iter->second);
@@ -712,6 +804,12 @@ void PurgeQueue::_execute_item_complete(
   ops_high_water = std::max(ops_high_water, ops_in_flight);
   logger->set(l_pq_executing_ops_high_water, ops_high_water);
 
+  bytes_in_flight -= iter->second.size;
+  logger->set(l_pq_executing_bytes, bytes_in_flight);
+  logger->inc(l_pq_executed_bytes, iter->second.size);
+
+  _update_adaptive_limit(iter->second, latency);
+
   dout(10) << "completed item for ino " << iter->second.ino << dendl;
 
   in_flight.erase(iter);
@@ -724,7 +822,8 @@ void PurgeQueue::_execute_item_complete(
   uint64_t write_pos = journaler.get_write_pos(); 
   uint64_t read_pos = journaler.get_read_pos(); 
   uint64_t expire_pos = journaler.get_expire_pos(); 
-  uint64_t item_num = (write_pos - (in_flight.size() ? expire_pos : read_pos)) 
+  uint64_t item_num = (write_pos -
+		       (expire_tracker.empty() ? read_pos : expire_pos))
 		      / purge_item_journal_size;
   dout(10) << "left purge items in journal: " << item_num 
     << " (purge_item_journal_size/write_pos/read_pos/expire_pos) now at " 
@@ -769,11 +868,26 @@ void PurgeQueue::update_op_limit(const MDSMap &mds_map)
   if (cct->_conf->mds_max_purge_ops) {
     max_purge_ops = std::min(max_purge_ops, cct->_conf->mds_max_purge_ops);
   }
+
+  // the adaptive limit starts from the static one and goes from there
+  if (!adaptive_ops) {
+    adaptive_ops = std::max<uint64_t>(max_purge_ops, 1);
+  }
+  if (logger) {
+    logger->set(l_pq_ops_limit, _get_op_limit());
+  }
 }
 
 void PurgeQueue::handle_conf_change(const std::set<std::string>& changed, const MDSMap& mds_map)
 {
-  if (changed.count("mds_max_purge_ops")
+  if (changed.count("mds_purge_target_latency")) {
+    {
+      std::lock_guard l(lock);
+      adaptive_ops = 0;
+      op_latency_avg = 0;
+    }
+    update_op_limit(mds_map);
+  } else if (changed.count("mds_max_purge_ops")
       || changed.count("mds_max_purge_ops_per_pg")) {
     update_op_limit(mds_map);
   } else if (changed.count("mds_max_purge_files")) {
@@ -808,7 +922,7 @@ bool PurgeQueue::drain(
   ceph_assert(progress_total != nullptr);
   ceph_assert(in_flight_count != nullptr);
 
-  const bool done = in_flight.empty() && (
+  const bool done = in_flight.empty() && lookahead.empty() && (
       journaler.get_read_pos() == journaler.get_write_pos());
   if (done) {
     return true;
@@ -831,7 +945,7 @@ bool PurgeQueue::drain(
 
   *progress = drain_initial - bytes_remaining;
   *progress_total = drain_initial;
-  *in_flight_count = in_flight.size();
+  *in_flight_count = in_flight.size() + lookahead.size();
 
   return false;
 }
@@ -91,6 +91,9 @@ enum {
   l_pq_executing_high_water,
   l_pq_executed,
   l_pq_item_in_journal,
+  l_pq_executing_bytes,
+  l_pq_executed_bytes,
+  l_pq_ops_limit,
   l_pq_last
 };
 
@@ -116,6 +119,45 @@ public:
   object_locator_t oloc;
 };
 
+/**
+ * The purge queue entries that were read from the journal but are not
+ * expired yet, by their end position.  They are purged out of order,
+ * but the journal can only be expired up to the first one that is not
+ * done.
+ */
+class PurgeExpireTracker
+{
+public:
+  // the entry ending at pos was read
+  void add(uint64_t pos) {
+    ceph_assert(entries.empty() || pos > entries.rbegin()->first);
+    entries.emplace_hint(entries.end(), pos, false);
+  }
+  // the entry ending at pos is purged: returns how far the journal can
+  // be expired now, or 0 if no further than before
+  uint64_t complete(uint64_t pos) {
+    auto p = entries.find(pos);
+    ceph_assert(p != entries.end() && !p->second);
+    p->second = true;
+    uint64_t expire_to = 0;
+    while (!entries.empty() && entries.begin()->second) {
+      expire_to = entries.begin()->first;
+      entries.erase(entries.begin());
+    }
+    return expire_to;
+  }
+  bool empty() const {
+    return entries.empty();
+  }
+  size_t size() const {
+    return entries.size();
+  }
+
+private:
+  // end position -> done
+  std::map<uint64_t, bool> entries;
+};
+
 /**
  * A persistent queue of PurgeItems.  This class both writes and reads
  * to the queue.  There is one of these per MDS rank.
@@ -182,6 +224,9 @@ public:
 private:
   uint32_t _calculate_ops(const PurgeItem &item) const;
 
+  uint64_t _get_op_limit() const;
+  void _update_adaptive_limit(const PurgeItem &item, double latency);
+
   bool _can_consume();
 
   // recover the journal write_pos (drop any partial written entry)
@@ -194,7 +239,7 @@ private:
   bool _consume();
 
   void _execute_item(const PurgeItem &item, uint64_t expire_to);
-  void _execute_item_complete(uint64_t expire_to);
+  void _execute_item_complete(uint64_t expire_to, double latency);
 
   void _go_readonly(int r);
 
@@ -220,7 +265,20 @@ private:
   // Map of Journaler offset to PurgeItem
   std::map<uint64_t, PurgeItem> in_flight;
 
-  std::set<uint64_t> pending_expire;
+  // Items read from the journal but not executed yet, so that the
+  // largest of them can go first
+  struct LookaheadItem {
+    PurgeItem item;
+    ceph::coarse_mono_time read_stamp;
+    // how many later entries went first
+    unsigned skipped = 0;
+  };
+  std::map<uint64_t, LookaheadItem> lookahead;
+  // a corrupt entry was read: stop reading and go readonly once the
+  // lookahead is done
+  bool read_error = false;
+
+  PurgeExpireTracker expire_tracker;
 
   // Throttled allowances
   uint64_t ops_in_flight = 0;
@@ -228,6 +286,13 @@ private:
   // Dynamic op limit per MDS based on PG count
   uint64_t max_purge_ops = 0;
 
+  // Op limit driven by purge latency, if mds_purge_target_latency is set
+  uint64_t adaptive_ops = 0;
+  double op_latency_avg = 0;
+  ceph::coarse_mono_time last_backoff;
+
+  uint64_t bytes_in_flight = 0;
+
   // How many bytes were remaining when drain() was first called,
   // used for indicating progress.
   uint64_t drain_initial = 0;
@@ -0,0 +1,301 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "ReplyEncoder.h"
+
+#include "common/Finisher.h"
+#include "include/Context.h"
+#include "messages/MClientReply.h"
+#include "SessionMap.h"
+
+#define dout_context g_ceph_context
+#define dout_subsys ceph_subsys_mds
+#undef dout_prefix
+#define dout_prefix *_dout << "mds.reply_encoder "
+
+using ceph::bufferlist;
+
+void inodestat_t::encode(bufferlist& bl) const
+{
+  using ceph::encode;
+
+  // see CInode::encode_inodestat(), which this used to be part of: the
+  // xattrs are encoded straight into bl rather than into a bufferlist
+  // of their own, to save the allocation
+  auto encode_xattrs = [this, &bl]() {
+    using ceph::encode;
+    if (xattr_version) {
+      ceph_le32 xbl_len;
+      auto filler = bl.append_hole(sizeof(xbl_len));
+      const auto starting_bl_len = bl.length();
+      if (xattrs)
+	encode(*xattrs, bl);
+      else
+	encode((__u32)0, bl);
+      xbl_len = bl.length() - starting_bl_len;
+      filler.copy_in(sizeof(xbl_len), (char *)&xbl_len);
+    } else {
+      encode((__u32)0, bl);
+    }
+  };
+
+  /*
+   * note: encoding matches MClientReply::InodeStat
+   */
+  if (reply_encoding) {
+    ENCODE_START(6, 1, bl);
+    encode(ino, bl);
+    encode(snapid, bl);
+    encode(rdev, bl);
+    encode(version, bl);
+    encode(xattr_version, bl);
+    encode(ecap, bl);
+    {
+      ceph_file_layout legacy_layout;
+      layout.to_legacy(&legacy_layout);
+      encode(legacy_layout, bl);
+    }
+    encode(ctime, bl);
+    encode(mtime, bl);
+    encode(atime, bl);
+    encode(time_warp_seq, bl);
+    encode(size, bl);
+    encode(max_size, bl);
+    encode(truncate_size, bl);
+    encode(truncate_seq, bl);
+    encode(mode, bl);
+    encode(uid, bl);
+    encode(gid, bl);
+    encode(nlink, bl);
+    encode(dirstat.nfiles, bl);
+    encode(dirstat.nsubdirs, bl);
+    encode(rstat.rbytes, bl);
+    encode(rstat.rfiles, bl);
+    encode(rstat.rsubdirs, bl);
+    encode(rstat.rctime, bl);
+    dirfragtree.encode(bl);
+    encode(symlink, bl);
+    encode(dir_layout, bl);
+    encode_xattrs();
+    encode(inline_version, bl);
+    encode(inline_data, bl);
+    encode(quota, bl);
+    encode(layout.pool_ns, bl);
+    encode(btime, bl);
+    encode(change_attr, bl);
+    encode(export_pin, bl);
+    encode(snap_btime, bl);
+    encode(rstat.rsnaps, bl);
+    encode(snap_metadata, bl);
+    encode(fscrypt, bl);
+    ENCODE_FINISH(bl);
+  }
+  else {
+    encode(ino, bl);
+    encode(snapid, bl);
+    encode(rdev, bl);
+    encode(version, bl);
+    encode(xattr_version, bl);
+    encode(ecap, bl);
+    {
+      ceph_file_layout legacy_layout;
+      layout.to_legacy(&legacy_layout);
+      encode(legacy_layout, bl);
+    }
+    encode(ctime, bl);
+    encode(mtime, bl);
+    encode(atime, bl);
+    encode(time_warp_seq, bl);
+    encode(size, bl);
+    encode(max_size, bl);
+    encode(truncate_size, bl);
+    encode(truncate_seq, bl);
+    encode(mode, bl);
+    encode(uid, bl);
+    encode(gid, bl);
+    encode(nlink, bl);
+    encode(dirstat.nfiles, bl);
+    encode(dirstat.nsubdirs, bl);
+    encode(rstat.rbytes, bl);
+    encode(rstat.rfiles, bl);
+    encode(rstat.rsubdirs, bl);
+    encode(rstat.rctime, bl);
+    dirfragtree.encode(bl);
+    encode(symlink, bl);
+    if (con_features & CEPH_FEATURE_DIRLAYOUTHASH) {
+      encode(dir_layout, bl);
+    }
+    encode_xattrs();
+    if (con_features & CEPH_FEATURE_MDS_INLINE_DATA) {
+      encode(inline_version, bl);
+      encode(inline_data, bl);
+    }
+    if (con_features & CEPH_FEATURE_MDS_QUOTA) {
+      encode(quota, bl);
+    }
+    if (con_features & CEPH_FEATURE_FS_FILE_LAYOUT_V2) {
+      encode(layout.pool_ns, bl);
+    }
+    if (con_features & CEPH_FEATURE_FS_BTIME) {
+      encode(btime, bl);
+      encode(change_attr, bl);
+    }
+  }
+}
+
+void deferred_bl_t::append(bufferlist&& bl)
+{
+  if (bl.length() == 0) {
+    return;
+  }
+  len += bl.length();
+  if (parts.empty() || !std::holds_alternative<bufferlist>(parts.back())) {
+    parts.emplace_back(std::move(bl));
+  } else {
+    std::get<bufferlist>(parts.back()).claim_append(bl);
+  }
+}
+
+void deferred_bl_t::append(inodestat_t&& st)
+{
+  if (!defer) {
+    bufferlist bl;
+    st.encode(bl);
+    append(std::move(bl));
+    return;
+  }
+  len += st.length_bound;
+  parts.emplace_back(std::move(st));
+}
+
+void deferred_bl_t::claim_append(deferred_bl_t& other)
+{
+  for (auto& p : other.parts) {
+    if (auto bl = std::get_if<bufferlist>(&p); bl) {
+      append(std::move(*bl));
+    } else {
+      len += std::get<inodestat_t>(p).length_bound;
+      parts.emplace_back(std::move(p));
+    }
+  }
+  other.parts.clear();
+  other.len = 0;
+}
+
+void deferred_bl_t::encode(bufferlist& out) const
+{
+  for (auto& p : parts) {
+    if (auto bl = std::get_if<bufferlist>(&p); bl) {
+      out.append(*bl);
+    } else {
+      std::get<inodestat_t>(p).encode(out);
+    }
+  }
+}
+
+bool ReplyOutQueue::queue(const ceph::ref_t<Message>& m,
+			  const ConnectionRef& con)
+{
+  std::lock_guard l(lock);
+  if (entries.empty()) {
+    return false;
+  }
+  entries.push_back({++last_seq, m, con, true});
+  return true;
+}
+
+uint64_t ReplyOutQueue::add_pending(const ceph::ref_t<Message>& m,
+				    const ConnectionRef& con)
+{
+  std::lock_guard l(lock);
+  entries.push_back({++last_seq, m, con, false});
+  return last_seq;
+}
+
+void ReplyOutQueue::ready(uint64_t seq)
+{
+  std::lock_guard l(lock);
+  // every entry has a seq, so they are contiguous
+  ceph_assert(!entries.empty());
+  ceph_assert(seq >= entries.front().seq);
+  auto& e = entries[seq - entries.front().seq];
+  ceph_assert(e.seq == seq);
+  e.ready = true;
+  send_ready();
+}
+
+void ReplyOutQueue::send_ready()
+{
+  // send under the lock, so that a message queued later cannot be sent
+  // first by another thread
+  while (!entries.empty() && entries.front().ready) {
+    auto& e = entries.front();
+    if (e.con) {
+      e.con->send_message2(std::move(e.m));
+    } else {
+      dout(10) << "dropping " << *e.m << ", session has no connection"
+	       << dendl;
+    }
+    entries.pop_front();
+  }
+}
+
+ReplyEncoder::ReplyEncoder(CephContext *cct, unsigned nthreads)
+{
+  for (unsigned i = 0; i < nthreads; ++i) {
+    workers.push_back(std::make_unique<Finisher>(
+      cct, "MDSReplyEncoder", "MR_Encoder"));
+  }
+}
+
+ReplyEncoder::~ReplyEncoder() = default;
+
+void ReplyEncoder::start()
+{
+  for (auto& w : workers) {
+    w->start();
+  }
+}
+
+void ReplyEncoder::stop()
+{
+  for (auto& w : workers) {
+    w->wait_for_empty();
+    w->stop();
+  }
+}
+
+void ReplyEncoder::queue(Session *session,
+			 const ceph::ref_t<MClientReply>& reply,
+			 deferred_bl_t&& trace, deferred_bl_t&& extra)
+{
+  if (!session->deferred_out_queue) {
+    session->deferred_out_queue = std::make_shared<ReplyOutQueue>();
+  }
+  auto out = session->deferred_out_queue;
+  uint64_t seq = out->add_pending(reply, session->get_connection());
+  dout(20) << __func__ << " " << *reply << " to " << session->info.inst.name
+	   << " seq " << seq << dendl;
+
+  auto& w = workers[next++ % workers.size()];
+  w->queue(new LambdaContext(
+    [out, seq, reply, trace=std::move(trace), extra=std::move(extra)](int) {
+      // nothing else holds the reply until it is sent
+      bufferlist bl;
+      trace.encode(bl);
+      reply->set_trace(bl);
+      bufferlist extra_bl;
+      extra.encode(extra_bl);
+      reply->set_extra_bl(extra_bl);
+      out->ready(seq);
+    }));
+}
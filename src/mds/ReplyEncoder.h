@@ -0,0 +1,168 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MDS_REPLYENCODER_H
+#define CEPH_MDS_REPLYENCODER_H
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+#include "include/buffer.h"
+#include "include/frag.h"
+#include "include/fs_types.h"
+#include "include/mempool.h"
+#include "mdstypes.h"
+#include "msg/Connection.h"
+#include "msg/Message.h"
+
+class Finisher;
+class MClientReply;
+class Session;
+
+/*
+ * What CInode::encode_inodestat() puts in a reply for one inode.  The
+ * fields are copied out of the inode under mds_lock by
+ * CInode::get_inodestat(), so that the stat can be encoded without it.
+ */
+struct inodestat_t {
+  using xattr_map_const_ptr =
+    std::shared_ptr<const xattr_map<mempool::mds_co::pool_allocator>>;
+
+  void encode(ceph::buffer::list& bl) const;
+
+  bool reply_encoding = false;	// session has CEPHFS_FEATURE_REPLY_ENCODING
+  uint64_t con_features = 0;	// for the older encodings
+
+  inodeno_t ino;
+  snapid_t snapid;
+  uint32_t rdev = 0;
+  version_t version = 0;
+  version_t xattr_version = 0;
+  ceph_mds_reply_cap ecap = {};
+  file_layout_t layout;
+  utime_t ctime, mtime, atime, btime;
+  uint32_t time_warp_seq = 0;
+  uint64_t size = 0;
+  uint64_t max_size = 0;
+  uint64_t truncate_size = 0;
+  uint32_t truncate_seq = 0;
+  uint32_t mode = 0;
+  uint32_t uid = 0;
+  uint32_t gid = 0;
+  int32_t nlink = 0;
+  frag_info_t dirstat;
+  nest_info_t rstat;
+  fragtree_t dirfragtree;
+  std::string symlink;
+  ceph_dir_layout dir_layout = {};
+  xattr_map_const_ptr xattrs;	// null encodes an empty map
+  version_t inline_version = 0;
+  ceph::buffer::list inline_data;
+  quota_info_t quota;
+  uint64_t change_attr = 0;
+  mds_rank_t export_pin = MDS_RANK_NONE;
+  utime_t snap_btime;
+  std::map<std::string, std::string> snap_metadata;
+  bool fscrypt = false;
+
+  // upper bound on the encoded length, if it was asked for
+  unsigned length_bound = 0;
+};
+
+/*
+ * A reply payload made of encoded bytes and inode stats.  Unless it is
+ * deferred, the stats are encoded as they are appended; otherwise they
+ * are kept until encode() is called, which needs no locks.
+ */
+class deferred_bl_t {
+public:
+  explicit deferred_bl_t(bool defer = false) : defer(defer) {}
+
+  bool is_deferred() const {
+    return defer;
+  }
+  bool empty() const {
+    return parts.empty();
+  }
+  // the encoded length, or an upper bound on it while stats are deferred
+  unsigned length() const {
+    return len;
+  }
+
+  void append(ceph::buffer::list&& bl);
+  void append(inodestat_t&& st);
+  void claim_append(deferred_bl_t& other);
+
+  void encode(ceph::buffer::list& out) const;
+
+private:
+  bool defer;
+  unsigned len = 0;
+  std::vector<std::variant<ceph::buffer::list, inodestat_t>> parts;
+};
+
+/*
+ * Messages for one client session, held back behind the replies that
+ * are still being encoded so that the client gets them in order.
+ */
+class ReplyOutQueue {
+public:
+  // queue m if replies are being encoded; false if it can be sent now
+  bool queue(const ceph::ref_t<Message>& m, const ConnectionRef& con);
+  // hold the place of a reply that is being encoded
+  uint64_t add_pending(const ceph::ref_t<Message>& m, const ConnectionRef& con);
+  // the reply at seq is encoded; send it and what is ready behind it
+  void ready(uint64_t seq);
+
+private:
+  struct entry_t {
+    uint64_t seq;
+    ceph::ref_t<Message> m;
+    ConnectionRef con;
+    bool ready;
+  };
+
+  void send_ready();
+
+  ceph::mutex lock = ceph::make_mutex("ReplyOutQueue::lock");
+  std::deque<entry_t> entries;
+  uint64_t last_seq = 0;
+};
+
+/*
+ * Encodes the inode stats of getattr, lookup and readdir replies on a
+ * few threads, so that mds_lock is only held to copy them out of the
+ * cache.  Locks and caps are still taken and issued under mds_lock.
+ */
+class ReplyEncoder {
+public:
+  ReplyEncoder(CephContext *cct, unsigned nthreads);
+  ~ReplyEncoder();
+
+  void start();
+  void stop();
+
+  // encode trace and extra into reply, then send it to the session
+  void queue(Session *session, const ceph::ref_t<MClientReply>& reply,
+	     deferred_bl_t&& trace, deferred_bl_t&& extra);
+
+private:
+  std::vector<std::unique_ptr<Finisher>> workers;
+  unsigned next = 0;
+};
+
+#endif
@@ -2189,6 +2189,9 @@ void Server::reply_client_request(MDRequestRef& mdr, const ref_t<MClientReply> &
 
   // reply at all?
   if (session && !client_inst.name.is_mds()) {
+    bool deferred = is_reply_deferred(mdr);
+    deferred_bl_t trace(deferred);
+
     // send reply.
     if (!did_early_reply &&   // don't issue leases if we sent an earlier reply already
 	(tracei || tracedn)) {
@@ -2197,16 +2200,37 @@ void Server::reply_client_request(MDRequestRef& mdr, const ref_t<MClientReply> &
 	  mdcache->try_reconnect_cap(tracei, session);
       } else {
 	// include metadata in reply
-	set_trace_dist(reply, tracei, tracedn, mdr);
+	set_trace_dist(reply, tracei, tracedn, mdr, trace);
       }
     }
 
-    // We can set the extra bl unconditionally: if it's already been sent in the
-    // early_reply, set_extra_bl will have claimed it and reply_extra_bl is empty
-    reply->set_extra_bl(mdr->reply_extra_bl);
-
     reply->set_mdsmap_epoch(mds->mdsmap->get_epoch());
-    mds->send_message_client(reply, session);
+    if (deferred) {
+      // the reply is sent once its inode stats are encoded
+      deferred_bl_t extra(true);
+      if (mdr->reply_extra_deferred.empty()) {
+	extra.append(std::move(mdr->reply_extra_bl));
+      } else {
+	extra.claim_append(mdr->reply_extra_deferred);
+      }
+      mds->reply_encoder->queue(session, reply, std::move(trace),
+				std::move(extra));
+    } else {
+      if (!trace.empty()) {
+	bufferlist bl;
+	trace.encode(bl);
+	reply->set_trace(bl);
+      }
+      if (!mdr->reply_extra_deferred.empty()) {
+	mdr->reply_extra_deferred.encode(mdr->reply_extra_bl);
+      }
+
+      // We can set the extra bl unconditionally: if it's already been sent in the
+      // early_reply, set_extra_bl will have claimed it and reply_extra_bl is empty
+      reply->set_extra_bl(mdr->reply_extra_bl);
+
+      mds->send_message_client(reply, session);
+    }
   }
 
   if (req->is_queued_for_replay() &&
@@ -2239,6 +2263,23 @@ void Server::reply_client_request(MDRequestRef& mdr, const ref_t<MClientReply> &
 void Server::set_trace_dist(const ref_t<MClientReply> &reply,
 			    CInode *in, CDentry *dn,
 			    MDRequestRef& mdr)
+{
+  deferred_bl_t trace;
+  set_trace_dist(reply, in, dn, mdr, trace);
+  if (!trace.empty()) {
+    bufferlist bl;
+    trace.encode(bl);
+    reply->set_trace(bl);
+  }
+}
+
+/*
+ * as above, but leave the trace in trace, whose inode stats may be
+ * encoded later (see ReplyEncoder)
+ */
+void Server::set_trace_dist(const ref_t<MClientReply> &reply,
+			    CInode *in, CDentry *dn,
+			    MDRequestRef& mdr, deferred_bl_t& trace)
 {
   // skip doing this for debugging purposes?
   if (g_conf()->mds_inject_traceless_reply_probability &&
@@ -2274,7 +2315,9 @@ void Server::set_trace_dist(const ref_t<MClientReply> &reply,
     CDir *dir = dn->get_dir();
     CInode *diri = dir->get_inode();
 
-    diri->encode_inodestat(bl, session, NULL, snapid);
+    inodestat_t dirist;
+    diri->get_inodestat(dirist, session, NULL, snapid);
+    trace.append(std::move(dirist));
     dout(20) << "set_trace_dist added diri " << *diri << dendl;
 
 #ifdef MDS_VERIFY_FRAGSTAT
@@ -2308,15 +2351,39 @@ void Server::set_trace_dist(const ref_t<MClientReply> &reply,
   } else
     reply->head.is_dentry = 0;
 
+  trace.append(std::move(bl));
+
   // inode
   if (in) {
-    in->encode_inodestat(bl, session, NULL, snapid, 0, mdr->getattr_caps);
+    inodestat_t ist;
+    in->get_inodestat(ist, session, NULL, snapid, 0, mdr->getattr_caps);
+    trace.append(std::move(ist));
     dout(20) << "set_trace_dist added in   " << *in << dendl;
     reply->head.is_target = 1;
   } else
     reply->head.is_target = 0;
+}
 
-  reply->set_trace(bl);
+/*
+ * encode the inode stats of this request's reply off mds_lock?  only
+ * for the read-only requests that are most of a busy rank's load.
+ */
+bool Server::is_reply_deferred(const MDRequestRef& mdr) const
+{
+  if (!mds->reply_encoder || !mdr->session ||
+      !mdr->session->get_connection())
+    return false;
+  const cref_t<MClientRequest> &req = mdr->client_request;
+  if (!req || req->is_replay() || mdr->did_early_reply)
+    return false;
+  switch (req->get_op()) {
+  case CEPH_MDS_OP_GETATTR:
+  case CEPH_MDS_OP_LOOKUP:
+  case CEPH_MDS_OP_READDIR:
+    return true;
+  default:
+    return false;
+  }
 }
 
 void Server::handle_client_request(const cref_t<MClientRequest> &req)
@@ -4625,7 +4692,7 @@ void Server::handle_client_readdir(MDRequestRef& mdr)
   bytes_left -= realm->get_snap_trace().length();
 
   // build dir contents
-  bufferlist dnbl;
+  deferred_bl_t dnbl(is_reply_deferred(mdr));
   __u32 numfiles = 0;
   bool start = !offset_hash && offset_str.empty();
   // skip all dns < dentry_key_t(snapid, offset_str, offset_hash)
@@ -4698,26 +4765,26 @@ void Server::handle_client_readdir(MDRequestRef& mdr)
       break;
     }
     
-    unsigned start_len = dnbl.length();
-
     // dentry
     dout(12) << "including    dn " << *dn << dendl;
-    encode(dn->get_name(), dnbl);
+    bufferlist dnentry;
+    encode(dn->get_name(), dnentry);
     int lease_mask = dnl->is_primary() ? CEPH_LEASE_PRIMARY_LINK : 0;
-    mds->locker->issue_client_lease(dn, mdr, lease_mask, now, dnbl);
+    mds->locker->issue_client_lease(dn, mdr, lease_mask, now, dnentry);
 
     // inode
     dout(12) << "including inode " << *in << dendl;
-    int r = in->encode_inodestat(dnbl, mdr->session, realm, snapid, bytes_left - (int)dnbl.length());
+    inodestat_t st;
+    int r = in->get_inodestat(st, mdr->session, realm, snapid,
+			      bytes_left - (int)(dnbl.length() + dnentry.length()));
     if (r < 0) {
-      // chop off dn->name, lease
-      dout(10) << " ran out of room, stopping at " << start_len << " < " << bytes_left << dendl;
-      bufferlist keep;
-      keep.substr_of(dnbl, 0, start_len);
-      dnbl.swap(keep);
+      // leave out dn->name, lease
+      dout(10) << " ran out of room, stopping at " << dnbl.length() << " < " << bytes_left << dendl;
       break;
     }
     ceph_assert(r >= 0);
+    dnbl.append(std::move(dnentry));
+    dnbl.append(std::move(st));
     numfiles++;
 
     // touch dn
@@ -4740,15 +4807,21 @@ void Server::handle_client_readdir(MDRequestRef& mdr)
   // finish final blob
   encode(numfiles, dirbl);
   encode(flags, dirbl);
-  dirbl.claim_append(dnbl);
   
   // yay, reply
   dout(10) << "reply to " << *req << " readdir num=" << numfiles
-	   << " bytes=" << dirbl.length()
+	   << " bytes=" << dirbl.length() + dnbl.length()
 	   << " start=" << (int)start
 	   << " end=" << (int)end
 	   << dendl;
-  mdr->reply_extra_bl = dirbl;
+  if (dnbl.is_deferred()) {
+    mdr->reply_extra_deferred = deferred_bl_t(true);
+    mdr->reply_extra_deferred.append(std::move(dirbl));
+    mdr->reply_extra_deferred.claim_append(dnbl);
+  } else {
+    dnbl.encode(dirbl);
+    mdr->reply_extra_bl = dirbl;
+  }
 
   // bump popularity.  NOTE: this doesn't quite capture it.
   mds->balancer->hit_dir(dir, META_POP_IRD, -1, numfiles);
@@ -167,6 +167,9 @@ public:
   void respond_to_request(MDRequestRef& mdr, int r = 0);
   void set_trace_dist(const ref_t<MClientReply> &reply, CInode *in, CDentry *dn,
 		      MDRequestRef& mdr);
+  void set_trace_dist(const ref_t<MClientReply> &reply, CInode *in, CDentry *dn,
+		      MDRequestRef& mdr, deferred_bl_t& trace);
+  bool is_reply_deferred(const MDRequestRef& mdr) const;
 
   void handle_peer_request(const cref_t<MMDSPeerRequest> &m);
   void handle_peer_request_reply(const cref_t<MMDSPeerRequest> &m);
@@ -31,6 +31,7 @@
 #include "CInode.h"
 #include "Capability.h"
 #include "MDSContext.h"
+#include "ReplyEncoder.h"
 #include "msg/Message.h"
 
 struct MDRequestImpl;
@@ -417,6 +418,7 @@ public:
   xlist<Session*>::item item_session_list;
 
   std::list<ceph::ref_t<Message>> preopen_out_queue;  ///< messages for client, queued before they connect
+  std::shared_ptr<ReplyOutQueue> deferred_out_queue;  ///< messages for client, queued behind replies being encoded
 
   /* This is mutable to allow get_request_count to be const. elist does not
    * support const iterators yet.
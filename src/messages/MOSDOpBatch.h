@@ -0,0 +1,191 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+
+#ifndef CEPH_MOSDOPBATCH_H
+#define CEPH_MOSDOPBATCH_H
+
+#include "msg/Message.h"
+#include "osd/osd_types.h"
+
+/*
+ * OSD op batch
+ *
+ * Several already encoded MOSDOps, all targeting the same pg, packed
+ * into a single message.  The receiving OSD unpacks the batch and
+ * dispatches each op independently; each gets its own MOSDOpReply.
+ * The ops' data segments are concatenated in this message's data
+ * segment so that write payloads are not copied into the front.
+ */
+class MOSDOpBatch final : public Message {
+public:
+  static constexpr int HEAD_VERSION = 1;
+  static constexpr int COMPAT_VERSION = 1;
+
+  struct op_t {
+    __u16 version = 0;
+    __u16 compat_version = 0;
+    __u16 priority = 0;
+    ceph_tid_t tid = 0;
+    ceph::buffer::list front;
+    uint32_t data_len = 0;
+    uint16_t data_off = 0;
+
+    void encode(ceph::buffer::list &bl) const {
+      using ceph::encode;
+      ENCODE_START(1, 1, bl);
+      encode(version, bl);
+      encode(compat_version, bl);
+      encode(priority, bl);
+      encode(tid, bl);
+      encode(front, bl);
+      encode(data_len, bl);
+      encode(data_off, bl);
+      ENCODE_FINISH(bl);
+    }
+    void decode(ceph::buffer::list::const_iterator &p) {
+      using ceph::decode;
+      DECODE_START(1, p);
+      decode(version, p);
+      decode(compat_version, p);
+      decode(priority, p);
+      decode(tid, p);
+      decode(front, p);
+      decode(data_len, p);
+      decode(data_off, p);
+      DECODE_FINISH(p);
+    }
+  };
+
+  spg_t pgid;
+  std::vector<op_t> ops;
+
+  MOSDOpBatch()
+    : Message{MSG_OSD_OP_BATCH, HEAD_VERSION, COMPAT_VERSION} {}
+  explicit MOSDOpBatch(spg_t pgid_)
+    : Message{MSG_OSD_OP_BATCH, HEAD_VERSION, COMPAT_VERSION},
+      pgid(pgid_) {}
+
+  /// encode m with the given features and append it to the batch
+  void add_op(Message *m, uint64_t features) {
+    ceph_assert(m->get_type() == CEPH_MSG_OSD_OP);
+    m->encode(features, 0);
+    op_t op;
+    op.version = m->get_header().version;
+    op.compat_version = m->get_header().compat_version;
+    op.priority = m->get_priority();
+    op.tid = m->get_tid();
+    op.front = m->get_payload();
+    op.data_len = m->get_data().length();
+    op.data_off = m->get_header().data_off;
+    data.append(m->get_data());
+    ops.push_back(std::move(op));
+    if (m->get_priority() > get_priority()) {
+      set_priority(m->get_priority());
+    }
+  }
+
+  size_t get_num_ops() const {
+    return ops.size();
+  }
+
+  /**
+   * unpack
+   *
+   * Rebuilds each packed op as a standalone message, as if it had been
+   * received on its own over this message's connection.  The returned
+   * messages are still undecoded beyond what decode_payload() does
+   * and take over their share of this message's byte throttle.
+   * Throws ceph::buffer::error if the batch is malformed, in which case
+   * no message is returned.
+   */
+  template <typename M>
+  std::vector<ceph::ref_t<M>> unpack() {
+    std::vector<ceph::ref_t<M>> ret;
+    ret.reserve(ops.size());
+    auto p = data.cbegin();
+    for (auto &op : ops) {
+      auto m = ceph::make_message<M>();
+      ceph_msg_header h = get_header();
+      h.type = CEPH_MSG_OSD_OP;
+      h.version = op.version;
+      h.compat_version = op.compat_version;
+      h.priority = op.priority;
+      h.tid = op.tid;
+      h.front_len = op.front.length();
+      h.middle_len = 0;
+      h.data_len = op.data_len;
+      h.data_off = op.data_off;
+      m->set_header(h);
+      m->set_footer(get_footer());
+      m->set_connection(get_connection());
+      m->set_recv_stamp(get_recv_stamp());
+      m->set_throttle_stamp(get_throttle_stamp());
+      m->set_recv_complete_stamp(get_recv_complete_stamp());
+      if (byte_throttler) {
+	m->set_byte_throttler(byte_throttler);
+      }
+      m->set_payload(op.front);
+      m->set_data(copy_aligned(p, op.data_len, op.data_off));
+      m->decode_payload();
+      ret.push_back(std::move(m));
+    }
+    return ret;
+  }
+
+  void encode_payload(uint64_t features) override {
+    using ceph::encode;
+    encode(pgid, payload);
+    encode(ops, payload);
+  }
+
+  void decode_payload() override {
+    using ceph::decode;
+    auto p = payload.cbegin();
+    decode(pgid, p);
+    decode(ops, p);
+  }
+
+  std::string_view get_type_name() const override { return "osd_op_batch"; }
+
+  void print(std::ostream& out) const override {
+    out << "osd_op_batch(" << pgid << " " << ops.size() << " ops";
+    if (!ops.empty()) {
+      out << " tid " << ops.front().tid << ".." << ops.back().tid;
+    }
+    out << ")";
+  }
+
+private:
+  /// copy len bytes into a buffer that starts at off's offset within a
+  /// page, as the messenger lays out a received message's data segment
+  static ceph::buffer::list copy_aligned(ceph::buffer::list::const_iterator& p,
+					 unsigned len, unsigned off) {
+    ceph::buffer::list bl;
+    if (len == 0) {
+      return bl;
+    }
+    unsigned head = off & ~CEPH_PAGE_MASK;
+    ceph::buffer::ptr ptr(ceph::buffer::create_small_page_aligned(head + len));
+    ptr.set_offset(head);
+    ptr.set_length(len);
+    p.copy(len, ptr.c_str());
+    bl.push_back(std::move(ptr));
+    return bl;
+  }
+
+  template<class T, typename... Args>
+  friend boost::intrusive_ptr<T> ceph::make_message(Args&&... args);
+};
+WRITE_CLASS_ENCODER(MOSDOpBatch::op_t)
+
+#endif
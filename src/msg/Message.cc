@@ -68,6 +68,7 @@
 #include "messages/MOSDFull.h"
 #include "messages/MOSDPing.h"
 #include "messages/MOSDOp.h"
+#include "messages/MOSDOpBatch.h"
 #include "messages/MOSDOpReply.h"
 #include "messages/MOSDRepOp.h"
 #include "messages/MOSDRepOpReply.h"
@@ -513,6 +514,9 @@ Message *decode_message(CephContext *cct,
   case CEPH_MSG_OSD_OP:
     m = make_message<MOSDOp>();
     break;
+  case MSG_OSD_OP_BATCH:
+    m = make_message<MOSDOpBatch>();
+    break;
   case CEPH_MSG_OSD_OPREPLY:
     m = make_message<MOSDOpReply>();
     break;
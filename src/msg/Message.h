@@ -119,6 +119,7 @@
 #define MSG_OSD_BACKFILL_RESERVE 99
 #define MSG_OSD_RECOVERY_RESERVE 150
 #define MSG_OSD_FORCE_RECOVERY 151
+#define MSG_OSD_OP_BATCH       152
 
 #define MSG_OSD_PG_PUSH        105
 #define MSG_OSD_PG_PULL        106
@@ -79,6 +79,7 @@
 #include "messages/MOSDMarkMeDead.h"
 #include "messages/MOSDFull.h"
 #include "messages/MOSDOp.h"
+#include "messages/MOSDOpBatch.h"
 #include "messages/MOSDOpReply.h"
 #include "messages/MOSDBackoff.h"
 #include "messages/MOSDBeacon.h"
@@ -7134,6 +7135,9 @@ void OSD::ms_fast_dispatch(Message *m)
   case MSG_OSD_FORCE_RECOVERY:
     handle_fast_force_recovery(static_cast<MOSDForceRecovery*>(m));
     return;
+  case MSG_OSD_OP_BATCH:
+    handle_fast_op_batch(static_cast<MOSDOpBatch*>(m));
+    return;
   case MSG_OSD_SCRUB2:
     handle_fast_scrub(static_cast<MOSDScrub2*>(m));
     return;
@@ -9396,6 +9400,27 @@ void OSD::handle_fast_pg_remove(MOSDPGRemove *m)
   m->put();
 }
 
+void OSD::handle_fast_op_batch(MOSDOpBatch *m)
+{
+  dout(20) << __func__ << " " << *m << dendl;
+  // Each op is dispatched as if it had arrived in its own MOSDOp, in
+  // the order the client packed them, so per-object ordering and the
+  // reply path are unchanged.
+  std::vector<ceph::ref_t<MOSDOp>> ops;
+  try {
+    ops = m->unpack<MOSDOp>();
+  } catch (const ceph::buffer::error& e) {
+    derr << __func__ << " failed to unpack " << *m << " from "
+	 << m->get_source_inst() << ": " << e.what() << dendl;
+    m->put();
+    return;
+  }
+  m->put();
+  for (auto& op : ops) {
+    ms_fast_dispatch(op.detach());
+  }
+}
+
 void OSD::handle_fast_force_recovery(MOSDForceRecovery *m)
 {
   dout(10) << __func__ << " " << *m << dendl;
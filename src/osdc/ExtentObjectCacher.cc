@@ -0,0 +1,1033 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "ExtentObjectCacher.h"
+#include "Striper.h"
+#include "common/Cond.h"
+#include "common/debug.h"
+#include "common/errno.h"
+#include "include/ceph_assert.h"
+
+#define dout_subsys ceph_subsys_objectcacher
+#undef dout_prefix
+#define dout_prefix *_dout << "extentobjectcacher." << name << " "
+
+using std::vector;
+using ceph::bufferlist;
+
+/*** read state ***/
+
+struct ExtentObjectCacher::ReadOp {
+  ceph::mutex lock = ceph::make_mutex("ExtentObjectCacher::ReadOp::lock");
+  vector<ObjectExtent> extents;
+  /// per object extent: offset within the extent -> data
+  vector<std::map<uint64_t, bufferlist>> pieces;
+  unsigned pending = 0;
+  int r = 0;
+  bufferlist *out;
+  Context *onfinish;
+
+  ReadOp(const vector<ObjectExtent>& extents, bufferlist *out,
+	 Context *onfinish)
+    : extents(extents), pieces(extents.size()), out(out),
+      onfinish(onfinish) {}
+
+  uint64_t assemble(CephContext *cct) {
+    Striper::StripedReadResult result;
+    uint64_t total = 0;
+    for (size_t i = 0; i < extents.size(); ++i) {
+      bufferlist bl;
+      for (auto& p : pieces[i]) {
+	bl.claim_append(p.second);
+      }
+      total += bl.length();
+      result.add_partial_result(cct, bl, extents[i].buffer_extents);
+    }
+    result.assemble_result(cct, *out, true);
+    return total;
+  }
+};
+
+class ExtentObjectCacher::C_ReadFinish : public Context {
+  ExtentObjectCacher *oc;
+  std::shared_ptr<ReadOp> op;
+  size_t idx;           ///< index into op->extents
+  uint64_t piece_off;   ///< offset within that extent
+  Shard *shard;         ///< null if the read bypasses the cache
+  int64_t pool;
+  object_t oid;
+  uint64_t off;
+  uint64_t len;
+  uint64_t write_gen;   ///< of the object when the read was issued
+public:
+  bufferlist bl;
+
+  C_ReadFinish(ExtentObjectCacher *oc, std::shared_ptr<ReadOp> op,
+	       size_t idx, uint64_t piece_off, Shard *shard,
+	       int64_t pool, const object_t& oid, uint64_t off, uint64_t len,
+	       uint64_t write_gen)
+    : oc(oc), op(std::move(op)), idx(idx), piece_off(piece_off),
+      shard(shard), pool(pool), oid(oid), off(off), len(len),
+      write_gen(write_gen) {}
+
+  void finish(int r) override {
+    if (r == -ENOENT) {
+      bl.clear();
+      r = 0;
+    }
+    if (r >= 0) {
+      // a short read means zeros past the end of the object
+      if (bl.length() < len) {
+	bl.append_zero(len - bl.length());
+      } else if (bl.length() > len) {
+	bufferlist t;
+	t.substr_of(bl, 0, len);
+	bl.swap(t);
+      }
+    }
+    if (shard) {
+      std::lock_guard l{shard->lock};
+      if (r >= 0) {
+	oc->read_finish(*shard, pool, oid, off, bl, write_gen);
+      } else {
+	Object *ob = oc->lookup_object(*shard, pool, oid);
+	ceph_assert(ob);
+	ob->pending_io--;
+	oc->maybe_close_object(*shard, ob);
+      }
+    }
+
+    bool done;
+    {
+      std::lock_guard l{op->lock};
+      if (r < 0) {
+	if (op->r == 0) {
+	  op->r = r;
+	}
+      } else {
+	op->pieces[idx][piece_off] = std::move(bl);
+      }
+      done = (--op->pending == 0);
+    }
+    if (done) {
+      if (op->r < 0) {
+	op->onfinish->complete(op->r);
+      } else {
+	op->onfinish->complete(op->assemble(oc->cct));
+      }
+    }
+    oc->io_finish();
+  }
+};
+
+class ExtentObjectCacher::C_WriteCommit : public Context {
+  ExtentObjectCacher *oc;
+  Shard *shard;
+  int64_t pool;
+  object_t oid;
+  ceph_tid_t tid;
+public:
+  C_WriteCommit(ExtentObjectCacher *oc, Shard *shard, int64_t pool,
+		const object_t& oid, ceph_tid_t tid)
+    : oc(oc), shard(shard), pool(pool), oid(oid), tid(tid) {}
+
+  void finish(int r) override {
+    oc->write_commit(*shard, pool, oid, tid, r);
+    oc->io_finish();
+  }
+};
+
+/*** ExtentObjectCacher ***/
+
+ExtentObjectCacher::ExtentObjectCacher(
+  CephContext *cct, std::string name, WritebackHandler& wb,
+  uint64_t max_bytes, uint64_t max_dirty, uint64_t target_dirty,
+  double max_dirty_age, unsigned num_shards)
+  : cct(cct), name(std::move(name)), writeback_handler(wb),
+    max_bytes(max_bytes), max_dirty(max_dirty), target_dirty(target_dirty),
+    max_dirty_age(ceph::make_timespan(max_dirty_age)),
+    num_shards(std::max(num_shards, 1u)),
+    shards(new Shard[this->num_shards]),
+    flusher_thread(this)
+{
+}
+
+ExtentObjectCacher::~ExtentObjectCacher()
+{
+  ceph_assert(!flusher_thread.is_started());
+  std::lock_guard l{inflight_lock};
+  ceph_assert(inflight == 0);
+}
+
+void ExtentObjectCacher::start()
+{
+  flusher_thread.create("flusher");
+}
+
+void ExtentObjectCacher::stop()
+{
+  if (flusher_thread.is_started()) {
+    {
+      std::lock_guard l{flusher_lock};
+      flusher_stop = true;
+      flusher_cond.notify_all();
+    }
+    wake_dirty_waiters();
+    flusher_thread.join();
+  }
+  std::unique_lock l{inflight_lock};
+  inflight_cond.wait(l, [this] { return inflight == 0; });
+}
+
+/*** objects ***/
+
+ExtentObjectCacher::Shard& ExtentObjectCacher::get_shard(
+  const ObjectSet *oset, uint64_t object_no)
+{
+  uint64_t h = (uint64_t(oset->ino) * 0x9e3779b97f4a7c15ull) ^
+    (object_no * 0xc2b2ae3d27d4eb4full) ^ uint64_t(oset->poolid);
+  return shards[(h ^ (h >> 32)) % num_shards];
+}
+
+ExtentObjectCacher::Object *ExtentObjectCacher::lookup_object(
+  Shard& shard, int64_t pool, const object_t& oid)
+{
+  auto p = shard.objects.find(std::make_pair(pool, oid));
+  if (p == shard.objects.end()) {
+    return nullptr;
+  }
+  return p->second.get();
+}
+
+ExtentObjectCacher::Object *ExtentObjectCacher::get_object(
+  Shard& shard, ObjectSet *oset, const ObjectExtent& ex)
+{
+  auto key = std::make_pair(ex.oloc.pool, ex.oid);
+  auto p = shard.objects.find(key);
+  if (p != shard.objects.end()) {
+    touch(shard, p->second.get());
+    return p->second.get();
+  }
+  auto ob = std::make_unique<Object>(ex.oid, ex.objectno, ex.oloc, oset);
+  Object *o = ob.get();
+  shard.objects.emplace(key, std::move(ob));
+  shard.set_objects[oset].insert(o);
+  shard.lru.push_front(o);
+  o->lru_pos = shard.lru.begin();
+  ldout(cct, 20) << "get_object new " << ex.oid << dendl;
+  return o;
+}
+
+void ExtentObjectCacher::touch(Shard& shard, Object *ob)
+{
+  shard.lru.splice(shard.lru.begin(), shard.lru, ob->lru_pos);
+}
+
+bool ExtentObjectCacher::maybe_close_object(Shard& shard, Object *ob)
+{
+  if (!ob->extents.empty() || ob->pending_io || !ob->tx_waiters.empty()) {
+    return false;
+  }
+  ldout(cct, 20) << "close_object " << ob->oid << dendl;
+  ceph_assert(ob->dirty_bytes == 0);
+  shard.lru.erase(ob->lru_pos);
+  auto p = shard.set_objects.find(ob->oset);
+  ceph_assert(p != shard.set_objects.end());
+  p->second.erase(ob);
+  if (p->second.empty()) {
+    shard.set_objects.erase(p);
+  }
+  shard.objects.erase(std::make_pair(ob->oloc.pool, ob->oid));
+  return true;
+}
+
+/*** extents ***/
+
+void ExtentObjectCacher::account(Shard& shard, Object *ob,
+				 const extent_t& ex, int sign)
+{
+  uint64_t len = ex.length();
+  switch (ex.state) {
+  case state_t::CLEAN:
+    if (sign > 0) {
+      stat_clean += len;
+      shard.clean_bytes += len;
+    } else {
+      stat_clean -= len;
+      shard.clean_bytes -= len;
+    }
+    break;
+  case state_t::DIRTY:
+    if (sign > 0) {
+      stat_dirty += len;
+      if (ob->dirty_bytes == 0) {
+	shard.dirty_objects.insert(ob);
+      }
+      ob->dirty_bytes += len;
+    } else {
+      stat_dirty -= len;
+      ob->dirty_bytes -= len;
+      if (ob->dirty_bytes == 0) {
+	shard.dirty_objects.erase(ob);
+      }
+    }
+    break;
+  case state_t::TX:
+    if (sign > 0) {
+      stat_tx += len;
+    } else {
+      stat_tx -= len;
+    }
+    break;
+  }
+}
+
+bool ExtentObjectCacher::can_merge(const extent_t& a, const extent_t& b)
+{
+  if (a.state != b.state) {
+    return false;
+  }
+  switch (a.state) {
+  case state_t::CLEAN:
+    return true;
+  case state_t::DIRTY:
+    return a.snapc.seq == b.snapc.seq && a.failed == b.failed;
+  case state_t::TX:
+    return a.tid == b.tid;
+  }
+  return false;
+}
+
+void ExtentObjectCacher::try_merge(Object *ob,
+				   std::map<uint64_t, extent_t>::iterator p)
+{
+  auto n = std::next(p);
+  if (n != ob->extents.end() &&
+      p->first + p->second.length() == n->first &&
+      can_merge(p->second, n->second)) {
+    p->second.bl.claim_append(n->second.bl);
+    p->second.dirtied = std::min(p->second.dirtied, n->second.dirtied);
+    ob->extents.erase(n);
+  }
+  if (p != ob->extents.begin()) {
+    auto q = std::prev(p);
+    if (q->first + q->second.length() == p->first &&
+	can_merge(q->second, p->second)) {
+      q->second.bl.claim_append(p->second.bl);
+      q->second.dirtied = std::min(q->second.dirtied, p->second.dirtied);
+      ob->extents.erase(p);
+    }
+  }
+}
+
+void ExtentObjectCacher::merge_all(Object *ob)
+{
+  auto p = ob->extents.begin();
+  while (p != ob->extents.end()) {
+    auto n = std::next(p);
+    if (n != ob->extents.end() &&
+	p->first + p->second.length() == n->first &&
+	can_merge(p->second, n->second)) {
+      p->second.bl.claim_append(n->second.bl);
+      p->second.dirtied = std::min(p->second.dirtied, n->second.dirtied);
+      ob->extents.erase(n);
+    } else {
+      p = n;
+    }
+  }
+}
+
+void ExtentObjectCacher::punch(Shard& shard, Object *ob,
+			       uint64_t off, uint64_t len)
+{
+  uint64_t end = off + len;
+  auto p = ob->extents.lower_bound(off);
+  if (p != ob->extents.begin()) {
+    auto q = std::prev(p);
+    if (q->first + q->second.length() > off) {
+      p = q;
+    }
+  }
+  while (p != ob->extents.end() && p->first < end) {
+    uint64_t eoff = p->first;
+    uint64_t eend = eoff + p->second.length();
+    extent_t ex = std::move(p->second);
+    p = ob->extents.erase(p);
+    account(shard, ob, ex, -1);
+    auto split = [&ex](uint64_t from, uint64_t to) {
+      extent_t part{ex.state, {}, ex.tid, ex.snapc, ex.mtime, ex.dirtied,
+		    ex.failed};
+      part.bl.substr_of(ex.bl, from, to - from);
+      return part;
+    };
+    if (eoff < off) {
+      extent_t head = split(0, off - eoff);
+      account(shard, ob, head, 1);
+      ob->extents.emplace_hint(p, eoff, std::move(head));
+    }
+    if (eend > end) {
+      extent_t tail = split(end - eoff, eend - eoff);
+      account(shard, ob, tail, 1);
+      ob->extents.emplace_hint(p, end, std::move(tail));
+      break;
+    }
+  }
+}
+
+void ExtentObjectCacher::insert(Shard& shard, Object *ob, uint64_t off,
+				extent_t&& ex)
+{
+  punch(shard, ob, off, ex.length());
+  account(shard, ob, ex, 1);
+  auto p = ob->extents.emplace(off, std::move(ex)).first;
+  try_merge(ob, p);
+}
+
+void ExtentObjectCacher::fill(Shard& shard, Object *ob, uint64_t off,
+			      const bufferlist& bl)
+{
+  uint64_t end = off + bl.length();
+  uint64_t pos = off;
+  while (pos < end) {
+    auto p = ob->extents.upper_bound(pos);
+    if (p != ob->extents.begin()) {
+      auto q = std::prev(p);
+      uint64_t qend = q->first + q->second.length();
+      if (qend > pos) {
+	pos = qend;
+	continue;
+      }
+    }
+    uint64_t hole_end = p == ob->extents.end() ? end : std::min(end, p->first);
+    extent_t ex{state_t::CLEAN};
+    ex.bl.substr_of(bl, pos - off, hole_end - pos);
+    insert(shard, ob, pos, std::move(ex));
+    pos = hole_end;
+  }
+}
+
+/*** read ***/
+
+int ExtentObjectCacher::readx(const vector<ObjectExtent>& extents,
+			      snapid_t snap, bufferlist *bl, ObjectSet *oset,
+			      Context *onfinish, int op_flags)
+{
+  struct fetch_t {
+    size_t idx;
+    uint64_t piece_off;
+    const ObjectExtent *ex;
+    Shard *shard;
+    uint64_t off;
+    uint64_t len;
+    uint64_t write_gen;
+  };
+  vector<fetch_t> fetches;
+  auto op = std::make_shared<ReadOp>(extents, bl, onfinish);
+
+  if (snap == CEPH_NOSNAP) {
+    for (size_t i = 0; i < extents.size(); ++i) {
+      const ObjectExtent& ex = extents[i];
+      Shard& shard = get_shard(oset, ex.objectno);
+      std::lock_guard l{shard.lock};
+      Object *ob = get_object(shard, oset, ex);
+      uint64_t pos = ex.offset;
+      uint64_t end = ex.offset + ex.length;
+      auto p = ob->extents.upper_bound(pos);
+      if (p != ob->extents.begin()) {
+	--p;
+      }
+      while (pos < end) {
+	if (p != ob->extents.end() && p->first <= pos &&
+	    p->first + p->second.length() > pos) {
+	  // hit
+	  uint64_t hit_end = std::min(end, p->first + p->second.length());
+	  bufferlist& piece = op->pieces[i][pos - ex.offset];
+	  piece.substr_of(p->second.bl, pos - p->first, hit_end - pos);
+	  pos = hit_end;
+	  ++p;
+	} else if (p != ob->extents.end() && p->first <= pos) {
+	  ++p;
+	} else {
+	  uint64_t hole_end =
+	    p == ob->extents.end() ? end : std::min(end, p->first);
+	  fetches.push_back({i, pos - ex.offset, &ex, &shard, pos,
+			     hole_end - pos, ob->write_gen});
+	  ob->pending_io++;
+	  pos = hole_end;
+	}
+      }
+      trim(shard);
+    }
+  } else {
+    for (size_t i = 0; i < extents.size(); ++i) {
+      const ObjectExtent& ex = extents[i];
+      fetches.push_back({i, 0, &ex, nullptr, ex.offset, ex.length, 0});
+    }
+  }
+
+  if (fetches.empty()) {
+    uint64_t r = op->assemble(cct);
+    ldout(cct, 20) << "readx hit " << r << " bytes" << dendl;
+    if (r == 0) {
+      // nothing to read: 0 would otherwise tell the caller to wait
+      onfinish->complete(0);
+    }
+    return r;
+  }
+
+  ldout(cct, 20) << "readx " << fetches.size() << " misses" << dendl;
+  op->pending = fetches.size();
+  for (auto& f : fetches) {
+    auto fin = new C_ReadFinish(this, op, f.idx, f.piece_off, f.shard,
+				f.ex->oloc.pool, f.ex->oid, f.off, f.len,
+				f.write_gen);
+    io_start();
+    writeback_handler.read(f.ex->oid, f.ex->objectno, f.ex->oloc,
+			   f.off, f.len, snap, &fin->bl, f.ex->truncate_size,
+			   oset->truncate_seq, op_flags, {}, fin);
+  }
+  return 0;
+}
+
+void ExtentObjectCacher::read_finish(Shard& shard, int64_t pool,
+				     const object_t& oid, uint64_t off,
+				     bufferlist& bl, uint64_t write_gen)
+{
+  Object *ob = lookup_object(shard, pool, oid);
+  ceph_assert(ob);
+  ob->pending_io--;
+  if (ob->write_gen == write_gen) {
+    // only fill the holes: other reads may have filled parts already
+    fill(shard, ob, off, bl);
+  } else {
+    // a write since the read was issued may have been written back and
+    // trimmed already, leaving a hole the read data is older than
+    ldout(cct, 20) << "read_finish " << oid << " " << off << "~"
+		   << bl.length() << " raced with a write, not caching"
+		   << dendl;
+  }
+  maybe_close_object(shard, ob);
+  trim(shard);
+}
+
+/*** write ***/
+
+int ExtentObjectCacher::writex(const vector<ObjectExtent>& extents,
+			       const SnapContext& snapc, const bufferlist& bl,
+			       ceph::real_time mtime, ObjectSet *oset,
+			       Context *onfinish)
+{
+  vector<write_io_t> ios;
+  C_GatherBuilder gather(cct);
+  bool write_through = (max_dirty == 0);
+  auto now = ceph::coarse_mono_clock::now();
+  for (auto& ex : extents) {
+    Shard& shard = get_shard(oset, ex.objectno);
+    std::lock_guard l{shard.lock};
+    Object *ob = get_object(shard, oset, ex);
+    ob->write_gen++;
+    uint64_t pos = ex.offset;
+    for (auto& [boff, blen] : ex.buffer_extents) {
+      extent_t e{state_t::DIRTY, {}, 0, snapc, mtime, now};
+      e.bl.substr_of(bl, boff, blen);
+      insert(shard, ob, pos, std::move(e));
+      pos += blen;
+    }
+    if (write_through) {
+      flush_object(shard, ob, &gather, &ios);
+    }
+    trim(shard);
+  }
+  issue_writes(ios);
+
+  if (!write_through) {
+    wait_for_writeback(onfinish);
+    return 0;
+  }
+  if (!gather.has_subs()) {
+    if (onfinish) {
+      onfinish->complete(0);
+    }
+    return 0;
+  }
+  if (onfinish) {
+    gather.set_finisher(onfinish);
+    gather.activate();
+    return 0;
+  }
+  C_SaferCond cond;
+  gather.set_finisher(&cond);
+  gather.activate();
+  return cond.wait();
+}
+
+void ExtentObjectCacher::wait_for_writeback(Context *onfinish)
+{
+  if (stat_dirty > target_dirty) {
+    std::unique_lock l{flusher_lock};
+    flusher_cond.notify_all();
+    if (stat_dirty + stat_tx > max_dirty && flusher_thread.is_started() &&
+	!flusher_stop) {
+      ldout(cct, 10) << "wait_for_writeback waiting, dirty " << stat_dirty
+		     << " tx " << stat_tx << " max " << max_dirty << dendl;
+      if (onfinish) {
+	dirty_waiters.push_back(onfinish);
+	return;
+      }
+      dirty_cond.wait(l, [this] {
+	return stat_dirty + stat_tx <= max_dirty || flusher_stop;
+      });
+    }
+  }
+  if (onfinish) {
+    onfinish->complete(0);
+  }
+}
+
+void ExtentObjectCacher::wake_dirty_waiters()
+{
+  std::list<Context*> ls;
+  {
+    std::lock_guard l{flusher_lock};
+    if (stat_dirty + stat_tx > max_dirty && !flusher_stop) {
+      return;
+    }
+    dirty_cond.notify_all();
+    ls.swap(dirty_waiters);
+  }
+  finish_contexts(cct, ls, 0);
+}
+
+void ExtentObjectCacher::set_max_dirty(uint64_t v)
+{
+  max_dirty = v;
+  wake_dirty_waiters();
+}
+
+void ExtentObjectCacher::start_writeback(Shard& shard, Object *ob,
+					 uint64_t off, uint64_t len,
+					 ceph::coarse_mono_time cutoff,
+					 ceph::coarse_mono_time retry_cutoff,
+					 vector<write_io_t> *ios)
+{
+  uint64_t end = off + len;
+  auto p = ob->extents.upper_bound(off);
+  if (p != ob->extents.begin()) {
+    --p;
+  }
+  for (; p != ob->extents.end() && p->first < end; ++p) {
+    extent_t& ex = p->second;
+    if (ex.state != state_t::DIRTY ||
+	ex.dirtied > (ex.failed ? retry_cutoff : cutoff) ||
+	p->first + ex.length() <= off) {
+      continue;
+    }
+    account(shard, ob, ex, -1);
+    ex.state = state_t::TX;
+    ex.tid = ++last_tid;
+    account(shard, ob, ex, 1);
+    ob->pending_io++;
+    ios->push_back({&shard, ob->oid, ob->oloc, p->first, ex.bl, ex.snapc,
+		    ex.mtime, ob->oset->truncate_size,
+		    static_cast<__u32>(ob->oset->truncate_seq), ex.tid});
+  }
+}
+
+void ExtentObjectCacher::issue_writes(vector<write_io_t>& ios)
+{
+  for (auto& io : ios) {
+    ldout(cct, 20) << "issue_write " << io.oid << " " << io.off << "~"
+		   << io.bl.length() << " tid " << io.tid << dendl;
+    io_start();
+    writeback_handler.write(
+      io.oid, io.oloc, io.off, io.bl.length(), io.snapc, io.bl, io.mtime,
+      io.trunc_size, io.trunc_seq, 0, {},
+      new C_WriteCommit(this, io.shard, io.oloc.pool, io.oid, io.tid));
+  }
+  ios.clear();
+}
+
+void ExtentObjectCacher::write_commit(Shard& shard, int64_t pool,
+				      const object_t& oid, ceph_tid_t tid,
+				      int r)
+{
+  vector<Context*> waiters;
+  {
+    std::lock_guard l{shard.lock};
+    Object *ob = lookup_object(shard, pool, oid);
+    ceph_assert(ob);
+    ldout(cct, 20) << "write_commit " << oid << " tid " << tid
+		   << " r = " << r << dendl;
+    auto now = ceph::coarse_mono_clock::now();
+    for (auto& [off, ex] : ob->extents) {
+      if (ex.state != state_t::TX || ex.tid != tid) {
+	continue;
+      }
+      account(shard, ob, ex, -1);
+      if (r < 0) {
+	// leave it dirty, to be retried once it has aged again
+	ex.state = state_t::DIRTY;
+	ex.dirtied = now;
+	ex.failed = true;
+      } else {
+	ex.state = state_t::CLEAN;
+	ex.snapc = SnapContext();
+	ex.failed = false;
+      }
+      ex.tid = 0;
+      account(shard, ob, ex, 1);
+    }
+    merge_all(ob);
+    ob->pending_io--;
+    auto w = ob->tx_waiters.find(tid);
+    if (w != ob->tx_waiters.end()) {
+      waiters.swap(w->second);
+      ob->tx_waiters.erase(w);
+    }
+    if (r < 0) {
+      ldout(cct, 1) << "write_commit " << oid << " tid " << tid
+		    << " failed: " << cpp_strerror(r) << dendl;
+      if (waiters.empty()) {
+	// keep it for the next flush of the set
+	shard.write_errors.emplace(ob->oset, r);
+      }
+    }
+    maybe_close_object(shard, ob);
+    trim(shard);
+  }
+  for (auto c : waiters) {
+    c->complete(r);
+  }
+  wake_dirty_waiters();
+}
+
+/*** flush, trim, release ***/
+
+bool ExtentObjectCacher::flush_object(Shard& shard, Object *ob,
+				      C_GatherBuilder *gather,
+				      vector<write_io_t> *ios)
+{
+  start_writeback(shard, ob, 0, UINT64_MAX, ceph::coarse_mono_time::max(),
+		  ceph::coarse_mono_time::max(), ios);
+  std::set<ceph_tid_t> tids;
+  for (auto& p : ob->extents) {
+    if (p.second.state == state_t::TX) {
+      tids.insert(p.second.tid);
+    }
+  }
+  if (gather) {
+    for (auto tid : tids) {
+      ob->tx_waiters[tid].push_back(gather->new_sub());
+    }
+  }
+  return tids.empty();
+}
+
+void ExtentObjectCacher::finish_flush(C_GatherBuilder& gather,
+				      Context *onfinish, int err)
+{
+  if (!onfinish) {
+    return;
+  }
+  if (err < 0) {
+    onfinish = new LambdaContext([onfinish, err](int r) {
+	onfinish->complete(r < 0 ? r : err);
+      });
+  }
+  if (gather.has_subs()) {
+    gather.set_finisher(onfinish);
+    gather.activate();
+  } else {
+    onfinish->complete(0);
+  }
+}
+
+bool ExtentObjectCacher::flush_set(ObjectSet *oset, Context *onfinish)
+{
+  C_GatherBuilder gather(cct);
+  bool clean = true;
+  int err = 0;
+  size_t num_ios = 0;
+  for (unsigned i = 0; i < num_shards; ++i) {
+    Shard& shard = shards[i];
+    vector<write_io_t> ios;
+    {
+      std::lock_guard l{shard.lock};
+      auto p = shard.set_objects.find(oset);
+      if (p != shard.set_objects.end()) {
+	for (auto ob : p->second) {
+	  if (!flush_object(shard, ob, onfinish ? &gather : nullptr, &ios)) {
+	    clean = false;
+	  }
+	}
+      }
+      auto e = shard.write_errors.find(oset);
+      if (onfinish && e != shard.write_errors.end()) {
+	if (err == 0) {
+	  err = e->second;
+	}
+	shard.write_errors.erase(e);
+      }
+    }
+    num_ios += ios.size();
+    issue_writes(ios);
+  }
+  ldout(cct, 10) << "flush_set " << oset->ino << " wrote " << num_ios
+		 << " extents, err " << err << dendl;
+  finish_flush(gather, onfinish, err);
+  return clean;
+}
+
+bool ExtentObjectCacher::flush_all(Context *onfinish)
+{
+  C_GatherBuilder gather(cct);
+  bool clean = true;
+  int err = 0;
+  for (unsigned i = 0; i < num_shards; ++i) {
+    Shard& shard = shards[i];
+    vector<write_io_t> ios;
+    {
+      std::lock_guard l{shard.lock};
+      for (auto& p : shard.objects) {
+	if (!flush_object(shard, p.second.get(),
+			  onfinish ? &gather : nullptr, &ios)) {
+	  clean = false;
+	}
+      }
+      if (onfinish) {
+	for (auto& [oset, r] : shard.write_errors) {
+	  if (err == 0) {
+	    err = r;
+	  }
+	}
+	shard.write_errors.clear();
+      }
+    }
+    issue_writes(ios);
+  }
+  finish_flush(gather, onfinish, err);
+  return clean;
+}
+
+void ExtentObjectCacher::trim(Shard& shard)
+{
+  // each shard trims its own objects, oldest first, until the cache as
+  // a whole is back under max_bytes.  Only clean data can go, so stop
+  // once this shard has none left (the rest is up to the other
+  // shards) or after TRIM_MAX_SCAN objects.  Objects that stay (dirty,
+  // or with I/O in flight) move to the front, so the next call does not
+  // scan them again.
+  unsigned scanned = 0;
+  while (stat_clean + stat_dirty + stat_tx > max_bytes &&
+	 shard.clean_bytes > 0 && !shard.lru.empty() &&
+	 scanned++ < TRIM_MAX_SCAN) {
+    Object *ob = shard.lru.back();
+    for (auto q = ob->extents.begin(); q != ob->extents.end(); ) {
+      if (q->second.state == state_t::CLEAN) {
+	account(shard, ob, q->second, -1);
+	q = ob->extents.erase(q);
+      } else {
+	++q;
+      }
+    }
+    if (!maybe_close_object(shard, ob)) {
+      touch(shard, ob);
+    }
+  }
+}
+
+uint64_t ExtentObjectCacher::release_set(ObjectSet *oset)
+{
+  uint64_t unclean = 0;
+  for (unsigned i = 0; i < num_shards; ++i) {
+    Shard& shard = shards[i];
+    std::lock_guard l{shard.lock};
+    auto p = shard.set_objects.find(oset);
+    if (p == shard.set_objects.end()) {
+      continue;
+    }
+    vector<Object*> obs(p->second.begin(), p->second.end());
+    for (auto ob : obs) {
+      for (auto q = ob->extents.begin(); q != ob->extents.end(); ) {
+	if (q->second.state == state_t::CLEAN) {
+	  account(shard, ob, q->second, -1);
+	  q = ob->extents.erase(q);
+	} else {
+	  unclean += q->second.length();
+	  ++q;
+	}
+      }
+      maybe_close_object(shard, ob);
+    }
+  }
+  ldout(cct, 10) << "release_set " << oset->ino << " unclean " << unclean
+		 << dendl;
+  return unclean;
+}
+
+void ExtentObjectCacher::purge_set(ObjectSet *oset)
+{
+  ldout(cct, 10) << "purge_set " << oset->ino << dendl;
+  for (unsigned i = 0; i < num_shards; ++i) {
+    Shard& shard = shards[i];
+    std::lock_guard l{shard.lock};
+    shard.write_errors.erase(oset);
+    auto p = shard.set_objects.find(oset);
+    if (p == shard.set_objects.end()) {
+      continue;
+    }
+    vector<Object*> obs(p->second.begin(), p->second.end());
+    for (auto ob : obs) {
+      discard(shard, ob, 0, UINT64_MAX, nullptr);
+      maybe_close_object(shard, ob);
+    }
+  }
+  wake_dirty_waiters();
+}
+
+void ExtentObjectCacher::discard(Shard& shard, Object *ob, uint64_t off,
+				 uint64_t len, C_GatherBuilder *gather)
+{
+  uint64_t end = len > UINT64_MAX - off ? UINT64_MAX : off + len;
+  // reads in flight must not fill the range back in
+  ob->write_gen++;
+  if (gather) {
+    std::set<ceph_tid_t> tids;
+    for (auto& [eoff, ex] : ob->extents) {
+      if (ex.state == state_t::TX && eoff < end &&
+	  eoff + ex.length() > off) {
+	tids.insert(ex.tid);
+      }
+    }
+    for (auto tid : tids) {
+      ob->tx_waiters[tid].push_back(gather->new_sub());
+    }
+  }
+  punch(shard, ob, off, end - off);
+}
+
+void ExtentObjectCacher::discard_extents(ObjectSet *oset,
+					 const vector<ObjectExtent>& extents,
+					 C_GatherBuilder *gather, bool locked)
+{
+  for (auto& ex : extents) {
+    Shard& shard = get_shard(oset, ex.objectno);
+    std::unique_lock l{shard.lock, std::defer_lock};
+    if (!locked) {
+      l.lock();
+    }
+    Object *ob = lookup_object(shard, ex.oloc.pool, ex.oid);
+    if (!ob) {
+      continue;
+    }
+    ldout(cct, 20) << "discard " << ex.oid << " " << ex.offset << "~"
+		   << ex.length << dendl;
+    discard(shard, ob, ex.offset, ex.length, gather);
+    maybe_close_object(shard, ob);
+  }
+}
+
+void ExtentObjectCacher::discard_set(ObjectSet *oset,
+				     const vector<ObjectExtent>& extents)
+{
+  discard_extents(oset, extents, nullptr, false);
+  wake_dirty_waiters();
+}
+
+void ExtentObjectCacher::discard_writeback(ObjectSet *oset,
+					   const vector<ObjectExtent>& extents,
+					   Context *on_finish)
+{
+  C_GatherBuilder gather(cct);
+  discard_extents(oset, extents, &gather, false);
+  wake_dirty_waiters();
+  if (gather.has_subs()) {
+    gather.set_finisher(on_finish);
+    gather.activate();
+  } else {
+    on_finish->complete(0);
+  }
+}
+
+void ExtentObjectCacher::truncate_set(ObjectSet *oset, uint64_t truncate_seq,
+				      uint64_t truncate_size,
+				      const vector<ObjectExtent>& extents)
+{
+  ldout(cct, 10) << "truncate_set " << oset->ino << " seq " << truncate_seq
+		 << " size " << truncate_size << dendl;
+  {
+    // the truncate fields are read under the shard locks when writes
+    // are started, and no write may carry the new ones with data that
+    // is about to be dropped
+    vector<std::unique_lock<ceph::mutex>> locks;
+    locks.reserve(num_shards);
+    for (unsigned i = 0; i < num_shards; ++i) {
+      locks.emplace_back(shards[i].lock);
+    }
+    oset->truncate_seq = truncate_seq;
+    oset->truncate_size = truncate_size;
+    discard_extents(oset, extents, nullptr, true);
+  }
+  wake_dirty_waiters();
+}
+
+bool ExtentObjectCacher::set_is_empty(ObjectSet *oset)
+{
+  for (unsigned i = 0; i < num_shards; ++i) {
+    Shard& shard = shards[i];
+    std::lock_guard l{shard.lock};
+    if (shard.set_objects.count(oset)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*** flusher ***/
+
+void ExtentObjectCacher::flusher_entry()
+{
+  ldout(cct, 10) << "flusher start" << dendl;
+  std::unique_lock l{flusher_lock};
+  while (!flusher_stop) {
+    l.unlock();
+    auto cutoff = ceph::coarse_mono_clock::now() - max_dirty_age;
+    for (unsigned i = 0; i < num_shards; ++i) {
+      Shard& shard = shards[i];
+      vector<write_io_t> ios;
+      {
+	std::lock_guard sl{shard.lock};
+	vector<Object*> dirty(shard.dirty_objects.begin(),
+			      shard.dirty_objects.end());
+	for (auto ob : dirty) {
+	  // over target: write back everything, otherwise just what
+	  // has aged out.  Failed writes are retried only once aged.
+	  auto c = stat_dirty > target_dirty ?
+	    ceph::coarse_mono_time::max() : cutoff;
+	  start_writeback(shard, ob, 0, UINT64_MAX, c, cutoff, &ios);
+	}
+      }
+      issue_writes(ios);
+    }
+    l.lock();
+    if (flusher_stop) {
+      break;
+    }
+    flusher_cond.wait_for(l, std::chrono::seconds(1));
+  }
+  ldout(cct, 10) << "flusher finish" << dendl;
+}
+
+void ExtentObjectCacher::io_start()
+{
+  std::lock_guard l{inflight_lock};
+  ++inflight;
+}
+
+void ExtentObjectCacher::io_finish()
+{
+  std::lock_guard l{inflight_lock};
+  if (--inflight == 0) {
+    inflight_cond.notify_all();
+  }
+}
@@ -0,0 +1,313 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#ifndef CEPH_OSDC_EXTENTOBJECTCACHER_H
+#define CEPH_OSDC_EXTENTOBJECTCACHER_H
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/Thread.h"
+#include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
+#include "common/snap_types.h"
+#include "include/Context.h"
+#include "include/types.h"
+#include "osd/osd_types.h"
+
+#include "WritebackHandler.h"
+
+/**
+ * ExtentObjectCacher
+ *
+ * A writeback object cache, driven by the same WritebackHandler as
+ * ObjectCacher, built for many concurrent callers.
+ *
+ * Each cached object keeps its data as a map of non-overlapping
+ * extents, ordered by offset.  Adjacent extents in the same state are
+ * merged as they are inserted, so a stream of small sequential writes
+ * or reads ends up as a handful of extents rather than one buffer
+ * head each, and lookups are logarithmic in the number of extents.
+ *
+ * Objects are hashed onto shards by object set and object number, each
+ * shard with its own lock, object table and LRU, so I/O to different
+ * objects of a file or image does not serialize on one cache lock.
+ * Callers do not hold any lock; the WritebackHandler is never called
+ * with a shard lock held and its completions may run in any thread.
+ *
+ * A failed writeback leaves its data dirty.  The error goes to whoever
+ * waits for that write (flush_set(), a write-through writex()), or if
+ * nobody does, to the next flush_set() or flush_all() of the set.  The
+ * flusher retries failed data only once it is max_dirty_age old again.
+ *
+ * Reads of snapshots bypass the cache.
+ */
+class ExtentObjectCacher {
+public:
+  struct ObjectSet {
+    inodeno_t ino;
+    int64_t poolid;
+    uint64_t truncate_seq = 0;
+    uint64_t truncate_size = 0;
+
+    ObjectSet(int64_t poolid, inodeno_t ino)
+      : ino(ino), poolid(poolid) {}
+  };
+
+  ExtentObjectCacher(CephContext *cct, std::string name,
+		     WritebackHandler& wb,
+		     uint64_t max_bytes, uint64_t max_dirty,
+		     uint64_t target_dirty, double max_dirty_age,
+		     unsigned num_shards);
+  ~ExtentObjectCacher();
+
+  void start();
+  void stop();
+
+  /**
+   * read the given object extents into *bl
+   *
+   * @return the number of bytes read if everything was cached, in
+   * which case onfinish is untouched (as with ObjectCacher, the caller
+   * must complete or delete it); otherwise 0, and onfinish is
+   * completed with the number of bytes read or a negative error.  A
+   * read of nothing completes onfinish with 0.
+   */
+  int readx(const std::vector<ObjectExtent>& extents, snapid_t snap,
+	    ceph::buffer::list *bl, ObjectSet *oset, Context *onfinish,
+	    int op_flags = 0);
+
+  /**
+   * buffer a write of bl, mapped onto the object extents
+   *
+   * Without onfinish, blocks while the cache is over its dirty limit,
+   * and with a zero dirty limit writes the data through, returning
+   * once it has committed.  With onfinish, never blocks: onfinish is
+   * completed instead when this call would have returned.
+   */
+  int writex(const std::vector<ObjectExtent>& extents,
+	     const SnapContext& snapc, const ceph::buffer::list& bl,
+	     ceph::real_time mtime, ObjectSet *oset,
+	     Context *onfinish = nullptr);
+
+  /**
+   * write back all dirty data in oset
+   *
+   * onfinish, if any, is completed once everything dirty or being
+   * written back at the time of the call has committed, with the
+   * first error of those writes or of an earlier writeback of oset
+   * that nobody waited for.
+   *
+   * @return true if nothing in oset was dirty or being written back
+   */
+  bool flush_set(ObjectSet *oset, Context *onfinish = nullptr);
+  bool flush_all(Context *onfinish = nullptr);
+
+  /// drop clean data for oset; returns bytes that could not be released
+  uint64_t release_set(ObjectSet *oset);
+
+  /// drop all data for oset, dirty or not, without writing it back
+  void purge_set(ObjectSet *oset);
+
+  /// drop all data in the extents, dirty or not
+  void discard_set(ObjectSet *oset, const std::vector<ObjectExtent>& extents);
+
+  /**
+   * drop all data in the extents, dirty or not, and complete on_finish
+   * once writes of the extents that are already in flight commit
+   */
+  void discard_writeback(ObjectSet *oset,
+			 const std::vector<ObjectExtent>& extents,
+			 Context *on_finish);
+
+  /**
+   * set oset's truncate_seq and truncate_size, and drop all data in the
+   * extents, i.e. the parts of oset past the new size
+   *
+   * Writes issued from now on carry the new truncate_seq.
+   */
+  void truncate_set(ObjectSet *oset, uint64_t truncate_seq,
+		    uint64_t truncate_size,
+		    const std::vector<ObjectExtent>& extents);
+
+  bool set_is_empty(ObjectSet *oset);
+
+  void set_max_dirty(uint64_t v);
+
+  uint64_t get_stat_clean() const { return stat_clean; }
+  uint64_t get_stat_dirty() const { return stat_dirty; }
+  uint64_t get_stat_tx() const { return stat_tx; }
+  unsigned get_num_shards() const { return num_shards; }
+
+private:
+  enum class state_t : uint8_t {
+    CLEAN,
+    DIRTY,
+    TX,     ///< being written back
+  };
+
+  struct extent_t {
+    state_t state;
+    ceph::buffer::list bl;
+    ceph_tid_t tid = 0;             ///< write tid, while TX
+    SnapContext snapc;              ///< dirty/tx only
+    ceph::real_time mtime;          ///< dirty/tx only
+    ceph::coarse_mono_time dirtied; ///< dirty only
+    bool failed = false;            ///< dirty again after a failed write
+
+    uint64_t length() const {
+      return bl.length();
+    }
+  };
+
+  struct Object {
+    object_t oid;
+    uint64_t object_no;
+    object_locator_t oloc;
+    ObjectSet *oset;
+    std::map<uint64_t, extent_t> extents;  ///< offset -> extent
+    uint64_t dirty_bytes = 0;
+    unsigned pending_io = 0;
+    /// bumped by every write, so reads issued before it do not fill
+    uint64_t write_gen = 0;
+    /// commit waiters, by write tid
+    std::map<ceph_tid_t, std::vector<Context*>> tx_waiters;
+    std::list<Object*>::iterator lru_pos;
+
+    Object(const object_t& oid, uint64_t object_no,
+	   const object_locator_t& oloc, ObjectSet *oset)
+      : oid(oid), object_no(object_no), oloc(oloc), oset(oset) {}
+  };
+
+  struct Shard {
+    ceph::mutex lock = ceph::make_mutex("ExtentObjectCacher::Shard::lock");
+    std::map<std::pair<int64_t, object_t>, std::unique_ptr<Object>> objects;
+    std::map<ObjectSet*, std::set<Object*>> set_objects;
+    std::set<Object*> dirty_objects;
+    std::list<Object*> lru;  ///< most recently used first
+    uint64_t clean_bytes = 0;
+    /// first failed writeback per set that nobody waited for
+    std::map<ObjectSet*, int> write_errors;
+  };
+
+  /// objects trim() looks at per call, so it stays cheap under the lock
+  static constexpr unsigned TRIM_MAX_SCAN = 128;
+
+  /// a write to issue once the shard lock is dropped
+  struct write_io_t {
+    Shard *shard;
+    object_t oid;
+    object_locator_t oloc;
+    uint64_t off;
+    ceph::buffer::list bl;
+    SnapContext snapc;
+    ceph::real_time mtime;
+    uint64_t trunc_size;
+    __u32 trunc_seq;
+    ceph_tid_t tid;
+  };
+
+  struct ReadOp;
+  class C_ReadFinish;
+  class C_WriteCommit;
+
+  CephContext *cct;
+  std::string name;
+  WritebackHandler& writeback_handler;
+  uint64_t max_bytes;
+  std::atomic<uint64_t> max_dirty;
+  uint64_t target_dirty;
+  ceph::timespan max_dirty_age;
+  const unsigned num_shards;
+  std::unique_ptr<Shard[]> shards;
+
+  std::atomic<uint64_t> stat_clean = {0};
+  std::atomic<uint64_t> stat_dirty = {0};
+  std::atomic<uint64_t> stat_tx = {0};
+  std::atomic<ceph_tid_t> last_tid = {0};
+
+  ceph::mutex inflight_lock =
+    ceph::make_mutex("ExtentObjectCacher::inflight_lock");
+  ceph::condition_variable inflight_cond;
+  uint64_t inflight = 0;
+
+  ceph::mutex flusher_lock =
+    ceph::make_mutex("ExtentObjectCacher::flusher_lock");
+  ceph::condition_variable flusher_cond;
+  ceph::condition_variable dirty_cond;  ///< writers throttled on max_dirty
+  std::list<Context*> dirty_waiters;    ///< async writers throttled
+  bool flusher_stop = false;
+  void flusher_entry();
+  class FlusherThread : public Thread {
+    ExtentObjectCacher *oc;
+  public:
+    explicit FlusherThread(ExtentObjectCacher *o) : oc(o) {}
+    void *entry() override {
+      oc->flusher_entry();
+      return 0;
+    }
+  } flusher_thread;
+
+  Shard& get_shard(const ObjectSet *oset, uint64_t object_no);
+  Object *get_object(Shard& shard, ObjectSet *oset, const ObjectExtent& ex);
+  Object *lookup_object(Shard& shard, int64_t pool, const object_t& oid);
+  void touch(Shard& shard, Object *ob);
+  bool maybe_close_object(Shard& shard, Object *ob);
+
+  /// add (sign > 0) or remove ex from the stats
+  void account(Shard& shard, Object *ob, const extent_t& ex, int sign);
+
+  /// remove [off, off+len) from ob's extents, splitting at the edges
+  void punch(Shard& shard, Object *ob, uint64_t off, uint64_t len);
+  /// insert ex at off, replacing whatever is there, then merge
+  void insert(Shard& shard, Object *ob, uint64_t off, extent_t&& ex);
+  /// insert clean data only into the holes of [off, off+bl.length())
+  void fill(Shard& shard, Object *ob, uint64_t off,
+	    const ceph::buffer::list& bl);
+  void try_merge(Object *ob, std::map<uint64_t, extent_t>::iterator p);
+  static void merge_all(Object *ob);
+  static bool can_merge(const extent_t& a, const extent_t& b);
+
+  /// drop [off, off+len) of ob; gather, if any, waits for its writes
+  void discard(Shard& shard, Object *ob, uint64_t off, uint64_t len,
+	       C_GatherBuilder *gather);
+  void discard_extents(ObjectSet *oset,
+		       const std::vector<ObjectExtent>& extents,
+		       C_GatherBuilder *gather, bool locked);
+
+  /**
+   * mark dirty extents in [off, off+len) of ob TX and queue their writes
+   *
+   * Only extents dirtied before cutoff are written, or for extents
+   * whose last write failed, before retry_cutoff.
+   */
+  void start_writeback(Shard& shard, Object *ob, uint64_t off, uint64_t len,
+		       ceph::coarse_mono_time cutoff,
+		       ceph::coarse_mono_time retry_cutoff,
+		       std::vector<write_io_t> *ios);
+  void issue_writes(std::vector<write_io_t>& ios);
+  void write_commit(Shard& shard, int64_t pool, const object_t& oid,
+		    ceph_tid_t tid, int r);
+  void read_finish(Shard& shard, int64_t pool, const object_t& oid,
+		   uint64_t off, ceph::buffer::list& bl, uint64_t write_gen);
+
+  void trim(Shard& shard);
+  /// start writeback of ob and make gather, if any, wait for its writes
+  bool flush_object(Shard& shard, Object *ob, C_GatherBuilder *gather,
+		    std::vector<write_io_t> *ios);
+  /// complete onfinish once gather completes, reporting err if it did not fail
+  static void finish_flush(C_GatherBuilder& gather, Context *onfinish,
+			   int err);
+  /// throttle a writer while over max_dirty
+  void wait_for_writeback(Context *onfinish);
+  void wake_dirty_waiters();
+
+  void io_start();
+  void io_finish();
+};
+
+#endif
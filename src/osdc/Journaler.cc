@@ -94,7 +94,21 @@ void Journaler::_set_layout(file_layout_t const *l)
 
   // prefetch intelligently.
   // (watch out, this is big if you use big objects or weird striping)
-  uint64_t periods = cct->_conf.get_val<uint64_t>("journaler_prefetch_periods");
+  uint64_t periods = prefetch_periods;
+  if (!periods) {
+    periods = cct->_conf.get_val<uint64_t>("journaler_prefetch_periods");
+  }
+  fetch_len = layout.get_period() * periods;
+}
+
+void Journaler::set_prefetch_periods(uint64_t periods)
+{
+  lock_guard l(lock);
+  ldout(cct, 10) << __func__ << " " << periods << dendl;
+  prefetch_periods = periods;
+  if (!periods) {
+    periods = cct->_conf.get_val<uint64_t>("journaler_prefetch_periods");
+  }
   fetch_len = layout.get_period() * periods;
 }
 
@@ -334,6 +334,7 @@ private:
 
   uint64_t fetch_len;     // how much to read at a time
   uint64_t temp_fetch_len;
+  uint64_t prefetch_periods = 0; // override journaler_prefetch_periods
 
   // for wait_for_readable()
   C_OnFinisher *on_readable;
@@ -508,6 +509,13 @@ public:
   void set_write_iohint(uint32_t iohint_flags) {
     write_iohint = iohint_flags;
   }
+  /**
+   * Read up to this many layout periods ahead of read_pos instead of
+   * journaler_prefetch_periods.  Each object in the window is read
+   * with its own request, so a larger window means more reads in
+   * flight.  0 restores the configured value.
+   */
+  void set_prefetch_periods(uint64_t periods);
   /**
    * Cause any ongoing waits to error out with -EAGAIN, set error
    * to -EAGAIN.
@@ -28,6 +28,7 @@
 
 #include "messages/MPing.h"
 #include "messages/MOSDOp.h"
+#include "messages/MOSDOpBatch.h"
 #include "messages/MOSDOpReply.h"
 #include "messages/MOSDBackoff.h"
 #include "messages/MOSDMap.h"
@@ -174,6 +175,9 @@ enum {
   l_osdc_osdop_omap_rd,
   l_osdc_osdop_omap_del,
 
+  l_osdc_op_batch,
+  l_osdc_op_batch_ops,
+
   l_osdc_last,
 };
 
@@ -213,6 +217,10 @@ const char** Objecter::get_tracked_conf_keys() const
     "crush_location",
     "rados_mon_op_timeout",
     "rados_osd_op_timeout",
+    "objecter_op_batch_window_us",
+    "objecter_op_batch_max_ops",
+    "objecter_op_batch_max_op_bytes",
+    "objecter_op_batch_min_inflight",
     NULL
   };
   return config_keys;
@@ -231,6 +239,21 @@ void Objecter::handle_conf_change(const ConfigProxy& conf,
   if (changed.count("rados_osd_op_timeout")) {
     osd_timeout = conf.get_val<std::chrono::seconds>("rados_osd_op_timeout");
   }
+  if (changed.count("objecter_op_batch_window_us")) {
+    op_batch_window = std::chrono::microseconds(
+      conf.get_val<uint64_t>("objecter_op_batch_window_us"));
+  }
+  if (changed.count("objecter_op_batch_max_ops")) {
+    op_batch_max_ops = conf.get_val<uint64_t>("objecter_op_batch_max_ops");
+  }
+  if (changed.count("objecter_op_batch_max_op_bytes")) {
+    op_batch_max_op_bytes =
+      conf.get_val<Option::size_t>("objecter_op_batch_max_op_bytes");
+  }
+  if (changed.count("objecter_op_batch_min_inflight")) {
+    op_batch_min_inflight =
+      conf.get_val<uint64_t>("objecter_op_batch_min_inflight");
+  }
 }
 
 void Objecter::update_crush_location()
@@ -257,6 +280,10 @@ void Objecter::init()
     pcb.add_u64_counter(l_osdc_op_send, "op_send", "Sent operations");
     pcb.add_u64_counter(l_osdc_op_send_bytes, "op_send_bytes", "Sent data", NULL, 0, unit_t(UNIT_BYTES));
     pcb.add_u64_counter(l_osdc_op_resend, "op_resend", "Resent operations");
+    pcb.add_u64_counter(l_osdc_op_batch, "op_batch",
+			"Operation batch messages sent");
+    pcb.add_u64_counter(l_osdc_op_batch_ops, "op_batch_ops",
+			"Operations sent in batch messages");
     pcb.add_u64_counter(l_osdc_op_reply, "op_reply", "Operation reply");
     pcb.add_u64_avg(l_osdc_oplen_avg, "oplen_avg", "Average length of operation vector");
 
@@ -526,7 +553,7 @@ void Objecter::shutdown()
 }
 
 void Objecter::_send_linger(LingerOp *info,
-			    ceph::shunique_lock<ceph::shared_mutex>& sul)
+			    ceph::shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   ceph_assert(sul.owns_lock() && sul.mutex() == &rwlock);
 
@@ -860,7 +887,7 @@ ceph_tid_t Objecter::linger_notify(LingerOp *info,
 }
 
 void Objecter::_linger_submit(LingerOp *info,
-			      ceph::shunique_lock<ceph::shared_mutex>& sul)
+			      ceph::shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   ceph_assert(sul.owns_lock() && sul.mutex() == &rwlock);
   ceph_assert(info->linger_id);
@@ -1023,7 +1050,7 @@ void Objecter::_scan_requests(
   map<ceph_tid_t, Op*>& need_resend,
   list<LingerOp*>& need_resend_linger,
   map<ceph_tid_t, CommandOp*>& need_resend_command,
-  ceph::shunique_lock<ceph::shared_mutex>& sul)
+  ceph::shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   ceph_assert(sul.owns_lock() && sul.mutex() == &rwlock);
 
@@ -1761,7 +1788,7 @@ void Objecter::_command_cancel_map_check(CommandOp *c)
  * promotion to write.
  */
 int Objecter::_get_session(int osd, OSDSession **session,
-			   shunique_lock<ceph::shared_mutex>& sul)
+			   shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   ceph_assert(sul && sul.mutex() == &rwlock);
 
@@ -1825,6 +1852,7 @@ void Objecter::_reopen_session(OSDSession *s)
   auto addrs = osdmap->get_addrs(s->osd);
   ldout(cct, 10) << "reopen_session osd." << s->osd << " session, addr now "
 		 << addrs << dendl;
+  _discard_op_batches(s);
   if (s->con) {
     s->con->set_priv(NULL);
     s->con->mark_down();
@@ -1847,6 +1875,7 @@ void Objecter::close_session(OSDSession *s)
     logger->inc(l_osdc_osd_session_close);
   }
   unique_lock sl(s->lock);
+  _discard_op_batches(s);
 
   std::list<LingerOp*> homeless_lingers;
   std::list<CommandOp*> homeless_commands;
@@ -1916,7 +1945,7 @@ void Objecter::wait_for_osd_map(epoch_t e)
 
 void Objecter::_get_latest_version(epoch_t oldest, epoch_t newest,
 				   std::unique_ptr<OpCompletion> fin,
-				   std::unique_lock<ceph::shared_mutex>&& l)
+				   std::unique_lock<ceph::sharded_shared_mutex>&& l)
 {
   ceph_assert(fin);
   if (osdmap->get_epoch() >= newest) {
@@ -2038,7 +2067,7 @@ void Objecter::_kick_requests(OSDSession *session,
 }
 
 void Objecter::_linger_ops_resend(map<uint64_t, LingerOp *>& lresend,
-				  unique_lock<ceph::shared_mutex>& ul)
+				  unique_lock<ceph::sharded_shared_mutex>& ul)
 {
   ceph_assert(ul.owns_lock());
   shunique_lock sul(std::move(ul));
@@ -2199,7 +2228,7 @@ void Objecter::op_submit(Op *op, ceph_tid_t *ptid, int *ctx_budget)
 }
 
 void Objecter::_op_submit_with_budget(Op *op,
-				      shunique_lock<ceph::shared_mutex>& sul,
+				      shunique_lock<ceph::sharded_shared_mutex>& sul,
 				      ceph_tid_t *ptid,
 				      int *ctx_budget)
 {
@@ -2303,7 +2332,7 @@ void Objecter::_send_op_account(Op *op)
   }
 }
 
-void Objecter::_op_submit(Op *op, shunique_lock<ceph::shared_mutex>& sul, ceph_tid_t *ptid)
+void Objecter::_op_submit(Op *op, shunique_lock<ceph::sharded_shared_mutex>& sul, ceph_tid_t *ptid)
 {
   // rwlock is locked
 
@@ -2922,7 +2951,7 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
 }
 
 int Objecter::_map_session(op_target_t *target, OSDSession **s,
-			   shunique_lock<ceph::shared_mutex>& sul)
+			   shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   _calc_target(target, nullptr);
   return _get_session(target->osd, s, sul);
@@ -3029,7 +3058,7 @@ void Objecter::_session_command_op_assign(OSDSession *to, CommandOp *op)
 }
 
 int Objecter::_recalc_linger_op_target(LingerOp *linger_op,
-				       shunique_lock<ceph::shared_mutex>& sul)
+				       shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   // rwlock is locked unique
 
@@ -3224,9 +3253,142 @@ void Objecter::_send_op(Op *op)
   if (op->trace.valid()) {
     m->trace.init("op msg", nullptr, &op->trace);
   }
+  if (_maybe_batch_op(op, m)) {
+    return;
+  }
   op->session->con->send_message(m);
 }
 
+bool Objecter::_maybe_batch_op(Op *op, MOSDOp *m)
+{
+  // rwlock is locked
+  // op->session->lock is locked unique
+
+  OSDSession *s = op->session;
+  if (op_batch_window == timespan::zero() ||
+      !s->con->has_features(CEPH_FEATUREMASK_OSD_OP_BATCH)) {
+    return false;
+  }
+
+  const spg_t& pgid = op->target.actual_pgid;
+  auto p = s->op_batches.find(pgid);
+  uint64_t bytes = 0;
+  for (auto& o : m->ops) {
+    bytes += o.indata.length();
+  }
+  if (bytes > op_batch_max_op_bytes) {
+    // too big to be worth holding; flush anything queued ahead of it
+    // for this pg so that ordering is preserved
+    if (p != s->op_batches.end()) {
+      _flush_op_batch(s, pgid);
+    }
+    return false;
+  }
+  if (p == s->op_batches.end()) {
+    // only start holding ops back once the session is busy; a lone op
+    // would just pay the window in latency
+    if (s->ops.size() < op_batch_min_inflight) {
+      return false;
+    }
+    p = s->op_batches.emplace(pgid, std::vector<OSDSession::batched_op_t>{}).first;
+    p->second.reserve(op_batch_max_ops);
+  }
+
+  ldout(cct, 20) << __func__ << " " << op->tid << " to " << pgid
+		 << " on osd." << s->osd << ", " << p->second.size()
+		 << " already queued" << dendl;
+  p->second.push_back({op->tid, m->get_retry_attempt(), m});
+  if (p->second.size() >= op_batch_max_ops) {
+    _flush_op_batch(s, pgid);
+  } else if (!s->op_batch_event) {
+    int osd = s->osd;
+    s->op_batch_event = timer.add_event(op_batch_window,
+					[this, osd]() {
+					  flush_op_batches(osd); });
+  }
+  return true;
+}
+
+void Objecter::_flush_op_batch(OSDSession *s, spg_t pgid)
+{
+  // rwlock is locked
+  // s->lock is locked unique
+
+  auto p = s->op_batches.find(pgid);
+  ceph_assert(p != s->op_batches.end());
+  std::vector<MOSDOp*> ms;
+  ms.reserve(p->second.size());
+  for (auto& b : p->second) {
+    auto i = s->ops.find(b.tid);
+    if (i == s->ops.end() || i->second->attempts != b.attempt + 1) {
+      ldout(cct, 20) << __func__ << " dropping stale " << b.tid << dendl;
+      b.m->put();
+      continue;
+    }
+    ms.push_back(b.m);
+  }
+  s->op_batches.erase(p);
+
+  if (ms.size() <= 1 ||
+      !s->con->has_features(CEPH_FEATUREMASK_OSD_OP_BATCH)) {
+    for (auto m : ms) {
+      s->con->send_message(m);
+    }
+    return;
+  }
+
+  ldout(cct, 15) << __func__ << " " << ms.size() << " ops to " << pgid
+		 << " on osd." << s->osd << dendl;
+  auto batch = new MOSDOpBatch(pgid);
+  uint64_t features = s->con->get_features();
+  for (auto m : ms) {
+    batch->add_op(m, features);
+    m->put();
+  }
+  logger->inc(l_osdc_op_batch);
+  logger->inc(l_osdc_op_batch_ops, ms.size());
+  s->con->send_message(batch);
+}
+
+void Objecter::_flush_op_batches(OSDSession *s)
+{
+  // rwlock is locked
+  // s->lock is locked unique
+
+  while (!s->op_batches.empty()) {
+    _flush_op_batch(s, s->op_batches.begin()->first);
+  }
+}
+
+void Objecter::_discard_op_batches(OSDSession *s)
+{
+  // s->lock is locked unique
+
+  if (s->op_batch_event) {
+    timer.cancel_event(s->op_batch_event);
+    s->op_batch_event = 0;
+  }
+  for (auto& [pgid, batch] : s->op_batches) {
+    for (auto& b : batch) {
+      b.m->put();
+    }
+  }
+  s->op_batches.clear();
+}
+
+void Objecter::flush_op_batches(int osd)
+{
+  shared_lock rl(rwlock);
+  auto p = osd_sessions.find(osd);
+  if (p == osd_sessions.end()) {
+    return;
+  }
+  OSDSession *s = p->second;
+  unique_lock sl(s->lock);
+  s->op_batch_event = 0;
+  _flush_op_batches(s);
+}
+
 int Objecter::calc_op_budget(const bc::small_vector_base<OSDOp>& ops)
 {
   int op_budget = 0;
@@ -3246,7 +3408,7 @@ int Objecter::calc_op_budget(const bc::small_vector_base<OSDOp>& ops)
 }
 
 void Objecter::_throttle_op(Op *op,
-			    shunique_lock<ceph::shared_mutex>& sul,
+			    shunique_lock<ceph::sharded_shared_mutex>& sul,
 			    int op_budget)
 {
   ceph_assert(sul && sul.mutex() == &rwlock);
@@ -4759,7 +4921,7 @@ void Objecter::submit_command(CommandOp *c, ceph_tid_t *ptid)
 }
 
 int Objecter::_calc_command_target(CommandOp *c,
-				   shunique_lock<ceph::shared_mutex>& sul)
+				   shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   ceph_assert(sul.owns_lock() && sul.mutex() == &rwlock);
 
@@ -4815,7 +4977,7 @@ int Objecter::_calc_command_target(CommandOp *c,
 }
 
 void Objecter::_assign_command_session(CommandOp *c,
-				       shunique_lock<ceph::shared_mutex>& sul)
+				       shunique_lock<ceph::sharded_shared_mutex>& sul)
 {
   ceph_assert(sul.owns_lock() && sul.mutex() == &rwlock);
 
@@ -4911,6 +5073,13 @@ Objecter::Objecter(CephContext *cct,
 {
   mon_timeout = cct->_conf.get_val<std::chrono::seconds>("rados_mon_op_timeout");
   osd_timeout = cct->_conf.get_val<std::chrono::seconds>("rados_osd_op_timeout");
+  op_batch_window = std::chrono::microseconds(
+    cct->_conf.get_val<uint64_t>("objecter_op_batch_window_us"));
+  op_batch_max_ops = cct->_conf.get_val<uint64_t>("objecter_op_batch_max_ops");
+  op_batch_max_op_bytes =
+    cct->_conf.get_val<Option::size_t>("objecter_op_batch_max_op_bytes");
+  op_batch_min_inflight =
+    cct->_conf.get_val<uint64_t>("objecter_op_batch_min_inflight");
 }
 
 Objecter::~Objecter()
@@ -73,6 +73,10 @@ class Module(MgrModule):
                     inos = self.get_latest("mds", info['name'], "mds_mem.ino")
                     dirs = self.get_latest("mds", info['name'], "mds_mem.dir")
                     caps = self.get_latest("mds", info['name'], "mds_mem.cap")
+                    purge_items = self.get_latest("mds", info['name'],
+                                                  "purge_queue.pq_item_in_journal")
+                    purge_bytes = self.get_latest("mds", info['name'],
+                                                  "purge_queue.pq_executing_bytes")
 
                     if rank == 0:
                         client_count = self.get_latest("mds", info['name'],
@@ -103,6 +107,10 @@ class Module(MgrModule):
                                              "mds_server.handle_client_request")
                         if output_format not in ('json', 'json-pretty'):
                             activity = "Reqs: " + mgr_util.format_dimless(rate, 5) + "/s"
+                            if purge_items or purge_bytes:
+                                activity += "  Purge: " + \
+                                    mgr_util.format_dimless(purge_items, 5) + " / " + \
+                                    mgr_util.format_bytes(purge_bytes, 5)
 
                     metadata = self.get_metadata('mds', info['name'],
                                                  default=defaultdict(lambda: 'unknown'))
@@ -118,7 +126,9 @@ class Module(MgrModule):
                             'dns': dns,
                             'inos': inos,
                             'dirs': dirs,
-                            'caps': caps
+                            'caps': caps,
+                            'purge_items': purge_items,
+                            'purge_bytes': purge_bytes
                         })
                     else:
                         rank_table.add_row([
@@ -0,0 +1,186 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/container/flat_map.hpp>
+
+#include "cls/rgw/cls_rgw_ops.h"
+
+namespace rgw::bucket_list {
+
+// Merges the ordered listings of several bucket index shards into one
+// ordered listing, as RGWRados::cls_bucket_list_ordered() returns it.
+//
+// A truncated shard can run out of entries while the others still have
+// some.  Nothing past its last entry can be returned until it is read
+// again, so that shard alone is re-read from just after its last key,
+// asking for twice as many entries as last time.  This is done at most
+// max_refills times per merge, after which the merge stalls and the
+// caller lists all of the shards again from its marker.  Every entry,
+// including those of results a refill replaced, stays in place for the
+// lifetime of the merge.
+class OrderedShardMerge {
+public:
+  // read up to count entries of shard that follow after into result
+  using refill_t = std::function<int(int shard, const cls_rgw_obj_key& after,
+				     uint32_t count, rgw_cls_list_ret* result)>;
+
+  OrderedShardMerge(std::map<int, rgw_cls_list_ret>& results,
+		    uint32_t per_shard, uint32_t max_refills,
+		    refill_t refill)
+    : max_refills(max_refills), refill(std::move(refill))
+  {
+    shards.reserve(results.size());
+    for (auto& [idx, result] : results) {
+      shards.emplace_back(idx, &result, per_shard);
+    }
+  }
+
+  // find the first entry; wanted is how many entries the caller can
+  // take, shards are only refilled while that is nonzero
+  int start(uint32_t wanted) {
+    for (size_t i = 0; i < shards.size(); ++i) {
+      int r = next_candidate(i, wanted);
+      if (r < 0) {
+	return r;
+      }
+    }
+    return 0;
+  }
+
+  // no entries left, or none that can be returned in order
+  bool done() const {
+    return candidates.empty() || stalled;
+  }
+
+  // the next entry in order
+  const std::string& name() const {
+    return current().cursor->first;
+  }
+  rgw_bucket_dir_entry& entry() {
+    return current().cursor->second;
+  }
+  int shard() const {
+    return current().idx;
+  }
+
+  // move on to the entry after the current one
+  int pop(uint32_t wanted) {
+    const size_t i = candidates.begin()->second;
+    candidates.erase(candidates.begin());
+    ++shards[i].cursor;
+    return next_candidate(i, wanted);
+  }
+
+  // whether any shard has entries that were not returned
+  bool is_truncated() const {
+    return std::any_of(shards.begin(), shards.end(),
+		       [] (const Shard& s) {
+			 return s.cursor != s.end || s.result->is_truncated;
+		       });
+  }
+
+  uint32_t get_num_refills() const {
+    return num_refills;
+  }
+
+private:
+  using ent_map_t =
+    boost::container::flat_map<std::string, rgw_bucket_dir_entry>;
+
+  struct Shard {
+    int idx;
+    rgw_cls_list_ret* result;
+    ent_map_t::iterator cursor;
+    ent_map_t::iterator end;
+    // key of the last entry, which the caller may move from
+    cls_rgw_obj_key last_key;
+    uint32_t count; // entries asked for last time
+
+    Shard(int idx, rgw_cls_list_ret* result, uint32_t count)
+      : idx(idx), result(result), count(count) {
+      reset();
+    }
+
+    void reset() {
+      cursor = result->dir.m.begin();
+      end = result->dir.m.end();
+      if (!result->dir.m.empty()) {
+	last_key = result->dir.m.rbegin()->second.key;
+      }
+    }
+  };
+
+  const uint32_t max_refills;
+  refill_t refill;
+  std::vector<Shard> shards;
+  // results replaced by refills are kept here, so that entries the
+  // caller may still point to are not freed
+  std::list<rgw_cls_list_ret> refill_results;
+  uint32_t num_refills = 0;
+  bool stalled = false;
+
+  // key=candidate, value=index into shards, which is not necessarily the
+  // shard number when not all shards were listed
+  std::map<std::string, size_t> candidates;
+
+  const Shard& current() const {
+    return shards[candidates.begin()->second];
+  }
+
+  // add the shard's next unique entry to the candidates, reading more
+  // from the shard if it ran out but is truncated
+  int next_candidate(size_t i, uint32_t wanted) {
+    auto& s = shards[i];
+    while (true) {
+      for (; s.cursor != s.end; ++s.cursor) {
+	if (candidates.emplace(s.cursor->first, i).second) {
+	  return 0;
+	}
+	// skip duplicate common prefixes
+      }
+      if (!s.result->is_truncated) {
+	return 0;
+      }
+      if (wanted == 0 || num_refills >= max_refills ||
+	  s.result->dir.m.empty()) {
+	// an empty but truncated result gives no key to continue after;
+	// either way nothing past this point can be returned in order
+	stalled = true;
+	return 0;
+      }
+
+      const uint32_t count = std::min(wanted, 2 * s.count);
+      auto& result = refill_results.emplace_back();
+      // when the last key ends in the delimiter it is a common prefix,
+      // which cls_rgw lists after by skipping the whole prefix
+      int r = refill(s.idx, s.last_key, count, &result);
+      if (r < 0) {
+	return r;
+      }
+      ++num_refills;
+      s.result = &result;
+      s.count = count;
+      s.reset();
+    }
+  }
+};
+
+} // namespace rgw::bucket_list
@@ -18,6 +18,7 @@
 enum {
   UPDATE_OBJ,
   REMOVE_OBJ,
+  REMOVE_OBJ_DATA, // from the object data cache, see ObjectDataCache
 };
 
 #define CACHE_FLAG_DATA           0x01
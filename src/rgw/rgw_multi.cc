@@ -13,6 +13,7 @@
 #include "rgw_op.h"
 #include "rgw_sal.h"
 #include "rgw_sal_rados.h"
+#include "rgw_aio_throttle.h"
 
 #include "services/svc_sys_obj.h"
 #include "services/svc_tier_rados.h"
@@ -195,6 +196,126 @@ int list_multipart_parts(struct req_state *s,
 			      next_marker, truncated, assume_unsorted);
 }
 
+namespace {
+
+// the meta object in rados, read through rgw::Aio with the request's
+// yield context
+class AioMetaReads : public rgw::multipart::MetaReads {
+  RGWSI_RADOS::Obj obj;
+  optional_yield y;
+  std::unique_ptr<rgw::Aio> aio;
+  std::list<std::pair<uint64_t, int>> completed;
+
+  void add_completed(rgw::AioResultList&& results) {
+    for (auto& r : results) {
+      completed.emplace_back(r.id, r.result);
+    }
+  }
+
+public:
+  AioMetaReads(RGWSI_RADOS::Obj&& obj, uint32_t max_aio, optional_yield y)
+    : obj(std::move(obj)), y(y), aio(rgw::make_throttle(max_aio, y)) {}
+  ~AioMetaReads() override {
+    aio->drain();
+  }
+
+  void start(uint64_t id, librados::ObjectReadOperation&& op) override {
+    add_completed(aio->get(obj, rgw::Aio::librados_op(std::move(op), y),
+			   1, id));
+  }
+  std::pair<uint64_t, int> wait() override {
+    while (completed.empty()) {
+      add_completed(aio->wait());
+    }
+    auto c = completed.front();
+    completed.pop_front();
+    return c;
+  }
+  void drain() override {
+    add_completed(aio->drain());
+  }
+  int operate(librados::ObjectReadOperation&& op) override {
+    return obj.operate(&op, nullptr, y);
+  }
+};
+
+// the meta object read through the store, all at once
+class StoreMetaReads : public rgw::multipart::MetaReads {
+  rgw::sal::Object *meta_obj;
+  optional_yield y;
+
+public:
+  StoreMetaReads(rgw::sal::Object *meta_obj, optional_yield y)
+    : meta_obj(meta_obj), y(y) {}
+
+  void start(uint64_t id, librados::ObjectReadOperation&& op) override {
+    ceph_abort_msg("no async reads without rados");
+  }
+  std::pair<uint64_t, int> wait() override {
+    ceph_abort_msg("no async reads without rados");
+  }
+  void drain() override {}
+  int operate(librados::ObjectReadOperation&& op) override {
+    return -EOPNOTSUPP;
+  }
+  int read_all(std::map<std::string, bufferlist> *vals) override {
+    return meta_obj->omap_get_all(vals, y);
+  }
+};
+
+} // anonymous namespace
+
+RGWMultipartCompleteReader::RGWMultipartCompleteReader(
+    const DoutPrefixProvider *dpp, rgw::sal::Store* store,
+    rgw::sal::Object *meta_obj, const string& upload_id,
+    std::vector<int>&& part_nums, uint32_t batch_size, uint32_t max_aio,
+    optional_yield y)
+  : dpp(dpp)
+{
+  bool sorted = false;
+  auto rados_store = dynamic_cast<rgw::sal::RadosStore*>(store);
+  if (rados_store) {
+    rgw_raw_obj raw_obj;
+    meta_obj->get_raw_obj(&raw_obj);
+    auto obj = rados_store->svc()->rados->obj(raw_obj);
+    if (obj.open() >= 0) {
+      reads = std::make_unique<AioMetaReads>(std::move(obj),
+					     std::max(max_aio, 1u), y);
+      sorted = is_v2_upload_id(upload_id);
+    }
+  }
+  if (!reads) {
+    // without rados the store's interface still works
+    reads = std::make_unique<StoreMetaReads>(meta_obj, y);
+  }
+  reader = std::make_unique<rgw::multipart::CompleteReader>(
+    dpp, *reads, sorted, std::move(part_nums), batch_size, max_aio);
+}
+
+int RGWMultipartCompleteReader::next(
+    std::map<uint32_t, RGWUploadPartInfo>& parts, bool *truncated)
+{
+  parts.clear();
+  std::map<uint32_t, bufferlist> encoded;
+  int ret = reader->next(encoded, truncated);
+  if (ret < 0) {
+    return ret;
+  }
+  for (auto& [num, bl] : encoded) {
+    RGWUploadPartInfo info;
+    try {
+      auto bli = bl.cbegin();
+      decode(info, bli);
+    } catch (buffer::error& err) {
+      ldpp_dout(dpp, 0) << "ERROR: could not part info, caught buffer::error" <<
+	dendl;
+      return -EIO;
+    }
+    parts[num] = std::move(info);
+  }
+  return 0;
+}
+
 int abort_multipart_upload(const DoutPrefixProvider *dpp,
 			   rgw::sal::Store* store, CephContext *cct,
 			   RGWObjectCtx *obj_ctx, rgw::sal::Bucket* bucket,
@@ -5,12 +5,15 @@
 #define CEPH_RGW_MULTI_H
 
 #include <map>
+#include <vector>
 #include "rgw_xml.h"
 #include "rgw_obj_manifest.h"
 #include "rgw_compression_types.h"
+#include "rgw_multipart_complete.h"
 
 namespace rgw { namespace sal {
   class Store;
+  class Object;
 } }
 
 #define MULTIPART_UPLOAD_ID_PREFIX_LEGACY "2/"
@@ -123,6 +126,28 @@ extern int list_multipart_parts(struct req_state *s,
                                 int *next_marker, bool *truncated,
                                 bool assume_unsorted = false);
 
+/*
+ * Reads the parts of an upload being completed, in part number order and
+ * in batches of up to batch_size parts; see rgw::multipart::CompleteReader.
+ * The meta object is read through rados directly when there is one,
+ * and through the store's omap_get_all() otherwise.
+ */
+class RGWMultipartCompleteReader {
+  const DoutPrefixProvider *dpp;
+  // the reader waits for its reads when it is destroyed, before them
+  std::unique_ptr<rgw::multipart::MetaReads> reads;
+  std::unique_ptr<rgw::multipart::CompleteReader> reader;
+
+public:
+  RGWMultipartCompleteReader(const DoutPrefixProvider *dpp,
+			     rgw::sal::Store* store, rgw::sal::Object *meta_obj,
+			     const string& upload_id, std::vector<int>&& part_nums,
+			     uint32_t batch_size, uint32_t max_aio,
+			     optional_yield y);
+
+  int next(std::map<uint32_t, RGWUploadPartInfo>& parts, bool *truncated);
+};
+
 extern int abort_multipart_upload(const DoutPrefixProvider *dpp, rgw::sal::Store* store,
 				  CephContext *cct, RGWObjectCtx *obj_ctx,
 				  rgw::sal::Bucket* bucket, RGWMPObj& mp_obj);
@@ -0,0 +1,271 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#include "rgw_multipart_complete.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+#define dout_subsys ceph_subsys_rgw
+
+namespace rgw::multipart {
+
+int MetaReads::read_all(std::map<std::string, ceph::buffer::list> *vals)
+{
+  std::string marker;
+  bool more = true;
+  while (more) {
+    std::map<std::string, ceph::buffer::list> page;
+    librados::ObjectReadOperation op;
+    op.omap_get_vals2(marker, 1000, &page, &more, nullptr);
+    int ret = operate(std::move(op));
+    if (ret < 0) {
+      return ret;
+    }
+    if (page.empty()) {
+      break;
+    }
+    marker = page.rbegin()->first;
+    vals->merge(page);
+  }
+  return 0;
+}
+
+IoCtxMetaReads::~IoCtxMetaReads()
+{
+  drain();
+}
+
+void IoCtxMetaReads::complete_cb(librados::completion_t, void *arg)
+{
+  auto c = static_cast<std::pair<IoCtxMetaReads*, uint64_t>*>(arg);
+  auto reads = c->first;
+  std::lock_guard l{reads->lock};
+  reads->completed.push_back(c->second);
+  delete c;
+  reads->cond.notify_all();
+}
+
+void IoCtxMetaReads::start(uint64_t id, librados::ObjectReadOperation&& op)
+{
+  auto arg = new std::pair<IoCtxMetaReads*, uint64_t>(this, id);
+  auto c = librados::Rados::aio_create_completion(arg, complete_cb);
+  std::unique_lock l{lock};
+  auto& p = pending[id];
+  p.first = std::move(op);
+  p.second = c;
+  l.unlock();
+  int r = ioctx.aio_operate(oid, c, &p.first, nullptr);
+  if (r < 0) {
+    // not started, so complete it here
+    delete arg;
+    l.lock();
+    c->release();
+    p.second = nullptr;
+    completed.push_back(id);
+    cond.notify_all();
+  }
+}
+
+std::pair<uint64_t, int> IoCtxMetaReads::wait()
+{
+  std::unique_lock l{lock};
+  cond.wait(l, [this] { return !completed.empty(); });
+  uint64_t id = completed.front();
+  completed.pop_front();
+  auto p = pending.find(id);
+  ceph_assert(p != pending.end());
+  int r = -EIO;
+  if (auto c = p->second.second; c) {
+    r = c->get_return_value();
+    c->release();
+  }
+  pending.erase(p);
+  return {id, r};
+}
+
+void IoCtxMetaReads::drain()
+{
+  std::unique_lock l{lock};
+  while (!pending.empty()) {
+    l.unlock();
+    wait();
+    l.lock();
+  }
+}
+
+int IoCtxMetaReads::operate(librados::ObjectReadOperation&& op)
+{
+  return ioctx.operate(oid, &op, nullptr);
+}
+
+bool parse_part_key(const std::string& key, uint32_t *num)
+{
+  static const std::string prefix = "part.";
+  if (key.compare(0, prefix.size(), prefix) != 0 ||
+      key.size() == prefix.size()) {
+    return false;
+  }
+  const char *s = key.c_str() + prefix.size();
+  char *end;
+  errno = 0;
+  unsigned long n = strtoul(s, &end, 10);
+  if (*end || errno || *s < '0' || *s > '9' || n > UINT32_MAX) {
+    return false;
+  }
+  *num = n;
+  return true;
+}
+
+CompleteReader::CompleteReader(const DoutPrefixProvider *dpp,
+			       MetaReads& reads, bool sorted,
+			       std::vector<int>&& _part_nums,
+			       uint32_t batch_size, uint32_t max_aio)
+  : dpp(dpp), reads(reads), part_nums(std::move(_part_nums)),
+    batch_size(std::max(batch_size, 1u)), max_aio(std::max(max_aio, 1u))
+{
+  if (!sorted || part_nums.empty()) {
+    read_all = true;
+    return;
+  }
+  batches.resize((part_nums.size() + batch_size - 1) / batch_size);
+}
+
+CompleteReader::~CompleteReader()
+{
+  // the pending reads still point into batches
+  drain();
+}
+
+void CompleteReader::issue()
+{
+  while (next_issue < batches.size() && next_issue < next_read + max_aio) {
+    Batch& batch = batches[next_issue];
+    size_t first = next_issue * batch_size;
+    size_t count = std::min<size_t>(batch_size, part_nums.size() - first);
+    if (first + count == part_nums.size()) {
+      count++; // to notice parts past the last requested one
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "part.%08d", first ? part_nums[first - 1] : 0);
+
+    librados::ObjectReadOperation op;
+    op.omap_get_vals2(buf, count, &batch.vals, &batch.more, &batch.rval);
+    reads.start(next_issue, std::move(op));
+    ++next_issue;
+  }
+}
+
+void CompleteReader::wait_for(Batch& batch)
+{
+  while (!batch.done) {
+    auto [id, r] = reads.wait();
+    Batch& b = batches[id];
+    if (r < 0) {
+      b.rval = r;
+    }
+    b.done = true;
+  }
+}
+
+void CompleteReader::drain()
+{
+  for (size_t i = next_read; i < next_issue; ++i) {
+    wait_for(batches[i]);
+  }
+}
+
+int CompleteReader::next_from_all(
+    std::map<uint32_t, ceph::buffer::list>& parts, bool *truncated)
+{
+  if (!read_all) {
+    ldpp_dout(dpp, 5) << "parts of the upload differ from the request, "
+		      << "reading all of them" << dendl;
+    drain();
+    batches.clear();
+    next_issue = next_read = 0;
+    read_all = true;
+  }
+  if (all_parts.empty()) {
+    std::map<std::string, ceph::buffer::list> vals;
+    int ret = reads.read_all(&vals);
+    if (ret < 0) {
+      return ret;
+    }
+    for (auto& [key, bl] : vals) {
+      uint32_t num;
+      if (!parse_part_key(key, &num)) {
+	ldpp_dout(dpp, 0) << "ERROR: bad part key " << key << dendl;
+	return -EIO;
+      }
+      if (num > last_num) {
+	all_parts[num] = std::move(bl);
+      }
+    }
+  }
+
+  auto iter = all_parts.upper_bound(last_num);
+  for (uint32_t i = 0; i < batch_size && iter != all_parts.end(); ++i, ++iter) {
+    parts[iter->first] = std::move(iter->second);
+    last_num = iter->first;
+  }
+  *truncated = (iter != all_parts.end());
+  return 0;
+}
+
+int CompleteReader::next(std::map<uint32_t, ceph::buffer::list>& parts,
+			 bool *truncated)
+{
+  parts.clear();
+  if (read_all || next_read == batches.size()) {
+    return next_from_all(parts, truncated);
+  }
+
+  issue();
+  Batch& batch = batches[next_read];
+  wait_for(batch);
+  if (batch.rval < 0) {
+    return batch.rval;
+  }
+
+  const size_t first = next_read * batch_size;
+  const size_t end = std::min<size_t>(first + batch_size, part_nums.size());
+  bool matches = (batch.vals.size() == end - first);
+  size_t i = first;
+  for (auto& [key, bl] : batch.vals) {
+    uint32_t num;
+    if (!parse_part_key(key, &num)) {
+      ldpp_dout(dpp, 0) << "ERROR: bad part key " << key << dendl;
+      return -EIO;
+    }
+    if (i == end || (int)num != part_nums[i]) {
+      matches = false;
+      break;
+    }
+    parts[num] = std::move(bl);
+    ++i;
+  }
+  if (!matches) {
+    parts.clear();
+    return next_from_all(parts, truncated);
+  }
+  last_num = parts.rbegin()->first;
+  batch.vals.clear();
+  ++next_read;
+  *truncated = (next_read < batches.size());
+  issue();
+  return 0;
+}
+
+} // namespace rgw::multipart
@@ -0,0 +1,124 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "include/buffer.h"
+#include "include/rados/librados.hpp"
+#include "common/ceph_mutex.h"
+#include "common/dout.h"
+
+namespace rgw::multipart {
+
+// The reads of an upload's meta object.  Reads that are started
+// run in the background until wait() returns their id.
+class MetaReads {
+public:
+  virtual ~MetaReads() = default;
+
+  virtual void start(uint64_t id, librados::ObjectReadOperation&& op) = 0;
+  // wait for a started read to complete, returning its id and result
+  virtual std::pair<uint64_t, int> wait() = 0;
+  // wait for all started reads to complete
+  virtual void drain() = 0;
+  virtual int operate(librados::ObjectReadOperation&& op) = 0;
+
+  // all of the omap, by default read 1000 keys at a time with operate()
+  virtual int read_all(std::map<std::string, ceph::buffer::list> *vals);
+};
+
+// MetaReads on an IoCtx, without a yield context
+class IoCtxMetaReads : public MetaReads {
+  librados::IoCtx& ioctx;
+  const std::string oid;
+
+  ceph::mutex lock = ceph::make_mutex("rgw::multipart::IoCtxMetaReads");
+  ceph::condition_variable cond;
+  // the ops and completions of the started reads, by id
+  std::map<uint64_t, std::pair<librados::ObjectReadOperation,
+			       librados::AioCompletion*>> pending;
+  std::list<uint64_t> completed;
+
+  static void complete_cb(librados::completion_t, void *arg);
+
+public:
+  IoCtxMetaReads(librados::IoCtx& ioctx, const std::string& oid)
+    : ioctx(ioctx), oid(oid) {}
+  ~IoCtxMetaReads() override;
+
+  void start(uint64_t id, librados::ObjectReadOperation&& op) override;
+  std::pair<uint64_t, int> wait() override;
+  void drain() override;
+  int operate(librados::ObjectReadOperation&& op) override;
+};
+
+// Parses the part number out of an omap key of the meta object,
+// "part.%08d" for v2 upload ids and "part.%d" otherwise.
+bool parse_part_key(const std::string& key, uint32_t *num);
+
+/*
+ * Reads the parts of an upload being completed, in part number order and
+ * in batches of up to batch_size parts, as the encoded part infos of the
+ * omap.  If the omap keys sort by part number (v2 upload ids), the key
+ * range of every batch follows from the part numbers in the request, and
+ * up to max_aio batches are read ahead in parallel.  Otherwise, or if the
+ * parts found differ from the ones requested, it falls back to reading
+ * the whole omap; callers see the uploaded parts either way and have to
+ * check them.
+ */
+class CompleteReader {
+  struct Batch {
+    std::map<std::string, ceph::buffer::list> vals;
+    bool more = false;
+    int rval = 0;
+    bool done = false;
+  };
+
+  const DoutPrefixProvider *dpp;
+  MetaReads& reads;
+  const std::vector<int> part_nums;
+  const uint32_t batch_size;
+  const uint32_t max_aio;
+
+  std::vector<Batch> batches;
+  size_t next_issue = 0;
+  size_t next_read = 0;
+
+  bool read_all = false;
+  std::map<uint32_t, ceph::buffer::list> all_parts;
+  uint32_t last_num = 0;
+
+  void issue();
+  void wait_for(Batch& batch);
+  void drain();
+  int next_from_all(std::map<uint32_t, ceph::buffer::list>& parts,
+		    bool *truncated);
+
+public:
+  // sorted: the omap keys sort by part number
+  CompleteReader(const DoutPrefixProvider *dpp, MetaReads& reads,
+		 bool sorted, std::vector<int>&& part_nums,
+		 uint32_t batch_size, uint32_t max_aio);
+  ~CompleteReader();
+
+  // the next batch, by part number; -EIO if a key is not a part's
+  int next(std::map<uint32_t, ceph::buffer::list>& parts, bool *truncated);
+};
+
+} // namespace rgw::multipart
@@ -0,0 +1,111 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include "rgw_obj_data_cache.h"
+
+uint64_t ObjectDataCache::get_size()
+{
+  uint64_t size = 0;
+  for (auto& shard : shards) {
+    std::lock_guard l{shard.lock};
+    size += shard.size;
+  }
+  return size;
+}
+
+size_t ObjectDataCache::get_num_entries()
+{
+  size_t n = 0;
+  for (auto& shard : shards) {
+    std::lock_guard l{shard.lock};
+    n += shard.entries.size();
+  }
+  return n;
+}
+
+uint64_t ObjectDataCache::get_gen(const std::string& name)
+{
+  Shard& shard = get_shard(name);
+  std::lock_guard l{shard.lock};
+  return shard.gen;
+}
+
+bool ObjectDataCache::get(const std::string& name, Info *info)
+{
+  Shard& shard = get_shard(name);
+  std::lock_guard l{shard.lock};
+  auto iter = shard.entries.find(name);
+  if (iter == shard.entries.end()) {
+    return false;
+  }
+  if (expiry.count() &&
+      ceph::coarse_mono_clock::now() - iter->second.time_added > expiry) {
+    remove(shard, iter);
+    return false;
+  }
+  shard.lru.splice(shard.lru.begin(), shard.lru, iter->second.lru_iter);
+  *info = iter->second.info;
+  return true;
+}
+
+void ObjectDataCache::put(const std::string& name, uint64_t gen,
+			  const Info& info)
+{
+  if (info.data.length() > max_obj_size) {
+    return;
+  }
+  uint64_t charge = info.data.length();
+  for (auto& [k, v] : info.attrs) {
+    charge += k.size() + v.length();
+  }
+  if (charge > max_shard_size) {
+    return;
+  }
+  Shard& shard = get_shard(name);
+  std::lock_guard l{shard.lock};
+  if (shard.gen != gen) {
+    // removed, or something else in the shard was, since info was read
+    return;
+  }
+  auto [iter, added] = shard.entries.try_emplace(name);
+  Entry& entry = iter->second;
+  if (added) {
+    shard.lru.push_front(name);
+    entry.lru_iter = shard.lru.begin();
+  } else {
+    shard.size -= entry.charge;
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry.lru_iter);
+  }
+  entry.info = info;
+  // private copies, so that we do not pin the buffers of a larger read
+  entry.info.data.rebuild();
+  for (auto& [k, v] : entry.info.attrs) {
+    v.rebuild();
+  }
+  entry.charge = charge;
+  entry.time_added = ceph::coarse_mono_clock::now();
+  shard.size += charge;
+
+  while (shard.size > max_shard_size) {
+    remove(shard, shard.entries.find(shard.lru.back()));
+  }
+}
+
+void ObjectDataCache::remove(const std::string& name)
+{
+  Shard& shard = get_shard(name);
+  std::lock_guard l{shard.lock};
+  ++shard.gen;
+  auto iter = shard.entries.find(name);
+  if (iter != shard.entries.end()) {
+    remove(shard, iter);
+  }
+}
+
+void ObjectDataCache::remove(Shard& shard,
+			     std::unordered_map<std::string, Entry>::iterator iter)
+{
+  shard.size -= iter->second.charge;
+  shard.lru.erase(iter->second.lru_iter);
+  shard.entries.erase(iter);
+}
@@ -0,0 +1,89 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#ifndef CEPH_RGWOBJDATACACHE_H
+#define CEPH_RGWOBJDATACACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "include/buffer.h"
+#include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
+
+/*
+ * The head objects of small objects: their data, attrs and rados version,
+ * served without going to the OSD.  A gateway that writes or removes a
+ * head object removes it here and notifies the other gateways to do the
+ * same (see RGWSI_SysObj_Cache::distribute_obj_data_remove()).  Should a
+ * notification be lost, entries are dropped after the expiry, like those
+ * of the system object cache.
+ *
+ * Each shard is an LRU holding at most max_size / num_shards bytes of
+ * data and attrs.
+ */
+class ObjectDataCache {
+public:
+  struct Info {
+    uint64_t version = 0;
+    uint64_t size = 0;
+    ceph::real_time mtime;
+    std::map<std::string, ceph::bufferlist> attrs;
+    ceph::bufferlist data;
+  };
+
+private:
+  struct Entry {
+    Info info;
+    uint64_t charge = 0;
+    ceph::coarse_mono_time time_added;
+    std::list<std::string>::iterator lru_iter;
+  };
+  struct Shard {
+    ceph::mutex lock = ceph::make_mutex("ObjectDataCache::Shard");
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru; // most recently used first
+    uint64_t size = 0;
+    uint64_t gen = 0; // bumped by remove()
+  };
+
+  std::vector<Shard> shards;
+  const uint64_t max_shard_size;
+  const uint64_t max_obj_size;
+  const ceph::timespan expiry;
+
+  Shard& get_shard(const std::string& name) {
+    return shards[std::hash<std::string>{}(name) % shards.size()];
+  }
+  void remove(Shard& shard, std::unordered_map<std::string, Entry>::iterator iter);
+
+public:
+  static constexpr unsigned DEFAULT_NUM_SHARDS = 16;
+
+  // an expiry of 0 keeps entries until they are evicted or removed
+  ObjectDataCache(uint64_t max_size, uint64_t _max_obj_size,
+		  ceph::timespan _expiry,
+		  unsigned num_shards = DEFAULT_NUM_SHARDS)
+    : shards(num_shards),
+      max_shard_size(max_size / num_shards),
+      max_obj_size(_max_obj_size),
+      expiry(_expiry) {}
+
+  uint64_t get_max_obj_size() const { return max_obj_size; }
+  // bytes of data and attrs cached
+  uint64_t get_size();
+  size_t get_num_entries();
+
+  // taken before reading an object and passed to put(), so that what was
+  // read is not cached if the object was removed in the meantime
+  uint64_t get_gen(const std::string& name);
+
+  bool get(const std::string& name, Info *info);
+  void put(const std::string& name, uint64_t gen, const Info& info);
+  void remove(const std::string& name);
+};
+
+#endif
@@ -5928,7 +5928,6 @@ void RGWCompleteMultipart::execute(optional_yield y)
   int total_parts = 0;
   int handled_parts = 0;
   int max_parts = 1000;
-  int marker = 0;
   bool truncated;
   RGWCompressionInfo cs_info;
   bool compressed = false;
@@ -5974,9 +5973,17 @@ void RGWCompleteMultipart::execute(optional_yield y)
   }
   attrs = meta_obj->get_attrs();
 
+  std::vector<int> part_nums;
+  part_nums.reserve(parts->parts.size());
+  for (const auto& part : parts->parts) {
+    part_nums.push_back(part.first);
+  }
+  RGWMultipartCompleteReader reader(this, store, meta_obj.get(), upload_id,
+    std::move(part_nums), max_parts,
+    s->cct->_conf.get_val<uint64_t>("rgw_multipart_complete_max_aio"), y);
+
   do {
-    op_ret = list_multipart_parts(s, upload_id, meta_oid, max_parts,
-				  marker, obj_parts, &marker, &truncated);
+    op_ret = reader.next(obj_parts, &truncated);
     if (op_ret == -ENOENT) {
       op_ret = -ERR_NO_SUCH_UPLOAD;
     }
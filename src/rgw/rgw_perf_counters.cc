@@ -31,6 +31,10 @@ int rgw_perf_start(CephContext *cct)
   plb.add_u64_counter(l_rgw_cache_hit, "cache_hit", "Cache hits");
   plb.add_u64_counter(l_rgw_cache_miss, "cache_miss", "Cache miss");
 
+  plb.add_u64_counter(l_rgw_data_cache_hit, "data_cache_hit", "Object data cache hits");
+  plb.add_u64_counter(l_rgw_data_cache_hit_b, "data_cache_hit_b", "Size of object data cache hits");
+  plb.add_u64_counter(l_rgw_data_cache_miss, "data_cache_miss", "Object data cache miss");
+
   plb.add_u64_counter(l_rgw_keystone_token_cache_hit, "keystone_token_cache_hit", "Keystone token cache hits");
   plb.add_u64_counter(l_rgw_keystone_token_cache_miss, "keystone_token_cache_miss", "Keystone token cache miss");
 
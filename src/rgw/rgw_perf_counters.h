@@ -28,6 +28,10 @@ enum {
   l_rgw_cache_hit,
   l_rgw_cache_miss,
 
+  l_rgw_data_cache_hit,
+  l_rgw_data_cache_hit_b,
+  l_rgw_data_cache_miss,
+
   l_rgw_keystone_token_cache_hit,
   l_rgw_keystone_token_cache_miss,
 
@@ -24,10 +24,13 @@
 #include "rgw_sal.h"
 #include "rgw_zone.h"
 #include "rgw_cache.h"
+#include "rgw_obj_data_cache.h"
+#include "rgw_perf_counters.h"
 #include "rgw_acl.h"
 #include "rgw_acl_s3.h" /* for dumping s3policy in debug log */
 #include "rgw_aio_throttle.h"
 #include "rgw_bucket.h"
+#include "rgw_bucket_list_merge.h"
 #include "rgw_rest_conn.h"
 #include "rgw_cr_rados.h"
 #include "rgw_cr_rest.h"
@@ -1081,6 +1084,7 @@ void RGWRados::finalize()
 
   delete binfo_cache;
   delete obj_tombstone_cache;
+  delete obj_data_cache;
 
   if (reshard_wait.get()) {
     reshard_wait->stop();
@@ -1316,6 +1320,16 @@ int RGWRados::init_complete(const DoutPrefixProvider *dpp)
     obj_tombstone_cache = new tombstone_cache_t(cct->_conf->rgw_obj_tombstone_cache_size);
   }
 
+  // invalidated through the notifications of the system object cache,
+  // so only with it
+  if (auto size = cct->_conf.get_val<Option::size_t>("rgw_obj_data_cache_size");
+      size > 0 && svc.cache) {
+    obj_data_cache = new ObjectDataCache(
+      size, cct->_conf.get_val<Option::size_t>("rgw_obj_data_cache_max_obj_size"),
+      std::chrono::seconds(cct->_conf.get_val<uint64_t>("rgw_cache_expiry_interval")));
+    svc.cache->set_obj_data_cache(obj_data_cache);
+  }
+
   reshard_wait = std::make_shared<RGWReshardWait>();
 
   reshard = new RGWReshard(this->store);
@@ -3177,6 +3191,8 @@ int RGWRados::Object::Write::_do_write_meta(const DoutPrefixProvider *dpp,
   epoch = ioctx.get_last_version();
   poolid = ioctx.get_id();
 
+  store->invalidate_obj_data(target->get_bucket_info(), obj, y);
+
   r = target->complete_atomic_modification();
   if (r < 0) {
     ldout(store->ctx(), 0) << "ERROR: complete_atomic_modification returned r=" << r << dendl;
@@ -5170,6 +5186,7 @@ int RGWRados::Object::Delete::delete_obj(optional_yield y, const DoutPrefixProvi
 
   int64_t poolid = ioctx.get_id();
   if (r >= 0) {
+    store->invalidate_obj_data(target->get_bucket_info(), obj, y);
     tombstone_cache_t *obj_tombstone_cache = store->get_tombstone_cache();
     if (obj_tombstone_cache) {
       tombstone_entry entry{*state};
@@ -5350,7 +5367,11 @@ int RGWRados::get_obj_state_impl(const DoutPrefixProvider *dpp, RGWObjectCtx *rc
   int r = -ENOENT;
 
   if (!assume_noent) {
-    r = RGWRados::raw_obj_stat(raw_obj, &s->size, &s->mtime, &s->epoch, &s->attrset, (s->prefetch_data ? &s->data : NULL), NULL, y);
+    if (s->prefetch_data && obj_data_cache) {
+      r = raw_obj_stat_cached(raw_obj, s, y);
+    } else {
+      r = RGWRados::raw_obj_stat(raw_obj, &s->size, &s->mtime, &s->epoch, &s->attrset, (s->prefetch_data ? &s->data : NULL), NULL, y);
+    }
   }
 
   if (r == -ENOENT) {
@@ -5860,6 +5881,9 @@ int RGWRados::set_attrs(const DoutPrefixProvider *dpp, void *ctx, const RGWBucke
   op.mtime2(&mtime_ts);
   auto& ioctx = ref.pool.ioctx();
   r = rgw_rados_operate(ioctx, ref.obj.oid, &op, null_yield);
+  if (r >= 0) {
+    invalidate_obj_data(bucket_info, obj, y);
+  }
   if (state) {
     if (r >= 0) {
       bufferlist acl_bl = attrs[RGW_ATTR_ACL];
@@ -6540,7 +6564,11 @@ int RGWRados::obj_operate(const RGWBucketInfo& bucket_info, const rgw_obj& obj,
     return r;
   }
 
-  return rgw_rados_operate(ref.pool.ioctx(), ref.obj.oid, op, null_yield);
+  r = rgw_rados_operate(ref.pool.ioctx(), ref.obj.oid, op, null_yield);
+  if (r >= 0) {
+    invalidate_obj_data(bucket_info, obj, null_yield);
+  }
+  return r;
 }
 
 int RGWRados::obj_operate(const RGWBucketInfo& bucket_info, const rgw_obj& obj, ObjectReadOperation *op)
@@ -7588,6 +7616,60 @@ int RGWRados::raw_obj_stat(rgw_raw_obj& obj, uint64_t *psize, real_time *pmtime,
   return 0;
 }
 
+int RGWRados::raw_obj_stat_cached(rgw_raw_obj& obj, RGWObjState *s,
+                                  optional_yield y)
+{
+  const std::string name = RGWSI_SysObj_Cache::obj_data_cache_name(obj);
+
+  ObjectDataCache::Info info;
+  if (obj_data_cache->get(name, &info)) {
+    s->size = info.size;
+    s->mtime = info.mtime;
+    s->epoch = info.version;
+    s->attrset = std::move(info.attrs);
+    s->data = std::move(info.data);
+    if (perfcounter) {
+      perfcounter->inc(l_rgw_data_cache_hit);
+      perfcounter->inc(l_rgw_data_cache_hit_b, s->data.length());
+    }
+    return 0;
+  }
+
+  const uint64_t gen = obj_data_cache->get_gen(name);
+  int r = raw_obj_stat(obj, &s->size, &s->mtime, &s->epoch, &s->attrset,
+                       &s->data, nullptr, y);
+  // only what fits in the head object is cached
+  if (r == 0 && s->size > 0 && s->data.length() == s->size &&
+      s->size <= obj_data_cache->get_max_obj_size()) {
+    if (perfcounter) {
+      perfcounter->inc(l_rgw_data_cache_miss);
+    }
+    info.version = s->epoch;
+    info.size = s->size;
+    info.mtime = s->mtime;
+    info.attrs = s->attrset;
+    info.data = s->data;
+    obj_data_cache->put(name, gen, info);
+  }
+  return r;
+}
+
+void RGWRados::invalidate_obj_data(const RGWBucketInfo& bucket_info,
+                                   const rgw_obj& obj, optional_yield y)
+{
+  if (!obj_data_cache) {
+    return;
+  }
+  rgw_raw_obj raw_obj;
+  obj_to_raw(bucket_info.placement_rule, obj, &raw_obj);
+  obj_data_cache->remove(RGWSI_SysObj_Cache::obj_data_cache_name(raw_obj));
+  int r = svc.cache->distribute_obj_data_remove(raw_obj, y);
+  if (r < 0) {
+    ldout(cct, 0) << "ERROR: failed to distribute object data cache removal of "
+                  << raw_obj << " r=" << r << dendl;
+  }
+}
+
 int RGWRados::get_bucket_stats(RGWBucketInfo& bucket_info, int shard_id, string *bucket_ver, string *master_ver,
     map<RGWObjCategory, RGWStorageStats>& stats, string *max_marker, bool *syncstopped)
 {
@@ -8407,64 +8489,7 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
     return r;
   }
 
-  // to manage the iterators through each shard's list results
-  struct ShardTracker {
-    const size_t shard_idx;
-    rgw_cls_list_ret& result;
-    const std::string& oid_name;
-    RGWRados::ent_map_t::iterator cursor;
-    RGWRados::ent_map_t::iterator end;
-
-    // manages an iterator through a shard and provides other
-    // accessors
-    ShardTracker(size_t _shard_idx,
-		 rgw_cls_list_ret& _result,
-		 const std::string& _oid_name):
-      shard_idx(_shard_idx),
-      result(_result),
-      oid_name(_oid_name),
-      cursor(_result.dir.m.begin()),
-      end(_result.dir.m.end())
-    {}
-
-    inline const std::string& entry_name() const {
-      return cursor->first;
-    }
-    rgw_bucket_dir_entry& dir_entry() const {
-      return cursor->second;
-    }
-    inline bool is_truncated() const {
-      return result.is_truncated;
-    }
-    inline ShardTracker& advance() {
-      ++cursor;
-      // return a self-reference to allow for chaining of calls, such
-      // as x.advance().at_end()
-      return *this;
-    }
-    inline bool at_end() const {
-      return cursor == end;
-    }
-  }; // ShardTracker
-
-  // add the next unique candidate, or return false if we reach the end
-  auto next_candidate = [] (CephContext *cct, ShardTracker& t,
-                            std::map<std::string, size_t>& candidates,
-                            size_t tracker_idx) {
-    while (!t.at_end()) {
-      if (candidates.emplace(t.entry_name(), tracker_idx).second) {
-        return;
-      }
-      t.advance(); // skip duplicate common prefixes
-    }
-  };
-
-  // one tracker per shard requested (may not be all shards)
-  std::vector<ShardTracker> results_trackers;
-  results_trackers.reserve(shard_list_results.size());
   for (auto& r : shard_list_results) {
-    results_trackers.emplace_back(r.first, r.second, shard_oids[r.first]);
-
     // if any *one* shard's result is trucated, the entire result is
     // truncated
     *is_truncated = *is_truncated || r.second.is_truncated;
@@ -8474,37 +8499,50 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
     *cls_filtered = *cls_filtered && r.second.cls_filtered;
   }
 
-  // create a map to track the next candidate entry from ShardTracker
-  // (key=candidate, value=index into results_trackers); as we consume
-  // entries from shards, we replace them with the next entries in the
-  // shards until we run out
-  map<string, size_t> candidates;
-  size_t tracker_idx = 0;
-  for (auto& t : results_trackers) {
-    // it's important that the values in the map refer to the index
-    // into the results_trackers vector, which may not be the same
-    // as the shard number (i.e., when not all shards are requested)
-    next_candidate(cct, t, candidates, tracker_idx);
-    ++tracker_idx;
+  // when a truncated shard runs out before the page is full, read more
+  // from just that shard and keep merging rather than stopping short,
+  // which would make the caller list all of the shards again; bound the
+  // serial reads this adds to one request
+  constexpr uint32_t max_shard_refills = 8;
+  auto refill = [&] (int shard, const cls_rgw_obj_key& after,
+		     uint32_t count, rgw_cls_list_ret* result) {
+    ldpp_dout(dpp, 20) << "RGWRados::" << __func__ <<
+      ": reading " << count << " more entries from shard " << shard <<
+      " after " << after << dendl;
+    librados::ObjectReadOperation op;
+    cls_rgw_bucket_list_op(op, after, prefix, delimiter, count,
+			   list_versions, result);
+    int r = rgw_rados_operate(ioctx, shard_oids[shard], &op, nullptr, y);
+    if (r < 0) {
+      return r;
+    }
+    *cls_filtered = *cls_filtered && result->cls_filtered;
+    return 0;
+  };
+  rgw::bucket_list::OrderedShardMerge merge(shard_list_results,
+					    num_entries_per_shard,
+					    max_shard_refills, refill);
+  r = merge.start(num_entries);
+  if (r < 0) {
+    return r;
   }
 
   rgw_bucket_dir_entry*
     last_entry_visited = nullptr; // to set last_entry (marker)
   map<string, bufferlist> updates;
   uint32_t count = 0;
-  while (count < num_entries && !candidates.empty()) {
+  // the merge stops early once a truncated shard is exhausted, as we
+  // cannot be certain that one of the next entries needs to come from
+  // that shard; S3 and swift protocols allow returning fewer than what
+  // was requested
+  while (count < num_entries && !merge.done()) {
     r = 0;
-    // select the next entry in lexical order (first key in map);
-    // again tracker_idx is not necessarily shard number, but is index
-    // into results_trackers vector
-    tracker_idx = candidates.begin()->second;
-    auto& tracker = results_trackers.at(tracker_idx);
-
-    const string& name = tracker.entry_name();
-    rgw_bucket_dir_entry& dirent = tracker.dir_entry();
+    const string& name = merge.name();
+    rgw_bucket_dir_entry& dirent = merge.entry();
+    const string& oid_name = shard_oids[merge.shard()];
 
     ldpp_dout(dpp, 20) << "RGWRados::" << __func__ << " currently processing " <<
-      dirent.key << " from shard " << tracker.shard_idx << dendl;
+      dirent.key << " from shard " << merge.shard() << dendl;
 
     const bool force_check =
       force_check_filter && force_check_filter(dirent.key.name);
@@ -8520,7 +8558,7 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
       librados::IoCtx sub_ctx;
       sub_ctx.dup(ioctx);
       r = check_disk_state(dpp, sub_ctx, bucket_info, dirent, dirent,
-			   updates[tracker.oid_name], y);
+			   updates[oid_name], y);
       if (r < 0 && r != -ENOENT) {
 	return r;
       }
@@ -8539,21 +8577,15 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
     } else { // r == -ENOENT
       ldpp_dout(dpp, 10) << "RGWRados::" << __func__ << ": skipping " <<
 	dirent.key.name << "[" << dirent.key.instance << "]" << dendl;
-      last_entry_visited = &tracker.dir_entry();
+      // the merge keeps refilled shards' earlier results alive, so this
+      // stays valid
+      last_entry_visited = &dirent;
     }
 
-    // refresh the candidates map
-    candidates.erase(candidates.begin());
-    tracker.advance();
-
-    next_candidate(cct, tracker, candidates, tracker_idx);
-
-    if (tracker.at_end() && tracker.is_truncated()) {
-      // once we exhaust one shard that is truncated, we need to stop,
-      // as we cannot be certain that one of the next entries needs to
-      // come from that shard; S3 and swift protocols allow returning
-      // fewer than what was requested
-      break;
+    // refresh the candidates
+    r = merge.pop(num_entries - count);
+    if (r < 0) {
+      return r;
     }
   } // while we haven't provided requested # of result entries
 
@@ -8572,13 +8604,7 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
 
   // determine truncation by checking if all the returned entries are
   // consumed or not
-  *is_truncated = false;
-  for (const auto& t : results_trackers) {
-    if (!t.at_end() || t.is_truncated()) {
-      *is_truncated = true;
-      break;
-    }
-  }
+  *is_truncated = merge.is_truncated();
 
   ldpp_dout(dpp, 20) << "RGWRados::" << __func__ <<
     ": returning, count=" << count << ", is_truncated=" << *is_truncated <<
@@ -9224,6 +9250,7 @@ int RGWRados::delete_obj_aio(const DoutPrefixProvider *dpp, const rgw_obj& obj,
   }
 
   handles.push_back(c);
+  invalidate_obj_data(bucket_info, obj, y);
 
   if (keep_index_consistent) {
     ret = delete_obj_index(obj, astate->mtime, dpp);
@@ -368,6 +368,7 @@ class lru_map;
 using tombstone_cache_t = lru_map<rgw_obj, tombstone_entry>;
 
 class RGWIndexCompletionManager;
+class ObjectDataCache;
 
 class RGWRados
 {
@@ -461,6 +462,7 @@ protected:
   RGWChainedCacheImpl_bucket_info_entry *binfo_cache;
 
   tombstone_cache_t *obj_tombstone_cache;
+  ObjectDataCache *obj_data_cache = nullptr;
 
   librados::IoCtx gc_pool_ctx;        // .rgw.gc
   librados::IoCtx lc_pool_ctx;        // .rgw.lc
@@ -1261,6 +1263,12 @@ public:
   int raw_obj_stat(rgw_raw_obj& obj, uint64_t *psize, ceph::real_time *pmtime, uint64_t *epoch,
                    map<string, bufferlist> *attrs, bufferlist *first_chunk,
                    RGWObjVersionTracker *objv_tracker, optional_yield y);
+  // raw_obj_stat() of the head object with its data, through obj_data_cache
+  int raw_obj_stat_cached(rgw_raw_obj& obj, RGWObjState *s, optional_yield y);
+  // the head object of obj was written or removed: drop it from the
+  // obj_data_cache of every gateway
+  void invalidate_obj_data(const RGWBucketInfo& bucket_info, const rgw_obj& obj,
+                           optional_yield y);
 
   int obj_operate(const RGWBucketInfo& bucket_info, const rgw_obj& obj, librados::ObjectWriteOperation *op);
   int obj_operate(const RGWBucketInfo& bucket_info, const rgw_obj& obj, librados::ObjectReadOperation *op);
@@ -10,6 +10,7 @@
 
 #include "rgw/rgw_zone.h"
 #include "rgw/rgw_tools.h"
+#include "rgw/rgw_obj_data_cache.h"
 
 #define dout_subsys ceph_subsys_rgw
 
@@ -457,6 +458,11 @@ int RGWSI_SysObj_Cache::watch_cb(uint64_t notify_id,
   case REMOVE_OBJ:
     cache.remove(name);
     break;
+  case REMOVE_OBJ_DATA:
+    if (obj_data_cache) {
+      obj_data_cache->remove(obj_data_cache_name(info.obj));
+    }
+    break;
   default:
     ldout(cct, 0) << "WARNING: got unknown notification op: " << info.op << dendl;
     return -EINVAL;
@@ -465,6 +471,22 @@ int RGWSI_SysObj_Cache::watch_cb(uint64_t notify_id,
   return 0;
 }
 
+std::string RGWSI_SysObj_Cache::obj_data_cache_name(const rgw_raw_obj& obj)
+{
+  return obj.pool.to_str() + "/" + obj.loc + "/" + obj.oid;
+}
+
+int RGWSI_SysObj_Cache::distribute_obj_data_remove(const rgw_raw_obj& obj,
+                                                   optional_yield y)
+{
+  RGWCacheNotifyInfo info;
+  info.op = REMOVE_OBJ_DATA;
+  info.obj = obj;
+  bufferlist bl;
+  encode(info, bl);
+  return notify_svc->distribute(obj_data_cache_name(obj), bl, y);
+}
+
 void RGWSI_SysObj_Cache::set_enabled(bool status)
 {
   cache.set_enabled(status);
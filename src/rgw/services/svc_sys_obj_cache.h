@@ -10,6 +10,7 @@
 #include "svc_sys_obj_core.h"
 
 class RGWSI_Notify;
+class ObjectDataCache;
 
 class RGWSI_SysObj_Cache_CB;
 class RGWSI_SysObj_Cache_ASocketHook;
@@ -22,6 +23,7 @@ class RGWSI_SysObj_Cache : public RGWSI_SysObj_Core
 
   RGWSI_Notify *notify_svc{nullptr};
   ObjectCache cache;
+  ObjectDataCache *obj_data_cache{nullptr};
 
   std::shared_ptr<RGWSI_SysObj_Cache_CB> cb;
 
@@ -103,6 +105,15 @@ public:
   void register_chained_cache(RGWChainedCache *cc);
   void unregister_chained_cache(RGWChainedCache *cc);
 
+  // the object data cache of RGWRados is invalidated through the
+  // notifications of this cache
+  void set_obj_data_cache(ObjectDataCache *c) {
+    obj_data_cache = c;
+  }
+  static std::string obj_data_cache_name(const rgw_raw_obj& obj);
+  // remove obj from the object data cache of every gateway
+  int distribute_obj_data_remove(const rgw_raw_obj& obj, optional_yield y);
+
   class ASocketHandler {
     RGWSI_SysObj_Cache *svc;
 
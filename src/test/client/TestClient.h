@@ -83,3 +83,50 @@ protected:
     Objecter* objecter = nullptr;
     Client* client = nullptr;
 };
+
+// A second client mount, for tests where another client has to compete
+// for caps.
+class TestClientWithOther : public TestClient {
+public:
+    void SetUp() override {
+      TestClient::SetUp();
+      other_messenger = Messenger::create_client_messenger(g_ceph_context,
+                                                           "client");
+      ASSERT_EQ(0, other_messenger->start());
+      other_mc = new MonClient(g_ceph_context, icp);
+      ASSERT_LE(0, other_mc->build_initial_monmap());
+      other_mc->set_messenger(other_messenger);
+      other_mc->set_want_keys(CEPH_ENTITY_TYPE_MDS | CEPH_ENTITY_TYPE_OSD);
+      ASSERT_LE(0, other_mc->init());
+      other_objecter = new Objecter(g_ceph_context, other_messenger,
+                                    other_mc, icp);
+      other_objecter->set_client_incarnation(0);
+      other_objecter->init();
+      other_messenger->add_dispatcher_tail(other_objecter);
+      other_objecter->start();
+      other = new Client(other_messenger, other_mc, other_objecter);
+      other->init();
+      ASSERT_EQ(0, other->mount("/", myperm, true));
+    }
+    void TearDown() override {
+      if (other) {
+        if (other->is_mounted())
+          other->unmount();
+        other->shutdown();
+        other_objecter->shutdown();
+        other_mc->shutdown();
+        other_messenger->shutdown();
+        other_messenger->wait();
+        delete other;
+        delete other_objecter;
+        delete other_mc;
+        delete other_messenger;
+      }
+      TestClient::TearDown();
+    }
+protected:
+    MonClient* other_mc = nullptr;
+    Messenger* other_messenger = nullptr;
+    Objecter* other_objecter = nullptr;
+    Client* other = nullptr;
+};
@@ -0,0 +1,128 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include <string>
+
+#include <fmt/format.h>
+
+#include "test/client/TestClient.h"
+
+// the other client checks what the mds ended up with
+class TestClientAsyncDirops : public TestClientWithOther {
+public:
+  void SetUp() override {
+    g_ceph_context->_conf.set_val_or_die("client_async_dirops", "true");
+    TestClientWithOther::SetUp();
+  }
+  void TearDown() override {
+    TestClientWithOther::TearDown();
+    g_ceph_context->_conf.set_val_or_die("client_async_dirops", "false");
+  }
+protected:
+  std::string make_dir() {
+    auto dir = fmt::format("{}_{}", ::testing::UnitTest::GetInstance()->current_test_info()->name(), getpid());
+    EXPECT_EQ(0, client->mkdir(dir.c_str(), 0777, myperm));
+    return dir;
+  }
+  // wait until the mds has everything done in dir
+  void sync_dir(const std::string& dir) {
+    int fd = client->open(dir.c_str(), O_RDONLY|O_DIRECTORY, myperm);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(0, client->fsync(fd, false));
+    ASSERT_EQ(0, client->close(fd));
+  }
+};
+
+TEST_F(TestClientAsyncDirops, CreateUnlink) {
+  const unsigned nfiles = 100;
+  auto dir = make_dir();
+
+  uint64_t creates = client->logger->get(l_c_async_create);
+  uint64_t unlinks = client->logger->get(l_c_async_unlink);
+  for (unsigned i = 0; i < nfiles; ++i) {
+    auto file = fmt::format("{}/f{}", dir, i);
+    int fd = client->open(file.c_str(), O_CREAT|O_EXCL|O_WRONLY, myperm, 0644);
+    ASSERT_LE(0, fd);
+    std::string data(i, 'x');
+    ASSERT_EQ((int)i, client->write(fd, data.c_str(), i, 0));
+    ASSERT_EQ(0, client->close(fd));
+  }
+  // the first creates ask for the caps and the delegated inos
+  ASSERT_LT(creates, client->logger->get(l_c_async_create));
+
+  for (unsigned i = 0; i < nfiles; i += 2) {
+    auto file = fmt::format("{}/f{}", dir, i);
+    ASSERT_EQ(0, client->unlink(file.c_str(), myperm));
+  }
+  ASSERT_LT(unlinks, client->logger->get(l_c_async_unlink));
+
+  // what we see is what the mds has
+  for (unsigned i = 0; i < nfiles; ++i) {
+    auto file = fmt::format("{}/f{}", dir, i);
+    struct stat st;
+    ASSERT_EQ(i % 2 ? 0 : -CEPHFS_ENOENT, client->stat(file.c_str(), &st, myperm));
+  }
+  sync_dir(dir);
+  for (unsigned i = 0; i < nfiles; ++i) {
+    auto file = fmt::format("{}/f{}", dir, i);
+    struct stat st;
+    if (i % 2) {
+      ASSERT_EQ(0, other->stat(file.c_str(), &st, myperm));
+      ASSERT_EQ((off_t)i, st.st_size);
+      ASSERT_EQ((mode_t)(S_IFREG | 0644), st.st_mode);
+    } else {
+      ASSERT_EQ(-CEPHFS_ENOENT, other->stat(file.c_str(), &st, myperm));
+    }
+  }
+
+  for (unsigned i = 1; i < nfiles; i += 2) {
+    auto file = fmt::format("{}/f{}", dir, i);
+    ASSERT_EQ(0, client->unlink(file.c_str(), myperm));
+  }
+  ASSERT_EQ(0, client->rmdir(dir.c_str(), myperm));
+}
+
+TEST_F(TestClientAsyncDirops, DependentOps) {
+  const unsigned nfiles = 20;
+  auto dir = make_dir();
+
+  // ops on a file that may not have reached the mds yet wait for it
+  for (unsigned i = 0; i < nfiles; ++i) {
+    auto file = fmt::format("{}/f{}", dir, i);
+    auto renamed = fmt::format("{}/r{}", dir, i);
+    int fd = client->open(file.c_str(), O_CREAT|O_EXCL|O_WRONLY, myperm, 0600);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(0, client->close(fd));
+    ASSERT_EQ(0, client->chmod(file.c_str(), 0640, myperm));
+    ASSERT_EQ(0, client->rename(file.c_str(), renamed.c_str(), myperm));
+    // and a name that is being unlinked is created again after it
+    ASSERT_EQ(0, client->unlink(renamed.c_str(), myperm));
+    fd = client->open(renamed.c_str(), O_CREAT|O_EXCL|O_WRONLY, myperm, 0600);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(0, client->close(fd));
+  }
+  sync_dir(dir);
+
+  for (unsigned i = 0; i < nfiles; ++i) {
+    auto file = fmt::format("{}/f{}", dir, i);
+    auto renamed = fmt::format("{}/r{}", dir, i);
+    struct stat st;
+    ASSERT_EQ(-CEPHFS_ENOENT, other->stat(file.c_str(), &st, myperm));
+    ASSERT_EQ(0, other->stat(renamed.c_str(), &st, myperm));
+    ASSERT_EQ((mode_t)(S_IFREG | 0600), st.st_mode);
+    ASSERT_EQ(0, client->unlink(renamed.c_str(), myperm));
+  }
+  ASSERT_EQ(0, client->rmdir(dir.c_str(), myperm));
+}
@@ -0,0 +1,187 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+// Data path benchmark for a single libcephfs client: all threads share
+// one mount and each one writes, then reads back, its own file.  With
+// one client every call goes through the same Client instance, so the
+// numbers show how much of the data path is serialized by client_lock.
+// Run it with an increasing number of threads.
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/cephfs/libcephfs.h"
+
+struct bench_config_t {
+  std::string root = "/client_io_bench";
+  uint64_t io_size = 1 << 20;
+  uint64_t file_size = 256 << 20;
+  unsigned seconds = 20;
+  std::vector<unsigned> threads = {1, 2, 4, 8, 16};
+};
+
+static std::string file_path(const bench_config_t& conf, unsigned i)
+{
+  return conf.root + "/f" + std::to_string(i);
+}
+
+static int run(ceph_mount_info* cmount, const bench_config_t& conf,
+               bool write, unsigned nthreads)
+{
+  std::atomic<uint64_t> bytes = 0;
+  std::atomic<int> error = 0;
+  std::atomic<bool> stop = false;
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < nthreads; ++i) {
+    threads.emplace_back([&, i] {
+      int fd = ceph_open(cmount, file_path(conf, i).c_str(),
+                         write ? O_CREAT | O_WRONLY : O_RDONLY, 0644);
+      if (fd < 0) {
+        error = fd;
+        return;
+      }
+      std::vector<char> buf(conf.io_size, 'a' + i % 26);
+      uint64_t off = 0;
+      uint64_t n = 0;
+      while (!stop) {
+        int r = write ?
+          ceph_write(cmount, fd, buf.data(), buf.size(), off) :
+          ceph_read(cmount, fd, buf.data(), buf.size(), off);
+        if (r < 0) {
+          error = r;
+          break;
+        }
+        n += r;
+        off += conf.io_size;
+        if (off + conf.io_size > conf.file_size || (!write && r == 0)) {
+          off = 0;
+        }
+      }
+      ceph_close(cmount, fd);
+      bytes += n;
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::seconds(conf.seconds));
+  stop = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  if (error < 0) {
+    return error;
+  }
+  if (write) {
+    int r = ceph_sync_fs(cmount);
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  std::cout << (write ? "write" : "read ") << "  threads " << nthreads
+            << "  " << static_cast<uint64_t>(bytes / elapsed / (1 << 20))
+            << " MiB/s" << std::endl;
+  return 0;
+}
+
+static void usage(const char* name)
+{
+  std::cout << "usage: " << name << " [options]\n"
+	    << "  --root <path>          directory for the files (/client_io_bench)\n"
+	    << "  --io-size <bytes>      size of each read and write (1M)\n"
+	    << "  --file-size <bytes>    wrap around at this offset (256M)\n"
+	    << "  --seconds <n>          duration of each run (20)\n"
+	    << "  --threads <n,...>      thread counts to run (1,2,4,8,16)\n"
+	    << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  bench_config_t conf;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    }
+    if (i + 1 == argc) {
+      std::cerr << argv[0] << ": " << arg << " requires a value" << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::string val = argv[++i];
+    try {
+      if (arg == "--root") {
+        conf.root = val;
+      } else if (arg == "--io-size") {
+        conf.io_size = std::stoull(val);
+      } else if (arg == "--file-size") {
+        conf.file_size = std::stoull(val);
+      } else if (arg == "--seconds") {
+        conf.seconds = std::stoul(val);
+      } else if (arg == "--threads") {
+        conf.threads.clear();
+        std::istringstream ss(val);
+        for (std::string t; std::getline(ss, t, ','); ) {
+          conf.threads.push_back(std::max(std::stoul(t), 1ul));
+        }
+      } else {
+        std::cerr << "unknown option " << arg << std::endl;
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } catch (const std::logic_error&) {
+      std::cerr << argv[0] << ": bad value for " << arg << ": " << val
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (conf.io_size == 0 || conf.io_size > INT_MAX ||
+      conf.file_size < conf.io_size) {
+    std::cerr << argv[0] << ": io size must be between 1 and the file size"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ceph_mount_info* cmount;
+  int r = ceph_create(&cmount, nullptr);
+  if (r == 0) {
+    ceph_conf_read_file(cmount, nullptr);
+    ceph_conf_parse_env(cmount, nullptr);
+    r = ceph_mount(cmount, "/");
+  }
+  if (r == 0) {
+    r = ceph_mkdirs(cmount, conf.root.c_str(), 0755);
+    if (r == -EEXIST) {
+      r = 0;
+    }
+  }
+  if (r < 0) {
+    std::cerr << "failed to mount: " << strerror(-r) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for (bool write : {true, false}) {
+    for (auto n : conf.threads) {
+      r = run(cmount, conf, write, n);
+      if (r < 0) {
+        std::cerr << (write ? "write" : "read") << " with " << n
+                  << " threads failed: " << strerror(-r) << std::endl;
+        ceph_shutdown(cmount);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  ceph_shutdown(cmount);
+  return EXIT_SUCCESS;
+}
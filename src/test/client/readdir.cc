@@ -0,0 +1,110 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <errno.h>
+
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "test/client/TestClient.h"
+
+// the other client holds the files open for write, so that the client
+// under test is not issued caps on them
+class TestClientReaddir : public TestClientWithOther {
+};
+
+TEST_F(TestClientReaddir, SingleEntryWithoutCaps) {
+  const unsigned nfiles = 200;
+  auto dir = fmt::format("{}_{}", ::testing::UnitTest::GetInstance()->current_test_info()->name(), getpid());
+  ASSERT_EQ(0, client->mkdir(dir.c_str(), 0777, myperm));
+
+  // the files are created and kept open for write by the other client
+  std::vector<int> fds;
+  for (unsigned i = 0; i < nfiles; ++i) {
+    auto file = fmt::format("{}/f{}", dir, i);
+    int fd = other->open(file.c_str(), O_CREAT|O_WRONLY, myperm, 0666);
+    ASSERT_LE(0, fd);
+    std::string data(i, 'x');
+    ASSERT_EQ((int)i, other->write(fd, data.c_str(), i, 0));
+    fds.push_back(fd);
+  }
+
+  // consume one entry per call, as readdir_r and Ganesha do, and count
+  // the MDS replies that took
+  auto read_dir = [&](uint64_t *replies) {
+    // a create in the directory takes away our Fs on it, so that the
+    // scan cannot be served from the readdir cache of an earlier one
+    auto scratch = fmt::format("{}/scratch", dir);
+    int fd = other->open(scratch.c_str(), O_CREAT|O_WRONLY, myperm, 0666);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(0, other->close(fd));
+    ASSERT_EQ(0, other->unlink(scratch.c_str(), myperm));
+
+    dir_result_t *dirp;
+    ASSERT_EQ(0, client->opendir(dir.c_str(), &dirp, myperm));
+    *replies = client->logger->get_tavg_ns(l_c_reply).first;
+    std::vector<bool> seen(nfiles);
+    unsigned found = 0;
+    while (true) {
+      struct dirent de;
+      struct ceph_statx stx;
+      int r = client->readdirplus_r(dirp, &de, &stx, CEPH_STATX_SIZE, 0,
+				    nullptr);
+      if (r == 0)
+	break;
+      ASSERT_EQ(1, r);
+      std::string name(de.d_name);
+      if (name == "." || name == "..")
+	continue;
+      unsigned i;
+      ASSERT_EQ(1, sscanf(name.c_str(), "f%u", &i));
+      ASSERT_LT(i, nfiles);
+      ASSERT_FALSE(seen[i]) << name << " returned twice";
+      seen[i] = true;
+      ++found;
+      ASSERT_TRUE(stx.stx_mask & CEPH_STATX_SIZE);
+      ASSERT_EQ((uint64_t)i, stx.stx_size);
+    }
+    *replies = client->logger->get_tavg_ns(l_c_reply).first - *replies;
+    ASSERT_EQ(nfiles, found);
+    ASSERT_EQ(0, client->closedir(dirp));
+  };
+  auto& conf = g_ceph_context->_conf;
+  auto timeout = conf.get_val<std::chrono::milliseconds>(
+    "client_readdir_attr_timeout");
+
+  // the attributes of the chunk are used as they came: one readdir
+  uint64_t replies;
+  conf.set_val_or_die("client_readdir_attr_timeout", "600000");
+  read_dir(&replies);
+  ASSERT_FALSE(HasFatalFailure());
+  ASSERT_LE(replies, 2u);
+
+  // they are always stale: each entry re-reads the rest of the chunk,
+  // with no getattr on top of that
+  conf.set_val_or_die("client_readdir_attr_timeout", "0");
+  read_dir(&replies);
+  ASSERT_FALSE(HasFatalFailure());
+  ASSERT_LE(replies, nfiles + 2);
+
+  conf.set_val_or_die("client_readdir_attr_timeout",
+		      std::to_string(timeout.count()));
+
+  for (unsigned i = 0; i < nfiles; ++i) {
+    ASSERT_EQ(0, other->close(fds[i]));
+    auto file = fmt::format("{}/f{}", dir, i);
+    ASSERT_EQ(0, client->unlink(file.c_str(), myperm));
+  }
+  ASSERT_EQ(0, client->rmdir(dir.c_str(), myperm));
+}
@@ -0,0 +1,70 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+// Reader throughput with many threads taking the lock shared, as
+// Objecter does on op submission, compared with a plain shared_mutex.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "common/sharded_shared_mutex.h"
+
+using ceph::sharded_shared_mutex;
+
+template <typename Mutex>
+static double read_mostly_mops(Mutex& m, unsigned nthreads, unsigned ops)
+{
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned t = 0; t < nthreads; ++t) {
+    threads.emplace_back([&m, t, ops] {
+      for (unsigned i = 0; i < ops; ++i) {
+	if (t == 0 && i % 10000 == 0) {
+	  std::unique_lock l(m);
+	} else {
+	  std::shared_lock l(m);
+	}
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  return (double(ops) * nthreads) / elapsed.count() / 1e6;
+}
+
+static void usage(const char *name) {
+  std::cout << name << " [threads [ops]]\n"
+	    << "\t threads: the number of threads (default: number of cpus, at least 4)\n"
+	    << "\t ops: the number of lock/unlock cycles per thread (default: 200000)\n";
+}
+
+int main(int argc, const char **argv)
+{
+  unsigned nthreads = std::max(4u, std::thread::hardware_concurrency());
+  unsigned ops = 200000;
+  if (argc > 3 ||
+      (argc > 1 && (nthreads = atoi(argv[1])) == 0) ||
+      (argc > 2 && (ops = atoi(argv[2])) == 0)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::shared_mutex plain;
+  sharded_shared_mutex sharded("sharded");
+  std::cout << "threads " << nthreads << ", " << ops << " ops per thread\n"
+	    << "shared_mutex " << read_mostly_mops(plain, nthreads, ops)
+	    << " Mops/s\n"
+	    << "sharded_shared_mutex(" << sharded.get_num_shards() << ") "
+	    << read_mostly_mops(sharded, nthreads, ops) << " Mops/s"
+	    << std::endl;
+  return EXIT_SUCCESS;
+}
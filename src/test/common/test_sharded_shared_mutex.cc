@@ -0,0 +1,143 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <future>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+#include "common/sharded_shared_mutex.h"
+#include "common/shunique_lock.h"
+
+#include "gtest/gtest.h"
+
+using ceph::sharded_shared_mutex;
+
+static bool try_lock_elsewhere(sharded_shared_mutex& m) {
+  return std::async(std::launch::async, [&m] {
+    if (!m.try_lock())
+      return false;
+    m.unlock();
+    return true;
+  }).get();
+}
+
+static bool try_lock_shared_elsewhere(sharded_shared_mutex& m) {
+  return std::async(std::launch::async, [&m] {
+    if (!m.try_lock_shared())
+      return false;
+    m.unlock_shared();
+    return true;
+  }).get();
+}
+
+TEST(ShardedSharedMutex, Unique) {
+  sharded_shared_mutex m("m", 4);
+  ASSERT_EQ(4u, m.get_num_shards());
+  {
+    std::unique_lock l(m);
+    ASSERT_FALSE(try_lock_elsewhere(m));
+    ASSERT_FALSE(try_lock_shared_elsewhere(m));
+  }
+  ASSERT_TRUE(try_lock_elsewhere(m));
+  ASSERT_TRUE(try_lock_shared_elsewhere(m));
+}
+
+TEST(ShardedSharedMutex, Shared) {
+  sharded_shared_mutex m("m", 4);
+  {
+    std::shared_lock l(m);
+    ASSERT_FALSE(try_lock_elsewhere(m));
+    ASSERT_TRUE(try_lock_shared_elsewhere(m));
+  }
+  ASSERT_TRUE(m.try_lock());
+  m.unlock();
+}
+
+#ifdef CEPH_DEBUG_MUTEX
+TEST(ShardedSharedMutex, DebugState) {
+  sharded_shared_mutex m("m", 4);
+  ASSERT_FALSE(ceph_mutex_is_locked(m));
+  {
+    std::shared_lock l(m);
+    ASSERT_TRUE(ceph_mutex_is_rlocked(m));
+    ASSERT_FALSE(ceph_mutex_is_wlocked(m));
+  }
+  {
+    std::unique_lock l(m);
+    ASSERT_TRUE(ceph_mutex_is_wlocked(m));
+    ASSERT_TRUE(ceph_mutex_is_locked_by_me(m));
+  }
+  ASSERT_FALSE(ceph_mutex_is_locked(m));
+}
+#endif
+
+TEST(ShardedSharedMutex, SharedFromManyThreads) {
+  // readers land on different shards; a writer must still exclude all
+  sharded_shared_mutex m("m", 3);
+  std::vector<std::thread> readers;
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  std::atomic<unsigned> locked{0};
+  for (unsigned i = 0; i < 8; ++i) {
+    readers.emplace_back([&] {
+      std::shared_lock l(m);
+      locked++;
+      released.wait();
+    });
+  }
+  while (locked < 8) {
+    std::this_thread::yield();
+  }
+  ASSERT_FALSE(try_lock_elsewhere(m));
+  release.set_value();
+  for (auto& t : readers) {
+    t.join();
+  }
+  ASSERT_TRUE(try_lock_elsewhere(m));
+}
+
+TEST(ShardedSharedMutex, Shunique) {
+  sharded_shared_mutex m("m");
+  ceph::shunique_lock l(m, ceph::acquire_shared);
+  ASSERT_TRUE(l.owns_lock_shared());
+  ASSERT_FALSE(try_lock_elsewhere(m));
+  l.unlock();
+  l.lock();
+  ASSERT_TRUE(l.owns_lock());
+  ASSERT_FALSE(try_lock_shared_elsewhere(m));
+  l.unlock();
+  ASSERT_TRUE(try_lock_elsewhere(m));
+}
+
+TEST(ShardedSharedMutex, Exclusion) {
+  // writers must observe and leave a consistent pair under concurrent
+  // readers and writers
+  sharded_shared_mutex m("m", 4);
+  uint64_t a = 0, b = 0;
+  std::atomic<bool> bad{false};
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t] {
+      for (unsigned i = 0; i < 20000; ++i) {
+	if (t % 4 == 0 && i % 16 == 0) {
+	  std::unique_lock l(m);
+	  a++;
+	  b++;
+	} else {
+	  std::shared_lock l(m);
+	  if (a != b) {
+	    bad = true;
+	  }
+	}
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_FALSE(bad);
+  ASSERT_EQ(a, b);
+}
@@ -314,12 +314,12 @@ TEST_F(btree_lba_manager_test, basic)
 TEST_F(btree_lba_manager_test, force_split)
 {
   run_async([this] {
-    for (unsigned i = 0; i < 40; ++i) {
+    for (unsigned i = 0; i < 400; ++i) {
       auto t = create_transaction();
       logger().debug("opened transaction");
       for (unsigned j = 0; j < 5; ++j) {
 	auto ret = alloc_mapping(t, 0, block_size, get_paddr());
-	if ((i % 10 == 0) && (j == 3)) {
+	if ((i % 100 == 0) && (j == 3)) {
 	  check_mappings(t);
 	  check_mappings();
 	}
@@ -334,7 +334,7 @@ TEST_F(btree_lba_manager_test, force_split)
 TEST_F(btree_lba_manager_test, force_split_merge)
 {
   run_async([this] {
-    for (unsigned i = 0; i < 80; ++i) {
+    for (unsigned i = 0; i < 400; ++i) {
       auto t = create_transaction();
       logger().debug("opened transaction");
       for (unsigned j = 0; j < 5; ++j) {
@@ -394,7 +394,7 @@ TEST_F(btree_lba_manager_test, single_transaction_split_merge)
   run_async([this] {
     {
       auto t = create_transaction();
-      for (unsigned i = 0; i < 600; ++i) {
+      for (unsigned i = 0; i < 3000; ++i) {
 	alloc_mapping(t, 0, block_size, get_paddr());
       }
       check_mappings(t);
@@ -417,7 +417,7 @@ TEST_F(btree_lba_manager_test, single_transaction_split_merge)
 
     {
       auto t = create_transaction();
-      for (unsigned i = 0; i < 600; ++i) {
+      for (unsigned i = 0; i < 3000; ++i) {
 	alloc_mapping(t, 0, block_size, get_paddr());
       }
       auto addresses = get_mapped_addresses(t);
@@ -0,0 +1,400 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <stdio.h>
+#include <iostream>
+#include <map>
+#include <random>
+
+#include "gtest/gtest.h"
+
+#include "crimson/common/delta_kv_node_layout.h"
+
+using namespace crimson;
+using namespace crimson::common;
+
+struct test_val_t {
+  uint32_t t1 = 0;
+  int32_t t2 = 0;
+
+  bool operator==(const test_val_t &rhs) const {
+    return rhs.t1 == t1 && rhs.t2 == t2;
+  }
+  bool operator!=(const test_val_t &rhs) const {
+    return !(*this == rhs);
+  }
+};
+
+struct test_val_le_t {
+  ceph_le32 t1{0};
+  ceph_les32 t2{0};
+
+  test_val_le_t() = default;
+  test_val_le_t(const test_val_le_t &) = default;
+  test_val_le_t(const test_val_t &nv)
+    : t1(nv.t1), t2(nv.t2) {}
+
+  operator test_val_t() const {
+    return test_val_t{t1, t2};
+  }
+};
+
+struct test_meta_t {
+  uint32_t t1 = 0;
+  uint32_t t2 = 0;
+
+  bool operator==(const test_meta_t &rhs) const {
+    return rhs.t1 == t1 && rhs.t2 == t2;
+  }
+  bool operator!=(const test_meta_t &rhs) const {
+    return !(*this == rhs);
+  }
+
+  std::pair<test_meta_t, test_meta_t> split_into(uint32_t pivot) const {
+    return std::make_pair(
+      test_meta_t{t1, pivot},
+      test_meta_t{pivot, t2});
+  }
+
+  static test_meta_t merge_from(const test_meta_t &lhs, const test_meta_t &rhs) {
+    return test_meta_t{lhs.t1, rhs.t2};
+  }
+
+  static std::pair<test_meta_t, test_meta_t>
+  rebalance(const test_meta_t &lhs, const test_meta_t &rhs, uint32_t pivot) {
+    return std::make_pair(
+      test_meta_t{lhs.t1, pivot},
+      test_meta_t{pivot, rhs.t2});
+  }
+};
+
+struct test_meta_le_t {
+  ceph_le32 t1{0};
+  ceph_le32 t2{0};
+
+  test_meta_le_t() = default;
+  test_meta_le_t(const test_meta_le_t &) = default;
+  test_meta_le_t(const test_meta_t &nv)
+    : t1(nv.t1), t2(nv.t2) {}
+
+  operator test_meta_t() const {
+    return test_meta_t{t1, t2};
+  }
+};
+
+struct test_codec_t {
+  using entry_t = std::pair<uint32_t, test_val_t>;
+
+  static constexpr size_t FULL_SIZE = 12;
+  static constexpr size_t MAX_DELTA_SIZE = 3 * DELTA_VARINT_MAX_SIZE;
+
+  static void encode_full(char *out, uint32_t key, const test_val_t &val) {
+    ceph_le32 k(key);
+    test_val_le_t v(val);
+    ::memcpy(out, &k, sizeof(k));
+    ::memcpy(out + sizeof(k), &v, sizeof(v));
+  }
+
+  static entry_t decode_full(const char *in) {
+    ceph_le32 k;
+    test_val_le_t v;
+    ::memcpy(&k, in, sizeof(k));
+    ::memcpy(&v, in + sizeof(k), sizeof(v));
+    return entry_t(k, v);
+  }
+
+  static size_t encode_delta(
+    char *out, const entry_t &prev, uint32_t key, const test_val_t &val) {
+    char *p = out;
+    p += encode_delta_varint(p, key - prev.first);
+    p += encode_delta_signed_varint(p, int64_t(val.t1) - prev.second.t1);
+    p += encode_delta_signed_varint(p, int64_t(val.t2) - prev.second.t2);
+    return p - out;
+  }
+
+  static size_t decode_delta(
+    const char *in, const entry_t &prev, entry_t &out) {
+    const char *p = in;
+    uint64_t key_delta;
+    int64_t t1_delta, t2_delta;
+    p += decode_delta_varint(p, key_delta);
+    p += decode_delta_signed_varint(p, t1_delta);
+    p += decode_delta_signed_varint(p, t2_delta);
+    out.first = prev.first + key_delta;
+    out.second.t1 = prev.second.t1 + t1_delta;
+    out.second.t2 = prev.second.t2 + t2_delta;
+    return p - in;
+  }
+};
+
+constexpr size_t NODE_SIZE = 4096;
+
+struct TestNode : DeltaKVNodeLayout<
+  NODE_SIZE, 16,
+  test_meta_t, test_meta_le_t,
+  uint32_t, ceph_le32,
+  test_val_t, test_val_le_t,
+  test_codec_t> {
+  char buf[NODE_SIZE];
+  TestNode() : DeltaKVNodeLayout(buf) {
+    memset(buf, 0, sizeof(buf));
+    clear();
+    set_meta({0, std::numeric_limits<uint32_t>::max()});
+  }
+  TestNode(const TestNode &rhs)
+    : DeltaKVNodeLayout(buf) {
+    ::memcpy(buf, rhs.buf, sizeof(buf));
+  }
+};
+
+/// fills node with sequential entries until at_max_capacity
+unsigned fill_sequential(TestNode &node, unsigned num = 0)
+{
+  auto iter = node.end();
+  while (!node.at_max_capacity()) {
+    node.journal_insert(iter, num, test_val_t{num, (int32_t)num}, nullptr);
+    ++num;
+    ++iter;
+  }
+  return num;
+}
+
+void check_sequential(const TestNode &node, unsigned num, unsigned last)
+{
+  for (auto &i : node) {
+    ASSERT_EQ(i.get_key(), num);
+    ASSERT_EQ(i.get_val(), (test_val_t{num, (int32_t)num}));
+    if (num < last) {
+      ASSERT_EQ(i.get_next_key_or_max(), num + 1);
+    } else {
+      ASSERT_EQ(std::numeric_limits<uint32_t>::max(), i.get_next_key_or_max());
+    }
+    ++num;
+  }
+}
+
+TEST(DeltaKVNodeTest, basic) {
+  auto node = TestNode();
+  ASSERT_EQ(node.get_size(), 0);
+
+  auto val = test_val_t{ 1, 1 };
+  node.journal_insert(node.begin(), 1, val, nullptr);
+  ASSERT_EQ(node.get_size(), 1);
+
+  auto iter = node.begin();
+  ASSERT_EQ(iter.get_key(), 1);
+  ASSERT_EQ(val, iter.get_val());
+
+  ASSERT_EQ(std::numeric_limits<uint32_t>::max(), iter.get_next_key_or_max());
+}
+
+TEST(DeltaKVNodeTest, at_capacity) {
+  auto node = TestNode();
+  auto num = fill_sequential(node);
+  ASSERT_EQ(node.get_size(), num);
+
+  // sequential runs should pack several times denser than the
+  // equivalent FixedKVNodeLayout (339 entries)
+  ASSERT_GT(num, 339u * 2);
+  check_sequential(node, 0, num - 1);
+}
+
+TEST(DeltaKVNodeTest, search) {
+  auto node = TestNode();
+  for (uint32_t i = 0; i < 500; ++i) {
+    node.journal_insert(node.end(), i * 2, test_val_t{i, 0}, nullptr);
+  }
+  for (uint32_t i = 0; i < 1000; ++i) {
+    auto lb = node.lower_bound(i);
+    auto ub = node.upper_bound(i);
+    auto f = node.find(i);
+    ASSERT_EQ(lb.get_offset(), (i + 1) / 2);
+    ASSERT_EQ(ub.get_offset(), (i / 2) + 1);
+    if (i % 2) {
+      ASSERT_TRUE(f == node.end());
+    } else {
+      ASSERT_EQ(f.get_key(), i);
+    }
+  }
+  ASSERT_TRUE(node.lower_bound(1000) == node.end());
+}
+
+TEST(DeltaKVNodeTest, split) {
+  auto node = TestNode();
+  auto num = fill_sequential(node);
+  auto total = node.get_size();
+
+  auto split_left = TestNode();
+  auto split_right = TestNode();
+  auto pivot = node.split_into(split_left, split_right);
+
+  ASSERT_EQ(split_left.get_size() + split_right.get_size(), total);
+  ASSERT_EQ(pivot, split_right.begin()->get_key());
+  ASSERT_EQ(split_left.get_meta().t1, split_left.begin()->get_key());
+  ASSERT_EQ(split_left.get_meta().t2, split_right.get_meta().t1);
+  ASSERT_EQ(split_right.get_meta().t2, std::numeric_limits<uint32_t>::max());
+  ASSERT_FALSE(split_left.at_max_capacity());
+  ASSERT_FALSE(split_right.at_max_capacity());
+
+  unsigned last = split_left.get_size() - 1;
+  for (auto &i : split_left) {
+    ASSERT_EQ(i.get_val(), (test_val_t{i.get_key(), (int32_t)i.get_key()}));
+  }
+  ASSERT_EQ((split_left.end() - 1)->get_key(), last);
+  check_sequential(split_right, last + 1, num - 1);
+}
+
+TEST(DeltaKVNodeTest, merge) {
+  auto node = TestNode();
+  auto node2 = TestNode();
+
+  unsigned num = 0;
+  while (node.at_min_capacity()) {
+    node.journal_insert(node.end(), num, test_val_t{num, (int32_t)num}, nullptr);
+    ++num;
+  }
+  node.journal_remove(node.end() - 1, nullptr);
+  --num;
+  node.set_meta({0, num});
+  node2.set_meta({num, std::numeric_limits<uint32_t>::max()});
+  auto start = num;
+  while (node2.at_min_capacity()) {
+    node2.journal_insert(node2.end(), num, test_val_t{num, (int32_t)num}, nullptr);
+    ++num;
+  }
+  node2.journal_remove(node2.end() - 1, nullptr);
+  --num;
+
+  ASSERT_TRUE(node.at_min_capacity());
+  ASSERT_TRUE(node2.at_min_capacity());
+  ASSERT_EQ(node2.get_size(), num - start);
+
+  auto total = node.get_size() + node2.get_size();
+
+  auto node_merged = TestNode();
+  node_merged.merge_from(node, node2);
+
+  ASSERT_FALSE(node_merged.at_max_capacity());
+  ASSERT_EQ(
+    node_merged.get_meta(),
+    (test_meta_t{0, std::numeric_limits<uint32_t>::max()}));
+  ASSERT_EQ(node_merged.get_size(), total);
+  check_sequential(node_merged, 0, total - 1);
+}
+
+TEST(DeltaKVNodeTest, balanced) {
+  for (bool prefer_left : { true, false }) {
+    auto node = TestNode();
+    auto node2 = TestNode();
+    unsigned num = 0;
+    for (; num < 10; ++num) {
+      node.journal_insert(
+	node.end(), num, test_val_t{num, (int32_t)num}, nullptr);
+    }
+    node.set_meta({0, num});
+    node2.set_meta({num, std::numeric_limits<uint32_t>::max()});
+    num = fill_sequential(node2, num);
+
+    auto total = node.get_size() + node2.get_size();
+    auto node_balanced = TestNode();
+    auto node_balanced2 = TestNode();
+    auto pivot = TestNode::balance_into_new_nodes(
+      node,
+      node2,
+      prefer_left,
+      node_balanced,
+      node_balanced2);
+
+    ASSERT_EQ(total, node_balanced.get_size() + node_balanced2.get_size());
+    ASSERT_EQ(pivot, node_balanced.get_size());
+    ASSERT_FALSE(node_balanced.at_min_capacity());
+    ASSERT_FALSE(node_balanced2.at_min_capacity());
+    ASSERT_EQ(
+      node_balanced.get_meta(),
+      (test_meta_t{0, pivot}));
+    ASSERT_EQ(
+      node_balanced2.get_meta(),
+      (test_meta_t{pivot, std::numeric_limits<uint32_t>::max()}));
+    check_sequential(node_balanced, 0, pivot - 1);
+    check_sequential(node_balanced2, pivot, total - 1);
+  }
+}
+
+TEST(DeltaKVNodeTest, random) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<uint32_t> key_dist(0, 1 << 20);
+  std::map<uint32_t, test_val_t> model;
+  auto node = TestNode();
+  for (unsigned i = 0; i < 20000; ++i) {
+    auto key = key_dist(gen);
+    auto iter = node.lower_bound(key);
+    bool present = iter != node.end() && iter.get_key() == key;
+    ASSERT_EQ(present, model.count(key) == 1);
+    if (present && (gen() % 2)) {
+      if (gen() % 2) {
+	node.journal_remove(iter, nullptr);
+	model.erase(key);
+      } else if (!node.at_max_capacity()) {
+	auto val = test_val_t{(uint32_t)gen(), (int32_t)gen()};
+	node.journal_update(iter, val, nullptr);
+	model[key] = val;
+      }
+    } else if (!present && !node.at_max_capacity()) {
+      auto val = test_val_t{key, -(int32_t)key};
+      node.journal_insert(iter, key, val, nullptr);
+      model[key] = val;
+    }
+  }
+  ASSERT_EQ(node.get_size(), model.size());
+  auto iter = node.begin();
+  for (auto &[k, v] : model) {
+    ASSERT_EQ(iter.get_key(), k);
+    ASSERT_EQ(iter.get_val(), v);
+    ++iter;
+  }
+}
+
+void run_replay_test(
+  std::vector<std::function<void(TestNode&, TestNode::delta_buffer_t&)>> &&f
+) {
+  TestNode node;
+  for (unsigned i = 0; i < f.size(); ++i) {
+    TestNode::delta_buffer_t buf;
+    TestNode replayed = node;
+    f[i](node, buf);
+    buf.replay(replayed);
+    ASSERT_EQ(node.get_size(), replayed.get_size());
+    ASSERT_EQ(node, replayed);
+    ASSERT_EQ(0, ::memcmp(node.buf, replayed.buf, NODE_SIZE));
+  }
+}
+
+TEST(DeltaKVNodeTest, replay) {
+  run_replay_test({
+      [](auto &n, auto &b) {
+	n.journal_insert(n.lower_bound(1), 1, test_val_t{1, 1}, &b);
+	ASSERT_EQ(1, n.get_size());
+      },
+      [](auto &n, auto &b) {
+	n.journal_insert(n.lower_bound(3), 3, test_val_t{1, 2}, &b);
+	ASSERT_EQ(2, n.get_size());
+      },
+      [](auto &n, auto &b) {
+	n.journal_remove(n.find(3), &b);
+	ASSERT_EQ(1, n.get_size());
+      },
+      [](auto &n, auto &b) {
+	n.journal_insert(n.lower_bound(2), 2, test_val_t{5, 1}, &b);
+	ASSERT_EQ(2, n.get_size());
+      },
+      [](auto &n, auto &b) {
+	for (uint32_t i = 10; i < 100; ++i) {
+	  n.journal_insert(n.lower_bound(i), i, test_val_t{i, 1}, &b);
+	}
+	n.journal_update(n.find(50), test_val_t{7, 7}, &b);
+	n.journal_remove(n.find(60), &b);
+	n.journal_replace(n.find(61), 60, test_val_t{8, 8}, &b);
+	ASSERT_EQ(91, n.get_size());
+      }
+  });
+}
@@ -27,6 +27,10 @@ class MockCacheClient {
   MOCK_METHOD6(lookup_object, void(std::string, uint64_t, uint64_t, uint64_t,
                                   std::string, CacheGenContextURef));
   MOCK_METHOD1(register_client, int(Context*));
+  MOCK_CONST_METHOD0(supports_promote, bool());
+  MOCK_METHOD6(promote_objects, void(std::string, uint64_t, uint64_t, uint64_t,
+                                     std::vector<std::string>,
+                                     CacheGenContextURef));
 };
 
 class MockCacheServer {
@@ -0,0 +1,109 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <unistd.h>
+#include <gtest/gtest.h>
+
+#include "global/global_context.h"
+#include "tools/immutable_object_cache/ShmIndex.h"
+
+using namespace ceph::immutable_obj_cache;
+
+class TestShmIndex : public ::testing::Test {
+public:
+  std::string m_path;
+
+  void SetUp() override {
+    m_path = "/tmp/ceph_test_shm_index." + std::to_string(getpid());
+  }
+  void TearDown() override {
+    ::unlink(m_path.c_str());
+  }
+};
+
+TEST_F(TestShmIndex, InsertLookupErase) {
+  ShmIndex index(g_ceph_context);
+  ASSERT_FALSE(index.lookup("ns:1:2:obj"));
+  ASSERT_EQ(0, index.create(m_path, 1024));
+
+  ASSERT_TRUE(index.insert("ns:1:2:obj"));
+  ASSERT_TRUE(index.insert("ns:1:2:obj2"));
+  ASSERT_TRUE(index.lookup("ns:1:2:obj"));
+  ASSERT_TRUE(index.lookup("ns:1:2:obj2"));
+  ASSERT_FALSE(index.lookup("ns:1:3:obj"));
+
+  // re-inserting keeps a single slot
+  ASSERT_TRUE(index.insert("ns:1:2:obj"));
+  index.erase("ns:1:2:obj");
+  ASSERT_FALSE(index.lookup("ns:1:2:obj"));
+  ASSERT_TRUE(index.lookup("ns:1:2:obj2"));
+}
+
+TEST_F(TestShmIndex, NamesOfOneLength) {
+  // names of one length differ only in their data, which is all a pair
+  // of hashes of the same family would have to go on
+  ShmIndex index(g_ceph_context);
+  ASSERT_EQ(0, index.create(m_path, 1 << 16));
+  char name[64];
+  for (int i = 0; i < 4096; ++i) {
+    snprintf(name, sizeof(name), "rbd_data.1234.%016x", i);
+    ASSERT_TRUE(index.insert(name));
+  }
+  for (int i = 0; i < 4096; ++i) {
+    snprintf(name, sizeof(name), "rbd_data.1234.%016x", i);
+    ASSERT_TRUE(index.lookup(name));
+    snprintf(name, sizeof(name), "rbd_data.5678.%016x", i);
+    ASSERT_FALSE(index.lookup(name));
+  }
+}
+
+TEST_F(TestShmIndex, SharedWithReader) {
+  ShmIndex writer(g_ceph_context);
+  ShmIndex reader(g_ceph_context);
+  ASSERT_EQ(-ENOENT, reader.open(m_path));
+
+  ASSERT_EQ(0, writer.create(m_path, 128));
+  ASSERT_EQ(0, reader.open(m_path));
+  ASSERT_FALSE(reader.lookup("obj"));
+
+  ASSERT_TRUE(writer.insert("obj"));
+  ASSERT_TRUE(reader.lookup("obj"));
+  writer.erase("obj");
+  ASSERT_FALSE(reader.lookup("obj"));
+
+  // a restarted daemon publishes a new file, old readers keep the old one
+  ASSERT_TRUE(writer.insert("obj"));
+  ASSERT_EQ(0, writer.create(m_path, 128));
+  ASSERT_TRUE(reader.lookup("obj"));
+  ASSERT_EQ(0, reader.open(m_path));
+  ASSERT_FALSE(reader.lookup("obj"));
+}
+
+TEST_F(TestShmIndex, InvalidFile) {
+  ShmIndex index(g_ceph_context);
+  FILE *f = fopen(m_path.c_str(), "w");
+  ASSERT_TRUE(f != nullptr);
+  fputs("not an index", f);
+  fclose(f);
+  ASSERT_EQ(-EINVAL, index.open(m_path));
+  ASSERT_FALSE(index.is_open());
+}
+
+TEST_F(TestShmIndex, ProbeWindowFull) {
+  // with fewer slots than the probe window every name competes for all slots
+  const uint64_t slots = 4;
+  ShmIndex index(g_ceph_context);
+  ASSERT_EQ(0, index.create(m_path, slots));
+  for (uint64_t i = 0; i < slots; ++i) {
+    ASSERT_TRUE(index.insert("obj" + std::to_string(i)));
+  }
+  ASSERT_FALSE(index.insert("obj" + std::to_string(slots)));
+
+  // removed slots are reused
+  index.erase("obj0");
+  ASSERT_TRUE(index.insert("obj" + std::to_string(slots)));
+  ASSERT_FALSE(index.lookup("obj0"));
+  for (uint64_t i = 1; i <= slots; ++i) {
+    ASSERT_TRUE(index.lookup("obj" + std::to_string(i)));
+  }
+}
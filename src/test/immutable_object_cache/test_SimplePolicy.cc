@@ -233,3 +233,17 @@ TEST_F(TestSimplePolicy, test_evict_list_10) {
     m_promoted_lru.erase(m_promoted_lru.begin());
   }
 }
+
+TEST_F(TestSimplePolicy, test_touch) {
+  // touching the coldest entry makes it the hottest
+  std::string coldest = m_promoted_lru.front();
+  m_simple_policy->touch(coldest);
+  m_promoted_lru.erase(m_promoted_lru.begin());
+  m_promoted_lru.push_back(coldest);
+  ASSERT_EQ(m_promoted_lru.front(), m_simple_policy->get_evict_entry());
+
+  // but does not promote unknown objects
+  m_simple_policy->touch("touched_file");
+  ASSERT_EQ(OBJ_CACHE_NONE, m_simple_policy->get_status("touched_file"));
+  ASSERT_EQ(m_promoted_lru.size(), m_simple_policy->get_promoted_entry_num());
+}
@@ -48,3 +48,77 @@ TEST(test_for_message, test_1)
   delete req;
   delete req_decode;
 }
+
+TEST(test_for_message, test_promote)
+{
+  std::vector<std::string> oids{"rbd_data.1234.0000000000000000",
+                                "rbd_data.1234.0000000000000001"};
+  ObjectCacheRequest* req = new ObjectCachePromoteData(
+    RBDSC_PROMOTE, 42, 3, 7, 4194304, "ns", oids);
+  req->encode();
+  auto payload_bl = req->get_payload_bufferlist();
+
+  ObjectCacheRequest* req_decode = decode_object_cache_request(payload_bl);
+  ASSERT_EQ(req_decode->get_request_type(), RBDSC_PROMOTE);
+  auto promote_decode = (ObjectCachePromoteData*)req_decode;
+  ASSERT_EQ(promote_decode->seq, 42UL);
+  ASSERT_EQ(promote_decode->pool_id, 3UL);
+  ASSERT_EQ(promote_decode->snap_id, 7UL);
+  ASSERT_EQ(promote_decode->object_size, 4194304UL);
+  ASSERT_EQ(promote_decode->pool_namespace, "ns");
+  ASSERT_EQ(promote_decode->oids, oids);
+
+  delete req;
+  delete req_decode;
+}
+
+TEST(test_for_message, test_touch)
+{
+  std::vector<std::string> names{"ns:3:7:rbd_data.1234.0000000000000000",
+                                 "ns:3:7:rbd_data.1234.0000000000000001"};
+  ObjectCacheRequest* req = new ObjectCacheTouchData(RBDSC_TOUCH, 43, names);
+  req->encode();
+  auto payload_bl = req->get_payload_bufferlist();
+
+  ObjectCacheRequest* req_decode = decode_object_cache_request(payload_bl);
+  ASSERT_EQ(req_decode->get_request_type(), RBDSC_TOUCH);
+  auto touch_decode = (ObjectCacheTouchData*)req_decode;
+  ASSERT_EQ(touch_decode->seq, 43UL);
+  ASSERT_EQ(touch_decode->cache_file_names, names);
+
+  delete req;
+  delete req_decode;
+}
+
+TEST(test_for_message, test_register_reply)
+{
+  ObjectCacheRequest* req = new ObjectCacheRegReplyData(
+    RBDSC_REGISTER_REPLY, 1, RBDSC_FEATURE_PROMOTE, "/cache/", "/cache/index");
+  req->encode();
+  auto payload_bl = req->get_payload_bufferlist();
+
+  ObjectCacheRequest* req_decode = decode_object_cache_request(payload_bl);
+  ASSERT_EQ(req_decode->get_request_type(), RBDSC_REGISTER_REPLY);
+  auto reply_decode = (ObjectCacheRegReplyData*)req_decode;
+  ASSERT_EQ(reply_decode->features, RBDSC_FEATURE_PROMOTE);
+  ASSERT_EQ(reply_decode->cache_dir, "/cache/");
+  ASSERT_EQ(reply_decode->shm_index_path, "/cache/index");
+  delete req_decode;
+
+  delete req;
+
+  // a reply from an older daemon carries no payload
+  bufferlist old_bl;
+  ENCODE_START(2, 1, old_bl);
+  ceph::encode((uint16_t)RBDSC_REGISTER_REPLY, old_bl);
+  ceph::encode((uint64_t)2, old_bl);
+  ENCODE_FINISH(old_bl);
+
+  req_decode = decode_object_cache_request(old_bl);
+  ASSERT_EQ(req_decode->get_request_type(), RBDSC_REGISTER_REPLY);
+  reply_decode = (ObjectCacheRegReplyData*)req_decode;
+  ASSERT_EQ(reply_decode->features, 0UL);
+  ASSERT_TRUE(reply_decode->cache_dir.empty());
+  ASSERT_TRUE(reply_decode->shm_index_path.empty());
+  delete req_decode;
+}
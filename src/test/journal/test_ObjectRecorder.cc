@@ -55,7 +55,8 @@ public:
 			  uint32_t flush_interval,
 			  uint16_t flush_bytes,
 			  double flush_age,
-			  int max_in_flight)
+			  int max_in_flight,
+			  bool group_commit = false)
       : m_ioctx{ioctx},
 	m_work_queue{work_queue},
 	m_flush_interval{flush_interval},
@@ -63,7 +64,8 @@ public:
 	m_flush_age{flush_age},
 	m_max_in_flight_appends{max_in_flight < 0 ?
 				std::numeric_limits<uint64_t>::max() :
-				static_cast<uint64_t>(max_in_flight)}
+				static_cast<uint64_t>(max_in_flight)},
+	m_group_commit{group_commit}
     {}
     ~ObjectRecorderFlusher() {
       for (auto& [object_recorder, m] : m_object_recorders) {
@@ -79,7 +81,7 @@ public:
     auto create_object(std::string_view oid, uint8_t order, ceph::mutex* lock) {
       auto object = ceph::make_ref<journal::ObjectRecorder>(
         m_ioctx, oid, 0, lock, m_work_queue, &m_handler,
-	order, m_max_in_flight_appends);
+	order, m_max_in_flight_appends, m_group_commit);
       {
 	std::lock_guard locker{*lock};
 	object->set_append_batch_options(m_flush_interval,
@@ -112,6 +114,7 @@ public:
     uint64_t m_flush_bytes = std::numeric_limits<uint64_t>::max();
     double m_flush_age = 600;
     uint64_t m_max_in_flight_appends = 0;
+    bool m_group_commit = false;
     using ObjectRecorders =
       std::list<std::pair<ceph::ref_t<journal::ObjectRecorder>, ceph::mutex*>>;
     ObjectRecorders m_object_recorders;
@@ -361,6 +364,46 @@ TEST_F(TestObjectRecorder, FlushFuture) {
   ASSERT_EQ(0, cond.wait());
 }
 
+TEST_F(TestObjectRecorder, FlushGroupCommit) {
+  std::string oid = get_temp_oid();
+  ASSERT_EQ(0, create(oid));
+  ASSERT_EQ(0, client_register(oid));
+  auto metadata = create_metadata(oid);
+  ASSERT_EQ(0, init_metadata(metadata));
+
+  ceph::mutex lock = ceph::make_mutex("object_recorder_lock");
+  ObjectRecorderFlusher flusher(m_ioctx, m_work_queue, 0, 0, 0, 1, true);
+  auto object = flusher.create_object(oid, 24, &lock);
+
+  journal::AppendBuffer append_buffer1 = create_append_buffer(234, 123,
+                                                              "payload1");
+  journal::AppendBuffer append_buffer2 = create_append_buffer(234, 124,
+                                                              "payload2");
+  journal::AppendBuffer append_buffer3 = create_append_buffer(234, 125,
+                                                              "payload3");
+  lock.lock();
+  ASSERT_FALSE(object->append({append_buffer1}));
+  lock.unlock();
+
+  // the first append is in-flight so flushes of the following ones are
+  // deferred until it completes and then sent together
+  object->flush(append_buffer1.first);
+  lock.lock();
+  ASSERT_FALSE(object->append({append_buffer2, append_buffer3}));
+  lock.unlock();
+  object->flush(append_buffer2.first);
+  object->flush(append_buffer3.first);
+
+  C_SaferCond cond1;
+  append_buffer1.first->wait(&cond1);
+  C_SaferCond cond3;
+  append_buffer3.first->wait(&cond3);
+  ASSERT_EQ(0, cond1.wait());
+  ASSERT_EQ(0, cond3.wait());
+  ASSERT_TRUE(append_buffer2.first->is_complete());
+  ASSERT_EQ(0U, object->get_pending_appends());
+}
+
 TEST_F(TestObjectRecorder, FlushDetachedFuture) {
   std::string oid = get_temp_oid();
   ASSERT_EQ(0, create(oid));
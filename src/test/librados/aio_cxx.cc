@@ -7,7 +7,9 @@
 
 #include "gtest/gtest.h"
 
+#include "common/ceph_context.h"
 #include "common/errno.h"
+#include "common/perf_counters_collection.h"
 #include "include/err.h"
 #include "include/rados/librados.hpp"
 #include "include/types.h"
@@ -921,6 +923,137 @@ TEST(LibRadosAio, SimpleStatPP) {
   ASSERT_EQ(sizeof(buf), psize);
 }
 
+TEST(LibRadosAio, OperateMultiPP) {
+  AioTestDataPP test_data;
+  ASSERT_EQ("", test_data.init());
+  constexpr int num_objects = 32;
+  for (int i = 0; i < num_objects; ++i) {
+    bufferlist bl;
+    bl.append(std::string(i + 1, 'a' + (i % 26)));
+    ASSERT_EQ(0, test_data.m_ioctx.write_full("obj" + stringify(i), bl));
+  }
+
+  // every existing object plus one missing one
+  std::vector<ObjectReadOperation> rd(num_objects + 1);
+  std::vector<uint64_t> sizes(num_objects + 1);
+  std::vector<bufferlist> bls(num_objects + 1);
+  std::vector<std::pair<std::string, ObjectReadOperation*>> ops;
+  for (int i = 0; i <= num_objects; ++i) {
+    rd[i].stat(&sizes[i], nullptr, nullptr);
+    rd[i].read(0, 0, &bls[i], nullptr);
+    ops.emplace_back("obj" + stringify(i), &rd[i]);
+  }
+  std::vector<int> rvals;
+  auto my_completion = std::unique_ptr<AioCompletion>{Rados::aio_create_completion()};
+  ASSERT_TRUE(my_completion);
+  ASSERT_EQ(0, test_data.m_ioctx.aio_operate_multi(my_completion.get(), ops,
+						   &rvals));
+  {
+    TestAlarm alarm;
+    ASSERT_EQ(0, my_completion->wait_for_complete());
+  }
+  ASSERT_EQ(-ENOENT, my_completion->get_return_value());
+  ASSERT_EQ(size_t(num_objects + 1), rvals.size());
+  for (int i = 0; i < num_objects; ++i) {
+    ASSERT_EQ(0, rvals[i]);
+    ASSERT_EQ(uint64_t(i + 1), sizes[i]);
+    ASSERT_EQ(std::string(i + 1, 'a' + (i % 26)), bls[i].to_str());
+  }
+  ASSERT_EQ(-ENOENT, rvals[num_objects]);
+
+  // an empty batch completes immediately
+  std::vector<std::pair<std::string, ObjectReadOperation*>> none;
+  auto my_completion2 = std::unique_ptr<AioCompletion>{Rados::aio_create_completion()};
+  ASSERT_EQ(0, test_data.m_ioctx.aio_operate_multi(my_completion2.get(), none,
+						   &rvals));
+  {
+    TestAlarm alarm;
+    ASSERT_EQ(0, my_completion2->wait_for_complete());
+  }
+  ASSERT_EQ(0, my_completion2->get_return_value());
+  ASSERT_TRUE(rvals.empty());
+}
+
+// the number of ops the cluster handle's objecter has sent in batches
+static uint64_t get_batched_ops(Rados& cluster)
+{
+  auto cct = reinterpret_cast<CephContext*>(cluster.cct());
+  uint64_t n = 0;
+  cct->get_perfcounters_collection()->with_counters(
+    [&n](const PerfCountersCollectionImpl::CounterMap& by_path) {
+      auto p = by_path.find("objecter.op_batch_ops");
+      if (p != by_path.end()) {
+	n = p->second.data->u64;
+      }
+    });
+  return n;
+}
+
+TEST(LibRadosAio, OpBatchPP) {
+  AioTestDataPP test_data;
+  ASSERT_EQ("", test_data.init());
+  Rados& cluster = test_data.m_cluster;
+  // hold every op long enough for the ones after it to join its batch
+  ASSERT_EQ(0, cluster.conf_set("objecter_op_batch_window_us", "50000"));
+  ASSERT_EQ(0, cluster.conf_set("objecter_op_batch_min_inflight", "0"));
+  auto reset = make_scope_guard([&cluster] {
+    cluster.conf_set("objecter_op_batch_window_us", "0");
+  });
+  const uint64_t batched_before = get_batched_ops(cluster);
+
+  // many small writes to the same few objects, each to its own extent,
+  // so that the ops for each pg are batched together
+  constexpr int num_objects = 4;
+  constexpr int num_extents = 32;
+  constexpr int extent_len = 100;
+  auto content = [](int obj, int extent) {
+    return std::string(extent_len, 'a' + (obj * num_extents + extent) % 26);
+  };
+  std::vector<std::unique_ptr<AioCompletion>> completions;
+  for (int extent = 0; extent < num_extents; ++extent) {
+    for (int obj = 0; obj < num_objects; ++obj) {
+      bufferlist bl;
+      bl.append(content(obj, extent));
+      completions.emplace_back(Rados::aio_create_completion());
+      ASSERT_EQ(0, test_data.m_ioctx.aio_write(
+		  "obj" + stringify(obj), completions.back().get(), bl,
+		  extent_len, extent * extent_len));
+    }
+  }
+  for (auto& c : completions) {
+    TestAlarm alarm;
+    ASSERT_EQ(0, c->wait_for_complete());
+    ASSERT_EQ(0, c->get_return_value());
+  }
+  completions.clear();
+
+  // read the extents back the same way; each reply has to land in the
+  // buffer of the read it answers
+  std::vector<bufferlist> bls(num_objects * num_extents);
+  for (int extent = 0; extent < num_extents; ++extent) {
+    for (int obj = 0; obj < num_objects; ++obj) {
+      completions.emplace_back(Rados::aio_create_completion());
+      ASSERT_EQ(0, test_data.m_ioctx.aio_read(
+		  "obj" + stringify(obj), completions.back().get(),
+		  &bls[extent * num_objects + obj], extent_len,
+		  extent * extent_len));
+    }
+  }
+  for (auto& c : completions) {
+    TestAlarm alarm;
+    ASSERT_EQ(0, c->wait_for_complete());
+    ASSERT_EQ(extent_len, c->get_return_value());
+  }
+  for (int extent = 0; extent < num_extents; ++extent) {
+    for (int obj = 0; obj < num_objects; ++obj) {
+      ASSERT_EQ(content(obj, extent), bls[extent * num_objects + obj].to_str());
+    }
+  }
+
+  // and the ops really went out in batches
+  ASSERT_LT(batched_before, get_batched_ops(cluster));
+}
+
 TEST(LibRadosAio, StatRemovePP) {
   AioTestDataPP test_data;
   ASSERT_EQ("", test_data.init());
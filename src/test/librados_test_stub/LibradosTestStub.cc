@@ -574,6 +574,10 @@ int IoCtx::list_watchers(const std::string& o,
     o, std::bind(&TestIoCtxImpl::list_watchers, _1, _2, out_watchers));
 }
 
+void IoCtx::locator_set_key(const std::string& key) {
+  // objects are only located by namespace and name
+}
+
 int IoCtx::notify(const std::string& o, uint64_t ver, bufferlist& bl) {
   TestIoCtxImpl *ctx = reinterpret_cast<TestIoCtxImpl*>(io_ctx_impl);
   return ctx->notify(o, bl, 0, NULL);
@@ -607,6 +611,11 @@ int IoCtx::operate(const std::string& oid, ObjectWriteOperation *op) {
   return ctx->operate(oid, *ops);
 }
 
+int IoCtx::operate(const std::string& oid, ObjectWriteOperation *op,
+                   int flags) {
+  return operate(oid, op);
+}
+
 int IoCtx::operate(const std::string& oid, ObjectReadOperation *op,
                    bufferlist *pbl) {
   TestIoCtxImpl *ctx = reinterpret_cast<TestIoCtxImpl*>(io_ctx_impl);
@@ -614,6 +623,11 @@ int IoCtx::operate(const std::string& oid, ObjectReadOperation *op,
   return ctx->operate_read(oid, *ops, pbl);
 }
 
+int IoCtx::operate(const std::string& oid, ObjectReadOperation *op,
+                   bufferlist *pbl, int flags) {
+  return operate(oid, op, pbl);
+}
+
 int IoCtx::read(const std::string& oid, bufferlist& bl, size_t len,
                 uint64_t off) {
   TestIoCtxImpl *ctx = reinterpret_cast<TestIoCtxImpl*>(io_ctx_impl);
@@ -873,6 +887,28 @@ void ObjectReadOperation::list_watchers(std::list<obj_watch_t> *out_watchers,
   o->ops.push_back(op);
 }
 
+void ObjectReadOperation::omap_get_vals2(
+    const std::string &start_after, const std::string &filter_prefix,
+    uint64_t max_return, std::map<std::string, bufferlist> *out_vals,
+    bool *pmore, int *prval) {
+  TestObjectOperationImpl *o = reinterpret_cast<TestObjectOperationImpl*>(impl);
+
+  ObjectOperationTestImpl op = std::bind(&TestIoCtxImpl::omap_get_vals2, _1,
+                                           _2, start_after, filter_prefix,
+                                           max_return, out_vals, pmore);
+  if (prval != NULL) {
+    op = std::bind(save_operation_result,
+                     std::bind(op, _1, _2, _3, _4, _5, _6), prval);
+  }
+  o->ops.push_back(op);
+}
+
+void ObjectReadOperation::omap_get_vals2(
+    const std::string &start_after, uint64_t max_return,
+    std::map<std::string, bufferlist> *out_vals, bool *pmore, int *prval) {
+  omap_get_vals2(start_after, "", max_return, out_vals, pmore, prval);
+}
+
 void ObjectReadOperation::read(size_t off, uint64_t len, bufferlist *pbl,
                                int *prval) {
   TestObjectOperationImpl *o = reinterpret_cast<TestObjectOperationImpl*>(impl);
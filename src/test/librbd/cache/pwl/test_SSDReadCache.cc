@@ -0,0 +1,125 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/cache/pwl/ssd/ReadCache.h"
+#include "global/global_context.h"
+#include "gtest/gtest.h"
+
+void register_test_ssd_read_cache() {
+}
+
+namespace librbd {
+namespace cache {
+namespace pwl {
+namespace ssd {
+
+static const uint64_t BS = ReadCache::BLOCK_SIZE;
+static const uint64_t REGION = 1 << 20;
+
+TEST(TestSSDReadCache, AdmitOnRepeatedMiss) {
+  ReadCache cache(g_ceph_context, REGION, 4 * BS, 2);
+  uint64_t off;
+  ASSERT_FALSE(cache.get(7, &off));
+  ASSERT_FALSE(cache.admit(7, &off));
+  ASSERT_TRUE(cache.admit(7, &off));
+  ASSERT_GE(off, REGION);
+  ASSERT_LT(off, REGION + 4 * BS);
+  ASSERT_EQ(0u, off % BS);
+
+  // not readable until filled
+  uint64_t hit;
+  ASSERT_FALSE(cache.get(7, &hit));
+  ASSERT_FALSE(cache.admit(7, &hit));
+  cache.fill_finish(off, true);
+  ASSERT_TRUE(cache.get(7, &hit));
+  ASSERT_EQ(off, hit);
+  cache.put(hit);
+}
+
+TEST(TestSSDReadCache, FailedFill) {
+  ReadCache cache(g_ceph_context, REGION, 4 * BS, 1);
+  uint64_t off;
+  ASSERT_TRUE(cache.admit(3, &off));
+  cache.fill_finish(off, false);
+  ASSERT_FALSE(cache.get(3, &off));
+  ASSERT_TRUE(cache.admit(3, &off));
+}
+
+TEST(TestSSDReadCache, InvalidateWhileFilling) {
+  ReadCache cache(g_ceph_context, REGION, 4 * BS, 1);
+  uint64_t off;
+  ASSERT_TRUE(cache.admit(5, &off));
+  cache.invalidate(5 * BS + 100, 10);
+  cache.fill_finish(off, true);
+  ASSERT_FALSE(cache.get(5, &off));
+}
+
+TEST(TestSSDReadCache, InvalidateRange) {
+  ReadCache cache(g_ceph_context, REGION, 8 * BS, 1);
+  uint64_t off;
+  for (uint64_t block = 0; block < 4; ++block) {
+    ASSERT_TRUE(cache.admit(block, &off));
+    cache.fill_finish(off, true);
+  }
+  // [BS - 1, 2 * BS + 1) touches blocks 0, 1 and 2
+  cache.invalidate(BS - 1, BS + 2);
+  ASSERT_FALSE(cache.get(0, &off));
+  ASSERT_FALSE(cache.get(1, &off));
+  ASSERT_FALSE(cache.get(2, &off));
+  ASSERT_TRUE(cache.get(3, &off));
+  cache.put(off);
+
+  // a discard much larger than the cache
+  cache.invalidate(0, 1ull << 40);
+  ASSERT_FALSE(cache.get(3, &off));
+}
+
+TEST(TestSSDReadCache, PinnedSlotNotReused) {
+  ReadCache cache(g_ceph_context, REGION, 1 * BS, 1);
+  uint64_t off, hit;
+  ASSERT_TRUE(cache.admit(1, &off));
+  cache.fill_finish(off, true);
+  ASSERT_TRUE(cache.get(1, &hit));
+
+  // the only slot is being read from
+  ASSERT_FALSE(cache.admit(2, &off));
+  cache.invalidate(BS, BS);
+  ASSERT_FALSE(cache.admit(2, &off));
+  cache.put(hit);
+  ASSERT_TRUE(cache.admit(2, &off));
+  ASSERT_EQ(hit, off);
+}
+
+TEST(TestSSDReadCache, ClockEviction) {
+  ReadCache cache(g_ceph_context, REGION, 2 * BS, 1);
+  uint64_t off;
+  ASSERT_TRUE(cache.admit(1, &off));
+  cache.fill_finish(off, true);
+  ASSERT_TRUE(cache.admit(2, &off));
+  cache.fill_finish(off, true);
+
+  // block 1 is referenced, so block 2 is evicted first
+  ASSERT_TRUE(cache.get(1, &off));
+  cache.put(off);
+  ASSERT_TRUE(cache.admit(3, &off));
+  cache.fill_finish(off, true);
+  ASSERT_TRUE(cache.get(1, &off));
+  cache.put(off);
+  ASSERT_FALSE(cache.get(2, &off));
+  ASSERT_TRUE(cache.get(3, &off));
+  cache.put(off);
+}
+
+TEST(TestSSDReadCache, InvalidateAll) {
+  ReadCache cache(g_ceph_context, REGION, 4 * BS, 1);
+  uint64_t off;
+  ASSERT_TRUE(cache.admit(1, &off));
+  cache.fill_finish(off, true);
+  cache.invalidate_all();
+  ASSERT_FALSE(cache.get(1, &off));
+}
+
+} // namespace ssd
+} // namespace pwl
+} // namespace cache
+} // namespace librbd
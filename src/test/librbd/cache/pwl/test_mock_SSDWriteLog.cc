@@ -1,7 +1,9 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 
+#include <chrono>
 #include <iostream>
+#include <thread>
 #include "common/hostname.h"
 #include "test/librbd/test_mock_fixture.h"
 #include "test/librbd/test_support.h"
@@ -609,6 +611,82 @@ TEST_F(TestMockCacheSSDWriteLog, invalidate) {
   ASSERT_EQ(0, finish_ctx3.wait());
 }
 
+TEST_F(TestMockCacheSSDWriteLog, invalidate_read_cache) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  ASSERT_EQ(0, mock_image_ctx.config.set_val("rbd_persistent_cache_read_size",
+                                             "1M"));
+  ASSERT_EQ(0, mock_image_ctx.config.set_val(
+    "rbd_persistent_cache_read_admit_reads", "1"));
+  MockImageWriteback mock_image_writeback(mock_image_ctx);
+  MockApi mock_api;
+  MockSSDWriteLog ssd(
+      mock_image_ctx, get_cache_state(mock_image_ctx, mock_api),
+      mock_image_writeback, mock_api);
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  auto read_block = [&ssd](bufferlist *bl) {
+    C_SaferCond ctx;
+    bl->clear();
+    ssd.read({{0, 4096}}, bl, 0, &ctx);
+    return ctx.wait();
+  };
+  auto write_below_cache = [&mock_image_writeback](char c) {
+    C_SaferCond ctx;
+    bufferlist bl;
+    bl.append(std::string(4096, c));
+    mock_image_writeback.aio_write({{0, 4096}}, std::move(bl), 0, &ctx);
+    return ctx.wait();
+  };
+
+  // the first miss admits the block; the data that comes back from the
+  // image below is written to the read cache asynchronously
+  ASSERT_EQ(0, write_below_cache('1'));
+  bufferlist bl1;
+  bl1.append(std::string(4096, '1'));
+  bufferlist read_bl;
+  ASSERT_EQ(4096, read_block(&read_bl));
+  ASSERT_TRUE(bl1.contents_equal(read_bl));
+
+  // change the image behind the cache's back, as a rollback would, and
+  // wait for reads to be served (stale) from the read cache
+  ASSERT_EQ(0, write_below_cache('2'));
+  bufferlist bl2;
+  bl2.append(std::string(4096, '2'));
+  bool cached = false;
+  for (int i = 0; i < 100 && !cached; ++i) {
+    ASSERT_EQ(4096, read_block(&read_bl));
+    cached = bl1.contents_equal(read_bl);
+    if (!cached) {
+      ASSERT_TRUE(bl2.contents_equal(read_bl));
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  ASSERT_TRUE(cached);
+
+  MockContextSSD finish_ctx_invalidate;
+  expect_context_complete(finish_ctx_invalidate, 0);
+  ssd.invalidate(&finish_ctx_invalidate);
+  ASSERT_EQ(0, finish_ctx_invalidate.wait());
+
+  // the next read misses and sees the image as it is now
+  ASSERT_EQ(4096, read_block(&read_bl));
+  ASSERT_TRUE(bl2.contents_equal(read_bl));
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  ssd.shut_down(&finish_ctx3);
+  ASSERT_EQ(0, finish_ctx3.wait());
+}
+
 TEST_F(TestMockCacheSSDWriteLog, flush) {
   librbd::ImageCtx *ictx;
   ASSERT_EQ(0, open_image(m_image_name, &ictx));
@@ -11,6 +11,7 @@ template class librbd::crypto::BlockCrypto<
 
 using ::testing::ExpectationSet;
 using ::testing::internal::ExpectationBase;
+using ::testing::Ne;
 using ::testing::Return;
 using ::testing::_;
 
@@ -93,13 +94,60 @@ TEST_F(TestMockCryptoBlockCrypto, Encrypt) {
   expect_update_context(std::string(2048, '1') + std::string(2048, '2'), 4096);
   expect_init_context(std::string("\x38\x12\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 16));
   expect_update_context(std::string(2048, '2') + std::string(2048, '3'), 4096);
-  EXPECT_CALL(cryptor, return_context(_, CipherMode::CIPHER_MODE_ENC));
 
   ASSERT_EQ(0, bc->encrypt(&data, image_offset));
 
   ASSERT_EQ(data.length(), 8192);
 }
 
+TEST_F(TestMockCryptoBlockCrypto, ContextReused) {
+  ceph::bufferlist data;
+  data.append(std::string(4096, '1'));
+
+  // the context is returned to the pool and picked up by the second call
+  expect_get_context(CipherMode::CIPHER_MODE_ENC);
+  EXPECT_CALL(cryptor, init_context(_, _, _)).Times(2);
+  EXPECT_CALL(cryptor, update_context(_, _, _, 4096)).Times(2).WillRepeatedly(
+          Return(4096));
+  ASSERT_EQ(0, bc->encrypt(&data, 0));
+  ASSERT_EQ(0, bc->encrypt(&data, 0));
+}
+
+TEST_F(TestMockCryptoBlockCrypto, DecryptInPlace) {
+  ceph::bufferlist data;
+  data.push_back(ceph::buffer::create(8192));
+  auto buf = reinterpret_cast<unsigned char*>(data.c_str());
+
+  expect_get_context(CipherMode::CIPHER_MODE_DEC);
+  EXPECT_CALL(cryptor, init_context(_, _, _)).Times(2);
+  EXPECT_CALL(cryptor, update_context(_, buf, buf, 4096)).WillOnce(
+          Return(4096));
+  EXPECT_CALL(cryptor, update_context(_, buf + 4096, buf + 4096, 4096))
+          .WillOnce(Return(4096));
+  ASSERT_EQ(0, bc->decrypt(&data, 0));
+
+  ASSERT_EQ(8192, data.length());
+  ASSERT_EQ(1, data.get_num_buffers());
+  ASSERT_EQ(buf, reinterpret_cast<unsigned char*>(data.c_str()));
+}
+
+TEST_F(TestMockCryptoBlockCrypto, DecryptSharedBuffer) {
+  ceph::bufferptr bp(ceph::buffer::create(4096));
+  auto buf = reinterpret_cast<unsigned char*>(bp.c_str());
+  ceph::bufferlist data;
+  data.append(bp);
+
+  // a buffer referenced elsewhere must not be modified
+  expect_get_context(CipherMode::CIPHER_MODE_DEC);
+  EXPECT_CALL(cryptor, init_context(_, _, _));
+  EXPECT_CALL(cryptor, update_context(_, buf, Ne(buf), 4096)).WillOnce(
+          Return(4096));
+  ASSERT_EQ(0, bc->decrypt(&data, 0));
+
+  ASSERT_EQ(4096, data.length());
+  ASSERT_NE(buf, reinterpret_cast<unsigned char*>(data.c_str()));
+}
+
 TEST_F(TestMockCryptoBlockCrypto, UnalignedImageOffset) {
   ceph::bufferlist data;
   data.append(std::string(4096, '1'));
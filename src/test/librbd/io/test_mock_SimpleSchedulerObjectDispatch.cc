@@ -89,6 +89,25 @@ struct TestMockIoSimpleSchedulerObjectDispatch : public TestMockFixture {
                 }));
   }
 
+  void expect_dispatch_delayed_write(MockTestImageCtx &mock_image_ctx,
+                                     uint64_t object_off,
+                                     const std::string &data, int r) {
+    EXPECT_CALL(*mock_image_ctx.io_object_dispatcher, send(_))
+      .WillOnce(Invoke([&mock_image_ctx, object_off, data, r](
+                           ObjectDispatchSpec* spec) {
+                  auto write = boost::get<ObjectDispatchSpec::WriteRequest>(
+                    &spec->request);
+                  EXPECT_TRUE(write != nullptr);
+                  if (write != nullptr) {
+                    EXPECT_EQ(object_off, write->object_off);
+                    EXPECT_EQ(data, write->data.to_str());
+                  }
+                  spec->dispatch_result = io::DISPATCH_RESULT_COMPLETE;
+                  mock_image_ctx.image_ctx->op_work_queue->queue(
+                      &spec->dispatcher_ctx, r);
+                }));
+  }
+
   void expect_cancel_timer_task(Context *timer_task) {
       EXPECT_CALL(m_mock_timer, cancel_event(timer_task))
         .WillOnce(Invoke([](Context *timer_task) {
@@ -504,6 +523,7 @@ TEST_F(TestMockIoSimpleSchedulerObjectDispatch, WriteNonSequential) {
   ASSERT_NE(on_finish2, &cond2);
   ASSERT_NE(timer_task, nullptr);
 
+  // overlapping, but with different op flags
   expect_dispatch_delayed_requests(mock_image_ctx, 0);
   expect_schedule_dispatch_delayed_requests(timer_task, nullptr);
 
@@ -513,9 +533,10 @@ TEST_F(TestMockIoSimpleSchedulerObjectDispatch, WriteNonSequential) {
   C_SaferCond cond3;
   Context *on_finish3 = &cond3;
   ASSERT_FALSE(mock_simple_scheduler_object_dispatch.write(
-      0, object_off, std::move(data), mock_image_ctx.get_data_io_context(), 0,
-      0, std::nullopt, {}, &object_dispatch_flags, nullptr, &dispatch_result,
-      &on_finish3, nullptr));
+      0, object_off, std::move(data), mock_image_ctx.get_data_io_context(),
+      LIBRADOS_OP_FLAG_FADVISE_DONTNEED, 0, std::nullopt, {},
+      &object_dispatch_flags, nullptr, &dispatch_result, &on_finish3,
+      nullptr));
   ASSERT_NE(on_finish3, &cond3);
 
   on_finish1->complete(0);
@@ -527,6 +548,74 @@ TEST_F(TestMockIoSimpleSchedulerObjectDispatch, WriteNonSequential) {
   ASSERT_EQ(0, cond3.wait());
 }
 
+TEST_F(TestMockIoSimpleSchedulerObjectDispatch, WriteOverlapped) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockSimpleSchedulerObjectDispatch
+      mock_simple_scheduler_object_dispatch(&mock_image_ctx);
+
+  expect_get_object_name(mock_image_ctx, 0);
+
+  InSequence seq;
+
+  ceph::bufferlist data;
+  data.append("X");
+  int object_dispatch_flags = 0;
+  C_SaferCond cond1;
+  Context *on_finish1 = &cond1;
+  ASSERT_FALSE(mock_simple_scheduler_object_dispatch.write(
+      0, 0, std::move(data), mock_image_ctx.get_data_io_context(), 0, 0,
+      std::nullopt, {}, &object_dispatch_flags, nullptr, nullptr, &on_finish1,
+      nullptr));
+  ASSERT_NE(on_finish1, &cond1);
+
+  Context *timer_task = nullptr;
+  expect_schedule_dispatch_delayed_requests(nullptr, &timer_task);
+
+  // 0~10, 5~10 (overlapping), 20~5 (separate), 15~5 (joins both),
+  // 2~3 (overwritten) and 0~1
+  std::vector<std::pair<uint64_t, std::string>> writes = {
+    {0, std::string(10, 'A')},
+    {5, std::string(10, 'B')},
+    {20, std::string(5, 'C')},
+    {15, std::string(5, 'D')},
+    {2, std::string(3, 'E')},
+    {0, std::string(1, 'F')}};
+  std::vector<std::unique_ptr<C_SaferCond>> conds;
+  std::vector<std::unique_ptr<C_SaferCond>> dispatched;
+  std::vector<Context*> on_finishes;
+  for (auto& [object_off, write_data] : writes) {
+    conds.emplace_back(new C_SaferCond());
+    dispatched.emplace_back(new C_SaferCond());
+    on_finishes.push_back(conds.back().get());
+
+    data.clear();
+    data.append(write_data);
+    io::DispatchResult dispatch_result;
+    ASSERT_TRUE(mock_simple_scheduler_object_dispatch.write(
+        0, object_off, std::move(data), mock_image_ctx.get_data_io_context(),
+        0, 0, std::nullopt, {}, &object_dispatch_flags, nullptr,
+        &dispatch_result, &on_finishes.back(), dispatched.back().get()));
+    ASSERT_EQ(dispatch_result, io::DISPATCH_RESULT_COMPLETE);
+    ASSERT_NE(on_finishes.back(), conds.back().get());
+  }
+
+  // a single request with the newest data
+  expect_dispatch_delayed_write(mock_image_ctx, 0,
+                                "FAEEEBBBBBBBBBBDDDDDCCCCC", 0);
+  expect_schedule_dispatch_delayed_requests(timer_task, nullptr);
+
+  on_finish1->complete(0);
+  ASSERT_EQ(0, cond1.wait());
+  for (size_t i = 0; i < writes.size(); ++i) {
+    ASSERT_EQ(0, dispatched[i]->wait());
+    on_finishes[i]->complete(0);
+    ASSERT_EQ(0, conds[i]->wait());
+  }
+}
+
 TEST_F(TestMockIoSimpleSchedulerObjectDispatch, Mixed) {
   librbd::ImageCtx *ictx;
   ASSERT_EQ(0, open_image(m_image_name, &ictx));
@@ -0,0 +1,244 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+// Measure how image IO submission scales with the number of submitting
+// threads for a range of rbd_io_dispatch_queues settings.  A scratch
+// image is created in --pool and removed afterwards.  With the default
+// --io-size 0 every request is a zero-length read, which runs through
+// the whole image dispatch path but never reaches the OSDs, so the
+// result is the librbd request path overhead alone.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "common/ceph_argparse.h"
+#include "common/config.h"
+#include "common/errno.h"
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "include/rados/librados.hpp"
+#include "include/rbd/librbd.hpp"
+#include "include/stringify.h"
+
+struct bench_config_t {
+  unsigned threads = 8;
+  uint64_t ops = 100000;
+  uint64_t queue_depth = 16;
+  uint64_t io_size = 0;
+  uint64_t image_size = 1 << 30;
+  bool write = false;
+};
+
+static int run_thread(librbd::Image& image, const bench_config_t& conf,
+                      unsigned thread) {
+  std::mt19937_64 rng(thread);
+  uint64_t blocks = conf.io_size == 0 ? 1 : conf.image_size / conf.io_size;
+  std::uniform_int_distribution<uint64_t> block_dist(0, blocks - 1);
+
+  ceph::bufferlist write_bl;
+  write_bl.append(std::string(conf.io_size, 'a' + thread % 26));
+
+  std::vector<librbd::RBD::AioCompletion*> comps;
+  std::vector<ceph::bufferlist> read_bls(conf.queue_depth);
+  for (uint64_t done = 0; done < conf.ops; ) {
+    comps.clear();
+    for (uint64_t i = 0; i < conf.queue_depth && done < conf.ops;
+         ++i, ++done) {
+      uint64_t off = block_dist(rng) * conf.io_size;
+      auto comp = new librbd::RBD::AioCompletion(nullptr, nullptr);
+      int r;
+      if (conf.write) {
+        r = image.aio_write(off, conf.io_size, write_bl, comp);
+      } else {
+        read_bls[i].clear();
+        r = image.aio_read(off, conf.io_size, read_bls[i], comp);
+      }
+      if (r < 0) {
+        comp->release();
+        return r;
+      }
+      comps.push_back(comp);
+    }
+
+    int ret = 0;
+    for (auto comp : comps) {
+      comp->wait_for_complete();
+      int r = comp->get_return_value();
+      if (r < 0 && ret == 0) {
+        ret = r;
+      }
+      comp->release();
+    }
+    if (ret < 0) {
+      return ret;
+    }
+  }
+  return 0;
+}
+
+static int run(librados::Rados& rados, librados::IoCtx& ioctx,
+               const std::string& image_name, const bench_config_t& conf,
+               uint64_t queues) {
+  int r = rados.conf_set("rbd_io_dispatch_queues",
+                         stringify(queues).c_str());
+  if (r < 0) {
+    std::cerr << "failed to set rbd_io_dispatch_queues: "
+              << cpp_strerror(r) << std::endl;
+    return r;
+  }
+
+  librbd::RBD rbd;
+  librbd::Image image;
+  r = rbd.open(ioctx, image, image_name.c_str());
+  if (r < 0) {
+    std::cerr << "failed to open image: " << cpp_strerror(r) << std::endl;
+    return r;
+  }
+
+  std::vector<int> results(conf.threads, 0);
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned t = 0; t < conf.threads; ++t) {
+    threads.emplace_back([&, t] {
+	results[t] = run_thread(image, conf, t);
+      });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  image.close();
+
+  for (auto result : results) {
+    if (result < 0) {
+      std::cerr << "IO failed: " << cpp_strerror(result) << std::endl;
+      return result;
+    }
+  }
+
+  uint64_t total_ops = conf.ops * conf.threads;
+  std::cout << "queues " << queues
+	    << "  threads " << conf.threads
+	    << "  ops " << total_ops
+	    << "  elapsed " << elapsed << "s"
+	    << "  iops " << static_cast<uint64_t>(total_ops / elapsed)
+	    << std::endl;
+  return 0;
+}
+
+static void usage(const char* name) {
+  std::cout << "usage: " << name << " [options]\n"
+	    << "  --pool <name>          pool for the scratch image (rbd)\n"
+	    << "  --threads <n>          submitting threads (8)\n"
+	    << "  --ops <n>              requests per thread (100000)\n"
+	    << "  --queue-depth <n>      requests in flight per thread (16)\n"
+	    << "  --io-size <bytes>      request size, 0 for dispatch only (0)\n"
+	    << "  --image-size <bytes>   scratch image size (1G)\n"
+	    << "  --queues <n,n,...>     rbd_io_dispatch_queues values (1,2,4,8)\n"
+	    << "  --write                issue writes instead of reads\n"
+	    << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  std::vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY, 0);
+
+  bench_config_t conf;
+  std::string pool_name = "rbd";
+  std::string queues_str = "1,2,4,8";
+  int threads = conf.threads;
+  long long ops = conf.ops;
+  long long queue_depth = conf.queue_depth;
+  long long io_size = conf.io_size;
+  long long image_size = conf.image_size;
+  std::ostringstream err;
+  for (auto i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_witharg(args, i, &threads, err, "--threads", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &ops, err, "--ops", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &queue_depth, err, "--queue-depth", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &io_size, err, "--io-size", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &image_size, err, "--image-size", (char*)NULL)) {
+      if (!err.str().empty()) {
+	std::cerr << argv[0] << ": " << err.str() << std::endl;
+	return EXIT_FAILURE;
+      }
+    } else if (ceph_argparse_witharg(args, i, &pool_name, "--pool", (char*)NULL) ||
+	       ceph_argparse_witharg(args, i, &queues_str, "--queues", (char*)NULL)) {
+    } else if (ceph_argparse_flag(args, i, "--write", (char*)NULL)) {
+      conf.write = true;
+    } else if (ceph_argparse_flag(args, i, "-h", "--help", (char*)NULL)) {
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else {
+      std::cerr << "unknown option " << *i << std::endl;
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (ops < 0 || io_size < 0 || image_size <= 0 || io_size > image_size) {
+    std::cerr << argv[0] << ": invalid sizes" << std::endl;
+    return EXIT_FAILURE;
+  }
+  conf.threads = std::max(threads, 1);
+  conf.ops = ops;
+  conf.queue_depth = std::max(queue_depth, 1LL);
+  conf.io_size = io_size;
+  conf.image_size = image_size;
+
+  std::vector<uint64_t> queues;
+  std::istringstream queues_ss(queues_str);
+  for (std::string q; std::getline(queues_ss, q, ','); ) {
+    queues.push_back(std::max<uint64_t>(std::strtoull(q.c_str(), nullptr, 10),
+                                        1));
+  }
+
+  librados::Rados rados;
+  int r = rados.init_with_context(g_ceph_context);
+  if (r == 0) {
+    r = rados.connect();
+  }
+  if (r < 0) {
+    std::cerr << "failed to connect to cluster: " << cpp_strerror(r)
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  librados::IoCtx ioctx;
+  r = rados.ioctx_create(pool_name.c_str(), ioctx);
+  if (r < 0) {
+    std::cerr << "failed to open pool " << pool_name << ": "
+              << cpp_strerror(r) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  librbd::RBD rbd;
+  std::string image_name = "io_dispatch_bench." + stringify(getpid());
+  int order = 0;
+  r = rbd.create2(ioctx, image_name.c_str(), conf.image_size,
+                  RBD_FEATURE_LAYERING, &order);
+  if (r < 0) {
+    std::cerr << "failed to create image: " << cpp_strerror(r) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for (auto q : queues) {
+    r = run(rados, ioctx, image_name, conf, q);
+    if (r < 0) {
+      break;
+    }
+  }
+
+  rbd.remove(ioctx, image_name.c_str());
+  return r < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
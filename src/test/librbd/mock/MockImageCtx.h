@@ -224,6 +224,8 @@ struct MockImageCtx {
   MOCK_CONST_METHOD0(get_stripe_period, uint64_t());
 
   MOCK_METHOD0(rebuild_data_io_context, void());
+  void invalidate_io_state() {
+  }
   IOContext get_data_io_context();
   IOContext duplicate_data_io_context();
 
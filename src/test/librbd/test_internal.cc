@@ -10,6 +10,7 @@
 #include "librbd/ExclusiveLock.h"
 #include "librbd/ImageState.h"
 #include "librbd/ImageWatcher.h"
+#include "librbd/ManagementOps.h"
 #include "librbd/internal.h"
 #include "librbd/ObjectMap.h"
 #include "librbd/Operations.h"
@@ -26,6 +27,8 @@
 #include <boost/scope_exit.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/assign/list_of.hpp>
+#include <functional>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -511,6 +514,80 @@ TEST_F(TestInternal, MultipleResize) {
   ASSERT_EQ(0U, size);
 }
 
+TEST_F(TestInternal, MultiQueueDispatch) {
+  librados::IoCtx io_ctx;
+  io_ctx.dup(m_ioctx);
+  librados::Rados rados(io_ctx);
+  ASSERT_EQ(0, rados.conf_set("rbd_io_dispatch_queues", "4"));
+  BOOST_SCOPE_EXIT(&rados) {
+    rados.conf_set("rbd_io_dispatch_queues", "1");
+  } BOOST_SCOPE_EXIT_END;
+
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  // every thread gets a queue of its own (threads outnumber queues), so
+  // each check below runs against several cached IO states
+  const unsigned num_threads = 8;
+  auto run = [](const std::function<void(unsigned)>& f) {
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < num_threads; ++i) {
+      threads.emplace_back(f, i);
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  };
+
+  std::atomic<unsigned> failed{0};
+  run([&](unsigned i) {
+      bufferlist bl;
+      bl.append(std::string(512, '1' + i));
+      bufferlist expected_bl = bl;
+      if (api::Io<>::write(*ictx, i * 4096, bl.length(), std::move(bl),
+                           0) != 512) {
+        failed++;
+        return;
+      }
+      bufferlist read_bl;
+      if (api::Io<>::read(*ictx, i * 4096, 512,
+                          librbd::io::ReadResult{&read_bl}, 0) != 512 ||
+          !expected_bl.contents_equal(read_bl)) {
+        failed++;
+      }
+    });
+  ASSERT_EQ(0U, failed);
+
+  // all queues must see the image shrink
+  uint64_t new_size = m_image_size >> 1;
+  librbd::NoOpProgressContext no_op;
+  ASSERT_EQ(0, ictx->operations->resize(new_size, true, no_op));
+  run([&](unsigned i) {
+      bufferlist read_bl;
+      if (api::Io<>::read(*ictx, new_size, 512,
+                          librbd::io::ReadResult{&read_bl}, 0) != -EINVAL ||
+          api::Io<>::read(*ictx, new_size - 512, 1024,
+                          librbd::io::ReadResult{&read_bl}, 0) != 512) {
+        failed++;
+      }
+    });
+  ASSERT_EQ(0U, failed);
+
+  // ... and become read-only on a snapshot
+  ASSERT_EQ(0, create_snapshot("snap1", false));
+  ASSERT_EQ(0, librbd::api::Image<>::snap_set(
+                 ictx, cls::rbd::UserSnapshotNamespace(), "snap1"));
+  run([&](unsigned i) {
+      bufferlist bl;
+      bl.append(std::string(512, '1'));
+      if (api::Io<>::write(*ictx, i * 4096, bl.length(), std::move(bl),
+                           0) != -EROFS) {
+        failed++;
+      }
+    });
+  ASSERT_EQ(0U, failed);
+}
+
 TEST_F(TestInternal, Metadata) {
   REQUIRE_FEATURE(RBD_FEATURE_LAYERING);
 
@@ -578,6 +655,30 @@ TEST_F(TestInternal, MetadataConfApply) {
   ASSERT_EQ(cache, ictx->cache);
 }
 
+TEST_F(TestInternal, ConcurrentManagementOps) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  ASSERT_EQ(0, ictx->config.set_val("rbd_concurrent_management_ops", "10"));
+  ASSERT_EQ(0, ictx->config.set_val("rbd_concurrent_management_bytes", "0"));
+  ASSERT_EQ(10U, librbd::util::get_concurrent_management_ops(ictx->config,
+                                                             4096));
+
+  // up to the byte limit in flight ...
+  ASSERT_EQ(0, ictx->config.set_val("rbd_concurrent_management_bytes",
+                                    "64M"));
+  ASSERT_EQ(64U, librbd::util::get_concurrent_management_ops(ictx->config,
+                                                             1 << 20));
+  ASSERT_EQ(16384U, librbd::util::get_concurrent_management_ops(ictx->config,
+                                                                4096));
+
+  // ... but never fewer requests than the ops limit
+  ASSERT_EQ(10U, librbd::util::get_concurrent_management_ops(ictx->config,
+                                                             16 << 20));
+  ASSERT_EQ(10U, librbd::util::get_concurrent_management_ops(ictx->config,
+                                                             0));
+}
+
 TEST_F(TestInternal, SnapshotCopyup)
 {
   REQUIRE_FEATURE(RBD_FEATURE_LAYERING);
@@ -0,0 +1,78 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "mds/mdstypes.h"
+#include "mds/MDBalancer.h"
+
+#include "gtest/gtest.h"
+
+using namespace std::chrono_literals;
+
+TEST(MDBalancer, PredictLoad)
+{
+  EXPECT_DOUBLE_EQ(100.0, MDBalancer::predict_load(100, 100, 0.5));
+  EXPECT_DOUBLE_EQ(120.0, MDBalancer::predict_load(100, 60, 0.5));
+  EXPECT_DOUBLE_EQ(80.0, MDBalancer::predict_load(100, 140, 0.5));
+  EXPECT_DOUBLE_EQ(0.0, MDBalancer::predict_load(10, 100, 1));
+}
+
+TEST(MDBalancer, PredictLoadSteadyGrowth)
+{
+  // taken from the raw loads, a steady growth gives a steady lead
+  // rather than one that compounds round after round
+  double last = 0;
+  for (double load = 100; load <= 1000; load += 100) {
+    if (last > 0) {
+      EXPECT_DOUBLE_EQ(load + 50, MDBalancer::predict_load(load, last, 0.5));
+    }
+    last = load;
+  }
+}
+
+TEST(ImportCooldown, Recent)
+{
+  ImportCooldown c;
+  const auto now = ImportCooldown::clock::now();
+  const dirfrag_t a(inodeno_t(0x1000), frag_t());
+  const dirfrag_t b(inodeno_t(0x1001), frag_t());
+
+  c.add(a, now, 30s);
+  EXPECT_TRUE(c.is_recent(a, now + 10s, 30s));
+  EXPECT_FALSE(c.is_recent(b, now + 10s, 30s));
+
+  // past the cooldown it is forgotten
+  EXPECT_FALSE(c.is_recent(a, now + 30s, 30s));
+  EXPECT_EQ(0u, c.size());
+}
+
+TEST(ImportCooldown, Trim)
+{
+  ImportCooldown c;
+  const auto now = ImportCooldown::clock::now();
+  for (unsigned i = 0; i < 10; ++i) {
+    c.add(dirfrag_t(inodeno_t(0x1000 + i), frag_t()), now, 30s);
+  }
+  EXPECT_EQ(10u, c.size());
+  // a later import drops the ones past the cooldown
+  c.add(dirfrag_t(inodeno_t(0x2000), frag_t()), now + 40s, 30s);
+  EXPECT_EQ(1u, c.size());
+}
+
+TEST(ImportCooldown, Disabled)
+{
+  ImportCooldown c;
+  const auto now = ImportCooldown::clock::now();
+  const dirfrag_t a(inodeno_t(0x1000), frag_t());
+  c.add(a, now, 0s);
+  EXPECT_EQ(0u, c.size());
+  EXPECT_FALSE(c.is_recent(a, now, 0s));
+}
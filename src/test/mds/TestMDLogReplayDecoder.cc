@@ -0,0 +1,121 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "mds/MDLogReplayDecoder.h"
+#include "mds/events/ENoOp.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// a journal of ENoOp events of varying size, so that later entries
+// often finish decoding before earlier ones
+struct Journal {
+  std::vector<bufferlist> events;
+  std::vector<uint64_t> pos;
+
+  explicit Journal(unsigned n) {
+    uint64_t off = 0;
+    for (unsigned i = 0; i < n; ++i) {
+      bufferlist bl;
+      ENoOp le((i % 7) * 32768 + i);
+      le.encode_with_header(bl, CEPH_FEATURES_ALL);
+      pos.push_back(off);
+      off += bl.length();
+      events.push_back(std::move(bl));
+    }
+  }
+
+  uint64_t end(unsigned i) const {
+    return pos[i] + events[i].length();
+  }
+};
+
+// check that e is entry i of the journal, decoded
+void check_entry(const Journal& j, unsigned i, MDLogReplayDecoder::Entry& e)
+{
+  EXPECT_EQ(j.pos[i], e.pos);
+  EXPECT_EQ(j.end(i), e.end);
+  ASSERT_TRUE(e.decoded);
+  ASSERT_TRUE(e.le);
+  EXPECT_EQ(EVENT_NOOP, e.le->get_type());
+  // the event is the one decoded from this entry's data
+  bufferlist bl;
+  e.le->encode_with_header(bl, CEPH_FEATURES_ALL);
+  EXPECT_TRUE(bl.contents_equal(j.events[i]));
+}
+
+} // anonymous namespace
+
+TEST(MDLogReplayDecoder, JournalOrder)
+{
+  Journal j(200);
+  for (unsigned nthreads : {0, 1, 4}) {
+    MDLogReplayDecoder decoder(nthreads, 16);
+    unsigned queued = 0;
+    unsigned popped = 0;
+    // as _replay_thread does: fill up the decoder, then take one entry
+    while (popped < j.events.size()) {
+      while (!decoder.full() && queued < j.events.size()) {
+	bufferlist bl = j.events[queued];
+	decoder.queue(j.pos[queued], j.end(queued), std::move(bl));
+	++queued;
+      }
+      ASSERT_FALSE(decoder.empty());
+      auto e = decoder.pop();
+      check_entry(j, popped, e);
+      ++popped;
+    }
+    EXPECT_TRUE(decoder.empty());
+  }
+}
+
+TEST(MDLogReplayDecoder, CorruptEntryKeepsItsPlace)
+{
+  Journal j(3);
+  MDLogReplayDecoder decoder(2, 8);
+  bufferlist garbage;
+  garbage.append("not a journal event");
+  bufferlist bl = j.events[0];
+  decoder.queue(j.pos[0], j.end(0), std::move(bl));
+  decoder.queue(j.end(0), j.end(0) + garbage.length(), std::move(garbage));
+  bl = j.events[1];
+  decoder.queue(j.pos[1], j.end(1), std::move(bl));
+
+  auto e = decoder.pop();
+  check_entry(j, 0, e);
+  e = decoder.pop();
+  EXPECT_EQ(j.end(0), e.pos);
+  EXPECT_TRUE(e.decoded);
+  EXPECT_FALSE(e.le);
+  e = decoder.pop();
+  check_entry(j, 1, e);
+  EXPECT_TRUE(decoder.empty());
+}
+
+TEST(MDLogReplayDecoder, ShutdownWithDecodesInFlight)
+{
+  Journal j(64);
+  for (unsigned popped : {0, 1, 10}) {
+    MDLogReplayDecoder decoder(4, j.events.size());
+    for (unsigned i = 0; i < j.events.size(); ++i) {
+      bufferlist bl = j.events[i];
+      decoder.queue(j.pos[i], j.end(i), std::move(bl));
+    }
+    for (unsigned i = 0; i < popped; ++i) {
+      auto e = decoder.pop();
+      check_entry(j, i, e);
+    }
+    // the decoder goes away with entries queued and being decoded; its
+    // workers must stop without touching freed entries or hanging
+  }
+}
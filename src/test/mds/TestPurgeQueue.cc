@@ -0,0 +1,70 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "mds/PurgeQueue.h"
+
+#include "gtest/gtest.h"
+
+TEST(PurgeExpireTracker, InOrder)
+{
+  PurgeExpireTracker t;
+  EXPECT_TRUE(t.empty());
+  t.add(100);
+  t.add(200);
+  EXPECT_EQ(100u, t.complete(100));
+  EXPECT_EQ(200u, t.complete(200));
+  EXPECT_TRUE(t.empty());
+}
+
+TEST(PurgeExpireTracker, OutOfOrder)
+{
+  PurgeExpireTracker t;
+  for (uint64_t pos = 100; pos <= 500; pos += 100) {
+    t.add(pos);
+  }
+  // nothing expires while the first entry is not done
+  EXPECT_EQ(0u, t.complete(300));
+  EXPECT_EQ(0u, t.complete(200));
+  EXPECT_EQ(0u, t.complete(500));
+  EXPECT_EQ(5u, t.size());
+  // then up to the next one that is not
+  EXPECT_EQ(300u, t.complete(100));
+  EXPECT_EQ(2u, t.size());
+  EXPECT_EQ(500u, t.complete(400));
+  EXPECT_TRUE(t.empty());
+}
+
+TEST(PurgeExpireTracker, ReadWhileInFlight)
+{
+  // entries read after the others completed still hold the expiry back
+  PurgeExpireTracker t;
+  t.add(100);
+  t.add(200);
+  EXPECT_EQ(0u, t.complete(200));
+  t.add(300);
+  t.add(400);
+  EXPECT_EQ(0u, t.complete(400));
+  EXPECT_EQ(200u, t.complete(100));
+  EXPECT_EQ(400u, t.complete(300));
+  EXPECT_TRUE(t.empty());
+
+  // and the bookkeeping does not outlive the entries
+  for (uint64_t pos = 1000; pos < 2000; pos += 10) {
+    t.add(pos);
+    if (pos >= 1010) {
+      t.complete(pos);
+    }
+  }
+  EXPECT_EQ(100u, t.size());
+  EXPECT_EQ(1990u, t.complete(1000));
+  EXPECT_TRUE(t.empty());
+}
@@ -0,0 +1,158 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "mds/ReplyEncoder.h"
+#include "messages/MClientReply.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+inodestat_t make_stat(inodeno_t ino)
+{
+  inodestat_t st;
+  st.ino = ino;
+  st.snapid = CEPH_NOSNAP;
+  st.version = 42;
+  st.xattr_version = 3;
+  st.ecap.caps = CEPH_CAP_PIN | CEPH_CAP_FILE_SHARED;
+  st.ecap.seq = 7;
+  st.layout = file_layout_t::get_default();
+  st.layout.pool_ns = "ns";
+  st.ctime = utime_t(100, 1);
+  st.mtime = utime_t(200, 2);
+  st.atime = utime_t(300, 3);
+  st.btime = utime_t(50, 5);
+  st.size = 12345;
+  st.max_size = 1 << 22;
+  st.truncate_seq = 2;
+  st.mode = S_IFREG | 0644;
+  st.uid = 1000;
+  st.gid = 1001;
+  st.nlink = 1;
+  st.rstat.rbytes = 12345;
+  st.rstat.rfiles = 1;
+  st.dirfragtree.split(frag_t(), 2);
+  st.symlink = "target";
+  auto xattrs = std::make_shared<xattr_map<mempool::mds_co::pool_allocator>>();
+  (*xattrs)[mempool::mds_co::string("user.a")] =
+    ceph::bufferptr("value", 5);
+  st.xattrs = xattrs;
+  st.inline_version = CEPH_INLINE_NONE;
+  st.quota.max_bytes = 1 << 30;
+  st.change_attr = 9;
+  st.export_pin = 1;
+  st.snap_metadata["key"] = "value";
+  st.fscrypt = true;
+  return st;
+}
+
+void check_stat(const inodestat_t& st, const InodeStat& ist)
+{
+  EXPECT_EQ(st.ino, ist.vino.ino);
+  EXPECT_EQ(st.snapid, ist.vino.snapid);
+  EXPECT_EQ(st.version, ist.version);
+  EXPECT_EQ(st.xattr_version, ist.xattr_version);
+  EXPECT_EQ(st.ecap.caps, ist.cap.caps);
+  EXPECT_EQ(st.ecap.seq, ist.cap.seq);
+  EXPECT_EQ(st.ctime, ist.ctime);
+  EXPECT_EQ(st.mtime, ist.mtime);
+  EXPECT_EQ(st.atime, ist.atime);
+  EXPECT_EQ(st.size, ist.size);
+  EXPECT_EQ(st.max_size, ist.max_size);
+  EXPECT_EQ(st.mode, ist.mode);
+  EXPECT_EQ(st.uid, ist.uid);
+  EXPECT_EQ(st.gid, ist.gid);
+  EXPECT_EQ(st.rstat.rbytes, ist.rstat.rbytes);
+  EXPECT_EQ(st.dirfragtree, ist.dirfragtree);
+  EXPECT_EQ(st.symlink, ist.symlink);
+  EXPECT_EQ(st.layout.pool_ns, ist.layout.pool_ns);
+  EXPECT_EQ(st.btime, ist.btime);
+  EXPECT_EQ(st.change_attr, ist.change_attr);
+  EXPECT_EQ(st.quota, ist.quota);
+
+  std::map<std::string, ceph::bufferptr> xattrs;
+  auto p = ist.xattrbl.cbegin();
+  decode(xattrs, p);
+  ASSERT_EQ(1u, xattrs.size());
+  EXPECT_EQ("value", std::string(xattrs["user.a"].c_str(), 5));
+}
+
+} // anonymous namespace
+
+TEST(ReplyEncoder, InodeStat)
+{
+  auto st = make_stat(0x10000000001);
+  st.reply_encoding = true;
+  ceph::bufferlist bl;
+  st.encode(bl);
+  auto p = bl.cbegin();
+  InodeStat ist(p, (uint64_t)-1);
+  EXPECT_TRUE(p.end());
+  check_stat(st, ist);
+  EXPECT_EQ(st.export_pin, ist.dir_pin);
+  EXPECT_EQ(st.snap_metadata, ist.snap_metadata);
+  EXPECT_EQ(st.fscrypt, ist.fscrypt);
+}
+
+TEST(ReplyEncoder, InodeStatOldEncoding)
+{
+  auto st = make_stat(0x10000000001);
+  st.con_features = CEPH_FEATURES_SUPPORTED_DEFAULT;
+  ceph::bufferlist bl;
+  st.encode(bl);
+  auto p = bl.cbegin();
+  InodeStat ist(p, st.con_features);
+  EXPECT_TRUE(p.end());
+  check_stat(st, ist);
+}
+
+TEST(ReplyEncoder, DeferredMatchesInline)
+{
+  // the same pieces encode to the same bytes whether the stats are
+  // encoded as they are added or later
+  deferred_bl_t inline_bl;
+  deferred_bl_t deferred(true);
+  deferred_bl_t tail(true);
+  for (int i = 0; i < 5; ++i) {
+    for (auto dbl : {&inline_bl, &deferred}) {
+      ceph::bufferlist name;
+      encode(std::string("dn") + std::to_string(i), name);
+      dbl->append(std::move(name));
+      auto st = make_stat(0x10000000000 + i);
+      st.reply_encoding = i % 2;
+      st.con_features = CEPH_FEATURES_SUPPORTED_DEFAULT;
+      st.length_bound = 4096;
+      dbl->append(std::move(st));
+    }
+  }
+  EXPECT_FALSE(inline_bl.is_deferred());
+  EXPECT_TRUE(deferred.is_deferred());
+
+  ceph::bufferlist head;
+  encode((__u32)5, head);
+  tail.append(std::move(head));
+  tail.claim_append(deferred);
+  EXPECT_TRUE(deferred.empty());
+  EXPECT_EQ(0u, deferred.length());
+
+  ceph::bufferlist expected;
+  encode((__u32)5, expected);
+  inline_bl.encode(expected);
+  ceph::bufferlist bl;
+  tail.encode(bl);
+  EXPECT_TRUE(bl.contents_equal(expected));
+
+  // the deferred length is a bound
+  EXPECT_EQ(expected.length(), 4 + inline_bl.length());
+  EXPECT_GE(tail.length(), bl.length());
+}
@@ -0,0 +1,245 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+// Metadata benchmark for a single MDS rank: every thread mounts its own
+// client (so that requests are not serialized by one client_lock) and
+// runs stat or readdir against a pre-built tree for a fixed time.  The
+// clients keep only a handful of inodes cached so that nearly every
+// operation turns into a lookup, getattr or readdir request on the MDS.
+// Run it with an increasing number of threads to see how one rank
+// scales, with mds_reply_encode_threads at 0 and above; compare with
+// the mds "dispatch_lock_wait" perf counter.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/cephfs/libcephfs.h"
+
+struct bench_config_t {
+  std::string root = "/mds_md_bench";
+  unsigned dirs = 64;
+  unsigned files = 1024;       // per directory
+  unsigned seconds = 20;
+  std::vector<unsigned> threads = {1, 2, 4, 8, 16};
+  std::string cache_size = "16";
+  bool create = true;
+};
+
+static int do_mount(const bench_config_t& conf, ceph_mount_info** cmount)
+{
+  int r = ceph_create(cmount, nullptr);
+  if (r < 0) {
+    return r;
+  }
+  ceph_conf_read_file(*cmount, nullptr);
+  ceph_conf_parse_env(*cmount, nullptr);
+  ceph_conf_set(*cmount, "client_cache_size", conf.cache_size.c_str());
+  r = ceph_mount(*cmount, "/");
+  if (r < 0) {
+    ceph_release(*cmount);
+    *cmount = nullptr;
+  }
+  return r;
+}
+
+static std::string dir_path(const bench_config_t& conf, unsigned d)
+{
+  return conf.root + "/d" + std::to_string(d);
+}
+
+static std::string file_path(const bench_config_t& conf, unsigned d,
+                             unsigned f)
+{
+  return dir_path(conf, d) + "/f" + std::to_string(f);
+}
+
+static int create_tree(const bench_config_t& conf)
+{
+  ceph_mount_info* cmount;
+  int r = do_mount(conf, &cmount);
+  if (r < 0) {
+    return r;
+  }
+  for (unsigned d = 0; d < conf.dirs && r >= 0; ++d) {
+    r = ceph_mkdirs(cmount, dir_path(conf, d).c_str(), 0755);
+    if (r == -EEXIST) {
+      r = 0;
+    }
+    for (unsigned f = 0; f < conf.files && r >= 0; ++f) {
+      int fd = ceph_open(cmount, file_path(conf, d, f).c_str(),
+                         O_CREAT | O_WRONLY, 0644);
+      if (fd < 0) {
+        r = fd;
+      } else {
+        ceph_close(cmount, fd);
+      }
+    }
+  }
+  ceph_shutdown(cmount);
+  return r;
+}
+
+static int run(const bench_config_t& conf, const std::string& op,
+               unsigned nthreads)
+{
+  std::vector<ceph_mount_info*> mounts(nthreads, nullptr);
+  int r = 0;
+  for (auto& m : mounts) {
+    r = do_mount(conf, &m);
+    if (r < 0) {
+      break;
+    }
+  }
+
+  std::atomic<uint64_t> ops = 0;
+  std::atomic<int> error = 0;
+  std::atomic<bool> stop = false;
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; r == 0 && i < nthreads; ++i) {
+    threads.emplace_back([&, cmount = mounts[i], seed = i] {
+      std::minstd_rand rng(seed);
+      uint64_t n = 0;
+      while (!stop) {
+        unsigned d = rng() % conf.dirs;
+        int ret = 0;
+        if (op == "stat") {
+          struct ceph_statx stx;
+          ret = ceph_statx(cmount, file_path(conf, d, rng() % conf.files).c_str(),
+                           &stx, CEPH_STATX_BASIC_STATS, 0);
+        } else {
+          ceph_dir_result* dirp;
+          ret = ceph_opendir(cmount, dir_path(conf, d).c_str(), &dirp);
+          if (ret == 0) {
+            while (ceph_readdir(cmount, dirp) != nullptr);
+            ceph_closedir(cmount, dirp);
+          }
+        }
+        if (ret < 0) {
+          error = ret;
+          break;
+        }
+        ++n;
+      }
+      ops += n;
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::seconds(conf.seconds));
+  stop = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  for (auto m : mounts) {
+    if (m) {
+      ceph_shutdown(m);
+    }
+  }
+  if (r < 0) {
+    return r;
+  }
+  if (error < 0) {
+    return error;
+  }
+
+  std::cout << op << "  threads " << nthreads
+            << "  " << static_cast<uint64_t>(ops / elapsed) << " ops/s"
+            << std::endl;
+  return 0;
+}
+
+static void usage(const char* name)
+{
+  std::cout << "usage: " << name << " [options]\n"
+	    << "  --root <path>          benchmark tree (/mds_md_bench)\n"
+	    << "  --dirs <n>             directories in the tree (64)\n"
+	    << "  --files <n>            files per directory (1024)\n"
+	    << "  --seconds <n>          duration of each run (20)\n"
+	    << "  --threads <n,...>      thread counts to run (1,2,4,8,16)\n"
+	    << "  --cache-size <n>       client_cache_size of each client (16)\n"
+	    << "  --no-create            reuse an existing tree\n"
+	    << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  bench_config_t conf;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (arg == "--no-create") {
+      conf.create = false;
+      continue;
+    }
+    if (i + 1 == argc) {
+      std::cerr << argv[0] << ": " << arg << " requires a value" << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::string val = argv[++i];
+    try {
+      if (arg == "--root") {
+        conf.root = val;
+      } else if (arg == "--dirs") {
+        conf.dirs = std::stoul(val);
+      } else if (arg == "--files") {
+        conf.files = std::stoul(val);
+      } else if (arg == "--seconds") {
+        conf.seconds = std::stoul(val);
+      } else if (arg == "--cache-size") {
+        conf.cache_size = std::to_string(std::stoul(val));
+      } else if (arg == "--threads") {
+        conf.threads.clear();
+        std::istringstream ss(val);
+        for (std::string t; std::getline(ss, t, ','); ) {
+          conf.threads.push_back(std::stoul(t));
+        }
+      } else {
+        std::cerr << "unknown option " << arg << std::endl;
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } catch (const std::logic_error&) {
+      std::cerr << argv[0] << ": bad value for " << arg << ": " << val
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (conf.dirs == 0 || conf.files == 0) {
+    std::cerr << argv[0] << ": tree must not be empty" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (conf.create) {
+    int r = create_tree(conf);
+    if (r < 0) {
+      std::cerr << "failed to create " << conf.root << ": "
+                << strerror(-r) << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  for (auto& op : {"stat", "readdir"}) {
+    for (auto n : conf.threads) {
+      int r = run(conf, op, std::max(n, 1u));
+      if (r < 0) {
+        std::cerr << op << " with " << n << " threads failed: "
+                  << strerror(-r) << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
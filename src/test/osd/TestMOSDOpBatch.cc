@@ -0,0 +1,173 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "gtest/gtest.h"
+
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "common/common_init.h"
+#include "messages/MOSDOp.h"
+#include "messages/MOSDOpBatch.h"
+#include "messages/MOSDOpReply.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+  std::vector<const char*> args(argv, argv+argc);
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+namespace {
+
+const uint64_t features = CEPH_FEATURES_ALL;
+const epoch_t epoch = 10;
+
+struct op_spec_t {
+  ceph_tid_t tid;
+  string oid;
+  uint64_t off;
+  string data;	// empty for a read
+  __u16 priority;
+};
+
+const vector<op_spec_t> specs = {
+  {101, "obj_a", 0, "first write", CEPH_MSG_PRIO_DEFAULT},
+  {102, "obj_b", 8192, "", CEPH_MSG_PRIO_LOW},
+  {103, "obj_c", 4096 + 100, string(5000, 'c'), CEPH_MSG_PRIO_HIGH},
+  {107, "obj_a", 4095, "straddles a page", CEPH_MSG_PRIO_DEFAULT},
+};
+
+spg_t get_pgid() {
+  return spg_t(pg_t(7, 3));
+}
+
+MOSDOp *make_op(const op_spec_t& spec) {
+  spg_t pgid = get_pgid();
+  hobject_t hoid(object_t(spec.oid), "", CEPH_NOSNAP, 3, 3, "");
+  auto m = new MOSDOp(1, spec.tid, hoid, pgid, epoch,
+		      spec.data.empty() ? CEPH_OSD_FLAG_READ : CEPH_OSD_FLAG_WRITE,
+		      features);
+  if (spec.data.empty()) {
+    m->read(spec.off, 4096);
+  } else {
+    bufferlist bl;
+    bl.append(spec.data);
+    m->write(spec.off, bl.length(), bl);
+  }
+  m->set_priority(spec.priority);
+  m->set_retry_attempt(spec.tid % 2);
+  return m;
+}
+
+// send m through encode_message()/decode_message() as the messenger would
+template <typename M>
+ceph::ref_t<M> over_the_wire(Message *m) {
+  bufferlist bl;
+  encode_message(m, features, bl);
+  auto p = bl.cbegin();
+  Message *decoded = decode_message(g_ceph_context, 0, p);
+  ceph_assert(decoded);
+  return ceph::ref_t<M>(static_cast<M*>(decoded), false);
+}
+
+ceph::ref_t<MOSDOpBatch> make_batch() {
+  auto batch = ceph::make_message<MOSDOpBatch>(get_pgid());
+  for (auto& spec : specs) {
+    auto m = make_op(spec);
+    batch->add_op(m, features);
+    m->put();
+  }
+  return over_the_wire<MOSDOpBatch>(batch.get());
+}
+
+} // anonymous namespace
+
+TEST(MOSDOpBatch, Unpack)
+{
+  auto batch = make_batch();
+  ASSERT_EQ(CEPH_MSG_PRIO_HIGH, batch->get_priority());
+  ASSERT_EQ(get_pgid(), batch->pgid);
+  ASSERT_EQ(specs.size(), batch->get_num_ops());
+
+  auto ops = batch->unpack<MOSDOp>();
+  ASSERT_EQ(specs.size(), ops.size());
+  for (size_t i = 0; i < specs.size(); ++i) {
+    auto& spec = specs[i];
+    auto& m = ops[i];
+    EXPECT_EQ(CEPH_MSG_OSD_OP, m->get_type());
+    EXPECT_EQ(spec.tid, m->get_tid());
+    EXPECT_EQ(spec.priority, m->get_priority());
+    EXPECT_EQ(spec.data.length(), m->get_header().data_len);
+    EXPECT_EQ(spec.data, m->get_data().to_str());
+    if (!spec.data.empty()) {
+      // the data lands at the offset within a page it was written at,
+      // as it would have had the op been received on its own
+      EXPECT_EQ(spec.off, m->get_header().data_off);
+      EXPECT_EQ(1u, m->get_data().get_num_buffers());
+      EXPECT_EQ(spec.off & ~CEPH_PAGE_MASK,
+		(uintptr_t)m->get_data().c_str() & ~CEPH_PAGE_MASK);
+    }
+
+    ASSERT_TRUE(m->finish_decode());
+    EXPECT_EQ(spec.oid, m->get_hobj().oid.name);
+    EXPECT_EQ(get_pgid(), m->get_spg());
+    EXPECT_EQ(epoch, m->get_map_epoch());
+    EXPECT_EQ((int)(spec.tid % 2), m->get_retry_attempt());
+    ASSERT_EQ(1u, m->ops.size());
+    EXPECT_EQ(spec.data.empty() ? CEPH_OSD_OP_READ : CEPH_OSD_OP_WRITE,
+	      m->ops[0].op.op);
+    EXPECT_EQ(spec.off, m->ops[0].op.extent.offset);
+  }
+}
+
+TEST(MOSDOpBatch, RepliesMatchTids)
+{
+  auto batch = make_batch();
+  auto ops = batch->unpack<MOSDOp>();
+  ASSERT_EQ(specs.size(), ops.size());
+
+  // reply to the ops out of order; each reply must still carry the tid
+  // and object of the op it answers
+  for (size_t i = ops.size(); i-- > 0; ) {
+    auto& m = ops[i];
+    ASSERT_TRUE(m->finish_decode());
+    auto reply = ceph::make_message<MOSDOpReply>(m.get(), 0, epoch,
+						 CEPH_OSD_FLAG_ACK, true);
+    auto received = over_the_wire<MOSDOpReply>(reply.get());
+    EXPECT_EQ(specs[i].tid, received->get_tid());
+    EXPECT_EQ(specs[i].oid, received->get_oid().name);
+    EXPECT_EQ((int)(specs[i].tid % 2), received->get_retry_attempt());
+    EXPECT_EQ(0, received->get_result());
+  }
+}
+
+TEST(MOSDOpBatch, Empty)
+{
+  auto batch = ceph::make_message<MOSDOpBatch>(get_pgid());
+  auto received = over_the_wire<MOSDOpBatch>(batch.get());
+  EXPECT_EQ(0u, received->get_num_ops());
+  EXPECT_TRUE(received->unpack<MOSDOp>().empty());
+}
+
+TEST(MOSDOpBatch, Malformed)
+{
+  {
+    // an op claims more data than the batch carries
+    auto batch = make_batch();
+    batch->ops.back().data_len += 1;
+    EXPECT_THROW(batch->unpack<MOSDOp>(), ceph::buffer::error);
+  }
+  {
+    // an op's front is cut short
+    auto batch = make_batch();
+    bufferlist front;
+    batch->ops[1].front.splice(0, 10, &front);
+    batch->ops[1].front.swap(front);
+    EXPECT_THROW(batch->unpack<MOSDOp>(), ceph::buffer::error);
+  }
+}
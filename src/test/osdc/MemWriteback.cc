@@ -55,7 +55,7 @@ class C_DelayWrite : public Context {
   object_t m_oid;
   uint64_t m_off;
   uint64_t m_len;
-  const bufferlist& m_bl;
+  bufferlist m_bl;
 
 public:
   C_DelayWrite(MemWriteback *mwb, CephContext *cct, Context *c, ceph::mutex *lock,
@@ -153,6 +153,10 @@ int MemWriteback::read_object_data(const object_t& oid, uint64_t off, uint64_t l
 
   const bufferlist& obj_bl = obj_i->second;
   dout(1) << "reading " << oid << " from total size " << obj_bl.length() << dendl;
+  if (off >= obj_bl.length()) {
+    data_bl->clear();
+    return 0;
+  }
 
   uint64_t read_len = std::min(len, obj_bl.length()-off);
   data_bl->substr_of(obj_bl, off, read_len);
@@ -0,0 +1,335 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+// Compare ObjectCacher, serialized on its single lock, with
+// ExtentObjectCacher under many concurrent callers.  Each thread works
+// on its own object set (as separate files or images would), issuing
+// random small reads and writes against MemWriteback.  With
+// --verify every read is checked against a per-thread model of the
+// data.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/Cond.h"
+#include "common/ceph_argparse.h"
+#include "common/ceph_mutex.h"
+#include "common/config.h"
+#include "common/snap_types.h"
+#include "global/global_init.h"
+#include "include/buffer.h"
+#include "include/stringify.h"
+#include "osdc/ExtentObjectCacher.h"
+#include "osdc/ObjectCacher.h"
+
+#include "MemWriteback.h"
+
+struct bench_config_t {
+  unsigned threads = 8;
+  uint64_t ops = 20000;
+  uint64_t objects = 4;
+  uint64_t obj_bytes = 4 << 20;
+  uint64_t max_len = 16 << 10;
+  float percent_reads = 0.7;
+  uint64_t delay_ns = 0;
+  bool verify = false;
+  int seed = 0;
+};
+
+struct workload_t {
+  const bench_config_t& conf;
+  std::mt19937_64 rng;
+  unsigned thread;
+  /// per object model, only maintained when verifying
+  std::vector<ceph::bufferlist> model;
+  bool failed = false;
+
+  workload_t(const bench_config_t& conf, unsigned thread)
+    : conf(conf), rng(conf.seed + thread), thread(thread) {
+    if (conf.verify) {
+      model.resize(conf.objects);
+      for (auto& bl : model) {
+	bl.append_zero(conf.obj_bytes);
+      }
+    }
+  }
+
+  ObjectExtent next_extent(uint64_t *objno) {
+    *objno = rng() % conf.objects;
+    uint64_t off = rng() % conf.obj_bytes;
+    uint64_t len = 1 + rng() % std::min(conf.max_len, conf.obj_bytes - off);
+    ObjectExtent ex(object_t("bench." + stringify(thread) + "." +
+			     stringify(*objno)),
+		    *objno, off, len, 0);
+    ex.oloc.pool = 0;
+    ex.buffer_extents.emplace_back(0, len);
+    return ex;
+  }
+
+  bool next_is_read() {
+    return (rng() % 1000) < conf.percent_reads * 1000;
+  }
+
+  ceph::bufferlist make_data(uint64_t len) {
+    ceph::bufferptr bp(len);
+    char c = 'a' + rng() % 26;
+    memset(bp.c_str(), c, len);
+    ceph::bufferlist bl;
+    bl.append(std::move(bp));
+    return bl;
+  }
+
+  void model_write(uint64_t objno, const ObjectExtent& ex,
+		   const ceph::bufferlist& bl) {
+    if (!conf.verify) {
+      return;
+    }
+    ceph::bufferlist& m = model[objno];
+    ceph::bufferlist n, tail;
+    n.substr_of(m, 0, ex.offset);
+    n.append(bl);
+    tail.substr_of(m, ex.offset + ex.length,
+		   m.length() - ex.offset - ex.length);
+    n.append(tail);
+    m.swap(n);
+  }
+
+  void model_check(uint64_t objno, const ObjectExtent& ex,
+		   ceph::bufferlist& bl) {
+    if (!conf.verify) {
+      return;
+    }
+    ceph::bufferlist expect;
+    expect.substr_of(model[objno], ex.offset, ex.length);
+    if (!bl.contents_equal(expect)) {
+      std::cerr << "thread " << thread << " read mismatch at " << ex
+		<< std::endl;
+      failed = true;
+    }
+  }
+};
+
+static double run_object_cacher(const bench_config_t& conf, bool *failed)
+{
+  ceph::mutex lock = ceph::make_mutex("object_cacher_bench::object_cacher");
+  MemWriteback writeback(g_ceph_context, &lock, conf.delay_ns);
+  ObjectCacher obc(g_ceph_context, "bench", writeback, lock, NULL, NULL,
+		   g_conf()->client_oc_size,
+		   g_conf()->client_oc_max_objects,
+		   g_conf()->client_oc_max_dirty,
+		   g_conf()->client_oc_target_dirty,
+		   g_conf()->client_oc_max_dirty_age,
+		   true);
+  obc.start();
+
+  std::vector<std::unique_ptr<ObjectCacher::ObjectSet>> osets;
+  for (unsigned t = 0; t < conf.threads; ++t) {
+    osets.emplace_back(new ObjectCacher::ObjectSet(NULL, 0, t + 1));
+  }
+
+  std::vector<std::thread> threads;
+  std::vector<std::unique_ptr<workload_t>> loads;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned t = 0; t < conf.threads; ++t) {
+    loads.emplace_back(new workload_t(conf, t));
+    threads.emplace_back([&, t] {
+      workload_t& w = *loads[t];
+      SnapContext snapc;
+      for (uint64_t i = 0; i < conf.ops; ++i) {
+	uint64_t objno;
+	ObjectExtent ex = w.next_extent(&objno);
+	if (w.next_is_read()) {
+	  ceph::bufferlist bl;
+	  C_SaferCond cond;
+	  ObjectCacher::OSDRead *rd = obc.prepare_read(CEPH_NOSNAP, &bl, 0);
+	  rd->extents.push_back(ex);
+	  lock.lock();
+	  int r = obc.readx(rd, osets[t].get(), &cond);
+	  lock.unlock();
+	  if (r == 0) {
+	    r = cond.wait();
+	  }
+	  ceph_assert(r >= 0);
+	  w.model_check(objno, ex, bl);
+	} else {
+	  ceph::bufferlist bl = w.make_data(ex.length);
+	  ObjectCacher::OSDWrite *wr =
+	    obc.prepare_write(snapc, bl, ceph::real_time::min(), 0, 0);
+	  wr->extents.push_back(ex);
+	  lock.lock();
+	  obc.writex(wr, osets[t].get(), NULL);
+	  lock.unlock();
+	  w.model_write(objno, ex, bl);
+	}
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  for (auto& oset : osets) {
+    C_SaferCond flushed;
+    lock.lock();
+    obc.flush_set(oset.get(), &flushed);
+    lock.unlock();
+    flushed.wait();
+    lock.lock();
+    obc.release_set(oset.get());
+    lock.unlock();
+  }
+  obc.stop();
+  for (auto& w : loads) {
+    *failed |= w->failed;
+  }
+  return conf.ops * conf.threads / elapsed.count();
+}
+
+static double run_extent_object_cacher(const bench_config_t& conf,
+				       unsigned shards, bool *failed)
+{
+  // ExtentObjectCacher takes no caller lock; MemWriteback still wants
+  // one to serialize its backing store
+  ceph::mutex wb_lock = ceph::make_mutex("object_cacher_bench::writeback");
+  MemWriteback writeback(g_ceph_context, &wb_lock, conf.delay_ns);
+  ExtentObjectCacher eoc(g_ceph_context, "bench", writeback,
+			 g_conf()->client_oc_size,
+			 g_conf()->client_oc_max_dirty,
+			 g_conf()->client_oc_target_dirty,
+			 g_conf()->client_oc_max_dirty_age,
+			 shards);
+  eoc.start();
+
+  std::vector<std::unique_ptr<ExtentObjectCacher::ObjectSet>> osets;
+  for (unsigned t = 0; t < conf.threads; ++t) {
+    osets.emplace_back(new ExtentObjectCacher::ObjectSet(0, t + 1));
+  }
+
+  std::vector<std::thread> threads;
+  std::vector<std::unique_ptr<workload_t>> loads;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned t = 0; t < conf.threads; ++t) {
+    loads.emplace_back(new workload_t(conf, t));
+    threads.emplace_back([&, t] {
+      workload_t& w = *loads[t];
+      SnapContext snapc;
+      std::vector<ObjectExtent> extents(1);
+      for (uint64_t i = 0; i < conf.ops; ++i) {
+	uint64_t objno;
+	extents[0] = w.next_extent(&objno);
+	if (w.next_is_read()) {
+	  ceph::bufferlist bl;
+	  C_SaferCond cond;
+	  int r = eoc.readx(extents, CEPH_NOSNAP, &bl, osets[t].get(), &cond);
+	  if (r == 0) {
+	    r = cond.wait();
+	  }
+	  ceph_assert(r >= 0);
+	  w.model_check(objno, extents[0], bl);
+	} else {
+	  ceph::bufferlist bl = w.make_data(extents[0].length);
+	  eoc.writex(extents, snapc, bl, ceph::real_time::min(),
+		     osets[t].get());
+	  w.model_write(objno, extents[0], bl);
+	}
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  for (auto& oset : osets) {
+    C_SaferCond flushed;
+    eoc.flush_set(oset.get(), &flushed);
+    flushed.wait();
+    if (eoc.release_set(oset.get())) {
+      std::cerr << "unclean data left after flush" << std::endl;
+      *failed = true;
+    }
+  }
+  eoc.stop();
+  for (auto& w : loads) {
+    *failed |= w->failed;
+  }
+  return conf.ops * conf.threads / elapsed.count();
+}
+
+int main(int argc, const char **argv)
+{
+  std::vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+  bench_config_t conf;
+  conf.seed = time(0) % 100000;
+  int threads = conf.threads;
+  long long ops = conf.ops;
+  long long objects = conf.objects;
+  long long obj_bytes = conf.obj_bytes;
+  long long max_len = conf.max_len;
+  long long delay_ns = conf.delay_ns;
+  int shards = 0;
+  std::ostringstream err;
+  for (auto i = args.begin(); i != args.end();) {
+    if (ceph_argparse_witharg(args, i, &threads, err, "--threads", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &ops, err, "--ops", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &objects, err, "--objects", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &obj_bytes, err, "--obj-size", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &max_len, err, "--max-op-size", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &delay_ns, err, "--delay-ns", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &conf.percent_reads, err, "--percent-read", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &shards, err, "--shards", (char*)NULL) ||
+	ceph_argparse_witharg(args, i, &conf.seed, err, "--seed", (char*)NULL)) {
+      if (!err.str().empty()) {
+	std::cerr << argv[0] << ": " << err.str() << std::endl;
+	return EXIT_FAILURE;
+      }
+    } else if (ceph_argparse_flag(args, i, "--verify", (char*)NULL)) {
+      conf.verify = true;
+    } else {
+      std::cerr << "unknown option " << *i << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  conf.threads = std::max(threads, 1);
+  conf.ops = ops;
+  conf.objects = std::max(objects, 1ll);
+  conf.obj_bytes = obj_bytes;
+  conf.max_len = max_len;
+  conf.delay_ns = delay_ns;
+  if (shards <= 0) {
+    shards = conf.threads;
+  }
+
+  std::cout << "threads " << conf.threads << " ops/thread " << conf.ops
+	    << " objects/thread " << conf.objects
+	    << " max op size " << conf.max_len
+	    << " percent reads " << conf.percent_reads
+	    << " seed " << conf.seed << std::endl;
+
+  bool failed = false;
+  double oc = run_object_cacher(conf, &failed);
+  std::cout << "ObjectCacher:       " << oc << " ops/s" << std::endl;
+  double eoc = run_extent_object_cacher(conf, shards, &failed);
+  std::cout << "ExtentObjectCacher: " << eoc << " ops/s (" << shards
+	    << " shards)" << std::endl;
+
+  if (failed) {
+    std::cerr << "verification failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
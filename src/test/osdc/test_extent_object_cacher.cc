@@ -0,0 +1,449 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "common/Cond.h"
+#include "common/ceph_context.h"
+#include "common/ceph_mutex.h"
+#include "common/snap_types.h"
+#include "global/global_context.h"
+#include "include/buffer.h"
+#include "osdc/ExtentObjectCacher.h"
+#include "osdc/WritebackHandler.h"
+
+#include "gtest/gtest.h"
+
+using ceph::bufferlist;
+
+/**
+ * Keeps objects in memory and holds every read and write until the test
+ * completes it, so that completions can be ordered against other I/O.
+ * A read returns the data as of when it was issued.  A write that is
+ * failed leaves the object alone.
+ */
+class ManualWriteback : public WritebackHandler {
+public:
+  struct read_t {
+    bufferlist data;
+    bufferlist *pbl;
+    Context *onfinish;
+  };
+  struct write_t {
+    object_t oid;
+    uint64_t off;
+    bufferlist bl;
+    __u32 trunc_seq;
+    Context *oncommit;
+  };
+
+  std::map<object_t, bufferlist> store;
+
+  void read(const object_t& oid, uint64_t object_no,
+	    const object_locator_t& oloc, uint64_t off, uint64_t len,
+	    snapid_t snapid, bufferlist *pbl, uint64_t trunc_size,
+	    __u32 trunc_seq, int op_flags,
+	    const ZTracer::Trace &parent_trace, Context *onfinish) override {
+    std::lock_guard l{lock};
+    read_t r{{}, pbl, onfinish};
+    auto& obj = store[oid];
+    if (off < obj.length()) {
+      r.data.substr_of(obj, off, std::min<uint64_t>(len, obj.length() - off));
+    }
+    reads.push_back(std::move(r));
+  }
+
+  bool may_copy_on_write(const object_t&, uint64_t, uint64_t,
+			 snapid_t) override {
+    return false;
+  }
+
+  ceph_tid_t write(const object_t& oid, const object_locator_t& oloc,
+		   uint64_t off, uint64_t len, const SnapContext& snapc,
+		   const bufferlist &bl, ceph::real_time mtime,
+		   uint64_t trunc_size, __u32 trunc_seq,
+		   ceph_tid_t journal_tid, const ZTracer::Trace &parent_trace,
+		   Context *oncommit) override {
+    std::lock_guard l{lock};
+    writes.push_back({oid, off, bl, trunc_seq, oncommit});
+    return ++tid;
+  }
+
+  size_t num_reads() {
+    std::lock_guard l{lock};
+    return reads.size();
+  }
+
+  size_t num_writes() {
+    std::lock_guard l{lock};
+    return writes.size();
+  }
+
+  void complete_reads() {
+    std::deque<read_t> rs;
+    {
+      std::lock_guard l{lock};
+      rs.swap(reads);
+    }
+    for (auto& r : rs) {
+      *r.pbl = std::move(r.data);
+      r.onfinish->complete(0);
+    }
+  }
+
+  void complete_writes(int r = 0) {
+    std::deque<write_t> ws;
+    {
+      std::lock_guard l{lock};
+      ws.swap(writes);
+      for (auto& w : ws) {
+	last_trunc_seq = w.trunc_seq;
+	if (r < 0) {
+	  continue;
+	}
+	auto& obj = store[w.oid];
+	if (obj.length() < w.off + w.bl.length()) {
+	  obj.append_zero(w.off + w.bl.length() - obj.length());
+	}
+	bufferlist t;
+	t.substr_of(obj, 0, w.off);
+	t.append(w.bl);
+	if (obj.length() > w.off + w.bl.length()) {
+	  bufferlist tail;
+	  tail.substr_of(obj, w.off + w.bl.length(),
+			 obj.length() - w.off - w.bl.length());
+	  t.append(tail);
+	}
+	obj.swap(t);
+      }
+    }
+    for (auto& w : ws) {
+      w.oncommit->complete(r);
+    }
+  }
+
+  __u32 last_trunc_seq = 0;
+
+private:
+  ceph::mutex lock = ceph::make_mutex("ManualWriteback::lock");
+  std::deque<read_t> reads;
+  std::deque<write_t> writes;
+  ceph_tid_t tid = 0;
+};
+
+class TestExtentObjectCacher : public ::testing::Test {
+public:
+  static constexpr uint64_t OBJ_SIZE = 1 << 16;
+
+  ManualWriteback wb;
+  ExtentObjectCacher::ObjectSet oset{0, 1};
+
+  std::unique_ptr<ExtentObjectCacher> make_cacher(uint64_t max_bytes,
+						  uint64_t max_dirty = 1 << 20) {
+    // no flusher thread: nothing is written back unless flushed
+    return std::make_unique<ExtentObjectCacher>(
+      g_ceph_context, "test", wb, max_bytes, max_dirty, max_dirty, 1, 4);
+  }
+
+  static std::vector<ObjectExtent> extents(uint64_t objectno, uint64_t off,
+					   uint64_t len) {
+    char oid[32];
+    snprintf(oid, sizeof(oid), "obj.%08llx", (unsigned long long)objectno);
+    ObjectExtent ex(object_t(oid), objectno, off, len, 0);
+    ex.oloc.pool = 0;
+    ex.buffer_extents.emplace_back(0, len);
+    return {ex};
+  }
+
+  static bufferlist pattern(uint64_t len, char c) {
+    bufferlist bl;
+    bl.append(std::string(len, c));
+    return bl;
+  }
+
+  void put_object(uint64_t objectno, char c) {
+    wb.store[object_t(extents(objectno, 0, 1)[0].oid)] = pattern(OBJ_SIZE, c);
+  }
+};
+
+TEST_F(TestExtentObjectCacher, ReadMissThenHit) {
+  auto oc = make_cacher(1 << 20);
+  put_object(0, 'a');
+
+  bufferlist bl;
+  C_SaferCond cond;
+  ASSERT_EQ(0, oc->readx(extents(0, 0, 4096), CEPH_NOSNAP, &bl, &oset,
+			 &cond));
+  ASSERT_EQ(1u, wb.num_reads());
+  wb.complete_reads();
+  ASSERT_EQ(4096, cond.wait());
+  ASSERT_TRUE(bl.contents_equal(pattern(4096, 'a')));
+  ASSERT_EQ(4096u, oc->get_stat_clean());
+
+  bufferlist bl2;
+  C_SaferCond unused;
+  ASSERT_EQ(4096, oc->readx(extents(0, 0, 4096), CEPH_NOSNAP, &bl2, &oset,
+			    &unused));
+  ASSERT_EQ(0u, wb.num_reads());
+  ASSERT_TRUE(bl2.contents_equal(pattern(4096, 'a')));
+  unused.complete(0);
+
+  ASSERT_EQ(0u, oc->release_set(&oset));
+  ASSERT_TRUE(oc->set_is_empty(&oset));
+  oc->stop();
+}
+
+TEST_F(TestExtentObjectCacher, EmptyRead) {
+  auto oc = make_cacher(1 << 20);
+  bufferlist bl;
+  C_SaferCond cond;
+  ASSERT_EQ(0, oc->readx({}, CEPH_NOSNAP, &bl, &oset, &cond));
+  ASSERT_EQ(0, cond.wait());
+  ASSERT_EQ(0u, wb.num_reads());
+  oc->stop();
+}
+
+TEST_F(TestExtentObjectCacher, WriteThenFlush) {
+  auto oc = make_cacher(1 << 20);
+  ASSERT_EQ(0, oc->writex(extents(0, 100, 200), SnapContext(),
+			  pattern(200, 'w'), ceph::real_clock::now(), &oset));
+  ASSERT_EQ(200u, oc->get_stat_dirty());
+
+  // a partial read hits the dirty data and fetches the rest
+  bufferlist bl;
+  C_SaferCond cond;
+  ASSERT_EQ(0, oc->readx(extents(0, 0, 400), CEPH_NOSNAP, &bl, &oset,
+			 &cond));
+  ASSERT_EQ(2u, wb.num_reads());
+  wb.complete_reads();
+  ASSERT_EQ(400, cond.wait());
+  bufferlist expected;
+  expected.append_zero(100);
+  expected.append(pattern(200, 'w'));
+  expected.append_zero(100);
+  ASSERT_TRUE(bl.contents_equal(expected));
+
+  C_SaferCond flushed;
+  ASSERT_FALSE(oc->flush_set(&oset, &flushed));
+  ASSERT_EQ(1u, wb.num_writes());
+  ASSERT_EQ(200u, oc->get_stat_tx());
+  wb.complete_writes();
+  ASSERT_EQ(0, flushed.wait());
+  ASSERT_EQ(0u, oc->get_stat_dirty());
+  ASSERT_EQ(0u, oc->get_stat_tx());
+  ASSERT_TRUE(oc->flush_set(&oset));
+  oc->stop();
+}
+
+TEST_F(TestExtentObjectCacher, ReadRacingWriteIsNotCached) {
+  auto oc = make_cacher(1 << 20);
+  put_object(0, 'o');
+
+  // the read reaches the OSD first and returns the old data ...
+  bufferlist bl;
+  C_SaferCond cond;
+  ASSERT_EQ(0, oc->readx(extents(0, 0, 4096), CEPH_NOSNAP, &bl, &oset,
+			 &cond));
+  ASSERT_EQ(1u, wb.num_reads());
+
+  // ... while a write of the same range is buffered, written back and
+  // dropped again before the read completes
+  ASSERT_EQ(0, oc->writex(extents(0, 0, 4096), SnapContext(),
+			  pattern(4096, 'n'), ceph::real_clock::now(), &oset));
+  C_SaferCond flushed;
+  oc->flush_set(&oset, &flushed);
+  wb.complete_writes();
+  ASSERT_EQ(0, flushed.wait());
+  oc->release_set(&oset);
+  ASSERT_EQ(0u, oc->get_stat_clean());
+
+  wb.complete_reads();
+  ASSERT_EQ(4096, cond.wait());
+  ASSERT_TRUE(bl.contents_equal(pattern(4096, 'o')));
+
+  // the old data must not have been cached
+  ASSERT_EQ(0u, oc->get_stat_clean());
+  bufferlist bl2;
+  C_SaferCond cond2;
+  ASSERT_EQ(0, oc->readx(extents(0, 0, 4096), CEPH_NOSNAP, &bl2, &oset,
+			 &cond2));
+  wb.complete_reads();
+  ASSERT_EQ(4096, cond2.wait());
+  ASSERT_TRUE(bl2.contents_equal(pattern(4096, 'n')));
+  oc->stop();
+}
+
+TEST_F(TestExtentObjectCacher, TrimToMaxBytes) {
+  const uint64_t max_bytes = 3 * 4096;
+  auto oc = make_cacher(max_bytes);
+  for (uint64_t i = 0; i < 8; ++i) {
+    put_object(i, 'a' + i);
+    bufferlist bl;
+    C_SaferCond cond;
+    ASSERT_EQ(0, oc->readx(extents(i, 0, 4096), CEPH_NOSNAP, &bl, &oset,
+			   &cond));
+    wb.complete_reads();
+    ASSERT_EQ(4096, cond.wait());
+    ASSERT_LE(oc->get_stat_clean(), max_bytes);
+  }
+
+  // the most recently read object is still cached
+  bufferlist bl;
+  C_SaferCond unused;
+  ASSERT_EQ(4096, oc->readx(extents(7, 0, 4096), CEPH_NOSNAP, &bl, &oset,
+			    &unused));
+  ASSERT_TRUE(bl.contents_equal(pattern(4096, 'h')));
+  unused.complete(0);
+
+  // dirty data is never trimmed, clean data makes room around it
+  ASSERT_EQ(0, oc->writex(extents(0, 0, 2 * 4096), SnapContext(),
+			  pattern(2 * 4096, 'w'), ceph::real_clock::now(),
+			  &oset));
+  ASSERT_EQ(2u * 4096, oc->get_stat_dirty());
+  ASSERT_LE(oc->get_stat_clean(), max_bytes - 2 * 4096);
+
+  C_SaferCond flushed;
+  oc->flush_set(&oset, &flushed);
+  wb.complete_writes();
+  ASSERT_EQ(0, flushed.wait());
+  oc->release_set(&oset);
+  oc->stop();
+}
+
+TEST_F(TestExtentObjectCacher, WriteErrorGoesToFlush) {
+  auto oc = make_cacher(1 << 20);
+  ASSERT_EQ(0, oc->writex(extents(0, 0, 4096), SnapContext(),
+			  pattern(4096, 'w'), ceph::real_clock::now(), &oset));
+
+  C_SaferCond flushed;
+  ASSERT_FALSE(oc->flush_set(&oset, &flushed));
+  wb.complete_writes(-EIO);
+  ASSERT_EQ(-EIO, flushed.wait());
+
+  // the data stays dirty and the next flush writes it again
+  ASSERT_EQ(4096u, oc->get_stat_dirty());
+  C_SaferCond flushed2;
+  ASSERT_FALSE(oc->flush_set(&oset, &flushed2));
+  ASSERT_EQ(1u, wb.num_writes());
+  wb.complete_writes();
+  ASSERT_EQ(0, flushed2.wait());
+  ASSERT_EQ(0u, oc->get_stat_dirty());
+  oc->stop();
+}
+
+TEST_F(TestExtentObjectCacher, UnwaitedWriteErrorGoesToNextFlush) {
+  auto oc = make_cacher(1 << 20);
+  ASSERT_EQ(0, oc->writex(extents(0, 0, 4096), SnapContext(),
+			  pattern(4096, 'w'), ceph::real_clock::now(), &oset));
+
+  // nobody waits for this writeback ...
+  ASSERT_FALSE(oc->flush_set(&oset));
+  wb.complete_writes(-EIO);
+
+  // ... so the next flush reports its error, even though the retry
+  // succeeds
+  C_SaferCond flushed;
+  ASSERT_FALSE(oc->flush_set(&oset, &flushed));
+  wb.complete_writes();
+  ASSERT_EQ(-EIO, flushed.wait());
+  ASSERT_EQ(0u, oc->get_stat_dirty());
+
+  // but only once
+  C_SaferCond flushed2;
+  ASSERT_TRUE(oc->flush_set(&oset, &flushed2));
+  ASSERT_EQ(0, flushed2.wait());
+  oc->stop();
+}
+
+TEST_F(TestExtentObjectCacher, WriteThroughError) {
+  auto oc = make_cacher(1 << 20, 0);
+  C_SaferCond written;
+  ASSERT_EQ(0, oc->writex(extents(0, 0, 4096), SnapContext(),
+			  pattern(4096, 'w'), ceph::real_clock::now(), &oset,
+			  &written));
+  ASSERT_EQ(1u, wb.num_writes());
+  wb.complete_writes(-EROFS);
+  ASSERT_EQ(-EROFS, written.wait());
+  oc->purge_set(&oset);
+  ASSERT_EQ(0u, oc->get_stat_dirty());
+  ASSERT_TRUE(oc->set_is_empty(&oset));
+  oc->stop();
+}
+
+TEST_F(TestExtentObjectCacher, DiscardWriteback) {
+  auto oc = make_cacher(1 << 20);
+  put_object(0, 'o');
+
+  // one range being written back, one dirty, one clean read in flight
+  ASSERT_EQ(0, oc->writex(extents(0, 0, 4096), SnapContext(),
+			  pattern(4096, 'x'), ceph::real_clock::now(), &oset));
+  ASSERT_FALSE(oc->flush_set(&oset));
+  ASSERT_EQ(0, oc->writex(extents(0, 8192, 4096), SnapContext(),
+			  pattern(4096, 'd'), ceph::real_clock::now(), &oset));
+  bufferlist bl;
+  C_SaferCond read;
+  ASSERT_EQ(0, oc->readx(extents(0, 16384, 4096), CEPH_NOSNAP, &bl, &oset,
+			 &read));
+
+  C_SaferCond discarded;
+  oc->discard_writeback(&oset, extents(0, 0, OBJ_SIZE), &discarded);
+  ASSERT_EQ(0u, oc->get_stat_dirty());
+  ASSERT_EQ(0u, oc->get_stat_tx());
+
+  // waits for the write already in flight, but not for the read
+  wb.complete_reads();
+  ASSERT_EQ(4096, read.wait());
+  ASSERT_EQ(0u, oc->get_stat_clean());
+  ASSERT_EQ(1u, wb.num_writes());
+  wb.complete_writes();
+  ASSERT_EQ(0, discarded.wait());
+  ASSERT_TRUE(oc->flush_set(&oset));
+  ASSERT_TRUE(oc->set_is_empty(&oset));
+  oc->stop();
+}
+
+TEST_F(TestExtentObjectCacher, TruncateSet) {
+  auto oc = make_cacher(1 << 20);
+  ASSERT_EQ(0, oc->writex(extents(0, 0, 8192), SnapContext(),
+			  pattern(8192, 'w'), ceph::real_clock::now(), &oset));
+  ASSERT_EQ(0, oc->writex(extents(1, 0, 4096), SnapContext(),
+			  pattern(4096, 'v'), ceph::real_clock::now(), &oset));
+
+  // truncate to 4096: the rest of object 0 and all of object 1 go
+  auto ex = extents(0, 4096, OBJ_SIZE - 4096);
+  auto ex1 = extents(1, 0, OBJ_SIZE);
+  ex.insert(ex.end(), ex1.begin(), ex1.end());
+  oc->truncate_set(&oset, 3, 4096, ex);
+  ASSERT_EQ(3u, oset.truncate_seq);
+  ASSERT_EQ(4096u, oset.truncate_size);
+  ASSERT_EQ(4096u, oc->get_stat_dirty());
+
+  C_SaferCond flushed;
+  ASSERT_FALSE(oc->flush_set(&oset, &flushed));
+  ASSERT_EQ(1u, wb.num_writes());
+  wb.complete_writes();
+  ASSERT_EQ(0, flushed.wait());
+  ASSERT_EQ(3u, wb.last_trunc_seq);
+  ASSERT_EQ(4096u, wb.store[object_t(ex[0].oid)].length());
+  ASSERT_EQ(0u, wb.store[object_t(ex1[0].oid)].length());
+  oc->release_set(&oset);
+  oc->stop();
+}
+
+TEST_F(TestExtentObjectCacher, PurgeSet) {
+  auto oc = make_cacher(1 << 20);
+  for (uint64_t i = 0; i < 8; ++i) {
+    ASSERT_EQ(0, oc->writex(extents(i, 0, 4096), SnapContext(),
+			    pattern(4096, 'p'), ceph::real_clock::now(),
+			    &oset));
+  }
+  ASSERT_EQ(8u * 4096, oc->get_stat_dirty());
+  oc->purge_set(&oset);
+  ASSERT_EQ(0u, oc->get_stat_dirty());
+  ASSERT_TRUE(oc->set_is_empty(&oset));
+  ASSERT_TRUE(oc->flush_set(&oset));
+  ASSERT_EQ(0u, wb.num_writes());
+  oc->stop();
+}
@@ -0,0 +1,266 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+// Part listing benchmark for multipart upload completion: fills an omap
+// the way a multipart meta object looks after N parts were uploaded
+// ("part.%08d" keys) and reads it back in pages of 1000 entries, first one
+// page at a time, then with several pages in flight, the way
+// rgw::multipart::CompleteReader does.  Run it against a vstart cluster
+// with increasing part counts, e.g.
+//
+//   ceph_test_rgw_mp_complete_bench --parts 1000,10000 --max-aio 8
+//
+// It is installed with the other ceph_test_* tools; see
+// rgw_multipart_complete_max_aio in doc/radosgw/config-ref.rst.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "include/rados/librados.hpp"
+
+struct bench_config_t {
+  std::string pool = "mp_complete_bench";
+  std::string oid = "mp_complete_bench.meta";
+  std::vector<unsigned> parts = {1000, 5000, 10000};
+  unsigned value_size = 1024;  // roughly an encoded RGWUploadPartInfo
+  unsigned page = 1000;
+  unsigned max_aio = 8;
+  unsigned runs = 5;
+};
+
+static std::string part_key(unsigned num)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "part.%08u", num);
+  return buf;
+}
+
+static int fill(librados::IoCtx& ioctx, const bench_config_t& conf,
+                unsigned nparts)
+{
+  int r = ioctx.remove(conf.oid);
+  if (r < 0 && r != -ENOENT) {
+    return r;
+  }
+  librados::bufferlist val;
+  val.append(std::string(conf.value_size, 'v'));
+  for (unsigned num = 1; num <= nparts; ) {
+    std::map<std::string, librados::bufferlist> m;
+    for (; num <= nparts && m.size() < 1000; ++num) {
+      m[part_key(num)] = val;
+    }
+    librados::ObjectWriteOperation op;
+    op.omap_set(m);
+    r = ioctx.operate(conf.oid, &op);
+    if (r < 0) {
+      return r;
+    }
+  }
+  return 0;
+}
+
+// one page after the other, as the completion used to do
+static int read_serial(librados::IoCtx& ioctx, const bench_config_t& conf,
+                       unsigned nparts)
+{
+  std::string marker = part_key(0);
+  unsigned total = 0;
+  bool more = true;
+  while (more) {
+    std::map<std::string, librados::bufferlist> vals;
+    int rval = 0;
+    librados::ObjectReadOperation op;
+    op.omap_get_vals2(marker, conf.page, &vals, &more, &rval);
+    int r = ioctx.operate(conf.oid, &op, nullptr);
+    if (r < 0) {
+      return r;
+    }
+    if (vals.empty()) {
+      break;
+    }
+    total += vals.size();
+    marker = vals.rbegin()->first;
+  }
+  return total == nparts ? 0 : -EIO;
+}
+
+// the key range of every page is known up front, keep max_aio in flight
+static int read_parallel(librados::IoCtx& ioctx, const bench_config_t& conf,
+                         unsigned nparts)
+{
+  struct page_t {
+    std::map<std::string, librados::bufferlist> vals;
+    bool more = false;
+    int rval = 0;
+    librados::AioCompletion *c = nullptr;
+  };
+  const unsigned npages = (nparts + conf.page - 1) / conf.page;
+  std::vector<page_t> pages(npages);
+  unsigned issued = 0;
+  unsigned total = 0;
+  int ret = 0;
+  for (unsigned i = 0; i < npages; ++i) {
+    for (; issued < npages && issued < i + conf.max_aio; ++issued) {
+      auto& p = pages[issued];
+      librados::ObjectReadOperation op;
+      op.omap_get_vals2(part_key(issued * conf.page), conf.page, &p.vals,
+                        &p.more, &p.rval);
+      p.c = librados::Rados::aio_create_completion();
+      int r = ioctx.aio_operate(conf.oid, p.c, &op, nullptr);
+      if (r < 0) {
+        p.c->release();
+        p.c = nullptr;
+        ret = r;
+        break;
+      }
+    }
+    auto& p = pages[i];
+    if (!p.c) {
+      break;
+    }
+    p.c->wait_for_complete();
+    int r = p.c->get_return_value();
+    p.c->release();
+    p.c = nullptr;
+    if (r < 0 && ret == 0) {
+      ret = r;
+    }
+    total += p.vals.size();
+    p.vals.clear();
+  }
+  for (auto& p : pages) {
+    if (p.c) {
+      p.c->wait_for_complete();
+      p.c->release();
+    }
+  }
+  if (ret < 0) {
+    return ret;
+  }
+  return total == nparts ? 0 : -EIO;
+}
+
+static int run(librados::IoCtx& ioctx, const bench_config_t& conf,
+               unsigned nparts)
+{
+  int r = fill(ioctx, conf, nparts);
+  if (r < 0) {
+    return r;
+  }
+  for (bool parallel : {false, true}) {
+    double best = 0;
+    for (unsigned i = 0; i < conf.runs; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      r = parallel ? read_parallel(ioctx, conf, nparts) :
+                     read_serial(ioctx, conf, nparts);
+      if (r < 0) {
+        return r;
+      }
+      auto elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+      if (i == 0 || elapsed < best) {
+        best = elapsed;
+      }
+    }
+    std::cout << (parallel ? "parallel" : "serial  ") << "  parts " << nparts
+              << "  " << static_cast<uint64_t>(best) << " ms" << std::endl;
+  }
+  return 0;
+}
+
+static void usage(const char* name)
+{
+  std::cout << "usage: " << name << " [options]\n"
+	    << "  --pool <name>          pool to use (mp_complete_bench)\n"
+	    << "  --parts <n,...>        part counts to run (1000,5000,10000)\n"
+	    << "  --value-size <bytes>   size of each part entry (1024)\n"
+	    << "  --max-aio <n>          pages in flight when parallel (8)\n"
+	    << "  --runs <n>             runs of each, best one is shown (5)\n"
+	    << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  bench_config_t conf;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    }
+    if (i + 1 == argc) {
+      std::cerr << argv[0] << ": " << arg << " requires a value" << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::string val = argv[++i];
+    try {
+      if (arg == "--pool") {
+        conf.pool = val;
+      } else if (arg == "--parts") {
+        conf.parts.clear();
+        std::istringstream ss(val);
+        for (std::string t; std::getline(ss, t, ','); ) {
+          conf.parts.push_back(std::stoul(t));
+        }
+      } else if (arg == "--value-size") {
+        conf.value_size = std::stoul(val);
+      } else if (arg == "--max-aio") {
+        conf.max_aio = std::max(std::stoul(val), 1ul);
+      } else if (arg == "--runs") {
+        conf.runs = std::max(std::stoul(val), 1ul);
+      } else {
+        std::cerr << "unknown option " << arg << std::endl;
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } catch (const std::logic_error&) {
+      std::cerr << argv[0] << ": bad value for " << arg << ": " << val
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  librados::Rados rados;
+  int r = rados.init(nullptr);
+  if (r == 0) {
+    rados.conf_read_file(nullptr);
+    rados.conf_parse_env(nullptr);
+    r = rados.connect();
+  }
+  if (r < 0) {
+    std::cerr << "failed to connect: " << strerror(-r) << std::endl;
+    return EXIT_FAILURE;
+  }
+  r = rados.pool_create(conf.pool.c_str());
+  if (r < 0 && r != -EEXIST) {
+    std::cerr << "failed to create pool " << conf.pool << ": "
+              << strerror(-r) << std::endl;
+    return EXIT_FAILURE;
+  }
+  librados::IoCtx ioctx;
+  r = rados.ioctx_create(conf.pool.c_str(), ioctx);
+  if (r < 0) {
+    std::cerr << "failed to open pool " << conf.pool << ": "
+              << strerror(-r) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for (auto n : conf.parts) {
+    r = run(ioctx, conf, n);
+    if (r < 0) {
+      std::cerr << "parts " << n << " failed: " << strerror(-r) << std::endl;
+      ioctx.remove(conf.oid);
+      return EXIT_FAILURE;
+    }
+  }
+  ioctx.remove(conf.oid);
+  return EXIT_SUCCESS;
+}
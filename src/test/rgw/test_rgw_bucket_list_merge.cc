@@ -0,0 +1,204 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#include "rgw/rgw_bucket_list_merge.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <gtest/gtest.h>
+
+using rgw::bucket_list::OrderedShardMerge;
+
+// the sorted object names of each index shard, listed the way cls_rgw
+// does: after a key, rolling names that contain the delimiter up into
+// common prefixes
+struct FakeBucket {
+  std::map<int, std::vector<std::string>> shards;
+  std::string delimiter;
+  // refills that return nothing but claim to be truncated
+  std::set<int> empty_refills;
+  unsigned refills = 0;
+
+  rgw_cls_list_ret list(int shard, const std::string& after,
+			uint32_t count) const {
+    rgw_cls_list_ret ret;
+    const auto& keys = shards.at(shard);
+    auto it = std::upper_bound(keys.begin(), keys.end(), after);
+    if (!delimiter.empty() && boost::algorithm::ends_with(after, delimiter)) {
+      while (it != keys.end() && boost::algorithm::starts_with(*it, after)) {
+	++it;
+      }
+    }
+    while (it != keys.end() && ret.dir.m.size() < count) {
+      rgw_bucket_dir_entry e;
+      e.exists = true;
+      auto pos = delimiter.empty() ? std::string::npos :
+	it->find(delimiter);
+      if (pos == std::string::npos) {
+	e.key.name = *it++;
+      } else {
+	e.key.name = it->substr(0, pos + delimiter.size());
+	e.flags = rgw_bucket_dir_entry::FLAG_COMMON_PREFIX;
+	while (it != keys.end() && boost::algorithm::starts_with(*it, e.key.name)) {
+	  ++it;
+	}
+      }
+      ret.dir.m[e.key.name] = e;
+    }
+    ret.is_truncated = it != keys.end();
+    return ret;
+  }
+
+  std::map<int, rgw_cls_list_ret> list_all(uint32_t count) const {
+    std::map<int, rgw_cls_list_ret> results;
+    for (const auto& [shard, keys] : shards) {
+      results[shard] = list(shard, "", count);
+    }
+    return results;
+  }
+
+  OrderedShardMerge::refill_t refill() {
+    return [this] (int shard, const cls_rgw_obj_key& after, uint32_t count,
+		   rgw_cls_list_ret* result) {
+      ++refills;
+      if (empty_refills.count(shard)) {
+	result->is_truncated = true;
+	return 0;
+      }
+      *result = list(shard, after.name, count);
+      return 0;
+    };
+  }
+};
+
+// consume the merge the way RGWRados::cls_bucket_list_ordered() does,
+// moving every entry out of the shard results
+static std::vector<std::string> drain(OrderedShardMerge& merge,
+				      uint32_t num_entries)
+{
+  std::map<std::string, rgw_bucket_dir_entry> m;
+  std::vector<std::string> names;
+  EXPECT_EQ(0, merge.start(num_entries));
+  while (names.size() < num_entries && !merge.done()) {
+    const std::string& name = merge.name();
+    names.push_back(name);
+    m[name] = std::move(merge.entry());
+    EXPECT_EQ(0, merge.pop(num_entries - names.size()));
+  }
+  return names;
+}
+
+TEST(BucketListMerge, MergesInOrder)
+{
+  FakeBucket b;
+  b.shards[0] = {"a", "d", "e", "f", "g", "h"};
+  b.shards[1] = {"b"};
+  b.shards[2] = {"c", "i"};
+  auto results = b.list_all(1);
+  OrderedShardMerge merge(results, 1, 8, b.refill());
+  auto names = drain(merge, 100);
+  std::vector<std::string> expected{"a", "b", "c", "d", "e", "f", "g", "h", "i"};
+  EXPECT_EQ(expected, names);
+  EXPECT_FALSE(merge.is_truncated());
+  // shard 0 is read again for 2 and then 4 entries, shard 2 for 2
+  EXPECT_EQ(3u, b.refills);
+}
+
+TEST(BucketListMerge, StopsAtNumEntries)
+{
+  FakeBucket b;
+  b.shards[0] = {"a", "c", "e", "g"};
+  b.shards[1] = {"b", "d", "f", "h"};
+  auto results = b.list_all(2);
+  OrderedShardMerge merge(results, 2, 8, b.refill());
+  auto names = drain(merge, 5);
+  std::vector<std::string> expected{"a", "b", "c", "d", "e"};
+  EXPECT_EQ(expected, names);
+  EXPECT_TRUE(merge.is_truncated());
+  // the second refill only asks for what the page still needs
+  EXPECT_EQ(2u, b.refills);
+}
+
+TEST(BucketListMerge, RefillAfterCommonPrefix)
+{
+  FakeBucket b;
+  b.delimiter = "/";
+  b.shards[0] = {"a/1", "a/2", "b/1", "c"};
+  b.shards[1] = {"a/3", "d"};
+  // both shards return "a/" first; shard 1's copy is skipped, leaving it
+  // exhausted, and it must be read again from after the whole prefix
+  auto results = b.list_all(1);
+  OrderedShardMerge merge(results, 1, 8, b.refill());
+  auto names = drain(merge, 100);
+  std::vector<std::string> expected{"a/", "b/", "c", "d"};
+  EXPECT_EQ(expected, names);
+  EXPECT_FALSE(merge.is_truncated());
+}
+
+TEST(BucketListMerge, EmptyRefillStillTruncated)
+{
+  FakeBucket b;
+  b.shards[0] = {"a", "c", "e"};
+  b.shards[1] = {"b", "d", "f"};
+  b.empty_refills.insert(0);
+  auto results = b.list_all(1);
+  OrderedShardMerge merge(results, 1, 8, b.refill());
+  // shard 0 ran out after "a" and yielded nothing more, so nothing past
+  // it can be returned in order
+  auto names = drain(merge, 100);
+  std::vector<std::string> expected{"a"};
+  EXPECT_EQ(expected, names);
+  EXPECT_TRUE(merge.done());
+  EXPECT_TRUE(merge.is_truncated());
+}
+
+TEST(BucketListMerge, RefillLimit)
+{
+  FakeBucket b;
+  b.shards[0] = {"a", "b", "c", "d", "e", "f", "g", "h", "i", "j"};
+  b.shards[1] = {"z"};
+  auto results = b.list_all(1);
+  OrderedShardMerge merge(results, 1, 2, b.refill());
+  // 1 entry, then 2 and 4 more from the two refills
+  auto names = drain(merge, 100);
+  std::vector<std::string> expected{"a", "b", "c", "d", "e", "f", "g"};
+  EXPECT_EQ(expected, names);
+  EXPECT_EQ(2u, merge.get_num_refills());
+  EXPECT_TRUE(merge.done());
+  EXPECT_TRUE(merge.is_truncated());
+}
+
+TEST(BucketListMerge, EntriesOfReplacedResultsStay)
+{
+  FakeBucket b;
+  b.shards[0] = {"a", "b", "c", "d"};
+  b.shards[1] = {"e"};
+  auto results = b.list_all(1);
+  OrderedShardMerge merge(results, 1, 8, b.refill());
+  ASSERT_EQ(0, merge.start(100));
+
+  // a skipped entry is left in place and remembered as the marker
+  rgw_bucket_dir_entry* last_entry_visited = &merge.entry();
+  ASSERT_EQ("a", merge.name());
+  ASSERT_EQ(0, merge.pop(100));
+  // shard 0 was refilled, and is once more before the end
+  while (!merge.done()) {
+    ASSERT_EQ(0, merge.pop(100));
+  }
+  EXPECT_EQ(2u, merge.get_num_refills());
+  EXPECT_EQ("a", last_entry_visited->key.name);
+}
@@ -0,0 +1,219 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#include "rgw/rgw_multipart_complete.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "include/rados/librados.hpp"
+#include "common/dout.h"
+#include "global/global_context.h"
+#include "test/librados/test_cxx.h"
+
+#define dout_subsys ceph_subsys_rgw
+
+using rgw::multipart::CompleteReader;
+using rgw::multipart::IoCtxMetaReads;
+
+static const std::string pool_name = "rgw.test.multipart";
+static const std::string meta_oid = "upload.meta";
+
+// the parts one next() call returned
+using Batch = std::vector<uint32_t>;
+
+class MultipartCompleteReader : public ::testing::Test {
+protected:
+  NoDoutPrefix dpp{g_ceph_context, dout_subsys};
+  librados::Rados rados;
+  librados::IoCtx ioctx;
+
+  void SetUp() override {
+    ASSERT_EQ("", connect_cluster_pp(rados));
+    int r = rados.pool_create(pool_name.c_str());
+    ASSERT_TRUE(r == 0 || r == -EEXIST);
+    ASSERT_EQ(0, rados.ioctx_create(pool_name.c_str(), ioctx));
+    r = ioctx.remove(meta_oid);
+    ASSERT_TRUE(r == 0 || r == -ENOENT);
+    ASSERT_EQ(0, ioctx.create(meta_oid, false));
+  }
+
+  void TearDown() override {
+    ioctx.close();
+    rados.shutdown();
+  }
+
+  // add the parts to the meta object, keyed the way uploading them does
+  // for v2 upload ids, or unpadded for older ones
+  void upload(const std::vector<int>& nums, bool sorted = true) {
+    std::map<std::string, bufferlist> vals;
+    for (int num : nums) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), sorted ? "part.%08d" : "part.%d", num);
+      encode((uint32_t)num * 100, vals[buf]);
+    }
+    librados::ObjectWriteOperation op;
+    op.omap_set(vals);
+    ASSERT_EQ(0, ioctx.operate(meta_oid, &op));
+  }
+
+  // read all of the parts, returning them as next() did
+  std::vector<Batch> read(std::vector<int>&& part_nums,
+			  uint32_t batch_size, uint32_t max_aio,
+			  bool sorted = true) {
+    IoCtxMetaReads reads(ioctx, meta_oid);
+    CompleteReader reader(&dpp, reads, sorted, std::move(part_nums),
+			  batch_size, max_aio);
+    std::vector<Batch> batches;
+    bool truncated = true;
+    while (truncated) {
+      std::map<uint32_t, bufferlist> parts;
+      int r = reader.next(parts, &truncated);
+      EXPECT_EQ(0, r);
+      if (r < 0 || batches.size() > 100) {
+	break;
+      }
+      Batch batch;
+      for (auto& [num, bl] : parts) {
+	uint32_t val;
+	auto p = bl.cbegin();
+	decode(val, p);
+	EXPECT_EQ(num * 100, val);
+	batch.push_back(num);
+      }
+      batches.push_back(std::move(batch));
+    }
+    return batches;
+  }
+};
+
+TEST(MultipartPartKey, Parse)
+{
+  uint32_t num = 0;
+  EXPECT_TRUE(rgw::multipart::parse_part_key("part.00000012", &num));
+  EXPECT_EQ(12u, num);
+  EXPECT_TRUE(rgw::multipart::parse_part_key("part.7", &num));
+  EXPECT_EQ(7u, num);
+  EXPECT_FALSE(rgw::multipart::parse_part_key("part.", &num));
+  EXPECT_FALSE(rgw::multipart::parse_part_key("part.-1", &num));
+  EXPECT_FALSE(rgw::multipart::parse_part_key("part.1x", &num));
+  EXPECT_FALSE(rgw::multipart::parse_part_key("part.99999999999", &num));
+  EXPECT_FALSE(rgw::multipart::parse_part_key("meta", &num));
+}
+
+TEST_F(MultipartCompleteReader, AllPartsMatch)
+{
+  upload({1, 2, 3, 5, 8, 13, 21});
+  std::vector<Batch> expected{{1, 2, 3}, {5, 8, 13}, {21}};
+  EXPECT_EQ(expected, read({1, 2, 3, 5, 8, 13, 21}, 3, 2));
+  EXPECT_EQ(expected, read({1, 2, 3, 5, 8, 13, 21}, 3, 8));
+}
+
+TEST_F(MultipartCompleteReader, ExtraPartInLastBatch)
+{
+  // the last batch asks for one more part than requested to notice this
+  upload({1, 2, 3, 4, 5});
+  std::vector<Batch> expected{{1, 2}, {3, 4}, {5}};
+  EXPECT_EQ(expected, read({1, 2, 3, 4}, 2, 1));
+
+  // also when the extra part follows a full batch
+  upload({6});
+  expected = {{1, 2, 3}, {4, 5, 6}};
+  EXPECT_EQ(expected, read({1, 2, 3, 4, 5}, 3, 1));
+}
+
+TEST_F(MultipartCompleteReader, MissingPartInTheMiddle)
+{
+  upload({1, 2, 4, 5, 6});
+  std::vector<Batch> expected{{1, 2}, {4, 5}, {6}};
+  EXPECT_EQ(expected, read({1, 2, 3, 4, 5, 6}, 2, 2));
+}
+
+TEST_F(MultipartCompleteReader, MissingLastPart)
+{
+  // the batch holds fewer parts than requested, but all of them match
+  upload({1, 2, 3, 4, 5});
+  std::vector<Batch> expected{{1, 2, 3}, {4, 5}};
+  EXPECT_EQ(expected, read({1, 2, 3, 4, 5, 6}, 3, 2));
+}
+
+TEST_F(MultipartCompleteReader, ExtraPartInTheMiddle)
+{
+  upload({1, 2, 3, 4, 5, 6, 7});
+  std::vector<Batch> expected{{1, 2}, {3, 4}, {5, 6}, {7}};
+  EXPECT_EQ(expected, read({1, 2, 3, 5, 6, 7}, 2, 2));
+}
+
+TEST_F(MultipartCompleteReader, FallbackAfterConsumedBatches)
+{
+  // the first batches match and are returned before the one missing
+  // part 7 is read; the fallback goes on after them, returning none
+  // of their parts again
+  std::vector<int> nums;
+  for (int i = 1; i <= 12; ++i) {
+    if (i != 7) {
+      nums.push_back(i);
+    }
+  }
+  upload(nums);
+  std::vector<int> requested{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  std::vector<Batch> expected{{1, 2, 3}, {4, 5, 6}, {8, 9, 10}, {11, 12}};
+  for (uint32_t max_aio : {1, 2, 4}) {
+    auto copy = requested;
+    EXPECT_EQ(expected, read(std::move(copy), 3, max_aio));
+  }
+}
+
+TEST_F(MultipartCompleteReader, NotV2UploadId)
+{
+  // the keys of these parts do not sort by part number, so all of them
+  // are read, and then returned in order
+  std::vector<int> nums;
+  for (int i = 1; i <= 12; ++i) {
+    nums.push_back(i);
+  }
+  upload(nums, false);
+  std::vector<Batch> expected{{1, 2, 3, 4, 5}, {6, 7, 8, 9, 10}, {11, 12}};
+  auto copy = nums;
+  EXPECT_EQ(expected, read(std::move(copy), 5, 2, false));
+
+  // as are extra parts
+  upload({13}, false);
+  expected = {{1, 2, 3, 4, 5}, {6, 7, 8, 9, 10}, {11, 12, 13}};
+  EXPECT_EQ(expected, read(std::move(nums), 5, 2, false));
+}
+
+TEST_F(MultipartCompleteReader, NoPartsRequested)
+{
+  upload({1, 2});
+  std::vector<Batch> expected{{1, 2}};
+  EXPECT_EQ(expected, read({}, 2, 1));
+}
+
+TEST_F(MultipartCompleteReader, BadKey)
+{
+  upload({1, 2});
+  std::map<std::string, bufferlist> vals;
+  vals["part.bad"];
+  librados::ObjectWriteOperation op;
+  op.omap_set(vals);
+  ASSERT_EQ(0, ioctx.operate(meta_oid, &op));
+
+  IoCtxMetaReads reads(ioctx, meta_oid);
+  CompleteReader reader(&dpp, reads, true, {1, 2}, 2, 1);
+  std::map<uint32_t, bufferlist> parts;
+  bool truncated;
+  EXPECT_EQ(-EIO, reader.next(parts, &truncated));
+}
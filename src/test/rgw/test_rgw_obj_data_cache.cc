@@ -0,0 +1,195 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#include "rgw/rgw_obj_data_cache.h"
+
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using ceph::bufferlist;
+using namespace std::chrono_literals;
+
+static bufferlist make_data(size_t len, char c)
+{
+  bufferlist bl;
+  bl.append(std::string(len, c));
+  return bl;
+}
+
+static ObjectDataCache::Info make_info(uint64_t version, size_t len, char c)
+{
+  ObjectDataCache::Info info;
+  info.version = version;
+  info.size = len;
+  info.data = make_data(len, c);
+  return info;
+}
+
+TEST(ObjectDataCache, GetPut)
+{
+  ObjectDataCache cache(1024, 256, 0s, 1);
+  ObjectDataCache::Info info;
+  EXPECT_FALSE(cache.get("a", &info));
+
+  auto in = make_info(7, 100, 'a');
+  in.mtime = ceph::real_clock::now();
+  in.attrs["user.rgw.etag"] = make_data(4, 'e');
+  cache.put("a", cache.get_gen("a"), in);
+  ASSERT_TRUE(cache.get("a", &info));
+  EXPECT_EQ(7u, info.version);
+  EXPECT_EQ(100u, info.size);
+  EXPECT_EQ(in.mtime, info.mtime);
+  ASSERT_EQ(1u, info.attrs.size());
+  EXPECT_TRUE(info.attrs["user.rgw.etag"].contents_equal(make_data(4, 'e')));
+  EXPECT_TRUE(info.data.contents_equal(make_data(100, 'a')));
+
+  // a newer version replaces the old one
+  cache.put("a", cache.get_gen("a"), make_info(8, 50, 'b'));
+  ASSERT_TRUE(cache.get("a", &info));
+  EXPECT_EQ(8u, info.version);
+  EXPECT_TRUE(info.attrs.empty());
+  EXPECT_TRUE(info.data.contents_equal(make_data(50, 'b')));
+
+  cache.remove("a");
+  EXPECT_FALSE(cache.get("a", &info));
+  cache.remove("a");
+}
+
+TEST(ObjectDataCache, RemovedWhileReading)
+{
+  ObjectDataCache cache(1024, 256, 0s, 1);
+  ObjectDataCache::Info info;
+
+  // what was read before a removal is not cached after it
+  uint64_t gen = cache.get_gen("a");
+  cache.remove("a");
+  cache.put("a", gen, make_info(1, 100, 'a'));
+  EXPECT_FALSE(cache.get("a", &info));
+
+  gen = cache.get_gen("a");
+  cache.put("a", gen, make_info(2, 100, 'a'));
+  ASSERT_TRUE(cache.get("a", &info));
+  EXPECT_EQ(2u, info.version);
+}
+
+TEST(ObjectDataCache, Expiry)
+{
+  ObjectDataCache cache(1024, 256, 1ms, 1);
+  ObjectDataCache::Info info;
+  cache.put("a", cache.get_gen("a"), make_info(1, 100, 'a'));
+  std::this_thread::sleep_for(50ms);
+  EXPECT_FALSE(cache.get("a", &info));
+  EXPECT_EQ(0u, cache.get_size());
+}
+
+TEST(ObjectDataCache, SizeAccounting)
+{
+  ObjectDataCache cache(1024, 256, 0s, 1);
+  cache.put("a", 0, make_info(1, 100, 'a'));
+  cache.put("b", 0, make_info(1, 200, 'b'));
+  EXPECT_EQ(300u, cache.get_size());
+  EXPECT_EQ(2u, cache.get_num_entries());
+
+  // replacing an entry accounts for its new size only
+  cache.put("a", 0, make_info(2, 10, 'a'));
+  EXPECT_EQ(210u, cache.get_size());
+  EXPECT_EQ(2u, cache.get_num_entries());
+
+  // attrs count too
+  auto info = make_info(3, 10, 'a');
+  info.attrs["k"] = make_data(9, 'v');
+  cache.put("a", 0, info);
+  EXPECT_EQ(220u, cache.get_size());
+
+  cache.remove("b");
+  EXPECT_EQ(20u, cache.get_size());
+  cache.remove("a");
+  EXPECT_EQ(0u, cache.get_size());
+  EXPECT_EQ(0u, cache.get_num_entries());
+}
+
+TEST(ObjectDataCache, CopiesData)
+{
+  ObjectDataCache cache(1024, 256, 0s, 1);
+  // the cached data is a private copy of only what was put, not a
+  // reference to the (larger) buffer it came from
+  bufferlist big = make_data(4096, 'x');
+  ObjectDataCache::Info in;
+  in.data.substr_of(big, 0, 100);
+  cache.put("a", 0, in);
+  EXPECT_EQ(100u, cache.get_size());
+
+  ObjectDataCache::Info info;
+  ASSERT_TRUE(cache.get("a", &info));
+  EXPECT_TRUE(info.data.is_contiguous());
+  EXPECT_NE(big.c_str(), info.data.c_str());
+  EXPECT_TRUE(info.data.contents_equal(make_data(100, 'x')));
+}
+
+TEST(ObjectDataCache, TooLarge)
+{
+  ObjectDataCache cache(1024, 256, 0s, 1);
+  ObjectDataCache::Info info;
+  cache.put("a", 0, make_info(1, 257, 'a'));
+  EXPECT_FALSE(cache.get("a", &info));
+  EXPECT_EQ(0u, cache.get_size());
+
+  // nor anything larger than a shard
+  ObjectDataCache sharded(1024, 1024, 0s, 8);
+  sharded.put("a", 0, make_info(1, 129, 'a'));
+  EXPECT_FALSE(sharded.get("a", &info));
+  sharded.put("a", 0, make_info(1, 128, 'a'));
+  EXPECT_TRUE(sharded.get("a", &info));
+}
+
+TEST(ObjectDataCache, EvictLeastRecentlyUsed)
+{
+  ObjectDataCache cache(300, 300, 0s, 1);
+  cache.put("a", 0, make_info(1, 100, 'a'));
+  cache.put("b", 0, make_info(1, 100, 'b'));
+  cache.put("c", 0, make_info(1, 100, 'c'));
+  EXPECT_EQ(300u, cache.get_size());
+
+  // a read makes "a" the most recently used, so "b" goes first
+  ObjectDataCache::Info info;
+  ASSERT_TRUE(cache.get("a", &info));
+  cache.put("d", 0, make_info(1, 100, 'd'));
+  EXPECT_EQ(300u, cache.get_size());
+  EXPECT_EQ(3u, cache.get_num_entries());
+  EXPECT_FALSE(cache.get("b", &info));
+
+  // so does an update, leaving "a" and then "d" the least recently
+  // used, both of which a larger entry evicts
+  cache.put("c", 0, make_info(2, 100, 'c'));
+  cache.put("e", 0, make_info(1, 200, 'e'));
+  EXPECT_EQ(300u, cache.get_size());
+  EXPECT_EQ(2u, cache.get_num_entries());
+  EXPECT_FALSE(cache.get("a", &info));
+  EXPECT_FALSE(cache.get("d", &info));
+  ASSERT_TRUE(cache.get("c", &info));
+  EXPECT_EQ(2u, info.version);
+  EXPECT_TRUE(cache.get("e", &info));
+}
+
+TEST(ObjectDataCache, Shards)
+{
+  // eviction is per shard; the total stays within the limit
+  ObjectDataCache cache(1600, 100, 0s, 16);
+  for (int i = 0; i < 100; ++i) {
+    cache.put(std::to_string(i), 0, make_info(1, 100, 'x'));
+    EXPECT_LE(cache.get_size(), 1600u);
+  }
+  EXPECT_EQ(cache.get_size(), cache.get_num_entries() * 100);
+  EXPECT_LE(cache.get_num_entries(), 16u);
+}
@@ -5,6 +5,7 @@
 #include "CacheClient.h"
 #include "common/Cond.h"
 #include "common/version.h"
+#include "Utils.h"
 
 #define dout_context g_ceph_context
 #define dout_subsys ceph_subsys_immutable_obj_cache
@@ -19,7 +20,7 @@ namespace immutable_obj_cache {
     : m_cct(ceph_ctx), m_io_service_work(m_io_service),
       m_dm_socket(m_io_service), m_ep(stream_protocol::endpoint(file)),
       m_io_thread(nullptr), m_session_work(false), m_writing(false),
-      m_reading(false), m_sequence_id(0) {
+      m_reading(false), m_sequence_id(0), m_shm_index(ceph_ctx) {
     m_worker_thread_num =
       m_cct->_conf.get_val<uint64_t>(
         "immutable_object_cache_client_dedicated_thread_num");
@@ -117,10 +118,94 @@ namespace immutable_obj_cache {
                                   std::string oid,
                                   CacheGenContextURef&& on_finish) {
     ldout(m_cct, 20) << dendl;
+    if (lookup_shm_index(pool_nspace, pool_id, snap_id, oid, on_finish)) {
+      return;
+    }
+
     ObjectCacheRequest* req = new ObjectCacheReadData(RBDSC_READ,
                                     ++m_sequence_id, 0, 0, pool_id,
                                     snap_id, object_size, oid, pool_nspace);
     req->process_msg = std::move(on_finish);
+    send_request(req);
+  }
+
+  bool CacheClient::lookup_shm_index(const std::string& pool_nspace,
+                                     uint64_t pool_id, uint64_t snap_id,
+                                     const std::string& oid,
+                                     CacheGenContextURef& on_finish) {
+    if (!m_shm_index.is_open()) {
+      return false;
+    }
+
+    std::string cache_file_name =
+      get_cache_file_name(pool_nspace, pool_id, snap_id, oid);
+    if (!m_shm_index.lookup(cache_file_name)) {
+      return false;
+    }
+
+    ldout(m_cct, 20) << "index hit: " << cache_file_name << dendl;
+    std::string cache_path = m_cache_dir +
+      get_cache_file_dir(cache_file_name) + cache_file_name;
+    ObjectCacheRequest* reply = new ObjectCacheReadReplyData(
+      RBDSC_READ_REPLY, 0, cache_path);
+    touch_object(std::move(cache_file_name));
+
+    // callers may hold locks that the completion needs, never complete inline
+    auto process_reply = [ctx = on_finish.release(), reply]() {
+      ctx->complete(reply);
+      delete reply;
+    };
+    if (m_worker_thread_num != 0) {
+      m_worker->post(process_reply);
+    } else {
+      m_io_service.post(process_reply);
+    }
+    return true;
+  }
+
+  void CacheClient::touch_object(std::string&& cache_file_name) {
+    if (!supports_touch()) {
+      return;
+    }
+
+    // the daemon does not see these hits, tell it about them in batches
+    // so that the objects stay ahead of the cold ones in its LRU
+    std::vector<std::string> cache_file_names;
+    {
+      std::lock_guard locker{m_touch_lock};
+      m_touched.insert(std::move(cache_file_name));
+      if (m_touched.size() < TOUCH_BATCH) {
+        return;
+      }
+      cache_file_names.assign(m_touched.begin(), m_touched.end());
+      m_touched.clear();
+    }
+
+    ldout(m_cct, 20) << "objects=" << cache_file_names.size() << dendl;
+    ObjectCacheRequest* req = new ObjectCacheTouchData(RBDSC_TOUCH,
+                                    ++m_sequence_id,
+                                    std::move(cache_file_names));
+    req->process_msg = make_gen_lambda_context<ObjectCacheRequest*,
+                         std::function<void(ObjectCacheRequest*)>>(
+      [](ObjectCacheRequest* ack) {});
+    send_request(req);
+  }
+
+  void CacheClient::promote_objects(std::string pool_nspace, uint64_t pool_id,
+                                    uint64_t snap_id, uint64_t object_size,
+                                    std::vector<std::string> oids,
+                                    CacheGenContextURef&& on_finish) {
+    ldout(m_cct, 20) << "objects=" << oids.size() << dendl;
+    ceph_assert(supports_promote());
+    ObjectCacheRequest* req = new ObjectCachePromoteData(RBDSC_PROMOTE,
+                                    ++m_sequence_id, pool_id, snap_id,
+                                    object_size, std::move(pool_nspace),
+                                    std::move(oids));
+    req->process_msg = std::move(on_finish);
+    send_request(req);
+  }
+
+  void CacheClient::send_request(ObjectCacheRequest* req) {
     req->encode();
 
     {
@@ -421,6 +506,16 @@ namespace immutable_obj_cache {
     data_buffer.append(std::move(bp_data));
     ObjectCacheRequest* req = decode_object_cache_request(data_buffer);
     if (req->type == RBDSC_REGISTER_REPLY) {
+      auto reg_reply = reinterpret_cast<ObjectCacheRegReplyData*>(req);
+      m_server_features = reg_reply->features;
+      m_cache_dir = reg_reply->cache_dir;
+      if (!reg_reply->shm_index_path.empty()) {
+        int r = m_shm_index.open(reg_reply->shm_index_path);
+        if (r < 0) {
+          ldout(m_cct, 5) << "failed to open cache index "
+                          << reg_reply->shm_index_path << ": " << r << dendl;
+        }
+      }
       m_session_work.store(true);
       on_finish->complete(0);
     } else {
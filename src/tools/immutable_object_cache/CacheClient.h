@@ -5,6 +5,7 @@
 #define CEPH_CACHE_CACHE_CLIENT_H
 
 #include <atomic>
+#include <set>
 #include <boost/asio.hpp>
 #include <boost/asio/error.hpp>
 #include <boost/algorithm/string.hpp>
@@ -14,6 +15,7 @@
 #include "include/Context.h"
 #include "Types.h"
 #include "SocketCommon.h"
+#include "ShmIndex.h"
 
 
 using boost::asio::local::stream_protocol;
@@ -35,8 +37,23 @@ class CacheClient {
                      uint64_t snap_id, uint64_t object_size, std::string oid,
                      CacheGenContextURef&& on_finish);
   int register_client(Context* on_finish);
+  bool supports_promote() const {
+    return (m_server_features & RBDSC_FEATURE_PROMOTE) != 0;
+  }
+  bool supports_touch() const {
+    return (m_server_features & RBDSC_FEATURE_TOUCH) != 0;
+  }
+  void promote_objects(std::string pool_nspace, uint64_t pool_id,
+                       uint64_t snap_id, uint64_t object_size,
+                       std::vector<std::string> oids,
+                       CacheGenContextURef&& on_finish);
 
  private:
+  void send_request(ObjectCacheRequest* req);
+  bool lookup_shm_index(const std::string& pool_nspace, uint64_t pool_id,
+                        uint64_t snap_id, const std::string& oid,
+                        CacheGenContextURef& on_finish);
+  void touch_object(std::string&& cache_file_name);
   void send_message();
   void try_send();
   void fault(const int err_type, const boost::system::error_code& err);
@@ -77,6 +94,17 @@ class CacheClient {
   std::map<uint64_t, ObjectCacheRequest*> m_seq_to_req;
   bufferlist m_outcoming_bl;
   bufferptr m_bp_header;
+
+  // filled in from the register reply
+  uint64_t m_server_features = 0;
+  std::string m_cache_dir;
+  ShmIndex m_shm_index;
+
+  // objects hit in the shared lookup index since the last touch request
+  static constexpr size_t TOUCH_BATCH = 64;
+  ceph::mutex m_touch_lock =
+    ceph::make_mutex("ceph::cache::CacheClient::m_touch_lock");
+  std::set<std::string> m_touched;
 };
 
 }  // namespace immutable_obj_cache
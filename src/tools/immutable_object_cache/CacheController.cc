@@ -105,7 +105,10 @@ void CacheController::handle_request(CacheSession* session,
       session->set_client_version(req_reg_data->version);
 
       ObjectCacheRequest* reply = new ObjectCacheRegReplyData(
-        RBDSC_REGISTER_REPLY, req->seq);
+        RBDSC_REGISTER_REPLY, req->seq,
+        RBDSC_FEATURE_PROMOTE | RBDSC_FEATURE_TOUCH,
+        m_object_cache_store->get_cache_dir(),
+        m_object_cache_store->get_shm_index_path());
       session->send(reply);
       break;
     }
@@ -129,6 +132,27 @@ void CacheController::handle_request(CacheSession* session,
       session->send(reply);
       break;
     }
+    case RBDSC_PROMOTE: {
+      auto req_promote_data = reinterpret_cast<ObjectCachePromoteData*>(req);
+      m_object_cache_store->promote_objects(
+        req_promote_data->pool_namespace, req_promote_data->pool_id,
+        req_promote_data->snap_id, req_promote_data->object_size,
+        req_promote_data->oids);
+
+      ObjectCacheRequest* reply = new ObjectCachePromoteReplyData(
+        RBDSC_PROMOTE_REPLY, req->seq);
+      session->send(reply);
+      break;
+    }
+    case RBDSC_TOUCH: {
+      auto req_touch_data = reinterpret_cast<ObjectCacheTouchData*>(req);
+      m_object_cache_store->touch_objects(req_touch_data->cache_file_names);
+
+      ObjectCacheRequest* reply = new ObjectCacheTouchReplyData(
+        RBDSC_TOUCH_REPLY, req->seq);
+      session->send(reply);
+      break;
+    }
     default:
       ldout(m_cct, 5) << "can't recongize request" << dendl;
       ceph_assert(0);
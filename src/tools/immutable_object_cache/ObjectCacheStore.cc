@@ -40,13 +40,15 @@ public:
 
 }  // anonymous namespace
 
+static const std::string SHM_INDEX_FILE = "index";
+
 enum ThrottleTargetCode {
   ROC_QOS_IOPS_THROTTLE = 1,
   ROC_QOS_BPS_THROTTLE = 2
 };
 
 ObjectCacheStore::ObjectCacheStore(CephContext *cct)
-      : m_cct(cct), m_rados(new librados::Rados()) {
+      : m_cct(cct), m_rados(new librados::Rados()), m_shm_index(cct) {
 
   m_cache_root_dir =
     m_cct->_conf.get_val<std::string>("immutable_object_cache_path");
@@ -94,6 +96,8 @@ ObjectCacheStore::ObjectCacheStore(CephContext *cct)
   }
   m_policy = new SimplePolicy(m_cct, cache_max_size, max_inflight_ops,
                               cache_watermark);
+  // leave room for promotions on demand
+  m_warmup_max_inflight = std::max<uint64_t>(1, max_inflight_ops / 2);
 }
 
 ObjectCacheStore::~ObjectCacheStore() {
@@ -140,12 +144,34 @@ int ObjectCacheStore::init(bool reset) {
       return -e.code().value();
     }
   }
+
+  uint64_t index_slots =
+    m_cct->_conf.get_val<uint64_t>("immutable_object_cache_shm_index_slots");
+  if (index_slots > 0) {
+    ret = m_shm_index.create(m_cache_root_dir + SHM_INDEX_FILE, index_slots);
+    if (ret < 0) {
+      lderr(m_cct) << "failed to create shared lookup index, clients will "
+                   << "look up objects through the socket only" << dendl;
+    }
+  }
   return 0;
 }
 
+std::string ObjectCacheStore::get_shm_index_path() const {
+  if (!m_shm_index.is_open()) {
+    return "";
+  }
+  return m_cache_root_dir + SHM_INDEX_FILE;
+}
+
 int ObjectCacheStore::shutdown() {
   ldout(m_cct, 20) << dendl;
 
+  {
+    std::lock_guard locker{m_warmup_lock};
+    m_warmup_queue.clear();
+    m_warmup_queued.clear();
+  }
   m_rados->shutdown();
   return 0;
 }
@@ -158,7 +184,8 @@ int ObjectCacheStore::init_cache() {
 }
 
 int ObjectCacheStore::do_promote(std::string pool_nspace, uint64_t pool_id,
-                                 uint64_t snap_id, std::string object_name) {
+                                 uint64_t snap_id, std::string object_name,
+                                 bool warmup) {
   ldout(m_cct, 20) << "to promote object: " << object_name
                    << " from pool id: " << pool_id
                    << " namespace: " << pool_nspace
@@ -187,9 +214,16 @@ int ObjectCacheStore::do_promote(std::string pool_nspace, uint64_t pool_id,
 
   librados::bufferlist* read_buf = new librados::bufferlist();
 
-  auto ctx = new LambdaContext([this, read_buf, cache_file_name](int ret) {
-    handle_promote_callback(ret, read_buf, cache_file_name);
-  });
+  auto ctx = new LambdaContext(
+    [this, read_buf, cache_file_name, warmup](int ret) {
+      handle_promote_callback(ret, read_buf, cache_file_name);
+      if (warmup) {
+        std::lock_guard locker{m_warmup_lock};
+        ceph_assert(m_warmup_inflight > 0);
+        --m_warmup_inflight;
+      }
+      kick_warmup();
+    });
 
   return promote_object(&ioctx, object_name, read_buf, ctx);
 }
@@ -235,6 +269,9 @@ int ObjectCacheStore::handle_promote_callback(int ret, bufferlist* read_buf,
   ceph_assert(OBJ_CACHE_SKIP == m_policy->get_status(cache_file_name));
   m_policy->update_status(cache_file_name, state, read_buf->length());
   ceph_assert(state == m_policy->get_status(cache_file_name));
+  if (state == OBJ_CACHE_PROMOTED) {
+    m_shm_index.insert(cache_file_name);
+  }
 
   delete read_buf;
 
@@ -285,6 +322,87 @@ int ObjectCacheStore::lookup_object(std::string pool_nspace, uint64_t pool_id,
   }
 }
 
+void ObjectCacheStore::promote_objects(
+    const std::string &pool_nspace, uint64_t pool_id, uint64_t snap_id,
+    uint64_t object_size, const std::vector<std::string> &object_names) {
+  ldout(m_cct, 10) << "pool id: " << pool_id
+                   << " namespace: " << pool_nspace
+                   << " snapshot: " << snap_id
+                   << " objects: " << object_names.size() << dendl;
+
+  {
+    std::lock_guard locker{m_warmup_lock};
+    for (auto &object_name : object_names) {
+      std::string cache_file_name =
+        get_cache_file_name(pool_nspace, pool_id, snap_id, object_name);
+      if (!m_warmup_queued.insert(cache_file_name).second) {
+        continue;
+      }
+      m_warmup_queue.push_back({pool_nspace, pool_id, snap_id, object_size,
+                                object_name, cache_file_name});
+    }
+  }
+
+  kick_warmup();
+}
+
+void ObjectCacheStore::touch_objects(
+    const std::vector<std::string> &cache_file_names) {
+  ldout(m_cct, 20) << "objects: " << cache_file_names.size() << dendl;
+  for (auto &cache_file_name : cache_file_names) {
+    m_policy->touch(cache_file_name);
+  }
+}
+
+void ObjectCacheStore::kick_warmup() {
+  std::unique_lock locker{m_warmup_lock};
+  while (!m_warmup_queue.empty() &&
+         m_warmup_inflight < m_warmup_max_inflight) {
+    auto &front = m_warmup_queue.front();
+    if (m_policy->get_free_size() < front.object_size) {
+      ldout(m_cct, 5) << "cache is full, dropping " << m_warmup_queue.size()
+                      << " queued promotions" << dendl;
+      m_warmup_queue.clear();
+      m_warmup_queued.clear();
+      break;
+    }
+
+    cache_status_t status = m_policy->lookup_object(front.cache_file_name);
+    if (status == OBJ_CACHE_SKIP &&
+        m_policy->get_status(front.cache_file_name) == OBJ_CACHE_NONE) {
+      // too many promotions in flight, retried once one completes
+      break;
+    }
+
+    PromoteRequest req = std::move(front);
+    m_warmup_queue.pop_front();
+    m_warmup_queued.erase(req.cache_file_name);
+    if (status != OBJ_CACHE_NONE) {
+      // already cached or being promoted
+      continue;
+    }
+
+    if (!take_token_from_throttle(req.object_size, 1)) {
+      // retried once the throttle is ready
+      m_policy->update_status(req.cache_file_name, OBJ_CACHE_NONE);
+      m_warmup_queued.insert(req.cache_file_name);
+      m_warmup_queue.push_front(std::move(req));
+      break;
+    }
+
+    ++m_warmup_inflight;
+    locker.unlock();
+    int r = do_promote(req.pool_nspace, req.pool_id, req.snap_id,
+                       req.object_name, true);
+    locker.lock();
+    if (r < 0) {
+      lderr(m_cct) << "fail to start promote" << dendl;
+      m_policy->update_status(req.cache_file_name, OBJ_CACHE_NONE);
+      --m_warmup_inflight;
+    }
+  }
+}
+
 int ObjectCacheStore::promote_object(librados::IoCtx* ioctx,
                                      std::string object_name,
                                      librados::bufferlist* read_buf,
@@ -324,6 +442,9 @@ int ObjectCacheStore::do_evict(std::string cache_file) {
 
   ldout(m_cct, 20) << "evict cache: " << cache_file_path << dendl;
 
+  // withdraw from the shared index first so that clients stop using it
+  m_shm_index.erase(cache_file);
+
   // TODO(dehao): possible race on read?
   int ret = std::remove(cache_file_path.c_str());
   // evict metadata
@@ -335,23 +456,11 @@ int ObjectCacheStore::do_evict(std::string cache_file) {
   return ret;
 }
 
-std::string ObjectCacheStore::get_cache_file_name(std::string pool_nspace,
-                                                       uint64_t pool_id,
-                                                       uint64_t snap_id,
-                                                       std::string oid) {
-  return pool_nspace + ":" + std::to_string(pool_id) + ":" +
-         std::to_string(snap_id) + ":" + oid;
-}
-
 std::string ObjectCacheStore::get_cache_file_path(std::string cache_file_name,
                                                   bool mkdir) {
   ldout(m_cct, 20) << cache_file_name <<dendl;
 
-  uint32_t crc = 0;
-  crc = ceph_crc32c(0, (unsigned char *)cache_file_name.c_str(),
-                    cache_file_name.length());
-
-  std::string cache_file_dir = std::to_string(crc % 100) + "/";
+  std::string cache_file_dir = get_cache_file_dir(cache_file_name);
 
   if (mkdir) {
     ldout(m_cct, 20) << "creating cache dir: " << cache_file_dir <<dendl;
@@ -374,14 +483,17 @@ std::string ObjectCacheStore::get_cache_file_path(std::string cache_file_name,
 
 void ObjectCacheStore::handle_throttle_ready(uint64_t tokens, uint64_t type) {
   m_io_throttled = false;
-  std::lock_guard lock(m_throttle_lock);
-  if (type & ROC_QOS_IOPS_THROTTLE){
-    m_iops_tokens += tokens;
-  } else if (type & ROC_QOS_BPS_THROTTLE){
-    m_bps_tokens += tokens;
-  } else {
-    lderr(m_cct) << "unknow throttle type." << dendl;
+  {
+    std::lock_guard lock(m_throttle_lock);
+    if (type & ROC_QOS_IOPS_THROTTLE){
+      m_iops_tokens += tokens;
+    } else if (type & ROC_QOS_BPS_THROTTLE){
+      m_bps_tokens += tokens;
+    } else {
+      lderr(m_cct) << "unknow throttle type." << dendl;
+    }
   }
+  kick_warmup();
 }
 
 bool ObjectCacheStore::take_token_from_throttle(uint64_t object_size,
@@ -10,8 +10,12 @@
 #include "common/Cond.h"
 #include "include/rados/librados.hpp"
 
+#include "ShmIndex.h"
 #include "SimplePolicy.h"
 
+#include <deque>
+#include <unordered_set>
+
 
 using librados::Rados;
 using librados::IoCtx;
@@ -36,25 +40,48 @@ class ObjectCacheStore {
                     std::string object_name,
                     bool return_dne_path,
                     std::string& target_cache_file_path);
+  // queue objects for promotion ahead of any lookup, e.g. to warm up the
+  // cache with the hot objects of a parent image
+  void promote_objects(const std::string &pool_nspace, uint64_t pool_id,
+                       uint64_t snap_id, uint64_t object_size,
+                       const std::vector<std::string> &object_names);
+  // refresh objects that clients found through the shared lookup index
+  void touch_objects(const std::vector<std::string> &cache_file_names);
+
+  const std::string &get_cache_dir() const {
+    return m_cache_root_dir;
+  }
+  // empty if the shared lookup index is disabled
+  std::string get_shm_index_path() const;
+
  private:
   enum ThrottleTypeCode {
     THROTTLE_CODE_BYTE,
     THROTTLE_CODE_OBJECT
   };
 
-  std::string get_cache_file_name(std::string pool_nspace, uint64_t pool_id,
-                                  uint64_t snap_id, std::string oid);
   std::string get_cache_file_path(std::string cache_file_name,
                                   bool mkdir = false);
   int evict_objects();
   int do_promote(std::string pool_nspace, uint64_t pool_id,
-                 uint64_t snap_id, std::string object_name);
+                 uint64_t snap_id, std::string object_name,
+                 bool warmup = false);
   int promote_object(librados::IoCtx*, std::string object_name,
                      librados::bufferlist* read_buf,
                      Context* on_finish);
   int handle_promote_callback(int, bufferlist*, std::string);
   int do_evict(std::string cache_file);
 
+  struct PromoteRequest {
+    std::string pool_nspace;
+    uint64_t pool_id;
+    uint64_t snap_id;
+    uint64_t object_size;
+    std::string object_name;
+    std::string cache_file_name;
+  };
+  void kick_warmup();
+
   bool take_token_from_throttle(uint64_t object_size, uint64_t object_num);
   void handle_throttle_ready(uint64_t tokens, uint64_t type);
   void apply_qos_tick_and_limit(const uint64_t flag,
@@ -77,6 +104,16 @@ class ObjectCacheStore {
     ceph::make_mutex("ceph::cache::ObjectCacheStore::m_throttle_lock");;
   uint64_t m_iops_tokens{0};
   uint64_t m_bps_tokens{0};
+
+  ShmIndex m_shm_index;
+
+  // bulk promotions, issued with at most m_warmup_max_inflight in flight
+  ceph::mutex m_warmup_lock =
+    ceph::make_mutex("ceph::cache::ObjectCacheStore::m_warmup_lock");
+  std::deque<PromoteRequest> m_warmup_queue;
+  std::unordered_set<std::string> m_warmup_queued;
+  uint64_t m_warmup_inflight{0};
+  uint64_t m_warmup_max_inflight;
 };
 
 }  // namespace immutable_obj_cache
@@ -22,11 +22,14 @@ class Policy {
   Policy() {}
   virtual ~Policy() {}
   virtual cache_status_t lookup_object(std::string) = 0;
+  // refresh the LRU position of a cached object, without promoting it
+  virtual void touch(const std::string&) = 0;
   virtual int evict_entry(std::string) = 0;
   virtual void update_status(std::string, cache_status_t,
                              uint64_t size = 0) = 0;
   virtual cache_status_t get_status(std::string) = 0;
   virtual void get_evict_list(std::list<std::string>* obj_list) = 0;
+  virtual uint64_t get_free_size() = 0;
 };
 
 }  // namespace immutable_obj_cache
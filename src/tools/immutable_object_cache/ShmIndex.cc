@@ -0,0 +1,203 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/debug.h"
+#include "common/errno.h"
+#include "include/ceph_hash.h"
+#include "include/crc32c.h"
+#include "ShmIndex.h"
+
+#define dout_context g_ceph_context
+#define dout_subsys ceph_subsys_immutable_obj_cache
+#undef dout_prefix
+#define dout_prefix *_dout << "ceph::cache::ShmIndex: " << this << " " \
+                           << __func__ << ": "
+
+namespace ceph {
+namespace immutable_obj_cache {
+
+ShmIndex::ShmIndex(CephContext *cct) : m_cct(cct) {
+}
+
+ShmIndex::~ShmIndex() {
+  close();
+}
+
+uint64_t ShmIndex::hash(const std::string &cache_file_name) {
+  // two different functions: the crc32c of the same data under two seeds
+  // differ by a constant for a given length, and only add a few bits
+  auto data = reinterpret_cast<const unsigned char*>(cache_file_name.c_str());
+  uint64_t hi = ceph_str_hash_rjenkins(cache_file_name.c_str(),
+                                       cache_file_name.length());
+  uint64_t lo = ceph_crc32c(0, data, cache_file_name.length());
+  return (hi << 32) | lo | SLOT_USED;
+}
+
+int ShmIndex::map(int fd, size_t length, bool writable) {
+  int prot = PROT_READ | (writable ? PROT_WRITE : 0);
+  void *addr = ::mmap(nullptr, length, prot, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    return -errno;
+  }
+  m_addr = addr;
+  m_length = length;
+  m_slots = reinterpret_cast<std::atomic<uint64_t>*>(
+    static_cast<char*>(addr) + HEADER_SIZE);
+  return 0;
+}
+
+int ShmIndex::create(const std::string &path, uint64_t num_slots) {
+  ldout(m_cct, 5) << "path=" << path << ", slots=" << num_slots << dendl;
+  ceph_assert(num_slots > 0);
+  close();
+
+  // clients of a previous daemon keep their mapping of the old file
+  ::unlink(path.c_str());
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    int r = -errno;
+    lderr(m_cct) << "failed to create " << path << ": " << cpp_strerror(r)
+                 << dendl;
+    return r;
+  }
+
+  size_t length = HEADER_SIZE + num_slots * sizeof(uint64_t);
+  int r = 0;
+  if (::ftruncate(fd, length) < 0) {
+    r = -errno;
+  } else {
+    r = map(fd, length, true);
+  }
+  ::close(fd);
+  if (r < 0) {
+    lderr(m_cct) << "failed to map " << path << ": " << cpp_strerror(r)
+                 << dendl;
+    ::unlink(path.c_str());
+    return r;
+  }
+
+  // a freshly truncated file reads as zeros, i.e. all slots empty
+  auto header = reinterpret_cast<header_t*>(m_addr);
+  header->num_slots = num_slots;
+  header->magic = MAGIC;
+  m_num_slots = num_slots;
+  return 0;
+}
+
+int ShmIndex::open(const std::string &path) {
+  ldout(m_cct, 20) << "path=" << path << dendl;
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -errno;
+  }
+
+  struct stat st;
+  int r = 0;
+  if (::fstat(fd, &st) < 0) {
+    r = -errno;
+  } else if (static_cast<uint64_t>(st.st_size) < HEADER_SIZE) {
+    r = -EINVAL;
+  } else {
+    r = map(fd, st.st_size, false);
+  }
+  ::close(fd);
+  if (r < 0) {
+    return r;
+  }
+
+  auto header = reinterpret_cast<const header_t*>(m_addr);
+  if (header->magic != MAGIC || header->num_slots == 0 ||
+      header->num_slots > (m_length - HEADER_SIZE) / sizeof(uint64_t)) {
+    close();
+    return -EINVAL;
+  }
+  m_num_slots = header->num_slots;
+  return 0;
+}
+
+void ShmIndex::close() {
+  if (m_addr != nullptr) {
+    ::munmap(m_addr, m_length);
+  }
+  m_addr = nullptr;
+  m_length = 0;
+  m_slots = nullptr;
+  m_num_slots = 0;
+}
+
+bool ShmIndex::insert(const std::string &cache_file_name) {
+  if (!is_open()) {
+    return false;
+  }
+
+  uint64_t key = hash(cache_file_name);
+  uint64_t start = (key >> 1) % m_num_slots;
+  uint64_t probes = std::min(PROBE_SLOTS, m_num_slots);
+
+  std::lock_guard locker{m_lock};
+  std::atomic<uint64_t> *free_slot = nullptr;
+  for (uint64_t i = 0; i < probes; ++i) {
+    auto &slot = m_slots[(start + i) % m_num_slots];
+    uint64_t v = slot.load(std::memory_order_relaxed);
+    if (v == SLOT_EMPTY || v == SLOT_REMOVED) {
+      if (free_slot == nullptr) {
+        free_slot = &slot;
+      }
+    } else if (v == key) {
+      return true;
+    }
+  }
+
+  if (free_slot == nullptr) {
+    ldout(m_cct, 20) << "no free slot for " << cache_file_name << dendl;
+    return false;
+  }
+  free_slot->store(key, std::memory_order_release);
+  return true;
+}
+
+void ShmIndex::erase(const std::string &cache_file_name) {
+  if (!is_open()) {
+    return;
+  }
+
+  uint64_t key = hash(cache_file_name);
+  uint64_t start = (key >> 1) % m_num_slots;
+  uint64_t probes = std::min(PROBE_SLOTS, m_num_slots);
+
+  std::lock_guard locker{m_lock};
+  for (uint64_t i = 0; i < probes; ++i) {
+    auto &slot = m_slots[(start + i) % m_num_slots];
+    if (slot.load(std::memory_order_relaxed) == key) {
+      slot.store(SLOT_REMOVED, std::memory_order_release);
+      return;
+    }
+  }
+}
+
+bool ShmIndex::lookup(const std::string &cache_file_name) const {
+  if (!is_open()) {
+    return false;
+  }
+
+  uint64_t key = hash(cache_file_name);
+  uint64_t start = (key >> 1) % m_num_slots;
+  uint64_t probes = std::min(PROBE_SLOTS, m_num_slots);
+  for (uint64_t i = 0; i < probes; ++i) {
+    if (m_slots[(start + i) % m_num_slots].load(
+          std::memory_order_acquire) == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace immutable_obj_cache
+}  // namespace ceph
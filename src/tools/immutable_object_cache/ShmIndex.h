@@ -0,0 +1,90 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_CACHE_SHM_INDEX_H
+#define CEPH_CACHE_SHM_INDEX_H
+
+#include <atomic>
+#include <string>
+
+#include "common/ceph_context.h"
+#include "common/ceph_mutex.h"
+
+namespace ceph {
+namespace immutable_obj_cache {
+
+/*
+ * Index of cached objects shared with clients through a memory mapped
+ * file in the cache directory.
+ *
+ * The daemon is the only writer: it publishes an object once it has been
+ * promoted and withdraws it before the cache file is evicted.  Clients
+ * map the index read-only and answer lookups that hit in it without a
+ * round trip to the daemon; a miss still goes over the socket so that
+ * the object gets promoted.  Objects found not to exist are never
+ * published: answering that from the index would send the client to the
+ * parent's parent, and a false answer would return wrong data.
+ *
+ * Slots hold a 63-bit hash of the cache file name, made of two
+ * independent 32-bit hashes, and are probed over a fixed window.  Clients
+ * derive the cache file path from the object name itself, so even a
+ * false hit can only send them to a missing file, which is handled like
+ * any other cache read failure.
+ */
+class ShmIndex {
+ public:
+  static constexpr uint64_t PROBE_SLOTS = 16;
+
+  ShmIndex(CephContext *cct);
+  ~ShmIndex();
+
+  // daemon side: create a new, empty index, replacing any existing file
+  int create(const std::string &path, uint64_t num_slots);
+  // client side: map an index created by the daemon
+  int open(const std::string &path);
+  void close();
+
+  bool is_open() const {
+    return m_slots != nullptr;
+  }
+
+  // daemon side, for promoted objects only
+  bool insert(const std::string &cache_file_name);
+  void erase(const std::string &cache_file_name);
+
+  // true if the object has been promoted
+  bool lookup(const std::string &cache_file_name) const;
+
+ private:
+  struct header_t {
+    uint64_t magic;
+    uint64_t num_slots;
+  };
+
+  static constexpr uint64_t MAGIC = 0x63656f6369647832ULL;
+  static constexpr uint64_t HEADER_SIZE = 64;
+
+  // a used slot holds the hash with the low bit set
+  static constexpr uint64_t SLOT_EMPTY = 0;
+  static constexpr uint64_t SLOT_REMOVED = 2;
+  static constexpr uint64_t SLOT_USED = 1;
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+  CephContext *m_cct;
+  void *m_addr = nullptr;
+  size_t m_length = 0;
+  std::atomic<uint64_t> *m_slots = nullptr;
+  uint64_t m_num_slots = 0;
+
+  // serializes daemon side updates
+  ceph::mutex m_lock =
+    ceph::make_mutex("ceph::cache::ShmIndex::m_lock");
+
+  static uint64_t hash(const std::string &cache_file_name);
+  int map(int fd, size_t length, bool writable);
+};
+
+}  // namespace immutable_obj_cache
+}  // namespace ceph
+#endif  // CEPH_CACHE_SHM_INDEX_H
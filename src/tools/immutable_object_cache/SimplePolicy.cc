@@ -82,6 +82,17 @@ cache_status_t SimplePolicy::lookup_object(std::string file_name) {
   return entry->status;
 }
 
+void SimplePolicy::touch(const std::string& file_name) {
+  ldout(cct, 20) << "touch: " << file_name << dendl;
+
+  std::shared_lock rlocker{m_cache_map_lock};
+  auto entry_it = m_cache_map.find(file_name);
+  if (entry_it != m_cache_map.end() &&
+      entry_it->second->status == OBJ_CACHE_PROMOTED) {
+    m_promoted_lru.lru_touch(entry_it->second);
+  }
+}
+
 void SimplePolicy::update_status(std::string file_name,
                                  cache_status_t new_status, uint64_t size) {
   ldout(cct, 20) << "update status for: " << file_name
@@ -22,6 +22,7 @@ class SimplePolicy : public Policy {
   ~SimplePolicy();
 
   cache_status_t lookup_object(std::string file_name);
+  void touch(const std::string& file_name);
   cache_status_t get_status(std::string file_name);
 
   void update_status(std::string file_name,
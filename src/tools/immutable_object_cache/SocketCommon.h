@@ -12,6 +12,14 @@ static const int RBDSC_READ            =  0X12;
 static const int RBDSC_REGISTER_REPLY  =  0X13;
 static const int RBDSC_READ_REPLY      =  0X14;
 static const int RBDSC_READ_RADOS      =  0X15;
+static const int RBDSC_PROMOTE         =  0X16;
+static const int RBDSC_PROMOTE_REPLY   =  0X17;
+static const int RBDSC_TOUCH           =  0X18;
+static const int RBDSC_TOUCH_REPLY     =  0X19;
+
+// features advertised by the daemon in RBDSC_REGISTER_REPLY
+static const uint64_t RBDSC_FEATURE_PROMOTE = 1ULL << 0;
+static const uint64_t RBDSC_FEATURE_TOUCH   = 1ULL << 1;
 
 static const int ASIO_ERROR_READ = 0X01;
 static const int ASIO_ERROR_WRITE = 0X02;
@@ -63,13 +63,31 @@ void ObjectCacheRegData::decode_payload(bufferlist::const_iterator i,
 ObjectCacheRegReplyData::ObjectCacheRegReplyData() {}
 ObjectCacheRegReplyData::ObjectCacheRegReplyData(uint16_t t, uint64_t s)
   : ObjectCacheRequest(t, s) {}
+ObjectCacheRegReplyData::ObjectCacheRegReplyData(
+    uint16_t t, uint64_t s, uint64_t features, const std::string &cache_dir,
+    const std::string &shm_index_path)
+  : ObjectCacheRequest(t, s), features(features), cache_dir(cache_dir),
+    shm_index_path(shm_index_path) {
+}
 
 ObjectCacheRegReplyData::~ObjectCacheRegReplyData() {}
 
-void ObjectCacheRegReplyData::encode_payload() {}
+void ObjectCacheRegReplyData::encode_payload() {
+  ceph::encode(features, payload);
+  ceph::encode(cache_dir, payload);
+  ceph::encode(shm_index_path, payload);
+}
 
-void ObjectCacheRegReplyData::decode_payload(bufferlist::const_iterator bl,
-                                            __u8 encode_version) {}
+void ObjectCacheRegReplyData::decode_payload(bufferlist::const_iterator i,
+                                            __u8 encode_version) {
+  if (i.end()) {
+    // older daemons reply without a payload
+    return;
+  }
+  ceph::decode(features, i);
+  ceph::decode(cache_dir, i);
+  ceph::decode(shm_index_path, i);
+}
 
 ObjectCacheReadData::ObjectCacheReadData(uint16_t t, uint64_t s,
                                          uint64_t read_offset,
@@ -139,6 +157,79 @@ void ObjectCacheReadRadosData::encode_payload() {}
 void ObjectCacheReadRadosData::decode_payload(bufferlist::const_iterator i,
                                               __u8 encode_version) {}
 
+ObjectCachePromoteData::ObjectCachePromoteData(
+    uint16_t t, uint64_t s, uint64_t pool_id, uint64_t snap_id,
+    uint64_t object_size, std::string pool_namespace,
+    std::vector<std::string> oids)
+  : ObjectCacheRequest(t, s), pool_id(pool_id), snap_id(snap_id),
+    object_size(object_size), pool_namespace(std::move(pool_namespace)),
+    oids(std::move(oids)) {
+}
+
+ObjectCachePromoteData::ObjectCachePromoteData(uint16_t t, uint64_t s)
+  : ObjectCacheRequest(t, s) {}
+
+ObjectCachePromoteData::~ObjectCachePromoteData() {}
+
+void ObjectCachePromoteData::encode_payload() {
+  ceph::encode(pool_id, payload);
+  ceph::encode(snap_id, payload);
+  ceph::encode(object_size, payload);
+  ceph::encode(pool_namespace, payload);
+  ceph::encode(oids, payload);
+}
+
+void ObjectCachePromoteData::decode_payload(bufferlist::const_iterator i,
+                                            __u8 encode_version) {
+  ceph::decode(pool_id, i);
+  ceph::decode(snap_id, i);
+  ceph::decode(object_size, i);
+  ceph::decode(pool_namespace, i);
+  ceph::decode(oids, i);
+}
+
+ObjectCachePromoteReplyData::ObjectCachePromoteReplyData() {}
+ObjectCachePromoteReplyData::ObjectCachePromoteReplyData(uint16_t t,
+                                                         uint64_t s)
+  : ObjectCacheRequest(t, s) {}
+
+ObjectCachePromoteReplyData::~ObjectCachePromoteReplyData() {}
+
+void ObjectCachePromoteReplyData::encode_payload() {}
+
+void ObjectCachePromoteReplyData::decode_payload(bufferlist::const_iterator i,
+                                                 __u8 encode_version) {}
+
+ObjectCacheTouchData::ObjectCacheTouchData(
+    uint16_t t, uint64_t s, std::vector<std::string> cache_file_names)
+  : ObjectCacheRequest(t, s), cache_file_names(std::move(cache_file_names)) {
+}
+
+ObjectCacheTouchData::ObjectCacheTouchData(uint16_t t, uint64_t s)
+  : ObjectCacheRequest(t, s) {}
+
+ObjectCacheTouchData::~ObjectCacheTouchData() {}
+
+void ObjectCacheTouchData::encode_payload() {
+  ceph::encode(cache_file_names, payload);
+}
+
+void ObjectCacheTouchData::decode_payload(bufferlist::const_iterator i,
+                                          __u8 encode_version) {
+  ceph::decode(cache_file_names, i);
+}
+
+ObjectCacheTouchReplyData::ObjectCacheTouchReplyData() {}
+ObjectCacheTouchReplyData::ObjectCacheTouchReplyData(uint16_t t, uint64_t s)
+  : ObjectCacheRequest(t, s) {}
+
+ObjectCacheTouchReplyData::~ObjectCacheTouchReplyData() {}
+
+void ObjectCacheTouchReplyData::encode_payload() {}
+
+void ObjectCacheTouchReplyData::decode_payload(bufferlist::const_iterator i,
+                                               __u8 encode_version) {}
+
 ObjectCacheRequest* decode_object_cache_request(bufferlist payload_buffer) {
   ObjectCacheRequest* req = nullptr;
 
@@ -171,6 +262,22 @@ ObjectCacheRequest* decode_object_cache_request(bufferlist payload_buffer) {
       req = new ObjectCacheReadRadosData(type, seq);
       break;
     }
+    case RBDSC_PROMOTE: {
+      req = new ObjectCachePromoteData(type, seq);
+      break;
+    }
+    case RBDSC_PROMOTE_REPLY: {
+      req = new ObjectCachePromoteReplyData(type, seq);
+      break;
+    }
+    case RBDSC_TOUCH: {
+      req = new ObjectCacheTouchData(type, seq);
+      break;
+    }
+    case RBDSC_TOUCH_REPLY: {
+      req = new ObjectCacheTouchReplyData(type, seq);
+      break;
+    }
     default:
       ceph_assert(0);
   }
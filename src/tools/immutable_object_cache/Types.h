@@ -72,14 +72,20 @@ class ObjectCacheRegData : public ObjectCacheRequest {
 
 class ObjectCacheRegReplyData : public ObjectCacheRequest {
  public:
+  uint64_t features = 0;
+  std::string cache_dir;
+  std::string shm_index_path;
   ObjectCacheRegReplyData();
   ObjectCacheRegReplyData(uint16_t t, uint64_t s);
+  ObjectCacheRegReplyData(uint16_t t, uint64_t s, uint64_t features,
+                          const std::string &cache_dir,
+                          const std::string &shm_index_path);
   ~ObjectCacheRegReplyData() override;
   void encode_payload() override;
   void decode_payload(bufferlist::const_iterator iter,
                       __u8 encode_version) override;
   uint16_t get_request_type() override { return RBDSC_REGISTER_REPLY; }
-  bool payload_empty() override { return true; }
+  bool payload_empty() override { return false; }
 };
 
 class ObjectCacheReadData : public ObjectCacheRequest {
@@ -129,6 +135,64 @@ class ObjectCacheReadRadosData : public ObjectCacheRequest {
   bool payload_empty() override { return true; }
 };
 
+class ObjectCachePromoteData : public ObjectCacheRequest {
+ public:
+  uint64_t pool_id;
+  uint64_t snap_id;
+  uint64_t object_size;
+  std::string pool_namespace;
+  std::vector<std::string> oids;
+  ObjectCachePromoteData(uint16_t t, uint64_t s, uint64_t pool_id,
+                         uint64_t snap_id, uint64_t object_size,
+                         std::string pool_namespace,
+                         std::vector<std::string> oids);
+  ObjectCachePromoteData(uint16_t t, uint64_t s);
+  ~ObjectCachePromoteData() override;
+  void encode_payload() override;
+  void decode_payload(bufferlist::const_iterator bl,
+                      __u8 encode_version) override;
+  uint16_t get_request_type() override { return RBDSC_PROMOTE; }
+  bool payload_empty() override { return false; }
+};
+
+class ObjectCachePromoteReplyData : public ObjectCacheRequest {
+ public:
+  ObjectCachePromoteReplyData();
+  ObjectCachePromoteReplyData(uint16_t t, uint64_t s);
+  ~ObjectCachePromoteReplyData() override;
+  void encode_payload() override;
+  void decode_payload(bufferlist::const_iterator bl,
+                      __u8 encode_version) override;
+  uint16_t get_request_type() override { return RBDSC_PROMOTE_REPLY; }
+  bool payload_empty() override { return true; }
+};
+
+class ObjectCacheTouchData : public ObjectCacheRequest {
+ public:
+  std::vector<std::string> cache_file_names;
+  ObjectCacheTouchData(uint16_t t, uint64_t s,
+                       std::vector<std::string> cache_file_names);
+  ObjectCacheTouchData(uint16_t t, uint64_t s);
+  ~ObjectCacheTouchData() override;
+  void encode_payload() override;
+  void decode_payload(bufferlist::const_iterator bl,
+                      __u8 encode_version) override;
+  uint16_t get_request_type() override { return RBDSC_TOUCH; }
+  bool payload_empty() override { return false; }
+};
+
+class ObjectCacheTouchReplyData : public ObjectCacheRequest {
+ public:
+  ObjectCacheTouchReplyData();
+  ObjectCacheTouchReplyData(uint16_t t, uint64_t s);
+  ~ObjectCacheTouchReplyData() override;
+  void encode_payload() override;
+  void decode_payload(bufferlist::const_iterator bl,
+                      __u8 encode_version) override;
+  uint16_t get_request_type() override { return RBDSC_TOUCH_REPLY; }
+  bool payload_empty() override { return true; }
+};
+
 ObjectCacheRequest* decode_object_cache_request(bufferlist payload_buffer);
 
 }  // namespace immutable_obj_cache
@@ -6,6 +6,7 @@
 
 #include "include/rados/librados.hpp"
 #include "include/Context.h"
+#include "include/crc32c.h"
 
 namespace ceph {
 namespace immutable_obj_cache {
@@ -20,6 +21,20 @@ void rados_callback(rados_completion_t c, void *arg) {
 
 }  // namespace detail
 
+inline std::string get_cache_file_name(const std::string &pool_nspace,
+                                       uint64_t pool_id, uint64_t snap_id,
+                                       const std::string &oid) {
+  return pool_nspace + ":" + std::to_string(pool_id) + ":" +
+         std::to_string(snap_id) + ":" + oid;
+}
+
+// cache files are spread over 100 sub-directories of the cache directory
+inline std::string get_cache_file_dir(const std::string &cache_file_name) {
+  uint32_t crc = ceph_crc32c(0, (unsigned char *)cache_file_name.c_str(),
+                             cache_file_name.length());
+  return std::to_string(crc % 100) + "/";
+}
+
 template <typename T, void(T::*MF)(int)=&T::complete>
 librados::AioCompletion *create_rados_callback(T *obj) {
   return librados::Rados::aio_create_completion(
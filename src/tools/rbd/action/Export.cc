@@ -8,7 +8,10 @@
 #include "include/Context.h"
 #include "common/errno.h"
 #include "common/Throttle.h"
+#include "common/safe_io.h"
 #include "include/encoding.h"
+#include "include/interval_set.h"
+#include "librbd/ManagementOps.h"
 #include <iostream>
 #include <fcntl.h>
 #include <stdlib.h>
@@ -190,7 +193,8 @@ int do_export_diff_fd(librbd::Image& image, const char *fromsnapname,
     }
   }
   ExportDiffContext edc(&image, fd, info.size,
-                        g_conf().get_val<uint64_t>("rbd_concurrent_management_ops"),
+                        librbd::util::get_concurrent_management_ops(
+                          g_conf(), 1ull << info.order),
                         no_progress, export_format);
   r = image.diff_iterate2(fromsnapname, 0, info.size, true, whole_object,
                           &C_ExportDiff::export_diff_cb, (void *)&edc);
@@ -317,15 +321,23 @@ class C_Export : public Context
 {
 public:
   C_Export(OrderedThrottle &ordered_throttle, librbd::Image &image,
-	   uint64_t fd_offset, uint64_t offset, uint64_t length, int fd)
+	   uint64_t fd_offset, uint64_t offset, uint64_t length, int fd,
+	   bool zeroed = false)
     : m_throttle(ordered_throttle), m_image(image), m_dest_offset(fd_offset),
-      m_offset(offset), m_length(length), m_fd(fd)
+      m_offset(offset), m_length(length), m_fd(fd), m_zeroed(zeroed)
   {
   }
 
   void send()
   {
     auto ctx = m_throttle.start_op(this);
+    if (m_zeroed) {
+      // known to be unallocated -- no need to read it from the cluster
+      m_bufferlist.append_zero(m_length);
+      ctx->complete(m_length);
+      return;
+    }
+
     auto aio_completion = new librbd::RBD::AioCompletion(
       ctx, &utils::aio_context_callback);
     int op_flags = LIBRADOS_OP_FLAG_FADVISE_SEQUENTIAL |
@@ -353,24 +365,38 @@ public:
     }
 
     ceph_assert(m_bufferlist.length() == static_cast<size_t>(r));
-    if (m_fd != STDOUT_FILENO) {
-      if (m_bufferlist.is_zero()) {
-        return;
-      }
-
-      uint64_t chkret = lseek64(m_fd, m_dest_offset, SEEK_SET);
-      if (chkret != m_dest_offset) {
-        cerr << "rbd: error seeking destination image to offset "
+    if (m_fd == STDOUT_FILENO) {
+      r = m_bufferlist.write_fd(m_fd);
+      if (r < 0) {
+        cerr << "rbd: error writing to destination image at offset "
              << m_dest_offset << std::endl;
-        r = -errno;
-        return;
       }
+      return;
     }
 
-    r = m_bufferlist.write_fd(m_fd);
-    if (r < 0) {
-      cerr << "rbd: error writing to destination image at offset "
-           << m_dest_offset << std::endl;
+    // write the read buffers in place, skipping zeroed extents so that the
+    // destination file stays sparse
+    uint64_t dest_offset = m_dest_offset;
+    for (auto &bp : m_bufferlist.buffers()) {
+      size_t buffer_offset = 0;
+      while (buffer_offset < bp.length()) {
+        size_t write_length = 0;
+        bool zeroed = false;
+        utils::calc_sparse_extent(bp, utils::RBD_DEFAULT_SPARSE_SIZE,
+                                  buffer_offset, bp.length(), &write_length,
+                                  &zeroed);
+        if (!zeroed) {
+          r = safe_pwrite(m_fd, bp.c_str() + buffer_offset, write_length,
+                          dest_offset + buffer_offset);
+          if (r < 0) {
+            cerr << "rbd: error writing to destination image at offset "
+                 << dest_offset + buffer_offset << std::endl;
+            return;
+          }
+        }
+        buffer_offset += write_length;
+      }
+      dest_offset += bp.length();
     }
   }
 
@@ -382,8 +408,42 @@ private:
   uint64_t m_offset;
   uint64_t m_length;
   int m_fd;
+  bool m_zeroed;
 };
 
+static int export_allocated_cb(uint64_t offset, size_t length, int exists,
+                               void *arg)
+{
+  auto allocated = reinterpret_cast<interval_set<uint64_t>*>(arg);
+  if (exists) {
+    allocated->union_insert(offset, length);
+  }
+  return 0;
+}
+
+// with a valid fast-diff object map the allocated extents of the whole
+// image are known without reading it.  Returns false if not available.
+static bool get_allocated_extents(librbd::Image& image, uint64_t size,
+                                  interval_set<uint64_t> *allocated)
+{
+  uint64_t features;
+  uint64_t flags;
+  if (image.features(&features) < 0 ||
+      (features & RBD_FEATURE_FAST_DIFF) == 0 ||
+      image.get_flags(&flags) < 0 ||
+      (flags & RBD_FLAG_FAST_DIFF_INVALID) != 0) {
+    return false;
+  }
+
+  int r = image.diff_iterate2(nullptr, 0, size, true, true,
+                              export_allocated_cb, allocated);
+  if (r < 0) {
+    allocated->clear();
+    return false;
+  }
+  return true;
+}
+
 const uint32_t MAX_KEYS = 64;
 
 static int do_export_v2(librbd::Image& image, librbd::image_info_t &info, int fd,
@@ -521,6 +581,9 @@ static int do_export_v1(librbd::Image& image, librbd::image_info_t &info,
 {
   int r = 0;
   size_t file_size = 0;
+  interval_set<uint64_t> allocated;
+  bool skip_holes = get_allocated_extents(image, info.size, &allocated);
+
   OrderedThrottle throttle(max_concurrent_ops, false);
   for (uint64_t offset = 0; offset < info.size; offset += period) {
     if (throttle.pending_error()) {
@@ -528,8 +591,15 @@ static int do_export_v1(librbd::Image& image, librbd::image_info_t &info,
     }
 
     uint64_t length = min(period, info.size - offset);
+    bool zeroed = skip_holes && !allocated.intersects(offset, length);
+    if (zeroed && fd != STDOUT_FILENO) {
+      // left as a hole by the final ftruncate
+      pc.update_progress(offset, info.size);
+      continue;
+    }
+
     C_Export *ctx = new C_Export(throttle, image, file_size + offset, offset,
-                                 length, fd);
+                                 length, fd, zeroed);
     ctx->send();
 
     pc.update_progress(offset, info.size);
@@ -560,7 +630,6 @@ static int do_export(librbd::Image& image, const char *path, bool no_progress,
     return r;
 
   int fd;
-  int max_concurrent_ops = g_conf().get_val<uint64_t>("rbd_concurrent_management_ops");
   bool to_stdout = (strcmp(path, "-") == 0);
   if (to_stdout) {
     fd = STDOUT_FILENO;
@@ -576,6 +645,8 @@ static int do_export(librbd::Image& image, const char *path, bool no_progress,
 
   utils::ProgressContext pc("Exporting image", no_progress);
   uint64_t period = image.get_stripe_count() * (1ull << info.order);
+  int max_concurrent_ops = librbd::util::get_concurrent_management_ops(
+    g_conf(), period);
 
   if (export_format == 1)
     r = do_export_v1(image, info, fd, period, max_concurrent_ops, pc);
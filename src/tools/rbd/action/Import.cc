@@ -14,6 +14,7 @@
 #include "common/debug.h"
 #include "common/errno.h"
 #include "common/safe_io.h"
+#include "librbd/ManagementOps.h"
 #include <iostream>
 #include <boost/program_options.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -727,7 +728,10 @@ static int do_import_v1(int fd, librbd::Image &image, uint64_t size,
   size_t reqlen = imgblklen;    // amount requested from read
   ssize_t readlen;              // amount received from one read
   size_t blklen = 0;            // amount accumulated from reads to fill blk
-  char *p = new char[imgblklen];
+  // read straight into the buffer handed to librbd, a new one is only
+  // needed once part of the previous block has been submitted
+  bufferptr readptr(buffer::create(imgblklen));
+  bool submitted = false;
   uint64_t image_pos = 0;
   bool from_stdin = (fd == STDIN_FILENO);
   boost::scoped_ptr<SimpleThrottle> throttle;
@@ -736,12 +740,13 @@ static int do_import_v1(int fd, librbd::Image &image, uint64_t size,
     throttle.reset(new SimpleThrottle(1, false));
   } else {
     throttle.reset(new SimpleThrottle(
-      g_conf().get_val<uint64_t>("rbd_concurrent_management_ops"), false));
+      librbd::util::get_concurrent_management_ops(g_conf(), imgblklen),
+      false));
   }
 
   reqlen = min<uint64_t>(reqlen, size);
   // loop body handles 0 return, as we may have a block to flush
-  while ((readlen = ::read(fd, p + blklen, reqlen)) >= 0) {
+  while ((readlen = ::read(fd, readptr.c_str() + blklen, reqlen)) >= 0) {
     if (throttle->pending_error()) {
       break;
     }
@@ -755,7 +760,7 @@ static int do_import_v1(int fd, librbd::Image &image, uint64_t size,
     if (!from_stdin)
       pc.update_progress(image_pos, size);
 
-    bufferptr blkptr(p, blklen); 
+    bufferptr blkptr(readptr, 0, blklen);
     // resize output image by binary expansion as we go for stdin
     if (from_stdin && (image_pos + (size_t)blklen) > size) {
       size *= 2;
@@ -784,6 +789,7 @@ static int do_import_v1(int fd, librbd::Image &image, uint64_t size,
 	C_Import *ctx = new C_Import(*throttle, image, write_bl,
 				     image_pos + buffer_offset);
 	ctx->send();
+	submitted = true;
       }
 
       buffer_offset += write_length;
@@ -798,6 +804,10 @@ static int do_import_v1(int fd, librbd::Image &image, uint64_t size,
       break;
     blklen = 0;
     reqlen = imgblklen;
+    if (submitted) {
+      readptr = buffer::create(imgblklen);
+      submitted = false;
+    }
   }
   r = throttle->wait_for_ret();
   if (r < 0) {
@@ -812,7 +822,6 @@ static int do_import_v1(int fd, librbd::Image &image, uint64_t size,
     }
   }
 out:
-  delete[] p;
   return r;
 }
 
@@ -27,6 +27,15 @@ enum {
   l_rbd_mirror_last,
 };
 
+enum {
+  l_rbd_mirror_snapshot_first = 27500,
+  l_rbd_mirror_snapshot_replay_snapshots,
+  l_rbd_mirror_snapshot_replay_snapshots_time,
+  l_rbd_mirror_snapshot_replay_bytes,
+  l_rbd_mirror_snapshot_sync_objects,
+  l_rbd_mirror_snapshot_last,
+};
+
 typedef std::shared_ptr<librados::Rados> RadosRef;
 typedef std::shared_ptr<librados::IoCtx> IoCtxRef;
 typedef std::shared_ptr<librbd::Image> ImageRef;
@@ -39,7 +39,7 @@
 #define dout_prefix *_dout << "rbd::mirror::image_replayer::snapshot::" \
                            << "Replayer: " << this << " " << __func__ << ": "
 
-extern PerfCounters *g_perf_counters;
+extern PerfCounters *g_snapshot_perf_counters;
 
 namespace rbd {
 namespace mirror {
@@ -1046,6 +1046,7 @@ void Replayer<I>::copy_image() {
            << "snap_seqs=" << m_local_mirror_snap_ns.snap_seqs << dendl;
 
   m_snapshot_bytes = 0;
+  m_snapshot_replay_start = ceph_clock_now();
   m_deep_copy_handler = new DeepCopyHandler(this);
   auto ctx = create_context_callback<
     Replayer<I>, &Replayer<I>::handle_copy_image>(this);
@@ -1080,6 +1081,12 @@ void Replayer<I>::handle_copy_image(int r) {
     m_snapshot_bytes = 0;
   }
 
+  if (g_snapshot_perf_counters) {
+    g_snapshot_perf_counters->inc(l_rbd_mirror_snapshot_replay_snapshots);
+    g_snapshot_perf_counters->tinc(l_rbd_mirror_snapshot_replay_snapshots_time,
+                                   ceph_clock_now() - m_snapshot_replay_start);
+  }
+
   apply_image_state();
 }
 
@@ -1090,8 +1097,16 @@ void Replayer<I>::handle_copy_image_progress(uint64_t object_number,
            << "object_count=" << object_count << dendl;
 
   std::unique_lock locker{m_lock};
-  m_local_mirror_snap_ns.last_copied_object_number = std::min(
-    object_number, object_count);
+  auto last_copied_object_number = std::min(object_number, object_count);
+  if (g_snapshot_perf_counters &&
+      last_copied_object_number >
+        m_local_mirror_snap_ns.last_copied_object_number) {
+    g_snapshot_perf_counters->inc(
+      l_rbd_mirror_snapshot_sync_objects,
+      last_copied_object_number -
+        m_local_mirror_snap_ns.last_copied_object_number);
+  }
+  m_local_mirror_snap_ns.last_copied_object_number = last_copied_object_number;
   m_local_object_count = object_count;
 
   update_non_primary_snapshot(false);
@@ -1104,6 +1119,11 @@ void Replayer<I>::handle_copy_image_read(uint64_t bytes_read) {
   std::unique_lock locker{m_lock};
   m_bytes_per_second(bytes_read);
   m_snapshot_bytes += bytes_read;
+
+  if (g_snapshot_perf_counters) {
+    g_snapshot_perf_counters->inc(l_rbd_mirror_snapshot_replay_bytes,
+                                  bytes_read);
+  }
 }
 
 template <typename I>
@@ -234,6 +234,7 @@ private:
   TimeRollingMean m_bytes_per_second;
 
   uint64_t m_snapshot_bytes = 0;
+  utime_t m_snapshot_replay_start;
   boost::accumulators::accumulator_set<
     uint64_t, boost::accumulators::stats<
       boost::accumulators::tag::rolling_mean>> m_bytes_per_snapshot{
@@ -15,6 +15,7 @@
 
 rbd::mirror::Mirror *mirror = nullptr;
 PerfCounters *g_perf_counters = nullptr;
+PerfCounters *g_snapshot_perf_counters = nullptr;
 
 void usage() {
   std::cout << "usage: rbd-mirror [options...]" << std::endl;
@@ -80,6 +81,22 @@ int main(int argc, const char **argv)
   g_perf_counters = plb.create_perf_counters();
   g_ceph_context->get_perfcounters_collection()->add(g_perf_counters);
 
+  PerfCountersBuilder splb(g_ceph_context, "rbd_mirror_snapshot",
+                           rbd::mirror::l_rbd_mirror_snapshot_first,
+                           rbd::mirror::l_rbd_mirror_snapshot_last);
+  splb.add_u64_counter(rbd::mirror::l_rbd_mirror_snapshot_replay_snapshots,
+                       "snapshots", "Snapshots", "r", prio);
+  splb.add_time_avg(rbd::mirror::l_rbd_mirror_snapshot_replay_snapshots_time,
+                    "snapshots_time", "Snapshots time", "rl", prio);
+  splb.add_u64_counter(rbd::mirror::l_rbd_mirror_snapshot_replay_bytes,
+                       "replay_bytes", "Replayed data", "rb", prio,
+                       unit_t(UNIT_BYTES));
+  splb.add_u64_counter(rbd::mirror::l_rbd_mirror_snapshot_sync_objects,
+                       "sync_objects", "Objects synced or skipped as unchanged",
+                       "so", prio);
+  g_snapshot_perf_counters = splb.create_perf_counters();
+  g_ceph_context->get_perfcounters_collection()->add(g_snapshot_perf_counters);
+
   mirror = new rbd::mirror::Mirror(g_ceph_context, cmd_args);
   int r = mirror->init();
   if (r < 0) {
@@ -96,9 +113,12 @@ int main(int argc, const char **argv)
   shutdown_async_signal_handler();
 
   g_ceph_context->get_perfcounters_collection()->remove(g_perf_counters);
+  g_ceph_context->get_perfcounters_collection()->remove(
+    g_snapshot_perf_counters);
 
   delete mirror;
   delete g_perf_counters;
+  delete g_snapshot_perf_counters;
 
   return r < 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }